@@ -37,14 +37,40 @@ if [ $? -ne 0 ]; then
     exit 1
 fi
 
-# 检查libcamera
+# 检查libcamera（可选，没有时只能使用synthetic/replay帧来源）
+LIBCAMERA_FLAGS=""
+LIBCAMERA_SOURCES=""
 pkg-config --exists libcamera > /dev/null 2>&1
 if [ $? -ne 0 ]; then
-    echo "错误: 未安装libcamera库"
-    echo "请先安装: sudo apt install libcamera-dev libcamera-apps"
-    exit 1
+    echo "警告: 未安装libcamera库，只编译synthetic/replay帧来源"
+    echo "需要摄像头时请安装: sudo apt install libcamera-dev libcamera-apps"
+else
+    LIBCAMERA_FLAGS="-DCINEPI_HAVE_LIBCAMERA $(pkg-config --cflags --libs libcamera)"
+    LIBCAMERA_SOURCES="../src/shared/libcamera_frame_source.cpp"
+fi
+
+# 检查liburing（可选，没有时直接I/O落盘使用pwrite线程池）
+LIBURING_FLAGS=""
+pkg-config --exists liburing > /dev/null 2>&1
+if [ $? -eq 0 ]; then
+    LIBURING_FLAGS="-DCINEPI_HAVE_LIBURING $(pkg-config --cflags --libs liburing)"
 fi
 
+# 检查libjpeg（可选，没有时代理流只能输出YUV）
+LIBJPEG_FLAGS=""
+pkg-config --exists libjpeg > /dev/null 2>&1
+if [ $? -eq 0 ]; then
+    LIBJPEG_FLAGS="-DCINEPI_HAVE_LIBJPEG $(pkg-config --cflags --libs libjpeg)"
+fi
+
+# 帧来源相关的共享源文件
+FRAME_SOURCES="../src/shared/frame_source.cpp ../src/shared/software_frame_source.cpp \
+    ../src/shared/synthetic_frame_source.cpp ../src/shared/replay_frame_source.cpp \
+    ../src/shared/bit_pack.cpp ../src/shared/cpu_features.cpp ../src/shared/debayer.cpp ../src/shared/frame_stats.cpp \
+    ../src/shared/frame_pool.cpp ../src/shared/raw_sink.cpp ../src/shared/direct_raw_sink.cpp ../src/shared/raw_container.cpp ../src/shared/segmented_sink.cpp ../src/shared/storage_monitor.cpp ../src/shared/proxy_writer.cpp ../src/shared/raw_preview.cpp ../src/shared/preview_scaler.cpp ../src/shared/focus_peaking.cpp ../src/shared/exposure_overlay.cpp ../src/shared/scopes.cpp \
+    ../src/shared/raw_writer.cpp ../src/shared/worker_pool.cpp ../src/shared/sensor_profile.cpp \
+    ../src/shared/lj92.cpp ../src/shared/dng_writer.cpp ../src/shared/dng_sink.cpp $LIBCAMERA_SOURCES"
+
 echo "所有依赖检查通过!"
 echo ""
 
@@ -55,15 +81,16 @@ cd build
 
 # 编译预览应用
 echo "编译cinepi_preview应用..."
-g++ -std=c++17 ../cinepi_preview.cpp -o cinepi_preview \
-    $(pkg-config --cflags --libs libcamera) \
+g++ -std=c++17 -O2 -pthread ../cinepi_preview.cpp ../src/shared/camera_controller.cpp ../src/shared/sdl_helper.cpp $FRAME_SOURCES -o cinepi_preview \
+    -I../src/shared \
+    $LIBCAMERA_FLAGS $LIBURING_FLAGS $LIBJPEG_FLAGS \
     $(pkg-config --cflags --libs sdl2) \
     $(pkg-config --cflags --libs SDL2_ttf)
 
 if [ $? -eq 0 ]; then
     echo "编译成功!"
     echo ""
-    echo "运行预览应用: ./cinepi_preview"
+    echo "运行预览应用: ./cinepi_preview [--source libcamera|synthetic|replay:<文件>] [--headless] [--frames N]"
     echo ""
     echo "使用说明:"
     echo "  空格键: 开始/停止预览"
@@ -0,0 +1,339 @@
+// cinepi_bench.cpp
+// 图像处理内核基准测试：对每个CPU支持的指令集级别测量整帧吞吐量，并与标量结果逐字节比较
+//
+// 吞吐量按16位像素数据量（宽 x 高 x 2字节）计算，便于不同打包格式之间比较。
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bit_pack.h"
+#include "cpu_features.h"
+#include "debayer.h"
+#include "dng_writer.h"
+#include "exposure_overlay.h"
+#include "focus_peaking.h"
+#include "lj92.h"
+#include "preview_scaler.h"
+
+// 默认使用IMX477全分辨率
+const unsigned int BENCH_WIDTH = 4056;
+const unsigned int BENCH_HEIGHT = 3040;
+const int BENCH_ITERATIONS = 20;
+// 预览缩放的目标纹理尺寸（录制程序的预览窗口）
+const unsigned int SCALE_WIDTH = 1280;
+const unsigned int SCALE_HEIGHT = 960;
+
+// 命令行选项
+struct Options {
+    unsigned int width;
+    unsigned int height;
+    int iterations;
+
+    Options() : width(BENCH_WIDTH), height(BENCH_HEIGHT), iterations(BENCH_ITERATIONS) {}
+};
+
+// 测试用的一帧数据，各种编码由标量内核预先生成
+struct BenchFrame {
+    unsigned int width;
+    unsigned int height;
+    std::vector<uint16_t> pixels;       // 12位像素，无行尾填充
+    std::vector<uint8_t> csi2p12;       // CSI-2 12位打包，带32字节对齐的行步长
+    std::vector<uint8_t> csi2p10;       // CSI-2 10位打包，带32字节对齐的行步长
+    std::vector<uint8_t> bgr;           // 整帧8位RGB（B,G,R），预览缩放的输入
+};
+
+// 一个被测内核：run把结果写入out，out的内容用于与标量结果比较
+struct BenchKernel {
+    const char* name;
+    std::function<void(const BenchFrame& frame, std::vector<uint8_t>& out)> run;
+};
+
+cinepi::FrameView makeView(const BenchFrame& frame, const std::vector<uint8_t>& data, cinepi::PixelEncoding encoding) {
+    cinepi::FrameView view;
+    view.data = data.data();
+    view.size = data.size();
+    view.width = frame.width;
+    view.height = frame.height;
+    view.stride = cinepi::AlignedRawStride(encoding, frame.width);
+    view.format = cinepi::FrameFormat(encoding, cinepi::BayerOrder::RGGB, cinepi::EncodingBitDepth(encoding));
+    return view;
+}
+
+// 生成带低位噪声的渐变12位图像（接近实拍的熵），并用标量内核打包
+BenchFrame makeFrame(unsigned int width, unsigned int height) {
+    BenchFrame frame;
+    frame.width = width;
+    frame.height = height;
+    frame.pixels.resize(static_cast<size_t>(width) * height);
+    uint32_t seed = 0x12345678u;
+    for (unsigned int y = 0; y < height; ++y) {
+        for (unsigned int x = 0; x < width; ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            uint32_t gradient = static_cast<uint32_t>((static_cast<uint64_t>(x) + y) * 4000 / (width + height));
+            frame.pixels[static_cast<size_t>(y) * width + x] = static_cast<uint16_t>(gradient + (seed >> 27));
+        }
+    }
+
+    cinepi::SetBitPackLevel(cinepi::SimdLevel::Scalar);
+    std::vector<uint16_t> row10(width);
+    size_t stride12 = cinepi::AlignedRawStride(cinepi::PixelEncoding::BayerCsi2p12, width);
+    size_t stride10 = cinepi::AlignedRawStride(cinepi::PixelEncoding::BayerCsi2p10, width);
+    frame.csi2p12.assign(stride12 * height, 0);
+    frame.csi2p10.assign(stride10 * height, 0);
+    for (unsigned int y = 0; y < height; ++y) {
+        const uint16_t* src = frame.pixels.data() + static_cast<size_t>(y) * width;
+        cinepi::PackRow(cinepi::PixelEncoding::BayerCsi2p12, src, frame.csi2p12.data() + y * stride12, width);
+        for (unsigned int x = 0; x < width; ++x) {
+            row10[x] = static_cast<uint16_t>(src[x] >> 2);
+        }
+        cinepi::PackRow(cinepi::PixelEncoding::BayerCsi2p10, row10.data(), frame.csi2p10.data() + y * stride10, width);
+    }
+
+    // 三个通道取不同的位段，避免通道之间完全相同
+    frame.bgr.resize(frame.pixels.size() * 3);
+    for (size_t i = 0; i < frame.pixels.size(); ++i) {
+        uint16_t value = frame.pixels[i];
+        frame.bgr[i * 3] = static_cast<uint8_t>(value >> 4);
+        frame.bgr[i * 3 + 1] = static_cast<uint8_t>(value >> 3);
+        frame.bgr[i * 3 + 2] = static_cast<uint8_t>(value);
+    }
+    return frame;
+}
+
+std::vector<BenchKernel> makeKernels() {
+    std::vector<BenchKernel> kernels;
+    kernels.push_back(BenchKernel{ "unpack12", [](const BenchFrame& frame, std::vector<uint8_t>& out) {
+        out.resize(frame.pixels.size() * 2);
+        cinepi::UnpackFrame(makeView(frame, frame.csi2p12, cinepi::PixelEncoding::BayerCsi2p12), reinterpret_cast<uint16_t*>(out.data()));
+    } });
+    kernels.push_back(BenchKernel{ "unpack10", [](const BenchFrame& frame, std::vector<uint8_t>& out) {
+        out.resize(frame.pixels.size() * 2);
+        cinepi::UnpackFrame(makeView(frame, frame.csi2p10, cinepi::PixelEncoding::BayerCsi2p10), reinterpret_cast<uint16_t*>(out.data()));
+    } });
+    kernels.push_back(BenchKernel{ "pack12", [](const BenchFrame& frame, std::vector<uint8_t>& out) {
+        size_t stride = cinepi::AlignedRawStride(cinepi::PixelEncoding::BayerCsi2p12, frame.width);
+        out.resize(stride * frame.height);
+        for (unsigned int y = 0; y < frame.height; ++y) {
+            cinepi::PackRow(cinepi::PixelEncoding::BayerCsi2p12, frame.pixels.data() + static_cast<size_t>(y) * frame.width,
+                            out.data() + y * stride, frame.width);
+        }
+    } });
+    kernels.push_back(BenchKernel{ "tiff12", [](const BenchFrame& frame, std::vector<uint8_t>& out) {
+        size_t row_bytes = (static_cast<size_t>(frame.width) * 3 + 1) / 2;
+        out.resize(row_bytes * frame.height);
+        for (unsigned int y = 0; y < frame.height; ++y) {
+            cinepi::PackTiff12Row(frame.pixels.data() + static_cast<size_t>(y) * frame.width, out.data() + y * row_bytes, frame.width);
+        }
+    } });
+    kernels.push_back(BenchKernel{ "unstride12", [](const BenchFrame& frame, std::vector<uint8_t>& out) {
+        out.resize(frame.csi2p12.size());
+        out.resize(cinepi::RemoveStride(makeView(frame, frame.csi2p12, cinepi::PixelEncoding::BayerCsi2p12), out.data()));
+    } });
+    // 单线程半分辨率RAW预览（12位解包 + 分离颜色 + 查表），录制时按核心数分块并行
+    kernels.push_back(BenchKernel{ "debayer_half", [](const BenchFrame& frame, std::vector<uint8_t>& out) {
+        static cinepi::DebayerTone tone;
+        if (tone.green.empty()) {
+            cinepi::BuildDebayerTone(tone, 12, 256, 1.8f, 1.5f, 2.2f);
+        }
+        unsigned int stride = frame.width / 2 * 3;
+        out.resize(static_cast<size_t>(stride) * (frame.height / 2));
+        cinepi::DebayerHalf(makeView(frame, frame.csi2p12, cinepi::PixelEncoding::BayerCsi2p12), tone, out.data(), stride,
+                            0, frame.height / 2);
+    } });
+    // 单线程把整帧RGB盒式缩小到预览纹理（含黑边），录制时按核心数分块并行
+    kernels.push_back(BenchKernel{ "scale_1280", [](const BenchFrame& frame, std::vector<uint8_t>& out) {
+        unsigned int stride = SCALE_WIDTH * 3;
+        out.assign(static_cast<size_t>(stride) * SCALE_HEIGHT, 0);
+        cinepi::ScaleRect rect = cinepi::FitScaleRect(static_cast<int>(frame.width), static_cast<int>(frame.height),
+                                                      static_cast<int>(SCALE_WIDTH), static_cast<int>(SCALE_HEIGHT));
+        cinepi::BoxScaleRows(frame.bgr.data(), frame.width, frame.height, frame.width * 3, out.data(), stride, rect,
+                             0, static_cast<unsigned int>(rect.height));
+    } });
+    // 单线程在缩小后的预览上做峰值对焦（复制并上色），录制时按核心数分块并行
+    kernels.push_back(BenchKernel{ "peaking_1280", [](const BenchFrame& frame, std::vector<uint8_t>& out) {
+        static std::vector<uint8_t> preview;
+        unsigned int stride = SCALE_WIDTH * 3;
+        if (preview.empty()) {
+            preview.assign(static_cast<size_t>(stride) * SCALE_HEIGHT, 0);
+            cinepi::ScaleRect rect = cinepi::FitScaleRect(static_cast<int>(frame.width), static_cast<int>(frame.height),
+                                                          static_cast<int>(SCALE_WIDTH), static_cast<int>(SCALE_HEIGHT));
+            cinepi::BoxScaleRows(frame.bgr.data(), frame.width, frame.height, frame.width * 3, preview.data(), stride, rect,
+                                 0, static_cast<unsigned int>(rect.height));
+        }
+        out.resize(preview.size());
+        cinepi::FocusPeakingRows(preview.data(), SCALE_WIDTH, SCALE_HEIGHT, stride, out.data(), stride,
+                                 cinepi::PeakingConfig(), 0, SCALE_HEIGHT / 2);
+    } });
+    // 单线程由RAW值生成斑马纹叠加到预览纹理大小的图像（采样 + 查表），录制时按核心数分块并行
+    kernels.push_back(BenchKernel{ "zebra_1280", [](const BenchFrame& frame, std::vector<uint8_t>& out) {
+        static std::vector<uint32_t> lut;
+        if (lut.empty()) {
+            cinepi::ExposureOverlayConfig config;
+            config.mode = cinepi::ExposureOverlayMode::Zebra;
+            config.zebra_mid_ire = 70;
+            cinepi::BuildExposureLut(lut, config, 12, 256);
+        }
+        unsigned int stride = SCALE_WIDTH * 3;
+        out.assign(static_cast<size_t>(stride) * SCALE_HEIGHT, 0);
+        cinepi::ScaleRect rect = cinepi::FitScaleRect(static_cast<int>(frame.width), static_cast<int>(frame.height),
+                                                      static_cast<int>(SCALE_WIDTH), static_cast<int>(SCALE_HEIGHT));
+        cinepi::ExposureOverlayRows(makeView(frame, frame.csi2p12, cinepi::PixelEncoding::BayerCsi2p12), lut.data(),
+                                    cinepi::ExposureOverlayMode::Zebra, out.data(), stride, rect,
+                                    0, static_cast<unsigned int>(rect.height) / 2);
+    } });
+    // 压缩整帧，分块按DNG录制的任务划分分给全部核心，ms/帧即录制时编码线程池能持续的速度
+    kernels.push_back(BenchKernel{ "lj92", [](const BenchFrame& frame, std::vector<uint8_t>& out) {
+        static cinepi::WorkerPool pool;
+        cinepi::FrameView view = makeView(frame, frame.csi2p12, cinepi::PixelEncoding::BayerCsi2p12);
+        std::vector<std::vector<uint8_t>> tiles;
+        cinepi::EncodeDngTiles(view, pool, tiles);
+        out.clear();
+        for (const std::vector<uint8_t>& tile : tiles) {
+            out.insert(out.end(), tile.begin(), tile.end());
+        }
+    } });
+    return kernels;
+}
+
+// 逐块解码无损压缩结果并与原始像素比较，同时计算相对12位紧密打包的压缩比
+bool checkLosslessRoundTrip(const BenchFrame& frame, double& ratio) {
+    cinepi::FrameView view = makeView(frame, frame.csi2p12, cinepi::PixelEncoding::BayerCsi2p12);
+    unsigned int tiles_across = (frame.width + cinepi::DNG_TILE_SIZE - 1) / cinepi::DNG_TILE_SIZE;
+    std::vector<uint8_t> tile;
+    std::vector<uint16_t> decoded;
+    size_t compressed_bytes = 0;
+    for (size_t i = 0; i < cinepi::DngTileCount(view); ++i) {
+        unsigned int width = 0;
+        unsigned int height = 0;
+        cinepi::EncodeDngTile(view, i, tile);
+        compressed_bytes += tile.size();
+        if (!cinepi::DecodeLosslessJpeg(tile.data(), tile.size(), decoded, width, height) ||
+            width != cinepi::DNG_TILE_SIZE || height != cinepi::DNG_TILE_SIZE) {
+            return false;
+        }
+        unsigned int x0 = static_cast<unsigned int>(i % tiles_across) * cinepi::DNG_TILE_SIZE;
+        unsigned int y0 = static_cast<unsigned int>(i / tiles_across) * cinepi::DNG_TILE_SIZE;
+        for (unsigned int y = 0; y < height && y0 + y < frame.height; ++y) {
+            for (unsigned int x = 0; x < width && x0 + x < frame.width; ++x) {
+                if (decoded[static_cast<size_t>(y) * width + x] != frame.pixels[static_cast<size_t>(y0 + y) * frame.width + x0 + x]) {
+                    return false;
+                }
+            }
+        }
+    }
+    ratio = static_cast<double>(frame.pixels.size()) * 1.5 / compressed_bytes;
+    return true;
+}
+
+// 打印用法
+void print_usage(const char* program) {
+    std::cout << "用法: " << program << " [选项]" << std::endl
+              << "  --width <N>       帧宽度（默认4056）" << std::endl
+              << "  --height <N>      帧高度（默认3040）" << std::endl
+              << "  --iterations <N>  每个内核的重复次数（默认20）" << std::endl;
+}
+
+// 解析命令行参数
+bool parse_args(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--width" && i + 1 < argc) {
+            options.width = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--height" && i + 1 < argc) {
+            options.height = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            options.iterations = std::atoi(argv[++i]);
+        } else if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return false;
+        } else {
+            std::cerr << "未知参数: " << arg << std::endl;
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    if (options.width < 2 || options.height < 2 || options.iterations < 1) {
+        std::cerr << "参数无效" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        return 1;
+    }
+
+    std::cout << "帧大小: " << options.width << "x" << options.height << "，每个内核" << options.iterations << "次" << std::endl;
+    std::cout << "CPU最高指令集: " << cinepi::SimdLevelName(cinepi::DetectSimdLevel()) << std::endl;
+
+    BenchFrame frame = makeFrame(options.width, options.height);
+    std::vector<BenchKernel> kernels = makeKernels();
+    double frame_gigabytes = static_cast<double>(frame.pixels.size()) * 2 / 1e9;
+
+    // 标量结果作为参考
+    std::vector<std::vector<uint8_t>> reference(kernels.size());
+    cinepi::SetBitPackLevel(cinepi::SimdLevel::Scalar);
+    cinepi::SetDebayerLevel(cinepi::SimdLevel::Scalar);
+    cinepi::SetPreviewScalerLevel(cinepi::SimdLevel::Scalar);
+    cinepi::SetFocusPeakingLevel(cinepi::SimdLevel::Scalar);
+    cinepi::SetExposureOverlayLevel(cinepi::SimdLevel::Scalar);
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        kernels[k].run(frame, reference[k]);
+    }
+
+    bool all_match = true;
+    std::vector<uint8_t> out;
+    for (cinepi::SimdLevel level : cinepi::SupportedSimdLevels()) {
+        if (!cinepi::SetBitPackLevel(level)) {
+            continue;
+        }
+        cinepi::SetDebayerLevel(level);
+        cinepi::SetPreviewScalerLevel(level);
+        cinepi::SetFocusPeakingLevel(level);
+        cinepi::SetExposureOverlayLevel(level);
+        for (size_t k = 0; k < kernels.size(); ++k) {
+            out.clear();
+            kernels[k].run(frame, out);     // 预热，同时检查结果
+            bool match = out == reference[k];
+            all_match = all_match && match;
+
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < options.iterations; ++i) {
+                kernels[k].run(frame, out);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            double rate = frame_gigabytes * options.iterations / seconds;
+
+            std::cout << std::left << std::setw(8) << cinepi::SimdLevelName(level)
+                      << std::setw(12) << kernels[k].name << std::right
+                      << std::fixed << std::setprecision(2) << std::setw(8) << rate << " GB/s  "
+                      << std::setw(8) << seconds * 1000.0 / options.iterations << " ms/帧  "
+                      << (match ? "一致" : "不一致") << std::endl;
+        }
+    }
+
+    cinepi::SetBitPackLevel(cinepi::DetectSimdLevel());
+    cinepi::SetDebayerLevel(cinepi::DetectSimdLevel());
+    cinepi::SetPreviewScalerLevel(cinepi::DetectSimdLevel());
+    cinepi::SetFocusPeakingLevel(cinepi::DetectSimdLevel());
+    cinepi::SetExposureOverlayLevel(cinepi::DetectSimdLevel());
+    double ratio = 0.0;
+    bool lossless = checkLosslessRoundTrip(frame, ratio);
+    all_match = all_match && lossless;
+    std::cout << "lj92往返校验: " << (lossless ? "一致" : "不一致") << "，压缩比 " << std::setprecision(2) << ratio << ":1" << std::endl;
+
+    if (!all_match) {
+        std::cerr << "错误: SIMD内核结果与标量版本不一致" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -5,8 +5,16 @@
 #include <thread>
 #include <chrono>
 #include <string>
+#include <cstdlib>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
 #include "src/shared/sdl_helper.h"
 #include "src/shared/camera_controller.h"
+#include "src/shared/exposure_overlay.h"
+#include "src/shared/focus_peaking.h"
+#include "src/shared/scopes.h"
+#include "src/shared/worker_pool.h"
 
 using namespace cinepi;
 
@@ -21,19 +29,35 @@ const Color BACKGROUND_COLOR(0, 0, 0, 255);
 const Color HIGHLIGHT_COLOR(0, 255, 0, 255);
 const Color PANEL_COLOR(0, 0, 0, 128);
 
+// 可切换的传感器输出模式
+struct SensorMode {
+    int width;
+    int height;
+};
+const SensorMode SENSOR_MODES[] = {
+    { 1280, 720 },
+    { 1920, 1080 },
+    { 2028, 1520 },
+    { 4056, 3040 },
+};
+
+// 没有事件时的最长等待（毫秒）
+const int IDLE_WAIT_MS = 100;
+
 // 预览应用类
 class PreviewApp {
 public:
-    PreviewApp() : isRunning(false), window(nullptr, SDL_DestroyWindow), renderer(nullptr, SDL_DestroyRenderer), texture(nullptr, SDL_DestroyTexture), font(nullptr, TTF_CloseFont) {
+    PreviewApp() : isRunning(false), lastFrameGeneration(0), textureWidth(0), textureHeight(0), sensorModeIndex(0), frameLimit(0), frameEventType(0), needsRedraw(true), peakingEnabled(false), peakingCostMs(0.0), peakingCostMaxMs(0.0), peakingUpdates(0), overlayCostMs(0.0), overlayCostMaxMs(0.0), overlayUpdates(0), window(nullptr, SDL_DestroyWindow), renderer(nullptr, SDL_DestroyRenderer), texture(nullptr, SDL_DestroyTexture), scopeTexture(nullptr, SDL_DestroyTexture), font(nullptr, TTF_CloseFont), focusPeaking(overlayPool), exposureOverlay(overlayPool), scopes(overlayPool) {
     }
     
     ~PreviewApp() {
         cleanup();
     }
     
-    bool initialize() {
+    bool initialize(const CameraParams& params, bool headless) {
         try {
             // 初始化SDL辅助类
+            sdlHelper.SetHeadless(headless);
             sdlHelper.Initialize();
             
             // 创建窗口
@@ -42,15 +66,30 @@ public:
             // 创建渲染器
             renderer = MakeRenderer(sdlHelper.CreateRenderer(window.get()));
             
-            // 加载默认字体
-            font = MakeFont(sdlHelper.LoadFont("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", 16));
+            // 加载默认字体，失败时只是不显示文字
+            try {
+                font = MakeFont(sdlHelper.LoadFont("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", 16));
+            } catch (const std::exception& e) {
+                std::cerr << "无法加载字体: " << e.what() << std::endl;
+            }
+            
+            // 示波器纹理固定尺寸，半透明叠加
+            scopeTexture = MakeTexture(sdlHelper.CreateTexture(renderer.get(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, SCOPE_WIDTH, SCOPE_HEIGHT));
+            SDL_SetTextureBlendMode(scopeTexture.get(), SDL_BLENDMODE_BLEND);
+            updateScopeTexture();
             
             // 初始化摄像头控制器
-            CameraParams params(WINDOW_WIDTH, WINDOW_HEIGHT, 30, 12);
             cameraController.Initialize(params);
             
-            // 创建纹理
-            texture = MakeTexture(sdlHelper.CreateTexture(renderer.get(), SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING, WINDOW_WIDTH, WINDOW_HEIGHT));
+            // 新预览帧到达时推送事件唤醒主循环
+            frameEventType = sdlHelper.RegisterEvent();
+            Uint32 eventType = frameEventType;
+            cameraController.SetFrameNotifier([eventType]() {
+                SDLHelper::PushEvent(eventType);
+            });
+            
+            // 创建纹理（尺寸跟随预览帧，显示时再缩放到窗口）
+            ensureTexture(params.PreviewWidth(), params.PreviewHeight());
             
             isRunning = true;
             return true;
@@ -61,30 +100,57 @@ public:
         }
     }
     
+    // 采集到指定帧数后退出，0表示不限
+    void setFrameLimit(uint64_t limit) {
+        frameLimit = limit;
+    }
+    
+    // 斑马纹阈值，需在initialize之前设置
+    void setExposureOverlay(const ExposureOverlayConfig& config) {
+        exposureOverlay.SetConfig(config);
+    }
+    
+    // 示波器统计频率，需在initialize之前设置
+    void setScopeConfig(const ScopeConfig& config) {
+        scopes.SetConfig(config);
+    }
+    
     void run() {
         try {
             // 启动预览
             cameraController.StartPreview();
+            std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
             
             SDL_Event event;
             while (isRunning) {
-                // 处理事件
-                while (SDL_PollEvent(&event)) {
-                    handleEvent(event);
+                // 等待新帧或输入事件，空闲时不占用CPU
+                if (SDL_WaitEventTimeout(&event, IDLE_WAIT_MS)) {
+                    do {
+                        handleEvent(event);
+                    } while (SDL_PollEvent(&event));
                 }
                 
-                // 更新预览
-                updatePreview();
-                
-                // 绘制界面
-                render();
+                if (frameLimit > 0 && cameraController.GetCaptureTiming().frames >= frameLimit) {
+                    isRunning = false;
+                }
                 
-                // 控制帧率
-                std::this_thread::sleep_for(std::chrono::milliseconds(16)); // ~60fps
+                // 只有新帧或输入变化时才重绘，呈现由垂直同步节拍
+                if (needsRedraw) {
+                    needsRedraw = false;
+                    updatePreview();
+                    render();
+                }
             }
             
             // 停止预览
             cameraController.StopPreview();
+            
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            uint64_t frames = cameraController.GetCaptureTiming().frames;
+            std::cout << "共采集 " << frames << " 帧, 用时 " << std::fixed << std::setprecision(2) << elapsed << "s, "
+                      << (elapsed > 0 ? frames / elapsed : 0.0) << "fps" << std::endl;
+            TextCacheStats textStats = sdlHelper.GetTextCacheStats();
+            std::cout << "文字缓存: 绘制 " << textStats.draws << " 次, 上传纹理 " << textStats.uploads << " 次, 淘汰 " << textStats.evictions << " 次" << std::endl;
         } catch (const std::exception& e) {
             std::cerr << "运行时错误: " << e.what() << std::endl;
         }
@@ -95,12 +161,36 @@ private:
     WindowPtr window;
     RendererPtr renderer;
     TexturePtr texture;
+    TexturePtr scopeTexture;       // 示波器图像，叠加在预览右下角
     CameraController cameraController;
     FontPtr font;
+    WorkerPool overlayPool;        // 峰值对焦、曝光叠加和示波器共用的工作线程（全部核心）
+    FocusPeaking focusPeaking;
+    ExposureOverlay exposureOverlay;   // 由RAW值生成的斑马纹/伪色（Z键切换）
+    Scopes scopes;                 // 直方图/波形/RGB分量（S键切换），耗时由示波器自己统计
     bool isRunning;
+    uint64_t lastFrameGeneration;  // 已上传到纹理的预览帧代数
+    int textureWidth;
+    int textureHeight;
+    size_t sensorModeIndex;        // 当前传感器输出模式（R键切换）
+    uint64_t frameLimit;
+    Uint32 frameEventType;         // 新预览帧事件
+    bool needsRedraw;
+    bool peakingEnabled;           // 峰值对焦（F键切换）
+    double peakingCostMs;          // 峰值对焦的累计耗时
+    double peakingCostMaxMs;
+    uint64_t peakingUpdates;
+    double overlayCostMs;          // 曝光叠加的累计耗时
+    double overlayCostMaxMs;
+    uint64_t overlayUpdates;
     
     // 处理SDL事件
     void handleEvent(SDL_Event& event) {
+        if (event.type == frameEventType) {
+            needsRedraw = true;
+            return;
+        }
+        
         switch (event.type) {
             case SDL_QUIT:
                 isRunning = false;
@@ -108,12 +198,14 @@ private:
                 
             case SDL_KEYDOWN:
                 handleKeyPress(event.key.keysym.sym);
+                needsRedraw = true;
                 break;
                 
             case SDL_WINDOWEVENT:
                 if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
                     handleWindowResize(event.window.data1, event.window.data2);
                 }
+                needsRedraw = true;
                 break;
         }
     }
@@ -148,16 +240,54 @@ private:
             case SDLK_w:
                 cameraController.CycleWhiteBalance();
                 break;
+                
+            case SDLK_r:
+                cycleSensorMode();
+                break;
+                
+            case SDLK_f:
+                togglePeaking();
+                break;
+                
+            case SDLK_z:
+                cycleExposureOverlay();
+                break;
+                
+            case SDLK_s:
+                cycleScope();
+                break;
+                
+            case SDLK_d:
+                cycleScopeRate();
+                break;
         }
     }
     
-    // 处理窗口大小变化
+    // 处理窗口大小变化：显示时按比例缩放，不需要重新配置摄像头
     void handleWindowResize(int width, int height) {
-        // 更新预览分辨率
-        cameraController.SetResolution(width, height);
-        
-        // 重新创建纹理
-        texture = MakeTexture(sdlHelper.CreateTexture(renderer.get(), SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING, width, height));
+        std::cout << "窗口大小: " << width << "x" << height << std::endl;
+    }
+    
+    // 切换传感器输出模式，走重新配置路径
+    void cycleSensorMode() {
+        sensorModeIndex = (sensorModeIndex + 1) % (sizeof(SENSOR_MODES) / sizeof(SENSOR_MODES[0]));
+        try {
+            cameraController.SetResolution(SENSOR_MODES[sensorModeIndex].width, SENSOR_MODES[sensorModeIndex].height);
+        } catch (const std::exception& e) {
+            std::cerr << "切换传感器模式失败: " << e.what() << std::endl;
+        }
+    }
+    
+    // 纹理尺寸与预览帧不同时重新创建
+    void ensureTexture(int width, int height) {
+        if (texture && width == textureWidth && height == textureHeight) {
+            return;
+        }
+        // 取景流（libcamera RGB888）的字节顺序是B,G,R，与录制程序相同；峰值对焦的默认标记色按此顺序即为红色
+        texture = MakeTexture(sdlHelper.CreateTexture(renderer.get(), SDL_PIXELFORMAT_BGR24, SDL_TEXTUREACCESS_STREAMING, width, height));
+        textureWidth = width;
+        textureHeight = height;
+        lastFrameGeneration = 0;
     }
     
     // 切换预览状态
@@ -169,26 +299,114 @@ private:
         }
     }
     
+    // 开关峰值对焦，重新统计耗时
+    void togglePeaking() {
+        peakingEnabled = !peakingEnabled;
+        peakingCostMs = 0.0;
+        peakingCostMaxMs = 0.0;
+        peakingUpdates = 0;
+    }
+    
+    // 循环切换曝光辅助：关 → 斑马纹 → 伪色，重新统计耗时
+    void cycleExposureOverlay() {
+        ExposureOverlayConfig config = exposureOverlay.Config();
+        switch (config.mode) {
+            case ExposureOverlayMode::Off:   config.mode = ExposureOverlayMode::Zebra; break;
+            case ExposureOverlayMode::Zebra: config.mode = ExposureOverlayMode::FalseColour; break;
+            default:                         config.mode = ExposureOverlayMode::Off; break;
+        }
+        exposureOverlay.SetConfig(config);
+        overlayCostMs = 0.0;
+        overlayCostMaxMs = 0.0;
+        overlayUpdates = 0;
+    }
+    
+    // 循环切换示波器：关 → 直方图 → 波形 → RGB分量
+    void cycleScope() {
+        ScopeConfig config = scopes.Config();
+        config.mode = static_cast<ScopeMode>((static_cast<unsigned int>(config.mode) + 1) % SCOPE_MODE_COUNT);
+        scopes.SetConfig(config);
+    }
+    
+    // 切换示波器的统计频率（每N帧、采样网格步长），各示波器重新统计耗时
+    void cycleScopeRate() {
+        ScopeConfig config = scopes.Config();
+        NextScopeRate(config);
+        scopes.SetConfig(config);
+    }
+    
+    // 把最近一次的示波器统计画进示波器纹理（还没有统计时为空白底色）
+    void updateScopeTexture() {
+        void* pixels = nullptr;
+        int pitch = 0;
+        if (!scopeTexture || SDL_LockTexture(scopeTexture.get(), nullptr, &pixels, &pitch) != 0) {
+            return;
+        }
+        scopes.Render(static_cast<uint8_t*>(pixels), pitch);
+        SDL_UnlockTexture(scopeTexture.get());
+    }
+    
     // 更新预览画面
     void updatePreview() {
         if (!cameraController.IsPreviewing()) {
             return;
         }
         
-        // 获取预览帧数据
-        const uint8_t* frameData = cameraController.GetPreviewFrame();
-        if (!frameData) {
+        // 获取最新帧（持有租约期间缓冲不会被回收），没有新帧时跳过纹理上传
+        uint64_t generation = 0;
+        FrameLease frame = cameraController.GetLatestFrame(&generation);
+        if (!frame || !frame->viewfinder.IsValid() || generation == lastFrameGeneration) {
+            return;
+        }
+        lastFrameGeneration = generation;
+        
+        // 重新配置后预览尺寸可能变化
+        const FrameView& view = frame->viewfinder;
+        ensureTexture(static_cast<int>(view.width), static_cast<int>(view.height));
+        
+        // 示波器直接读传感器缓冲，按统计频率跳过的帧保留上一次的图像
+        if (scopes.Update(view.data, view.width, view.height, view.stride)) {
+            updateScopeTexture();
+        }
+        
+        // 没有叠加时直接上传传感器缓冲（按实际步长）
+        if (!peakingEnabled && exposureOverlay.Config().mode == ExposureOverlayMode::Off) {
+            SDL_UpdateTexture(texture.get(), nullptr, view.data, static_cast<int>(view.stride));
             return;
         }
         
-        // 更新纹理
-        int width = cameraController.GetWidth();
-        SDL_UpdateTexture(
-            texture.get(),
-            nullptr,
-            frameData,
-            width * 3 // RGB24格式，每行字节数
-        );
+        // 峰值对焦和曝光叠加都写入锁定的纹理（只写不读）
+        void* pixels = nullptr;
+        int pitch = 0;
+        if (SDL_LockTexture(texture.get(), nullptr, &pixels, &pitch) != 0) {
+            std::cerr << "纹理锁定失败: " << SDL_GetError() << std::endl;
+            return;
+        }
+        uint8_t* dst = static_cast<uint8_t*>(pixels);
+        if (peakingEnabled) {
+            // 从传感器缓冲复制到纹理，同时标出边缘
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            focusPeaking.Apply(view.data, view.width, view.height, view.stride, dst, pitch);
+            double cost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            peakingCostMs += cost;
+            peakingCostMaxMs = std::max(peakingCostMaxMs, cost);
+            ++peakingUpdates;
+        } else {
+            for (unsigned int y = 0; y < view.height; ++y) {
+                memcpy(dst + static_cast<size_t>(y) * pitch, view.data + static_cast<size_t>(y) * view.stride, static_cast<size_t>(view.width) * 3);
+            }
+        }
+        if (exposureOverlay.Config().mode != ExposureOverlayMode::Off) {
+            ScaleRect rect = { 0, 0, static_cast<int>(view.width), static_cast<int>(view.height) };
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if (exposureOverlay.Apply(frame->raw, cameraController.GetBlackLevel(), dst, pitch, rect)) {
+                double cost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                overlayCostMs += cost;
+                overlayCostMaxMs = std::max(overlayCostMaxMs, cost);
+                ++overlayUpdates;
+            }
+        }
+        SDL_UnlockTexture(texture.get());
     }
     
     // 绘制界面
@@ -199,7 +417,16 @@ private:
         
         // 绘制预览画面
         if (cameraController.IsPreviewing() && texture) {
-            SDL_RenderCopy(renderer.get(), texture.get(), nullptr, nullptr);
+            int outputWidth = 0;
+            int outputHeight = 0;
+            SDL_GetRendererOutputSize(renderer.get(), &outputWidth, &outputHeight);
+            SDL_Rect dst = SDLHelper::FitRect(textureWidth, textureHeight, outputWidth, outputHeight);
+            SDL_RenderCopy(renderer.get(), texture.get(), nullptr, &dst);
+            if (scopes.Config().mode != ScopeMode::Off && scopeTexture) {
+                SDL_Rect scopeRect = { dst.x + dst.w - static_cast<int>(SCOPE_WIDTH) - 10, dst.y + dst.h - static_cast<int>(SCOPE_HEIGHT) - 10,
+                                       static_cast<int>(SCOPE_WIDTH), static_cast<int>(SCOPE_HEIGHT) };
+                SDL_RenderCopy(renderer.get(), scopeTexture.get(), nullptr, &scopeRect);
+            }
         } else {
             // 绘制占位符
             SDL_SetRenderDrawColor(renderer.get(), 64, 64, 64, 255);
@@ -213,6 +440,7 @@ private:
         
         // 显示渲染结果
         SDL_RenderPresent(renderer.get());
+        cameraController.NotePreviewPresented();
     }
     
     // 绘制信息面板
@@ -235,11 +463,11 @@ private:
         sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, cameraController.IsPreviewing() ? HIGHLIGHT_COLOR : TEXT_COLOR);
         yPos += lineHeight;
         
-        infoText = "分辨率: " + std::to_string(cameraController.GetWidth()) + "x" + std::to_string(cameraController.GetHeight());
+        infoText = "分辨率: " + std::to_string(cameraController.GetWidth()) + "x" + std::to_string(cameraController.GetHeight()) + " (" + cameraController.GetSourceName() + ")";
         sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, TEXT_COLOR);
         yPos += lineHeight;
         
-        infoText = "帧率: " + std::to_string(cameraController.GetFPS()) + "fps";
+        infoText = "帧率: " + std::to_string(cameraController.GetFPS()) + "fps, 模式切换 " + std::to_string(static_cast<int>(cameraController.GetReconfigureTime())) + "ms";
         sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, TEXT_COLOR);
         yPos += lineHeight;
         
@@ -255,18 +483,82 @@ private:
         sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, TEXT_COLOR);
         yPos += lineHeight;
         
+        CaptureTimingStats timing = cameraController.GetCaptureTiming();
+        infoText = "采集回调: " + std::to_string(static_cast<int>(timing.average_us)) + "us (最大 " + std::to_string(static_cast<int>(timing.max_us)) + "us)";
+        sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, TEXT_COLOR);
+        yPos += lineHeight;
+        
+        FrameLeaseStats leaseStats = cameraController.GetLeaseStats();
+        infoText = "缓冲: " + std::to_string(leaseStats.leased) + "/" + std::to_string(leaseStats.pool_size) + " 租用, 耗尽 " + std::to_string(leaseStats.starvation_events) + "次";
+        sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, TEXT_COLOR);
+        yPos += lineHeight;
+        
+        ControlLatencyStats controlStats = cameraController.GetControlLatency();
+        infoText = "控制延迟: " + std::to_string(controlStats.last_latency_frames) + "帧 (最大 " + std::to_string(controlStats.max_latency_frames) + "帧, 代数 " + std::to_string(controlStats.applied_generation) + "/" + std::to_string(controlStats.requested_generation) + ")";
+        sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, TEXT_COLOR);
+        yPos += lineHeight;
+        
+        FrameStatsSnapshot frameStats = cameraController.GetFrameStats().Snapshot();
+        infoText = "丢帧: " + std::to_string(frameStats.dropped_frames) + "/" + std::to_string(frameStats.frames) + ", 最大抖动 " + std::to_string(static_cast<int>(frameStats.max_jitter_ms * 1000)) + "us";
+        sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, frameStats.dropped_frames > 0 ? HIGHLIGHT_COLOR : TEXT_COLOR);
+        yPos += lineHeight;
+        
+        infoText = "显示延迟: p50 " + std::to_string(static_cast<int>(frameStats.display_latency.p50_ms)) + "ms, p95 " + std::to_string(static_cast<int>(frameStats.display_latency.p95_ms)) + "ms";
+        sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, TEXT_COLOR);
+        yPos += lineHeight;
+        
+        infoText = "峰值对焦: " + std::string(peakingEnabled ? "开" : "关");
+        if (peakingEnabled && peakingUpdates > 0) {
+            infoText += ", " + std::to_string(static_cast<int>(peakingCostMs * 1000 / peakingUpdates)) + "us (最大 " + std::to_string(static_cast<int>(peakingCostMaxMs * 1000)) + "us)";
+        }
+        sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, peakingEnabled ? HIGHLIGHT_COLOR : TEXT_COLOR);
+        yPos += lineHeight;
+        
+        ExposureOverlayMode overlayMode = exposureOverlay.Config().mode;
+        infoText = "曝光辅助: " + std::string(ExposureOverlayModeName(overlayMode));
+        if (overlayMode != ExposureOverlayMode::Off && overlayUpdates > 0) {
+            infoText += ", " + std::to_string(static_cast<int>(overlayCostMs * 1000 / overlayUpdates)) + "us (最大 " + std::to_string(static_cast<int>(overlayCostMaxMs * 1000)) + "us)";
+        }
+        sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, overlayMode != ExposureOverlayMode::Off ? HIGHLIGHT_COLOR : TEXT_COLOR);
+        yPos += lineHeight;
+        
+        // 示波器：当前类型、统计频率，以及本频率下测过的每种示波器的平均耗时
+        const ScopeConfig& scopeConfig = scopes.Config();
+        infoText = "示波器: " + std::string(ScopeModeName(scopeConfig.mode)) + ", 每" + std::to_string(scopeConfig.interval) + "帧, 隔" + std::to_string(scopeConfig.step) + "像素";
+        for (unsigned int i = 1; i < SCOPE_MODE_COUNT; ++i) {
+            ScopeMode mode = static_cast<ScopeMode>(i);
+            ScopeCost cost = scopes.Cost(mode);
+            if (cost.updates > 0) {
+                infoText += ", " + std::string(ScopeModeName(mode)) + " " + std::to_string(static_cast<int>(cost.average_ms * 1000)) + "us";
+                if (mode == scopeConfig.mode) {
+                    infoText += " (最大 " + std::to_string(static_cast<int>(cost.max_ms * 1000)) + "us)";
+                }
+            }
+        }
+        sdlHelper.RenderText(renderer.get(), font.get(), infoText, 20, yPos, scopeConfig.mode != ScopeMode::Off ? HIGHLIGHT_COLOR : TEXT_COLOR);
+        yPos += lineHeight;
+        
         // 绘制控制提示
         sdlHelper.RenderText(renderer.get(), font.get(), "空格键: 切换预览", 20, yPos, TEXT_COLOR);
         yPos += lineHeight;
         sdlHelper.RenderText(renderer.get(), font.get(), "方向键: 调整参数", 20, yPos, TEXT_COLOR);
         yPos += lineHeight;
+        sdlHelper.RenderText(renderer.get(), font.get(), "R: 切换传感器模式", 20, yPos, TEXT_COLOR);
+        yPos += lineHeight;
+        sdlHelper.RenderText(renderer.get(), font.get(), "F: 峰值对焦", 20, yPos, TEXT_COLOR);
+        yPos += lineHeight;
+        sdlHelper.RenderText(renderer.get(), font.get(), "Z: 斑马纹/伪色", 20, yPos, TEXT_COLOR);
+        yPos += lineHeight;
+        sdlHelper.RenderText(renderer.get(), font.get(), "S: 示波器, D: 统计频率", 20, yPos, TEXT_COLOR);
+        yPos += lineHeight;
         sdlHelper.RenderText(renderer.get(), font.get(), "ESC: 退出", 20, yPos, TEXT_COLOR);
     }
     
     // 清理资源
     void cleanup() {
         isRunning = false;
-        // 资源会通过智能指针自动清理
+        // 缓存的文字纹理属于渲染器，须在渲染器销毁之前释放；其余资源会通过智能指针自动清理
+        sdlHelper.ClearTextCache();
     }
     
 
@@ -275,11 +567,47 @@ private:
 int main(int argc, char* argv[]) {
     std::cout << "启动CinePI摄像头预览应用..." << std::endl;
     
+    // 解析命令行参数
+    CameraParams params(WINDOW_WIDTH, WINDOW_HEIGHT, 30, 12);
+    bool headless = false;
+    uint64_t frameLimit = 0;
+    ExposureOverlayConfig exposureConfig;
+    ScopeConfig scopeConfig;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--source" && i + 1 < argc) {
+            if (!ParseFrameSource(argv[++i], params)) {
+                std::cerr << "未知的帧来源: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frameLimit = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--zebra" && i + 1 < argc) {
+            if (!ParseZebraLevels(argv[++i], exposureConfig)) {
+                std::cerr << "无效的斑马纹阈值: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--scope-rate" && i + 1 < argc) {
+            if (!ParseScopeRate(argv[++i], scopeConfig)) {
+                std::cerr << "无效的示波器统计频率: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else {
+            std::cout << "用法: " << argv[0] << " [--source libcamera|synthetic|replay:<文件>] [--headless] [--frames N] [--zebra <高>[,<中>]] [--scope-rate <N>[,<步长>]]" << std::endl;
+            return -1;
+        }
+    }
+    
     // 创建预览应用实例
     PreviewApp app;
+    app.setFrameLimit(frameLimit);
+    app.setExposureOverlay(exposureConfig);
+    app.setScopeConfig(scopeConfig);
     
     // 初始化应用
-    if (!app.initialize()) {
+    if (!app.initialize(params, headless)) {
         std::cerr << "应用初始化失败！" << std::endl;
         return -1;
     }
@@ -9,9 +9,23 @@
 #include <cstdlib>
 #include <memory>
 #include <cstring>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
 
 // 自定义头文件
 #include "camera_controller.h"
+#include "exposure_overlay.h"
+#include "focus_peaking.h"
+#include "proxy_writer.h"
+#include "raw_container.h"
+#include "preview_scaler.h"
+#include "raw_preview.h"
+#include "raw_writer.h"
+#include "scopes.h"
+#include "segmented_sink.h"
+#include "storage_monitor.h"
 #include "sdl_helper.h"
 
 // 定义录制参数
@@ -21,6 +35,35 @@ const int RECORD_WIDTH = 4056;   // IMX477最大分辨率宽度
 const int RECORD_HEIGHT = 3040;  // IMX477最大分辨率高度
 const int FRAME_RATE = 24;       // 录制帧率
 const int BIT_DEPTH = 12;        // 位深度
+const int IDLE_WAIT_MS = 100;    // 没有事件时的最长等待，用于检查写入错误等状态
+
+// 命令行选项
+struct Options {
+    std::string record_dir;
+    cinepi::CameraParams camera_params;
+    bool headless;          // 无界面运行（CI）
+    bool record_on_start;   // 启动后立即开始录制
+    uint64_t frame_limit;   // 采集到指定帧数后退出，0表示不限
+    cinepi::RawWriterConfig writer_config;  // 写入队列容量与队列满时的策略
+    cinepi::RawSinkType sink_type;          // 落盘方式
+    std::string repair_path;                // 修复未正常关闭的RAW容器后退出
+    double preroll_seconds;                 // 预卷时长（秒），0表示不预卷
+    cinepi::SegmentConfig segment_config;   // 长镜头分段条件
+    cinepi::StorageConfig storage_config;   // 保留空间、测速和带宽准入
+    bool proxy_enabled;                     // 同时录制低分辨率代理
+    cinepi::ProxyConfig proxy_config;
+    size_t preview_threads;                 // 预览缩放和RAW去马赛克的线程数，0表示全部核心
+    cinepi::ExposureOverlayConfig exposure_config;  // 斑马纹阈值（Z键切换模式）
+    cinepi::ScopeConfig scope_config;               // 示波器统计频率（S键切换示波器，D键切换频率）
+
+    Options() : camera_params(RECORD_WIDTH, RECORD_HEIGHT, FRAME_RATE, BIT_DEPTH),
+                headless(false), record_on_start(false), frame_limit(0), sink_type(cinepi::RawSinkType::Buffered),
+                preroll_seconds(0.0), proxy_enabled(false), preview_threads(0) {
+        // 取景流按预览窗口尺寸输出，不需要整幅RGB
+        camera_params.preview_width = PREVIEW_WIDTH;
+        camera_params.preview_height = PREVIEW_HEIGHT;
+    }
+};
 
 // 录制状态
 enum RecordingStatus {
@@ -35,10 +78,41 @@ struct AppState {
     cinepi::CameraController camera_controller;
     cinepi::WindowPtr window;
     cinepi::RendererPtr renderer;
-    cinepi::TexturePtr texture;
+    cinepi::TexturePtr texture;         // 固定为预览窗口尺寸，帧按宽高比缩放进来
+    cinepi::TexturePtr scope_texture;   // 示波器图像，叠加在预览右下角
     cinepi::FontPtr font;
-    std::unique_ptr<std::ofstream> raw_file;
+    cinepi::RawWriter raw_writer;       // 采集线程入队，写入线程落盘
+    cinepi::StorageMonitor storage_monitor;
+    cinepi::ProxyWriter proxy_writer;   // 写入线程落盘后旁路生成代理
+    bool proxy_enabled;
+    cinepi::ProxyConfig proxy_config;
+    std::unique_ptr<cinepi::WorkerPool> preview_pool;  // 预览缩放和RAW去马赛克共用的线程
+    std::unique_ptr<cinepi::PreviewScaler> preview_scaler;
+    std::unique_ptr<cinepi::RawPreview> raw_preview;   // 非空时预览由RAW帧生成，不使用取景流
+    std::vector<uint8_t> raw_preview_buffer;            // RAW预览的半分辨率图像，缩放前
+    int preview_source_width;           // 最近一帧缩放前的尺寸
+    int preview_source_height;
+    std::unique_ptr<cinepi::FocusPeaking> focus_peaking;
+    bool peaking_enabled;               // F键切换
+    std::vector<uint8_t> peaking_buffer;                // 峰值对焦时先缩放到这里，上色后写入纹理
+    int64_t peaking_cost_ns;            // 峰值对焦的累计耗时（不含缩放）
+    int64_t peaking_cost_max_ns;
+    uint64_t peaking_updates;
+    std::unique_ptr<cinepi::ExposureOverlay> exposure_overlay;  // 由RAW值生成的斑马纹/伪色（Z键切换）
+    int64_t overlay_cost_ns;            // 曝光叠加的累计耗时
+    int64_t overlay_cost_max_ns;
+    uint64_t overlay_updates;
+    std::unique_ptr<cinepi::Scopes> scopes;             // 直方图/波形/RGB分量（S键切换），耗时由示波器自己统计
+    cinepi::RawWriterConfig writer_config;
+    cinepi::RawSinkType sink_type;
+    cinepi::SegmentConfig segment_config;
+    bool write_error;
     RecordingStatus recording_status;
+    uint64_t last_frame_generation;     // 已上传到纹理的预览帧代数
+    int64_t preview_cost_ns;            // 更新预览纹理的累计耗时（取景流上传或RAW去马赛克）
+    int64_t preview_cost_max_ns;
+    uint64_t preview_updates;
+    Uint32 frame_event_type;            // 新预览帧到达时推送的SDL事件
     std::string record_dir;
     std::string current_filename;
     bool running;
@@ -48,10 +122,16 @@ struct AppState {
     int iso;
     int white_balance;
     
-    AppState() : recording_status(IDLE), running(true),
+    AppState() : proxy_enabled(false), preview_source_width(0), preview_source_height(0), peaking_enabled(false),
+                 peaking_cost_ns(0), peaking_cost_max_ns(0), peaking_updates(0),
+                 overlay_cost_ns(0), overlay_cost_max_ns(0), overlay_updates(0), sink_type(cinepi::RawSinkType::Buffered), write_error(false), recording_status(IDLE),
+                 last_frame_generation(0), preview_cost_ns(0), preview_cost_max_ns(0), preview_updates(0), frame_event_type(0), running(true),
                  exposure_compensation(0.0f), iso(100), white_balance(4000),
                  window(nullptr, SDL_DestroyWindow), renderer(nullptr, SDL_DestroyRenderer),
-                 texture(nullptr, SDL_DestroyTexture), font(nullptr, TTF_CloseFont) {}
+                 texture(nullptr, SDL_DestroyTexture), scope_texture(nullptr, SDL_DestroyTexture), font(nullptr, TTF_CloseFont) {}
+    
+    // 缓存的文字纹理属于渲染器，须在渲染器销毁之前释放
+    ~AppState() { sdl_helper.ClearTextCache(); }
 };
 
 // 获取当前时间作为文件名
@@ -91,12 +171,46 @@ bool create_record_directory(const std::string& dir_path) {
     return true;
 }
 
+// 当前摄像头配置下的录制描述
+// .raw按步长写入整帧（包含行尾填充），格式见GetRawFormat()
+cinepi::RecordingInfo make_recording_info(AppState& state) {
+    cinepi::RecordingInfo info;
+    info.format = state.camera_controller.GetRawFormat();
+    info.width = static_cast<unsigned int>(state.camera_controller.GetWidth());
+    info.height = static_cast<unsigned int>(state.camera_controller.GetHeight());
+    info.frame_bytes = state.camera_controller.GetRawFrameBytes();
+    info.fps = state.camera_controller.GetFPS();
+    info.black_level = state.camera_controller.GetBlackLevel();
+    info.iso = state.iso;
+    info.white_balance = state.white_balance;
+    info.exposure_compensation = state.exposure_compensation;
+    return info;
+}
+
+// 当前格式和帧率下录制需要的数据率（MB/s）；压缩输出按未压缩计算，偏保守
+double required_mb_per_s(AppState& state) {
+    return static_cast<double>(state.camera_controller.GetRawFrameBytes()) * state.camera_controller.GetFPS() / (1024.0 * 1024.0);
+}
+
+// 把最近一次的示波器统计画进示波器纹理（还没有统计时为空白底色）
+void upload_scopes(AppState& state) {
+    void* pixels = nullptr;
+    int pitch = 0;
+    if (SDL_LockTexture(state.scope_texture.get(), nullptr, &pixels, &pitch) != 0) {
+        std::cerr << "示波器纹理锁定失败: " << SDL_GetError() << std::endl;
+        return;
+    }
+    state.scopes->Render(static_cast<uint8_t*>(pixels), static_cast<unsigned int>(pitch));
+    SDL_UnlockTexture(state.scope_texture.get());
+}
+
 // 初始化应用程序
-bool init_app(AppState& state, const std::string& record_dir) {
+bool init_app(AppState& state, const Options& options) {
     bool success = false;
     
     try {
         // 初始化SDL
+        state.sdl_helper.SetHeadless(options.headless);
         state.sdl_helper.Initialize();
         
         // 创建窗口、渲染器和纹理
@@ -112,40 +226,88 @@ bool init_app(AppState& state, const std::string& record_dir) {
             return false;
         }
         
-        state.texture = cinepi::MakeTexture(state.sdl_helper.CreateTexture(state.renderer.get(), SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING, PREVIEW_WIDTH, PREVIEW_HEIGHT));
+        // 取景流（libcamera RGB888）和RAW去马赛克输出的字节顺序都是B,G,R
+        state.texture = cinepi::MakeTexture(state.sdl_helper.CreateTexture(state.renderer.get(), SDL_PIXELFORMAT_BGR24, SDL_TEXTUREACCESS_STREAMING, PREVIEW_WIDTH, PREVIEW_HEIGHT));
         if (!state.texture) {
             std::cerr << "无法创建纹理" << std::endl;
             return false;
         }
+        state.preview_pool.reset(new cinepi::WorkerPool(options.preview_threads));
+        state.preview_scaler.reset(new cinepi::PreviewScaler(*state.preview_pool));
+        if (options.camera_params.raw_preview) {
+            state.raw_preview.reset(new cinepi::RawPreview(*state.preview_pool));
+        }
+        // 纹理是BGR24，默认标记色（B,G,R = 0,0,255）为红色
+        state.focus_peaking.reset(new cinepi::FocusPeaking(*state.preview_pool));
+        state.exposure_overlay.reset(new cinepi::ExposureOverlay(*state.preview_pool));
+        state.exposure_overlay->SetConfig(options.exposure_config);
+        state.scopes.reset(new cinepi::Scopes(*state.preview_pool));
+        state.scopes->SetConfig(options.scope_config);
+        state.scope_texture = cinepi::MakeTexture(state.sdl_helper.CreateTexture(state.renderer.get(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, cinepi::SCOPE_WIDTH, cinepi::SCOPE_HEIGHT));
+        if (!state.scope_texture) {
+            std::cerr << "无法创建示波器纹理" << std::endl;
+            return false;
+        }
+        SDL_SetTextureBlendMode(state.scope_texture.get(), SDL_BLENDMODE_BLEND);
+        upload_scopes(state);
         
-        state.font = cinepi::MakeFont(state.sdl_helper.LoadFont("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", 16));
-        if (!state.font) {
-            std::cerr << "无法加载字体" << std::endl;
-            // 字体加载失败不影响核心功能，继续执行
+        try {
+            state.font = cinepi::MakeFont(state.sdl_helper.LoadFont("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", 16));
+        } catch (const std::exception& e) {
+            // 字体加载失败不影响核心功能，继续执行（CI机器上通常没有字体）
+            std::cerr << "无法加载字体: " << e.what() << std::endl;
         }
         
         // 初始化摄像头控制器
-        cinepi::CameraParams params;
-        params.width = RECORD_WIDTH;
-        params.height = RECORD_HEIGHT;
-        params.fps = FRAME_RATE;
-        params.bit_depth = BIT_DEPTH;
+        cinepi::CameraParams params = options.camera_params;
         params.exposure_compensation = state.exposure_compensation;
         params.iso = state.iso;
         params.white_balance = state.white_balance;
         
         state.camera_controller.Initialize(params);
         
+        // 新预览帧到达时唤醒主循环
+        state.frame_event_type = state.sdl_helper.RegisterEvent();
+        Uint32 frame_event_type = state.frame_event_type;
+        state.camera_controller.SetFrameNotifier([frame_event_type]() {
+            cinepi::SDLHelper::PushEvent(frame_event_type);
+        });
+        
+        // RAW帧在回调中复制进写入队列，未在录制时直接返回
+        state.writer_config = options.writer_config;
+        state.sink_type = options.sink_type;
+        state.segment_config = options.segment_config;
+        if (state.segment_config.IsEnabled() && !cinepi::IsFileRawSink(state.sink_type)) {
+            std::cerr << "警告: DNG序列每帧一个文件，忽略分段设置" << std::endl;
+            state.segment_config = cinepi::SegmentConfig();
+        }
+        state.writer_config.stats = &state.camera_controller.GetFrameStats();
+        state.proxy_enabled = options.proxy_enabled;
+        state.proxy_config = options.proxy_config;
+        if (state.proxy_enabled) {
+            state.writer_config.tap = &state.proxy_writer;
+        }
+        state.camera_controller.SetFrameCallback([&state](const cinepi::FrameLease& lease) {
+            state.raw_writer.Submit(lease);
+        });
+        
+        // 预卷：按帧率折算帧数，队列内存按系统可用内存检查，不够时启动失败
+        if (options.preroll_seconds > 0) {
+            state.writer_config.preroll_frames = static_cast<size_t>(std::ceil(options.preroll_seconds * state.camera_controller.GetFPS()));
+            state.raw_writer.Arm(make_recording_info(state), state.writer_config);
+        }
+        
         // 启动摄像头预览
         state.camera_controller.StartPreview();
         
         // 设置录制目录
-        state.record_dir = record_dir;
+        state.record_dir = options.record_dir;
         if (!create_record_directory(state.record_dir)) {
             // 清理已初始化的资源
             state.camera_controller.StopPreview();
             return false;
         }
+        state.storage_monitor.Open(state.record_dir, options.storage_config);
         
         state.recording_status = IDLE;
         state.running = true;
@@ -164,21 +326,111 @@ bool init_app(AppState& state, const std::string& record_dir) {
     return success;
 }
 
+// 把预览帧缩放进纹理（采集尺寸与显示尺寸无关）：RAW预览先半分辨率去马赛克，取景流直接缩放
+void upload_preview(AppState& state, const cinepi::CapturedFrame& frame) {
+    cinepi::FrameView source = frame.viewfinder;
+    if (state.raw_preview) {
+        int width = 0;
+        int height = 0;
+        if (!cinepi::RawPreview::OutputSize(frame.raw, width, height)) {
+            return;
+        }
+        source = cinepi::FrameView();
+        source.width = static_cast<unsigned int>(width);
+        source.height = static_cast<unsigned int>(height);
+        source.stride = source.width * 3;
+        state.raw_preview_buffer.resize(static_cast<size_t>(source.stride) * source.height);
+        source.data = state.raw_preview_buffer.data();
+        state.raw_preview->Render(frame, state.camera_controller.GetBlackLevel(), state.raw_preview_buffer.data(), source.stride);
+    }
+    if (!source.data || source.width == 0 || source.height == 0) {
+        return;
+    }
+
+    void* pixels = nullptr;
+    int pitch = 0;
+    if (SDL_LockTexture(state.texture.get(), nullptr, &pixels, &pitch) != 0) {
+        std::cerr << "纹理锁定失败: " << SDL_GetError() << std::endl;
+        return;
+    }
+    uint8_t* texture_pixels = static_cast<uint8_t*>(pixels);
+    if (state.peaking_enabled) {
+        // 峰值对焦要读缩放结果，先缩放到内存中，上色时再写入纹理（锁定的纹理只写不读）
+        unsigned int stride = PREVIEW_WIDTH * 3;
+        state.peaking_buffer.resize(static_cast<size_t>(stride) * PREVIEW_HEIGHT);
+        state.preview_scaler->Scale(source.data, source.width, source.height, source.stride,
+                                    state.peaking_buffer.data(), PREVIEW_WIDTH, PREVIEW_HEIGHT, stride);
+        int64_t start_ns = cinepi::MonotonicNowNs();
+        state.focus_peaking->Apply(state.peaking_buffer.data(), PREVIEW_WIDTH, PREVIEW_HEIGHT, stride,
+                                   texture_pixels, static_cast<unsigned int>(pitch));
+        int64_t cost_ns = cinepi::MonotonicNowNs() - start_ns;
+        state.peaking_cost_ns += cost_ns;
+        state.peaking_cost_max_ns = std::max(state.peaking_cost_max_ns, cost_ns);
+        ++state.peaking_updates;
+    } else {
+        state.preview_scaler->Scale(source.data, source.width, source.height, source.stride,
+                                    texture_pixels, PREVIEW_WIDTH, PREVIEW_HEIGHT, static_cast<unsigned int>(pitch));
+    }
+
+    // 斑马纹/伪色直接写入纹理中图像所在的区域
+    if (state.exposure_overlay->Config().mode != cinepi::ExposureOverlayMode::Off) {
+        cinepi::ScaleRect rect = cinepi::FitScaleRect(static_cast<int>(source.width), static_cast<int>(source.height), PREVIEW_WIDTH, PREVIEW_HEIGHT);
+        int64_t start_ns = cinepi::MonotonicNowNs();
+        if (state.exposure_overlay->Apply(frame.raw, state.camera_controller.GetBlackLevel(), texture_pixels,
+                                          static_cast<unsigned int>(pitch), rect)) {
+            int64_t cost_ns = cinepi::MonotonicNowNs() - start_ns;
+            state.overlay_cost_ns += cost_ns;
+            state.overlay_cost_max_ns = std::max(state.overlay_cost_max_ns, cost_ns);
+            ++state.overlay_updates;
+        }
+    }
+
+    SDL_UnlockTexture(state.texture.get());
+    state.preview_source_width = static_cast<int>(source.width);
+    state.preview_source_height = static_cast<int>(source.height);
+
+    // 示波器由缩放前的图像统计，按统计频率跳过的帧保留上一次的图像
+    if (state.scopes->Update(source.data, source.width, source.height, source.stride)) {
+        upload_scopes(state);
+    }
+}
+
 // 更新预览窗口
 void update_preview(AppState& state) {
     try {
-        // 获取最新帧
-        const uint8_t* frame_data = state.camera_controller.GetPreviewFrame();
-        if (!frame_data) return;
+        // 获取最新帧，持有租约期间缓冲不会被回收
+        uint64_t generation = 0;
+        cinepi::FrameLease frame = state.camera_controller.GetLatestFrame(&generation);
+        if (!frame) return;
         
         // 清除渲染器
         SDL_SetRenderDrawColor(state.renderer.get(), 0, 0, 0, 255);
         SDL_RenderClear(state.renderer.get());
         
-        // 绘制帧
+        // 只有新帧到达时才更新纹理，记录耗时用于比较两种预览路径
+        if (state.texture && generation != state.last_frame_generation) {
+            int64_t start_ns = cinepi::MonotonicNowNs();
+            upload_preview(state, frame.Frame());
+            int64_t cost_ns = cinepi::MonotonicNowNs() - start_ns;
+            state.preview_cost_ns += cost_ns;
+            state.preview_cost_max_ns = std::max(state.preview_cost_max_ns, cost_ns);
+            ++state.preview_updates;
+            state.last_frame_generation = generation;
+        }
+        frame.Release();
+        
+        // 绘制帧，窗口大小变化时按比例缩放显示，不影响摄像头配置
         if (state.texture) {
-            SDL_UpdateTexture(state.texture.get(), nullptr, frame_data, PREVIEW_WIDTH * 3);
-            SDL_RenderCopy(state.renderer.get(), state.texture.get(), nullptr, nullptr);
+            int output_width = 0;
+            int output_height = 0;
+            SDL_GetRendererOutputSize(state.renderer.get(), &output_width, &output_height);
+            SDL_Rect dst = cinepi::SDLHelper::FitRect(PREVIEW_WIDTH, PREVIEW_HEIGHT, output_width, output_height);
+            SDL_RenderCopy(state.renderer.get(), state.texture.get(), nullptr, &dst);
+            if (state.scopes->Config().mode != cinepi::ScopeMode::Off) {
+                SDL_Rect scope_rect = { dst.x + dst.w - static_cast<int>(cinepi::SCOPE_WIDTH) - 10, dst.y + dst.h - static_cast<int>(cinepi::SCOPE_HEIGHT) - 10,
+                                        static_cast<int>(cinepi::SCOPE_WIDTH), static_cast<int>(cinepi::SCOPE_HEIGHT) };
+                SDL_RenderCopy(state.renderer.get(), state.scope_texture.get(), nullptr, &scope_rect);
+            }
         }
         
         // 渲染状态信息
@@ -186,13 +438,14 @@ void update_preview(AppState& state) {
         cinepi::Color red = {255, 0, 0, 255};
         
         std::stringstream status_text;
-        status_text << "CinePI RAW录制 - " << RECORD_WIDTH << "x" << RECORD_HEIGHT << " " << FRAME_RATE << "fps";
+        status_text << "CinePI RAW录制 - " << state.camera_controller.GetWidth() << "x" << state.camera_controller.GetHeight()
+                    << " " << state.camera_controller.GetFPS() << "fps (" << state.camera_controller.GetSourceName() << ")";
         state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), status_text.str(), 10, 10, white);
         
         // 录制状态
         if (state.recording_status == RECORDING) {
             state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), "录制中...", 10, 30, red);
-            state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), "文件: " + state.current_filename, 10, 50, white);
+            state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), "文件: " + state.current_filename + "  帧数: " + std::to_string(state.raw_writer.GetStats().frames_written), 10, 50, white);
         } else {
             state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), "准备录制", 10, 30, white);
         }
@@ -217,20 +470,144 @@ void update_preview(AppState& state) {
         state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), "W键: 循环切换白平衡", 10, 190, white);
         state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), "ESC键: 退出", 10, 210, white);
         
-        // 更新屏幕
-        SDL_RenderPresent(state.renderer.get());
+        // 采集回调耗时
+        cinepi::CaptureTimingStats timing = state.camera_controller.GetCaptureTiming();
+        params_text.str("");
+        params_text << "采集回调: 平均 " << std::setprecision(2) << timing.average_us / 1000.0
+                    << "ms, 最大 " << timing.max_us / 1000.0 << "ms";
+        state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 230, white);
         
-        // 如果正在录制，将帧保存到文件
-        if (state.recording_status == RECORDING && state.raw_file) {
-            try {
-                // 这里应该保存RAW数据，而不是预览数据
-                // 由于我们没有实际的RAW流，这里只是演示
-                // state.raw_file->write(reinterpret_cast<const char*>(raw_frame_data), raw_frame_size);
-            } catch (const std::exception& e) {
-                std::cerr << "写入RAW数据时发生异常: " << e.what() << std::endl;
-                state.recording_status = STOPPING;
+        // 帧缓冲租用情况
+        cinepi::FrameLeaseStats lease_stats = state.camera_controller.GetLeaseStats();
+        params_text.str("");
+        params_text << "缓冲: " << lease_stats.leased << "/" << lease_stats.pool_size << " 租用, 耗尽 " << lease_stats.starvation_events << "次";
+        state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 250,
+                                    lease_stats.starvation_events > 0 ? red : white);
+        
+        // 控制参数生效延迟
+        cinepi::ControlLatencyStats control_stats = state.camera_controller.GetControlLatency();
+        params_text.str("");
+        params_text << "控制延迟: " << control_stats.last_latency_frames << "帧 (最大 " << control_stats.max_latency_frames
+                    << "帧, 代数 " << control_stats.applied_generation << "/" << control_stats.requested_generation << ")";
+        state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 270, white);
+        
+        // 帧时序：丢帧、抖动和延迟
+        cinepi::FrameStatsSnapshot frame_stats = state.camera_controller.GetFrameStats().Snapshot();
+        params_text.str("");
+        params_text << "丢帧: " << frame_stats.dropped_frames << "/" << frame_stats.frames
+                    << ", 帧间隔 " << frame_stats.mean_interval_ms << "ms, 最大抖动 " << frame_stats.max_jitter_ms << "ms";
+        state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 290,
+                                    frame_stats.dropped_frames > 0 ? red : white);
+        params_text.str("");
+        params_text << "延迟 显示: " << frame_stats.display_latency.p50_ms << "/" << frame_stats.display_latency.p95_ms
+                    << "ms, 落盘: " << frame_stats.disk_latency.p50_ms << "/" << frame_stats.disk_latency.p95_ms << "ms (p50/p95)";
+        state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 310, white);
+        
+        // 写入队列占用
+        cinepi::RawWriterStats writer_stats = state.raw_writer.GetStats();
+        params_text.str("");
+        params_text << "写入队列: " << writer_stats.queued << "/" << writer_stats.capacity << " (峰值 " << writer_stats.high_water
+                    << "), 丢弃 " << writer_stats.frames_dropped << ", " << std::setprecision(1) << writer_stats.write_mb_per_s << "MB/s";
+        state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 330,
+                                    writer_stats.frames_dropped > 0 ? red : white);
+        params_text.str("");
+        params_text << "落盘(" << state.raw_writer.GetSinkName() << "): 单次写入 平均 " << std::setprecision(2)
+                    << writer_stats.sink.mean_write_ms << "ms, 最大 " << writer_stats.sink.max_write_ms << "ms";
+        state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 350, white);
+        
+        // 预卷缓冲：未录制时显示已积累的时长，录制时显示写在开头的预卷帧
+        if (writer_stats.preroll_capacity > 0) {
+            double fps = std::max(state.camera_controller.GetFPS(), 1);
+            params_text.str("");
+            if (state.recording_status == RECORDING) {
+                params_text << "预卷: 开头 " << std::setprecision(1) << writer_stats.preroll_flushed / fps << "s ("
+                            << writer_stats.preroll_flushed << "帧)";
+            } else {
+                params_text << "预卷: " << std::setprecision(1) << writer_stats.preroll_held / fps << "s / "
+                            << writer_stats.preroll_capacity / fps << "s (" << writer_stats.preroll_held << "帧)";
+            }
+            state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 370, white);
+        }
+        
+        // 存储：可录时长和带宽余量，不到5分钟或落盘跟不上时标红
+        cinepi::StorageSnapshot storage = state.storage_monitor.Snapshot();
+        double bandwidth = state.recording_status == RECORDING ? storage.measured_mb_per_s : storage.probe_mb_per_s;
+        params_text.str("");
+        params_text << "存储: 剩余 " << std::setprecision(1) << storage.free_bytes / (1024.0 * 1024.0 * 1024.0) << "GB, 约 "
+                    << static_cast<int>(storage.remaining_seconds / 60) << "分钟, ";
+        if (storage.probing) {
+            params_text << "测速中";
+        } else if (bandwidth > 0) {
+            params_text << (state.recording_status == RECORDING ? "落盘 " : "测速 ") << static_cast<int>(bandwidth) << "/"
+                        << static_cast<int>(storage.required_mb_per_s) << "MB/s (余量 " << std::showpos
+                        << static_cast<int>(bandwidth - storage.required_mb_per_s) << std::noshowpos << "MB/s)";
+        } else {
+            params_text << "需要 " << static_cast<int>(storage.required_mb_per_s) << "MB/s";
+        }
+        bool storage_warning = storage.remaining_seconds < 300 || (bandwidth > 0 && bandwidth < storage.required_mb_per_s);
+        state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 390,
+                                    storage_warning ? red : white);
+        
+        // 预览纹理更新耗时：RAW去马赛克加缩放，或取景流缩放
+        if (state.preview_updates > 0) {
+            params_text.str("");
+            params_text << "预览(" << (state.raw_preview ? "RAW " : "取景流 ") << state.preview_source_width << "x" << state.preview_source_height
+                        << "→" << PREVIEW_WIDTH << "x" << PREVIEW_HEIGHT << ", " << state.preview_pool->Size() << "线程): ";
+            params_text << "平均 " << std::setprecision(2) << state.preview_cost_ns / 1e6 / state.preview_updates
+                        << "ms, 最大 " << state.preview_cost_max_ns / 1e6 << "ms";
+            state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 410, white);
+        }
+        
+        // 峰值对焦：开启时显示上色耗时（不含缩放）
+        params_text.str("");
+        params_text << "峰值对焦(F键): ";
+        if (!state.peaking_enabled) {
+            params_text << "关";
+        } else if (state.peaking_updates > 0) {
+            params_text << "开, 阈值 " << state.focus_peaking->Config().threshold << ", 平均 " << std::setprecision(2)
+                        << state.peaking_cost_ns / 1e6 / state.peaking_updates << "ms, 最大 " << state.peaking_cost_max_ns / 1e6 << "ms";
+        } else {
+            params_text << "开";
+        }
+        state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 430, white);
+        
+        // 曝光辅助：模式、斑马纹阈值和叠加耗时
+        const cinepi::ExposureOverlayConfig& overlay_config = state.exposure_overlay->Config();
+        params_text.str("");
+        params_text << "曝光辅助(Z键): " << cinepi::ExposureOverlayModeName(overlay_config.mode);
+        if (overlay_config.mode == cinepi::ExposureOverlayMode::Zebra) {
+            params_text << " " << overlay_config.zebra_high_ire;
+            if (overlay_config.zebra_mid_ire > 0) {
+                params_text << "/" << overlay_config.zebra_mid_ire;
+            }
+            params_text << " IRE";
+        }
+        if (overlay_config.mode != cinepi::ExposureOverlayMode::Off && state.overlay_updates > 0) {
+            params_text << ", 平均 " << std::setprecision(2) << state.overlay_cost_ns / 1e6 / state.overlay_updates
+                        << "ms, 最大 " << state.overlay_cost_max_ns / 1e6 << "ms";
+        }
+        state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 450, white);
+        
+        // 示波器：当前类型、统计频率，以及本频率下测过的每种示波器的平均耗时
+        const cinepi::ScopeConfig& scope_config = state.scopes->Config();
+        params_text.str("");
+        params_text << "示波器(S/D键): " << cinepi::ScopeModeName(scope_config.mode) << ", 每" << scope_config.interval
+                    << "帧, 隔" << scope_config.step << "像素";
+        for (unsigned int i = 1; i < cinepi::SCOPE_MODE_COUNT; ++i) {
+            cinepi::ScopeMode mode = static_cast<cinepi::ScopeMode>(i);
+            cinepi::ScopeCost cost = state.scopes->Cost(mode);
+            if (cost.updates > 0) {
+                params_text << ", " << cinepi::ScopeModeName(mode) << " " << std::setprecision(2) << cost.average_ms << "ms";
+                if (mode == scope_config.mode) {
+                    params_text << "(最大 " << cost.max_ms << "ms)";
+                }
             }
         }
+        state.sdl_helper.RenderText(state.renderer.get(), state.font.get(), params_text.str(), 10, 470, white);
+        
+        // 更新屏幕
+        SDL_RenderPresent(state.renderer.get());
+        state.camera_controller.NotePreviewPresented();
     } catch (const std::exception& e) {
         std::cerr << "更新预览时发生异常: " << e.what() << std::endl;
     }
@@ -241,23 +618,73 @@ void start_recording(AppState& state) {
     if (state.recording_status != IDLE) return;
     
     try {
-        // 生成文件名
+        // 检查剩余空间和带宽；写入队列的空闲部分决定带宽不足时能撑多久
+        cinepi::RecordingInfo info = make_recording_info(state);
+        cinepi::RawWriterStats queue_stats = state.raw_writer.GetStats();
+        uint64_t buffer_bytes = queue_stats.capacity > 0 ?
+            static_cast<uint64_t>(queue_stats.capacity - queue_stats.preroll_held) * info.frame_bytes :
+            static_cast<uint64_t>(state.writer_config.ring_megabytes) * 1024 * 1024;
+        std::string admission;
+        bool admitted = state.storage_monitor.Admit(required_mb_per_s(state), buffer_bytes, admission);
+        if (!admitted) {
+            std::cerr << "无法开始录制: " << admission << std::endl;
+            return;
+        }
+        if (!admission.empty()) {
+            std::cerr << "警告: " << admission << std::endl;
+        }
+        
+        // 生成文件名（DNG序列输出为同名目录，分段输出为带序号的多个文件和剪辑清单）
+        std::unique_ptr<cinepi::RawSink> sink;
+        if (state.segment_config.IsEnabled()) {
+            sink.reset(new cinepi::SegmentedRawSink(state.sink_type, state.segment_config));
+        } else {
+            sink = cinepi::CreateRawSink(state.sink_type);
+        }
+        
+        // 需要编码的落盘方式（DNG序列）用最新一帧实测编码线程池能持续的帧率，低于采集帧率时与带宽不足同样处理
+        cinepi::FrameLease sample = state.camera_controller.GetLatestFrame();
+        double sustainable_fps = sample ? sink->MeasureSustainableFps(sample->raw) : 0.0;
+        int capture_fps = state.camera_controller.GetFPS();
+        if (sustainable_fps > 0 && sustainable_fps < capture_fps) {
+            double buffer_seconds = buffer_bytes / static_cast<double>(std::max<size_t>(info.frame_bytes, 1)) /
+                                    (capture_fps - sustainable_fps);
+            std::ostringstream text;
+            text << std::fixed << std::setprecision(1) << "编码速度不足: " << sink->Name() << " 实测约 " << sustainable_fps
+                 << "帧/秒, 采集 " << capture_fps << "帧/秒, 写入队列约 " << buffer_seconds << "s 后开始丢帧";
+            if (state.storage_monitor.Config().require_bandwidth) {
+                std::cerr << "无法开始录制: " << text.str() << std::endl;
+                return;
+            }
+            std::cerr << "警告: " << text.str() << std::endl;
+        }
+        sample.Release();
         std::string filename = get_current_time_filename();
-        state.current_filename = filename + ".raw";
+        state.current_filename = filename + sink->Extension();
         std::string filepath = state.record_dir + "/" + state.current_filename;
         
-        // 打开RAW文件
-        state.raw_file = std::make_unique<std::ofstream>(filepath, std::ios::binary);
-        if (!state.raw_file->is_open()) {
-            throw std::runtime_error("无法打开RAW文件");
+        // 打开输出并启动写入线程，之后的帧由回调入队；预卷中的帧排在最前面
+        const cinepi::FrameFormat& format = info.format;
+        
+        // 代理是可选的附加输出，打不开时只录RAW
+        if (state.proxy_enabled) {
+            try {
+                state.proxy_writer.Open(state.record_dir + "/" + filename + ".proxy", info, state.proxy_config);
+            } catch (const std::exception& e) {
+                std::cerr << "警告: 无法开始代理流，只录制RAW: " << e.what() << std::endl;
+            }
         }
         
-        // 开始录制
+        state.write_error = false;
+        state.camera_controller.GetFrameStats().Reset(state.camera_controller.GetFPS());
+        state.raw_writer.Start(std::move(sink), filepath, info, state.writer_config);
+        state.storage_monitor.BeginRecording();
         state.recording_status = RECORDING;
-        std::cout << "开始录制RAW视频: " << filepath << std::endl;
+        std::cout << "开始录制RAW视频: " << filepath << " (" << cinepi::PixelEncodingName(format.encoding)
+                  << ", " << format.bit_depth << "位)" << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "开始录制时发生异常: " << e.what() << std::endl;
-        state.raw_file.reset();
+        state.proxy_writer.Close(0);
     }
 }
 
@@ -267,14 +694,33 @@ void stop_recording(AppState& state) {
     
     state.recording_status = STOPPING;
     
-    if (state.raw_file) {
-        try {
-            state.raw_file->close();
-            std::cout << "停止录制RAW视频: " << state.current_filename << std::endl;
-        } catch (const std::exception& e) {
-            std::cerr << "停止录制时发生异常: " << e.what() << std::endl;
+    // 停止接收新帧，等待写入线程写完队列中的帧
+    try {
+        state.raw_writer.Stop();
+        if (state.raw_writer.HasError()) {
+            state.write_error = true;
         }
-        state.raw_file.reset();
+        cinepi::RawWriterStats writer_stats = state.raw_writer.GetStats();
+        state.storage_monitor.EndRecording(writer_stats.write_mb_per_s);
+        state.proxy_writer.Close(writer_stats.frames_written);
+        std::cout << "停止录制RAW视频: " << state.current_filename << " (" << writer_stats.frames_written << "帧, 其中预卷 "
+                  << writer_stats.preroll_flushed << "帧, 丢弃 "
+                  << writer_stats.frames_dropped << "帧, 队列峰值 " << writer_stats.high_water << "/" << writer_stats.capacity
+                  << ", 阻塞 " << std::fixed << std::setprecision(1) << writer_stats.blocked_ms << "ms, "
+                  << writer_stats.write_mb_per_s << "MB/s)" << std::endl;
+        std::cout << "落盘(" << state.raw_writer.GetSinkName() << "): " << writer_stats.sink.writes << "次写入, 平均 "
+                  << std::setprecision(2) << writer_stats.sink.mean_write_ms << "ms, 最大 "
+                  << writer_stats.sink.max_write_ms << "ms" << std::endl;
+        
+        // 本次录制的帧时序统计，与RAW文件同名
+        std::string stats_path = state.record_dir + "/" + state.current_filename + ".stats.json";
+        if (state.camera_controller.GetFrameStats().WriteJson(stats_path)) {
+            std::cout << "帧时序统计: " << stats_path << std::endl;
+        } else {
+            std::cerr << "无法写入帧时序统计: " << stats_path << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "停止录制时发生异常: " << e.what() << std::endl;
     }
     
     state.recording_status = IDLE;
@@ -330,11 +776,158 @@ void handle_keyboard(AppState& state, SDL_Event& event) {
             state.camera_controller.SetWhiteBalance(state.white_balance);
             break;
             
+        case SDLK_f:
+            // 开关峰值对焦，重新统计耗时
+            state.peaking_enabled = !state.peaking_enabled;
+            state.peaking_cost_ns = 0;
+            state.peaking_cost_max_ns = 0;
+            state.peaking_updates = 0;
+            break;
+            
+        case SDLK_z: {
+            // 循环切换曝光辅助：关 → 斑马纹 → 伪色，重新统计耗时
+            cinepi::ExposureOverlayConfig config = state.exposure_overlay->Config();
+            switch (config.mode) {
+                case cinepi::ExposureOverlayMode::Off:   config.mode = cinepi::ExposureOverlayMode::Zebra; break;
+                case cinepi::ExposureOverlayMode::Zebra: config.mode = cinepi::ExposureOverlayMode::FalseColour; break;
+                default:                                 config.mode = cinepi::ExposureOverlayMode::Off; break;
+            }
+            state.exposure_overlay->SetConfig(config);
+            state.overlay_cost_ns = 0;
+            state.overlay_cost_max_ns = 0;
+            state.overlay_updates = 0;
+            break;
+        }
+            
+        case SDLK_s: {
+            // 循环切换示波器：关 → 直方图 → 波形 → RGB分量
+            cinepi::ScopeConfig config = state.scopes->Config();
+            config.mode = static_cast<cinepi::ScopeMode>((static_cast<unsigned int>(config.mode) + 1) % cinepi::SCOPE_MODE_COUNT);
+            state.scopes->SetConfig(config);
+            break;
+        }
+            
+        case SDLK_d: {
+            // 切换示波器的统计频率（每N帧、采样网格步长），各示波器重新统计耗时
+            cinepi::ScopeConfig config = state.scopes->Config();
+            cinepi::NextScopeRate(config);
+            state.scopes->SetConfig(config);
+            break;
+        }
+            
         default:
             break;
     }
 }
 
+// 打印用法
+void print_usage(const char* program) {
+    std::cout << "用法: " << program << " [选项] [录制目录]" << std::endl
+              << "  --source <来源>   帧来源: libcamera、synthetic 或 replay:<文件> (默认libcamera)" << std::endl
+              << "  --headless        无界面运行（dummy视频驱动）" << std::endl
+              << "  --record          启动后立即开始录制" << std::endl
+              << "  --frames <N>      采集N帧后退出" << std::endl
+              << "  --ring-frames <N> 写入队列容量（帧）" << std::endl
+              << "  --ring-mb <N>     写入队列内存上限（MB，默认512，未指定--ring-frames时生效）" << std::endl
+              << "  --on-overrun <策略> 队列满时: block（阻塞采集）或 drop（丢帧并记录，默认）" << std::endl
+              << "  --preroll <秒>    预卷时长：未录制时在内存中保留最近的帧，开始录制时一并写入（如2~10）" << std::endl
+              << "  --writer <方式>   落盘方式: buffered（经过页缓存，默认）、direct（O_DIRECT对齐写入）、" << std::endl
+              << "                    dng（CinemaDNG序列，12位打包）、dng16（CinemaDNG序列，16位）" << std::endl
+              << "                    dng-lj92（CinemaDNG序列，多线程分块无损压缩）" << std::endl
+              << "                    或 container（带文件头、逐帧元数据和帧索引的.cpr容器）" << std::endl
+              << "  --proxy <格式>    同时录制1/4分辨率8位代理: mjpeg（每帧一个JPEG）或 yuv（每帧一个I420）" << std::endl
+              << "  --proxy-scale <N> 代理缩小倍数（偶数，默认4）" << std::endl
+              << "  --raw-preview     预览直接由RAW帧半分辨率去马赛克生成，不使用ISP取景流" << std::endl
+              << "  --preview-threads <N> 预览缩放和RAW去马赛克的线程数（默认全部核心）" << std::endl
+              << "  --zebra <高>[,<中>] 斑马纹阈值（IRE，按RAW值计算，默认95；中间一档如70画在[中, 中+5)之间）" << std::endl
+              << "  --scope-rate <N>[,<步长>] 示波器每N帧统计一次，在隔<步长>像素的网格上采样（默认1,2）" << std::endl
+              << "  --segment-mb <N>  长镜头分段：单个文件达到N MB时在帧边界切换到下一段" << std::endl
+              << "  --segment-seconds <N> 长镜头分段：单个文件达到N秒时切换（与--segment-mb同时设置时先到先切）" << std::endl
+              << "  --reserve-mb <N>  保留空间（MB，默认1024），剩余空间到这里时自动停止录制" << std::endl
+              << "  --probe-mb <N>    启动时在录制目录写入N MB测速（默认128，0表示不测速）" << std::endl
+              << "  --require-bandwidth 实测带宽低于录制数据率或编码速度低于采集帧率时拒绝开始录制（默认只警告）" << std::endl
+              << "  --repair <文件>   扫描未正常关闭的.cpr容器，补写帧索引后退出" << std::endl;
+}
+
+// 解析命令行参数
+bool parse_args(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--source" && i + 1 < argc) {
+            if (!cinepi::ParseFrameSource(argv[++i], options.camera_params)) {
+                std::cerr << "未知的帧来源: " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--record") {
+            options.record_on_start = true;
+        } else if (arg == "--frames" && i + 1 < argc) {
+            options.frame_limit = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--ring-frames" && i + 1 < argc) {
+            options.writer_config.ring_frames = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--ring-mb" && i + 1 < argc) {
+            options.writer_config.ring_megabytes = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--writer" && i + 1 < argc) {
+            if (!cinepi::ParseRawSinkType(argv[++i], options.sink_type)) {
+                std::cerr << "未知的落盘方式: " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "--preroll" && i + 1 < argc) {
+            options.preroll_seconds = std::max(0.0, std::strtod(argv[++i], nullptr));
+        } else if (arg == "--proxy" && i + 1 < argc) {
+            if (!cinepi::ParseProxyFormat(argv[++i], options.proxy_config.format)) {
+                std::cerr << "未知的代理格式: " << argv[i] << std::endl;
+                return false;
+            }
+            options.proxy_enabled = true;
+        } else if (arg == "--proxy-scale" && i + 1 < argc) {
+            options.proxy_config.scale = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--raw-preview") {
+            options.camera_params.raw_preview = true;
+        } else if (arg == "--preview-threads" && i + 1 < argc) {
+            options.preview_threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--zebra" && i + 1 < argc) {
+            if (!cinepi::ParseZebraLevels(argv[++i], options.exposure_config)) {
+                std::cerr << "无效的斑马纹阈值: " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "--scope-rate" && i + 1 < argc) {
+            if (!cinepi::ParseScopeRate(argv[++i], options.scope_config)) {
+                std::cerr << "无效的示波器统计频率: " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "--segment-mb" && i + 1 < argc) {
+            options.segment_config.max_bytes = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+        } else if (arg == "--segment-seconds" && i + 1 < argc) {
+            options.segment_config.max_seconds = std::max(0.0, std::strtod(argv[++i], nullptr));
+        } else if (arg == "--reserve-mb" && i + 1 < argc) {
+            options.storage_config.reserve_bytes = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+        } else if (arg == "--probe-mb" && i + 1 < argc) {
+            options.storage_config.probe_bytes = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+        } else if (arg == "--require-bandwidth") {
+            options.storage_config.require_bandwidth = true;
+        } else if (arg == "--repair" && i + 1 < argc) {
+            options.repair_path = argv[++i];
+        } else if (arg == "--on-overrun" && i + 1 < argc) {
+            if (!cinepi::ParseOverrunPolicy(argv[++i], options.writer_config.policy)) {
+                std::cerr << "未知的队列满策略: " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return false;
+        } else if (!arg.empty() && arg[0] != '-') {
+            options.record_dir = arg;
+        } else {
+            std::cerr << "未知参数: " << arg << std::endl;
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     // 默认录制目录
     std::string record_dir;
@@ -357,44 +950,91 @@ int main(int argc, char* argv[]) {
     #endif
     
     // 检查命令行参数
-    if (argc > 1) {
-        record_dir = argv[1];
+    Options options;
+    options.record_dir = record_dir;
+    if (!parse_args(argc, argv, options)) {
+        return 1;
+    }
+    
+    // 修复断电留下的容器文件，不启动摄像头
+    if (!options.repair_path.empty()) {
+        try {
+            uint64_t frames = cinepi::RepairRawContainer(options.repair_path);
+            std::cout << "RAW容器 " << options.repair_path << ": " << frames << " 帧，索引完整" << std::endl;
+            return 0;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
     }
     
     // 创建应用状态
     AppState state;
     
     // 初始化应用
-    if (!init_app(state, record_dir)) {
+    if (!init_app(state, options)) {
         std::cerr << "初始化应用失败" << std::endl;
         return 1;
     }
     
-    // 主循环
+    if (options.record_on_start) {
+        start_recording(state);
+    }
+    
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    
+    // 主循环：等待新帧或输入事件，有变化时才重绘
     while (state.running) {
         SDL_Event event;
+        bool redraw = false;
         
         // 处理事件
-        while (SDL_PollEvent(&event)) {
-            switch (event.type) {
-                case SDL_QUIT:
-                    state.running = false;
-                    break;
-                    
-                case SDL_KEYDOWN:
-                    handle_keyboard(state, event);
-                    break;
-                    
-                default:
-                    break;
-            }
+        if (SDL_WaitEventTimeout(&event, IDLE_WAIT_MS)) {
+            do {
+                if (event.type == state.frame_event_type) {
+                    redraw = true;
+                    continue;
+                }
+                switch (event.type) {
+                    case SDL_QUIT:
+                        state.running = false;
+                        break;
+                        
+                    case SDL_KEYDOWN:
+                        handle_keyboard(state, event);
+                        redraw = true;
+                        break;
+                        
+                    default:
+                        break;
+                }
+            } while (SDL_PollEvent(&event));
         }
         
-        // 更新预览
-        update_preview(state);
+        // 写入失败时停止录制
+        if (state.raw_writer.HasError() && state.recording_status == RECORDING) {
+            std::cerr << "写入RAW数据失败，停止录制" << std::endl;
+            stop_recording(state);
+        }
         
-        // 控制帧率
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / FRAME_RATE));
+        // 剩余空间到保留线时停止录制，队列中的帧仍有空间写完
+        cinepi::RawWriterStats writer_stats = state.raw_writer.GetStats();
+        state.storage_monitor.Update(required_mb_per_s(state), writer_stats.bytes_written,
+                                     static_cast<uint64_t>(writer_stats.queued) * state.camera_controller.GetRawFrameBytes());
+        if (state.recording_status == RECORDING && state.storage_monitor.Snapshot().reserve_reached) {
+            std::cerr << "剩余空间已到保留值，停止录制" << std::endl;
+            stop_recording(state);
+        }
+        
+        // 达到指定帧数后退出
+        if (options.frame_limit > 0 && state.camera_controller.GetCaptureTiming().frames >= options.frame_limit) {
+            state.running = false;
+        }
+        
+        // 更新预览（渲染器开启了垂直同步，呈现时按显示刷新节拍）
+        if (redraw) {
+            update_preview(state);
+        }
     }
     
     // 如果正在录制，停止录制
@@ -405,5 +1045,14 @@ int main(int argc, char* argv[]) {
     // 停止摄像头预览
     state.camera_controller.StopPreview();
     
-    return 0;
+    // 吞吐量汇总，便于在CI中比较
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    uint64_t frames = state.camera_controller.GetCaptureTiming().frames;
+    std::cout << "共采集 " << frames << " 帧, 用时 " << std::fixed << std::setprecision(2) << elapsed << "s, "
+              << (elapsed > 0 ? frames / elapsed : 0.0) << "fps" << std::endl;
+    cinepi::TextCacheStats text_stats = state.sdl_helper.GetTextCacheStats();
+    std::cout << "文字缓存: 绘制 " << text_stats.draws << " 次, 上传纹理 " << text_stats.uploads << " 次, 淘汰 "
+              << text_stats.evictions << " 次" << std::endl;
+    
+    return state.write_error ? 1 : 0;
 }
\ No newline at end of file
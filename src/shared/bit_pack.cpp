@@ -0,0 +1,525 @@
+// bit_pack.cpp
+// Bayer数据打包与解包实现
+//
+// CSI-2 12位：每2个像素3字节，前两字节为两个像素的高8位，第三字节低4位属于第一个像素。
+// CSI-2 10位：每4个像素5字节，前四字节为高8位，第五字节每2位依次属于四个像素。
+// TIFF 12位：高位在前的连续位流，两个像素占3字节。
+//
+// SIMD内核只处理一行的主体，剩余像素（以及读取会越过行尾的部分）交给标量版本，
+// 因此行宽和行步长不需要任何对齐。
+
+#include "bit_pack.h"
+#include <atomic>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace cinepi {
+
+namespace {
+
+typedef void (*UnpackKernel)(const uint8_t* src, uint16_t* dst, unsigned int width);
+typedef void (*PackKernel)(const uint16_t* src, uint8_t* dst, unsigned int width);
+
+// 一组同一指令集级别的内核
+struct BitPackKernels {
+    SimdLevel level;
+    UnpackKernel unpack10;
+    UnpackKernel unpack12;
+    PackKernel pack12;
+    PackKernel pack_tiff12;
+};
+
+// 字节重排表（-1表示清零），SSSE3/AVX2的pshufb和NEON的tbl共用
+// 12位解包：每个16位通道取像素的高8位 / 取两像素共享的低位字节
+alignas(16) const int8_t UNPACK12_HI[16] = { 0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1 };
+alignas(16) const int8_t UNPACK12_LO[16] = { 2, -1, 2, -1, 5, -1, 5, -1, 8, -1, 8, -1, 11, -1, 11, -1 };
+// 10位解包：同上，每组4个像素共享第5个字节
+alignas(16) const int8_t UNPACK10_HI[16] = { 0, -1, 1, -1, 2, -1, 3, -1, 5, -1, 6, -1, 7, -1, 8, -1 };
+alignas(16) const int8_t UNPACK10_LO[16] = { 4, -1, 4, -1, 4, -1, 4, -1, 9, -1, 9, -1, 9, -1, 9, -1 };
+// 12位打包：从16位通道中取高8位 / 取合并后的低位字节，输出12字节
+alignas(16) const int8_t PACK12_HI[16] = { 0, 2, -1, 4, 6, -1, 8, 10, -1, 12, 14, -1, -1, -1, -1, -1 };
+alignas(16) const int8_t PACK12_LO[16] = { -1, -1, 0, -1, -1, 4, -1, -1, 8, -1, -1, 12, -1, -1, -1, -1 };
+// TIFF 12位打包：每32位通道的24位值按大端取3字节
+alignas(16) const int8_t PACK_TIFF12[16] = { 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 };
+
+// ---- 标量参考实现 ----
+
+void unpack12Scalar(const uint8_t* src, uint16_t* dst, unsigned int width) {
+    unsigned int x = 0;
+    for (; x + 1 < width; x += 2, src += 3) {
+        dst[x] = static_cast<uint16_t>((src[0] << 4) | (src[2] & 0x0F));
+        dst[x + 1] = static_cast<uint16_t>((src[1] << 4) | (src[2] >> 4));
+    }
+    if (x < width) {
+        dst[x] = static_cast<uint16_t>((src[0] << 4) | (src[2] & 0x0F));
+    }
+}
+
+void unpack10Scalar(const uint8_t* src, uint16_t* dst, unsigned int width) {
+    unsigned int x = 0;
+    for (; x + 3 < width; x += 4, src += 5) {
+        dst[x] = static_cast<uint16_t>((src[0] << 2) | (src[4] & 0x03));
+        dst[x + 1] = static_cast<uint16_t>((src[1] << 2) | ((src[4] >> 2) & 0x03));
+        dst[x + 2] = static_cast<uint16_t>((src[2] << 2) | ((src[4] >> 4) & 0x03));
+        dst[x + 3] = static_cast<uint16_t>((src[3] << 2) | (src[4] >> 6));
+    }
+    for (unsigned int i = 0; x < width; ++x, ++i) {
+        dst[x] = static_cast<uint16_t>((src[i] << 2) | ((src[4] >> (2 * i)) & 0x03));
+    }
+}
+
+void pack12Scalar(const uint16_t* src, uint8_t* dst, unsigned int width) {
+    unsigned int x = 0;
+    for (; x + 1 < width; x += 2, dst += 3) {
+        dst[0] = static_cast<uint8_t>(src[x] >> 4);
+        dst[1] = static_cast<uint8_t>(src[x + 1] >> 4);
+        dst[2] = static_cast<uint8_t>((src[x] & 0x0F) | ((src[x + 1] & 0x0F) << 4));
+    }
+    if (x < width) {
+        dst[0] = static_cast<uint8_t>(src[x] >> 4);
+        dst[1] = 0;
+        dst[2] = static_cast<uint8_t>(src[x] & 0x0F);
+    }
+}
+
+void pack10Scalar(const uint16_t* src, uint8_t* dst, unsigned int width) {
+    unsigned int x = 0;
+    for (; x + 3 < width; x += 4, dst += 5) {
+        dst[0] = static_cast<uint8_t>(src[x] >> 2);
+        dst[1] = static_cast<uint8_t>(src[x + 1] >> 2);
+        dst[2] = static_cast<uint8_t>(src[x + 2] >> 2);
+        dst[3] = static_cast<uint8_t>(src[x + 3] >> 2);
+        dst[4] = static_cast<uint8_t>((src[x] & 0x03) | ((src[x + 1] & 0x03) << 2) |
+                                      ((src[x + 2] & 0x03) << 4) | ((src[x + 3] & 0x03) << 6));
+    }
+    if (x < width) {
+        memset(dst, 0, 5);
+        for (unsigned int i = 0; x < width; ++x, ++i) {
+            dst[i] = static_cast<uint8_t>(src[x] >> 2);
+            dst[4] |= static_cast<uint8_t>((src[x] & 0x03) << (2 * i));
+        }
+    }
+}
+
+void packTiff12Scalar(const uint16_t* src, uint8_t* dst, unsigned int width) {
+    unsigned int x = 0;
+    for (; x + 1 < width; x += 2, dst += 3) {
+        dst[0] = static_cast<uint8_t>(src[x] >> 4);
+        dst[1] = static_cast<uint8_t>(((src[x] & 0x0F) << 4) | ((src[x + 1] >> 8) & 0x0F));
+        dst[2] = static_cast<uint8_t>(src[x + 1]);
+    }
+    if (x < width) {
+        dst[0] = static_cast<uint8_t>(src[x] >> 4);
+        dst[1] = static_cast<uint8_t>((src[x] & 0x0F) << 4);
+    }
+}
+
+const BitPackKernels SCALAR_KERNELS = {
+    SimdLevel::Scalar, unpack10Scalar, unpack12Scalar, pack12Scalar, packTiff12Scalar
+};
+
+// ---- x86：SSSE3 / AVX2 ----
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define CINEPI_TARGET(isa) __attribute__((target(isa)))
+
+CINEPI_TARGET("ssse3") inline __m128i loadTable(const int8_t* table) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(table));
+}
+
+// 写出寄存器的前12字节
+CINEPI_TARGET("ssse3") inline void store12(uint8_t* dst, __m128i value) {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), value);
+    uint32_t tail = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(value, 8)));
+    memcpy(dst + 8, &tail, 4);
+}
+
+CINEPI_TARGET("ssse3")
+void unpack12Ssse3(const uint8_t* src, uint16_t* dst, unsigned int width) {
+    const __m128i hi_table = loadTable(UNPACK12_HI);
+    const __m128i lo_table = loadTable(UNPACK12_LO);
+    const __m128i even = _mm_setr_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+    const __m128i nibble = _mm_set1_epi16(0x0F);
+    unsigned int x = 0;
+    // 每次读16字节、用12字节（8像素），剩余不少于12像素时读取不会越过行尾
+    for (; x + 12 <= width; x += 8, src += 12) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i hi = _mm_slli_epi16(_mm_shuffle_epi8(v, hi_table), 4);
+        __m128i lo = _mm_shuffle_epi8(v, lo_table);
+        lo = _mm_or_si128(_mm_and_si128(even, _mm_and_si128(lo, nibble)), _mm_andnot_si128(even, _mm_srli_epi16(lo, 4)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_or_si128(hi, lo));
+    }
+    unpack12Scalar(src, dst + x, width - x);
+}
+
+CINEPI_TARGET("ssse3")
+void unpack10Ssse3(const uint8_t* src, uint16_t* dst, unsigned int width) {
+    const __m128i hi_table = loadTable(UNPACK10_HI);
+    const __m128i lo_table = loadTable(UNPACK10_LO);
+    // 乘以2^(6-2k)再右移6位，相当于第k个像素的低位字节右移2k位
+    const __m128i lo_scale = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+    const __m128i two_bits = _mm_set1_epi16(0x03);
+    unsigned int x = 0;
+    // 每次读16字节、用10字节（8像素）
+    for (; x + 16 <= width; x += 8, src += 10) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i hi = _mm_slli_epi16(_mm_shuffle_epi8(v, hi_table), 2);
+        __m128i lo = _mm_mullo_epi16(_mm_shuffle_epi8(v, lo_table), lo_scale);
+        lo = _mm_and_si128(_mm_srli_epi16(lo, 6), two_bits);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_or_si128(hi, lo));
+    }
+    unpack10Scalar(src, dst + x, width - x);
+}
+
+CINEPI_TARGET("ssse3")
+void pack12Ssse3(const uint16_t* src, uint8_t* dst, unsigned int width) {
+    const __m128i hi_table = loadTable(PACK12_HI);
+    const __m128i lo_table = loadTable(PACK12_LO);
+    const __m128i even = _mm_setr_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+    const __m128i nibble = _mm_set1_epi16(0x0F);
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8, dst += 12) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i hi = _mm_srli_epi16(v, 4);
+        // 偶数像素的低4位放低半字节、奇数像素的放高半字节，再把相邻两个通道合并到偶数通道
+        __m128i lo = _mm_and_si128(v, nibble);
+        lo = _mm_or_si128(_mm_and_si128(even, lo), _mm_andnot_si128(even, _mm_slli_epi16(lo, 4)));
+        lo = _mm_or_si128(lo, _mm_srli_epi32(lo, 16));
+        store12(dst, _mm_or_si128(_mm_shuffle_epi8(hi, hi_table), _mm_shuffle_epi8(lo, lo_table)));
+    }
+    pack12Scalar(src + x, dst, width - x);
+}
+
+CINEPI_TARGET("ssse3")
+void packTiff12Ssse3(const uint16_t* src, uint8_t* dst, unsigned int width) {
+    const __m128i order = loadTable(PACK_TIFF12);
+    const __m128i mask12 = _mm_set1_epi32(0x0FFF);
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8, dst += 12) {
+        // 每个32位通道是一对像素(a, b)，拼成24位的 a<<12 | b
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i pair = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(v, mask12), 12),
+                                    _mm_and_si128(_mm_srli_epi32(v, 16), mask12));
+        store12(dst, _mm_shuffle_epi8(pair, order));
+    }
+    packTiff12Scalar(src + x, dst, width - x);
+}
+
+const BitPackKernels SSSE3_KERNELS = {
+    SimdLevel::Ssse3, unpack10Ssse3, unpack12Ssse3, pack12Ssse3, packTiff12Ssse3
+};
+
+// AVX2的字节重排只在128位通道内进行，两个通道各处理一组，与SSSE3版本使用相同的表
+CINEPI_TARGET("avx2") inline __m256i loadTable2(const int8_t* table) {
+    return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table)));
+}
+
+CINEPI_TARGET("avx2") inline __m256i loadLanes(const uint8_t* low, const uint8_t* high) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(low))),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(high)), 1);
+}
+
+CINEPI_TARGET("avx2")
+void unpack12Avx2(const uint8_t* src, uint16_t* dst, unsigned int width) {
+    const __m256i hi_table = loadTable2(UNPACK12_HI);
+    const __m256i lo_table = loadTable2(UNPACK12_LO);
+    const __m256i even = _mm256_setr_epi16(-1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0);
+    const __m256i nibble = _mm256_set1_epi16(0x0F);
+    unsigned int x = 0;
+    // 两个通道分别从src和src+12读取，最远读到第28字节
+    for (; x + 20 <= width; x += 16, src += 24) {
+        __m256i v = loadLanes(src, src + 12);
+        __m256i hi = _mm256_slli_epi16(_mm256_shuffle_epi8(v, hi_table), 4);
+        __m256i lo = _mm256_shuffle_epi8(v, lo_table);
+        lo = _mm256_or_si256(_mm256_and_si256(even, _mm256_and_si256(lo, nibble)),
+                             _mm256_andnot_si256(even, _mm256_srli_epi16(lo, 4)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_or_si256(hi, lo));
+    }
+    unpack12Ssse3(src, dst + x, width - x);
+}
+
+CINEPI_TARGET("avx2")
+void unpack10Avx2(const uint8_t* src, uint16_t* dst, unsigned int width) {
+    const __m256i hi_table = loadTable2(UNPACK10_HI);
+    const __m256i lo_table = loadTable2(UNPACK10_LO);
+    const __m256i lo_scale = _mm256_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1);
+    const __m256i two_bits = _mm256_set1_epi16(0x03);
+    unsigned int x = 0;
+    // 两个通道分别从src和src+10读取，最远读到第26字节
+    for (; x + 24 <= width; x += 16, src += 20) {
+        __m256i v = loadLanes(src, src + 10);
+        __m256i hi = _mm256_slli_epi16(_mm256_shuffle_epi8(v, hi_table), 2);
+        __m256i lo = _mm256_mullo_epi16(_mm256_shuffle_epi8(v, lo_table), lo_scale);
+        lo = _mm256_and_si256(_mm256_srli_epi16(lo, 6), two_bits);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_or_si256(hi, lo));
+    }
+    unpack10Ssse3(src, dst + x, width - x);
+}
+
+CINEPI_TARGET("avx2")
+void pack12Avx2(const uint16_t* src, uint8_t* dst, unsigned int width) {
+    const __m256i hi_table = loadTable2(PACK12_HI);
+    const __m256i lo_table = loadTable2(PACK12_LO);
+    const __m256i even = _mm256_setr_epi16(-1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0);
+    const __m256i nibble = _mm256_set1_epi16(0x0F);
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16, dst += 24) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        __m256i hi = _mm256_srli_epi16(v, 4);
+        __m256i lo = _mm256_and_si256(v, nibble);
+        lo = _mm256_or_si256(_mm256_and_si256(even, lo), _mm256_andnot_si256(even, _mm256_slli_epi16(lo, 4)));
+        lo = _mm256_or_si256(lo, _mm256_srli_epi32(lo, 16));
+        __m256i out = _mm256_or_si256(_mm256_shuffle_epi8(hi, hi_table), _mm256_shuffle_epi8(lo, lo_table));
+        store12(dst, _mm256_castsi256_si128(out));
+        store12(dst + 12, _mm256_extracti128_si256(out, 1));
+    }
+    pack12Ssse3(src + x, dst, width - x);
+}
+
+CINEPI_TARGET("avx2")
+void packTiff12Avx2(const uint16_t* src, uint8_t* dst, unsigned int width) {
+    const __m256i order = loadTable2(PACK_TIFF12);
+    const __m256i mask12 = _mm256_set1_epi32(0x0FFF);
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16, dst += 24) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        __m256i pair = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(v, mask12), 12),
+                                       _mm256_and_si256(_mm256_srli_epi32(v, 16), mask12));
+        __m256i out = _mm256_shuffle_epi8(pair, order);
+        store12(dst, _mm256_castsi256_si128(out));
+        store12(dst + 12, _mm256_extracti128_si256(out, 1));
+    }
+    packTiff12Ssse3(src + x, dst, width - x);
+}
+
+const BitPackKernels AVX2_KERNELS = {
+    SimdLevel::Avx2, unpack10Avx2, unpack12Avx2, pack12Avx2, packTiff12Avx2
+};
+
+#undef CINEPI_TARGET
+
+#endif // x86
+
+// ---- ARM：NEON ----
+
+#if defined(__ARM_NEON)
+
+void unpack12Neon(const uint8_t* src, uint16_t* dst, unsigned int width) {
+    const uint8x16_t nibble = vdupq_n_u8(0x0F);
+    unsigned int x = 0;
+    // vld3按3字节一组解交织为：偶数像素高8位、奇数像素高8位、共享低位字节
+    for (; x + 32 <= width; x += 32, src += 48) {
+        uint8x16x3_t v = vld3q_u8(src);
+        uint8x16_t lo_even = vandq_u8(v.val[2], nibble);
+        uint8x16_t lo_odd = vshrq_n_u8(v.val[2], 4);
+        uint16x8x2_t out;
+        out.val[0] = vorrq_u16(vshll_n_u8(vget_low_u8(v.val[0]), 4), vmovl_u8(vget_low_u8(lo_even)));
+        out.val[1] = vorrq_u16(vshll_n_u8(vget_low_u8(v.val[1]), 4), vmovl_u8(vget_low_u8(lo_odd)));
+        vst2q_u16(dst + x, out);
+        out.val[0] = vorrq_u16(vshll_n_u8(vget_high_u8(v.val[0]), 4), vmovl_u8(vget_high_u8(lo_even)));
+        out.val[1] = vorrq_u16(vshll_n_u8(vget_high_u8(v.val[1]), 4), vmovl_u8(vget_high_u8(lo_odd)));
+        vst2q_u16(dst + x + 16, out);
+    }
+    unpack12Scalar(src, dst + x, width - x);
+}
+
+void pack12Neon(const uint16_t* src, uint8_t* dst, unsigned int width) {
+    const uint16x8_t nibble = vdupq_n_u16(0x0F);
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16, dst += 24) {
+        uint16x8x2_t v = vld2q_u16(src + x);
+        uint8x8x3_t out;
+        out.val[0] = vmovn_u16(vshrq_n_u16(v.val[0], 4));
+        out.val[1] = vmovn_u16(vshrq_n_u16(v.val[1], 4));
+        out.val[2] = vorr_u8(vmovn_u16(vandq_u16(v.val[0], nibble)),
+                             vshl_n_u8(vmovn_u16(vandq_u16(v.val[1], nibble)), 4));
+        vst3_u8(dst, out);
+    }
+    pack12Scalar(src + x, dst, width - x);
+}
+
+void packTiff12Neon(const uint16_t* src, uint8_t* dst, unsigned int width) {
+    const uint16x8_t nibble = vdupq_n_u16(0x0F);
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16, dst += 24) {
+        uint16x8x2_t v = vld2q_u16(src + x);
+        uint8x8x3_t out;
+        out.val[0] = vmovn_u16(vshrq_n_u16(v.val[0], 4));
+        out.val[1] = vmovn_u16(vorrq_u16(vshlq_n_u16(vandq_u16(v.val[0], nibble), 4),
+                                         vandq_u16(vshrq_n_u16(v.val[1], 8), nibble)));
+        out.val[2] = vmovn_u16(v.val[1]);
+        vst3_u8(dst, out);
+    }
+    packTiff12Scalar(src + x, dst, width - x);
+}
+
+#if defined(__aarch64__)
+void unpack10Neon(const uint8_t* src, uint16_t* dst, unsigned int width) {
+    const uint8x16_t hi_table = vld1q_u8(reinterpret_cast<const uint8_t*>(UNPACK10_HI));
+    const uint8x16_t lo_table = vld1q_u8(reinterpret_cast<const uint8_t*>(UNPACK10_LO));
+    const int16_t SHIFTS[8] = { 0, -2, -4, -6, 0, -2, -4, -6 };
+    const int16x8_t lo_shift = vld1q_s16(SHIFTS);
+    const uint16x8_t two_bits = vdupq_n_u16(0x03);
+    unsigned int x = 0;
+    // 每次读16字节、用10字节（8像素）；tbl对越界索引输出0
+    for (; x + 16 <= width; x += 8, src += 10) {
+        uint8x16_t v = vld1q_u8(src);
+        uint16x8_t hi = vshlq_n_u16(vreinterpretq_u16_u8(vqtbl1q_u8(v, hi_table)), 2);
+        uint16x8_t lo = vandq_u16(vshlq_u16(vreinterpretq_u16_u8(vqtbl1q_u8(v, lo_table)), lo_shift), two_bits);
+        vst1q_u16(dst + x, vorrq_u16(hi, lo));
+    }
+    unpack10Scalar(src, dst + x, width - x);
+}
+#endif
+
+const BitPackKernels NEON_KERNELS = {
+#if defined(__aarch64__)
+    SimdLevel::Neon, unpack10Neon, unpack12Neon, pack12Neon, packTiff12Neon
+#else
+    // 32位ARM没有单指令的16字节查表，10位解包使用标量版本
+    SimdLevel::Neon, unpack10Scalar, unpack12Neon, pack12Neon, packTiff12Neon
+#endif
+};
+
+#endif // __ARM_NEON
+
+const BitPackKernels* kernelsFor(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return &SCALAR_KERNELS;
+#if defined(__x86_64__) || defined(__i386__)
+        case SimdLevel::Ssse3:  return &SSSE3_KERNELS;
+        case SimdLevel::Avx2:   return &AVX2_KERNELS;
+#endif
+#if defined(__ARM_NEON)
+        case SimdLevel::Neon:   return &NEON_KERNELS;
+#endif
+        default:                return nullptr;
+    }
+}
+
+// CPU支持的最高级别；该级别没有对应内核时退回标量
+const BitPackKernels* bestKernels() {
+    const BitPackKernels* best = kernelsFor(DetectSimdLevel());
+    return best != nullptr ? best : &SCALAR_KERNELS;
+}
+
+std::atomic<const BitPackKernels*>& activeKernels() {
+    static std::atomic<const BitPackKernels*> active(bestKernels());
+    return active;
+}
+
+const BitPackKernels& kernels() {
+    return *activeKernels().load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+size_t RawRowBytes(PixelEncoding encoding, unsigned int width) {
+    // CSI-2打包按完整的像素组计算，行尾不足一组时也占满一组
+    switch (encoding) {
+        case PixelEncoding::BayerCsi2p10: return (static_cast<size_t>(width) + 3) / 4 * 5;
+        case PixelEncoding::BayerCsi2p12: return (static_cast<size_t>(width) + 1) / 2 * 3;
+        case PixelEncoding::Bayer16:      return static_cast<size_t>(width) * 2;
+        case PixelEncoding::RGB888:       return static_cast<size_t>(width) * 3;
+        default:                          return 0;
+    }
+}
+
+unsigned int AlignedRawStride(PixelEncoding encoding, unsigned int width) {
+    return static_cast<unsigned int>((RawRowBytes(encoding, width) + 31) & ~static_cast<size_t>(31));
+}
+
+PixelEncoding PackedEncodingForBitDepth(int bit_depth) {
+    if (bit_depth <= 10) {
+        return PixelEncoding::BayerCsi2p10;
+    }
+    return bit_depth <= 12 ? PixelEncoding::BayerCsi2p12 : PixelEncoding::Bayer16;
+}
+
+int EncodingBitDepth(PixelEncoding encoding) {
+    switch (encoding) {
+        case PixelEncoding::BayerCsi2p10: return 10;
+        case PixelEncoding::BayerCsi2p12: return 12;
+        case PixelEncoding::Bayer16:      return 16;
+        case PixelEncoding::RGB888:       return 8;
+        default:                          return 0;
+    }
+}
+
+void UnpackRow(PixelEncoding encoding, const uint8_t* src, uint16_t* dst, unsigned int width) {
+    switch (encoding) {
+        case PixelEncoding::BayerCsi2p12:
+            kernels().unpack12(src, dst, width);
+            break;
+        case PixelEncoding::BayerCsi2p10:
+            kernels().unpack10(src, dst, width);
+            break;
+        case PixelEncoding::Bayer16:
+            memcpy(dst, src, static_cast<size_t>(width) * 2);
+            break;
+        default:
+            memset(dst, 0, static_cast<size_t>(width) * 2);
+            break;
+    }
+}
+
+void PackRow(PixelEncoding encoding, const uint16_t* src, uint8_t* dst, unsigned int width) {
+    switch (encoding) {
+        case PixelEncoding::BayerCsi2p12:
+            kernels().pack12(src, dst, width);
+            break;
+        case PixelEncoding::BayerCsi2p10:
+            // 只用于生成测试图案，不在热路径上
+            pack10Scalar(src, dst, width);
+            break;
+        case PixelEncoding::Bayer16:
+            memcpy(dst, src, static_cast<size_t>(width) * 2);
+            break;
+        default:
+            break;
+    }
+}
+
+void PackTiff12Row(const uint16_t* src, uint8_t* dst, unsigned int width) {
+    kernels().pack_tiff12(src, dst, width);
+}
+
+void UnpackFrame(const FrameView& raw, uint16_t* dst) {
+    for (unsigned int y = 0; y < raw.height; ++y) {
+        UnpackRow(raw.format.encoding, raw.data + static_cast<size_t>(y) * raw.stride,
+                  dst + static_cast<size_t>(y) * raw.width, raw.width);
+    }
+}
+
+size_t RemoveStride(const FrameView& raw, uint8_t* dst) {
+    size_t row_bytes = RawRowBytes(raw.format.encoding, raw.width);
+    if (row_bytes == raw.stride) {
+        memcpy(dst, raw.data, row_bytes * raw.height);
+        return row_bytes * raw.height;
+    }
+    for (unsigned int y = 0; y < raw.height; ++y) {
+        memcpy(dst + static_cast<size_t>(y) * row_bytes, raw.data + static_cast<size_t>(y) * raw.stride, row_bytes);
+    }
+    return row_bytes * raw.height;
+}
+
+SimdLevel GetBitPackLevel() {
+    return kernels().level;
+}
+
+bool SetBitPackLevel(SimdLevel level) {
+    const BitPackKernels* selected = kernelsFor(level);
+    if (selected == nullptr || !SimdLevelSupported(level)) {
+        return false;
+    }
+    activeKernels().store(selected, std::memory_order_relaxed);
+    return true;
+}
+
+} // namespace cinepi
@@ -0,0 +1,52 @@
+// bit_pack.h
+// Bayer数据的打包与解包：MIPI CSI-2 10/12位打包格式与16位容器之间的转换
+//
+// 热路径内核（CSI-2解包、12位打包、TIFF 12位打包）有标量、SSSE3、AVX2和NEON版本，
+// 首次使用时按CPU能力选择，结果与标量版本逐字节一致。
+
+#ifndef BIT_PACK_H
+#define BIT_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include "cpu_features.h"
+#include "frame_types.h"
+
+namespace cinepi {
+
+// 一行像素在指定编码下的有效字节数（不含行尾填充）
+size_t RawRowBytes(PixelEncoding encoding, unsigned int width);
+
+// 按硬件习惯对齐到32字节的行步长
+unsigned int AlignedRawStride(PixelEncoding encoding, unsigned int width);
+
+// 按请求的位深度选择传感器打包格式（<=10位为CSI-2 10位，<=12位为CSI-2 12位，否则16位容器）
+PixelEncoding PackedEncodingForBitDepth(int bit_depth);
+
+// 编码对应的有效位深度
+int EncodingBitDepth(PixelEncoding encoding);
+
+// 解包一行到16位容器（数值保持原始位深，不左移）
+void UnpackRow(PixelEncoding encoding, const uint8_t* src, uint16_t* dst, unsigned int width);
+
+// 把一行16位数据打包为指定编码
+void PackRow(PixelEncoding encoding, const uint16_t* src, uint8_t* dst, unsigned int width);
+
+// 把一行12位数据按TIFF/DNG位序紧密打包：高位在前，两个像素占3字节
+void PackTiff12Row(const uint16_t* src, uint8_t* dst, unsigned int width);
+
+// 解包整帧并去掉行尾填充，dst至少width*height个像素
+void UnpackFrame(const FrameView& raw, uint16_t* dst);
+
+// 去掉行尾填充、保持原编码复制整帧，返回写入的字节数
+size_t RemoveStride(const FrameView& raw, uint8_t* dst);
+
+// 当前使用的内核级别
+SimdLevel GetBitPackLevel();
+
+// 强制使用指定级别的内核（基准测试和对比用），CPU不支持时返回false
+bool SetBitPackLevel(SimdLevel level);
+
+} // namespace cinepi
+
+#endif // BIT_PACK_H
@@ -2,26 +2,26 @@
 // 摄像头控制类实现
 
 #include "camera_controller.h"
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <thread>
 #include <chrono>
 #include <cstring>
-#include <libcamera/control_ids.h>
-#include <libcamera/formats.h>
 
 namespace cinepi {
 
 CameraController::CameraController() 
-    : camera_manager_(nullptr),
-      camera_(nullptr),
-      config_(nullptr),
-      allocator_(nullptr),
-      mapper_(nullptr),
-      stream_(nullptr),
-      request_(nullptr),
-      current_buffer_(nullptr),
-      preview_buffer_(nullptr),
+    : source_(nullptr),
+      notify_pending_(false),
+      control_generation_(0),
+      applied_generation_(0),
+      last_sequence_(0),
+      control_request_sequence_(0),
+      last_control_latency_(0),
+      max_control_latency_(0),
+      presented_generation_(0),
+      last_reconfigure_ms_(0.0),
       is_initialized_(false), 
       is_previewing_(false), 
       is_recording_(false) {
@@ -31,82 +31,31 @@ CameraController::~CameraController() {
     StopRecording();
     StopPreview();
     if (is_initialized_) {
-        // 清理资源
-        if (camera_) {
-            camera_->release();
-        }
-        if (camera_manager_) {
-            camera_manager_->stop();
-        }
-        delete[] preview_buffer_;
+        // 清理资源（预览持有的帧需先于帧来源释放）
+        releasePreviewLeases();
+        source_->Close();
+        source_.reset();
     }
 }
 
 void CameraController::Initialize(const CameraParams& params) {
+    // 已初始化时走重新配置路径，复用已打开的设备
     if (is_initialized_) {
+        Reconfigure(params);
         return;
     }
 
     params_ = params;
 
     try {
-        // 初始化相机管理器
-        camera_manager_.reset(new libcamera::CameraManager());
-        if (camera_manager_->start()) {
-            throw std::runtime_error("相机管理器初始化失败");
-        }
-
-        // 获取相机列表
-        auto cameras = camera_manager_->cameras();
-        if (cameras.empty()) {
-            throw std::runtime_error("未找到相机");
-        }
-
-        // 获取第一个相机
-        camera_ = cameras[0];
-        std::cout << "使用相机: " << camera_->id() << std::endl;
-
-        // 激活相机
-        if (camera_->acquire()) {
-            throw std::runtime_error("相机获取失败");
-        }
-
-        // 生成相机配置
-        config_ = camera_->generateConfiguration({
-            libcamera::StreamRole::Viewfinder,
-            libcamera::StreamRole::Raw
+        // 创建并打开帧来源
+        source_ = CreateFrameSource(params_);
+        source_->SetFrameHandler([this](const FrameLease& lease) {
+            handleFrame(lease);
         });
-
-        if (!config_ || config_->validate() == libcamera::CameraConfiguration::Invalid) {
-            throw std::runtime_error("相机配置无效");
-        }
-
-        // 配置预览流
-        libcamera::StreamConfiguration &viewfinder_config = config_->at(0);
-        viewfinder_config.size = libcamera::Size(params_.width, params_.height);
-        viewfinder_config.pixelFormat = libcamera::formats::RGB888;
-        viewfinder_config.bufferCount = 4;
-
-        // 配置相机
-        if (camera_->configure(config_.get())) {
-            throw std::runtime_error("相机配置失败");
-        }
-
-        // 获取预览流
-        stream_ = viewfinder_config.stream();
-
-        // 创建帧缓冲分配器
-        allocator_.reset(new libcamera::FrameBufferAllocator(camera_));
-        if (allocator_->allocate(stream_) < 0) {
-            throw std::runtime_error("帧缓冲分配失败");
-        }
-
-        // 创建帧缓冲映射器
-        mapper_.reset(new libcamera::FrameBufferMapper(allocator_.get()));
-
-        // 创建预览缓冲区
-        preview_buffer_ = new uint8_t[params_.width * params_.height * 3];
-        memset(preview_buffer_, 0, params_.width * params_.height * 3);
+        source_->Open(params_);
+        raw_format_ = source_->GetRawFormat();
+        frame_stats_.Reset(params_.fps);
 
         is_initialized_ = true;
 
@@ -115,28 +64,33 @@ void CameraController::Initialize(const CameraParams& params) {
         SetISO(params_.iso);
         SetWhiteBalance(params_.white_balance);
 
-        std::cout << "相机初始化成功" << std::endl;
+        std::cout << "相机初始化成功 (帧来源: " << source_->Name() << ")" << std::endl;
 
     } catch (const std::exception& e) {
         StopPreview();
         StopRecording();
-        if (camera_) {
-            camera_->release();
+        if (source_) {
+            source_->Close();
+            source_.reset();
         }
-        if (camera_manager_) {
-            camera_manager_->stop();
-        }
-        delete[] preview_buffer_;
-        preview_buffer_ = nullptr;
-        throw e;
+        throw;
     }
 }
 
 void CameraController::setupControls()
 {
-    if (!camera_) return;
-
-    // 控制参数将在start方法中设置
+    if (!source_) return;
+
+    // 按键连发时每次都提交，帧来源只把最新一组挂到下一个请求上
+    ControlSettings controls;
+    controls.exposure_compensation = params_.exposure_compensation;
+    controls.iso = params_.iso;
+    controls.white_balance = params_.white_balance;
+    controls.fps = params_.fps;
+
+    control_request_sequence_.store(last_sequence_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    controls.generation = control_generation_.fetch_add(1, std::memory_order_release) + 1;
+    source_->SetControls(controls);
 }
 
 void CameraController::StartPreview() {
@@ -145,57 +99,14 @@ void CameraController::StartPreview() {
     }
 
     try {
-        // 清理之前的请求
-        if (request_) {
-            delete request_;
-            request_ = nullptr;
-        }
-
-        // 创建控制列表
-        libcamera::ControlList controls(camera_->controls());
-        controls.set(libcamera::controls::AeEnable, true);
-        controls.set(libcamera::controls::AwbEnable, true);
-
-        // 启动相机
-        if (camera_->start(&controls) != 0) {
-            throw std::runtime_error("相机启动失败");
-        }
-
-        // 连接请求完成信号
-        camera_->requestCompleted.connect(this, &CameraController::processRequest);
-
-        // 获取缓冲列表
-        const std::vector<std::unique_ptr<libcamera::FrameBuffer>> &buffers = allocator_->buffers(stream_);
-        if (buffers.empty()) {
-            throw std::runtime_error("没有可用的缓冲");
-        }
-
-        // 创建并发送所有请求
-        for (size_t i = 0; i < buffers.size(); ++i) {
-            // 创建新请求
-            request_ = camera_->createRequest().release();
-            if (!request_) {
-                throw std::runtime_error("请求创建失败");
-            }
-
-            // 设置请求缓冲
-            request_->addBuffer(stream_, buffers[i].get());
-
-            // 发送请求
-            if (camera_->queueRequest(request_) < 0) {
-                delete request_;
-                request_ = nullptr;
-                throw std::runtime_error("请求发送失败");
-            }
-            request_ = nullptr; // 请求已被相机接管，不再属于我们
-        }
-
         is_previewing_ = true;
+        notify_pending_ = false;
+        source_->Start();
         std::cout << "预览已启动" << std::endl;
-
     } catch (const std::exception& e) {
+        is_previewing_ = false;
         StopPreview();
-        throw e;
+        throw;
     }
 }
 
@@ -205,82 +116,151 @@ void CameraController::StopPreview() {
     }
 
     try {
-        // 断开请求完成信号
-        camera_->requestCompleted.disconnect(this);
-        
-        if (request_) {
-            delete request_;
-            request_ = nullptr;
-        }
+        is_previewing_ = false;
 
-        // 停止相机
-        if (camera_->stop() != 0) {
-            throw std::runtime_error("相机停止失败");
-        }
+        // 先停止帧来源，再释放预览持有的帧
+        source_->Stop();
+        releasePreviewLeases();
+
+        CaptureTimingStats timing = GetCaptureTiming();
+        std::cout << "采集回调耗时: 平均 " << timing.average_us << "us, 最大 " << timing.max_us
+                  << "us (" << timing.frames << "帧)" << std::endl;
+        FrameLeaseStats lease_stats = GetLeaseStats();
+        std::cout << "缓冲耗尽次数: " << lease_stats.starvation_events << std::endl;
 
-        is_previewing_ = false;
         std::cout << "预览已停止" << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "停止预览时发生错误: " << e.what() << std::endl;
     }
 }
 
-void CameraController::processRequest(libcamera::Request* request) {
-    if (!request || request->status() != libcamera::Request::RequestComplete) {
-        if (request) {
-            // 如果请求状态不正常，仍需释放
-            delete request;
+void CameraController::handleFrame(const FrameLease& lease) {
+    // 第一帧携带最新代数时记录生效延迟（被覆盖的中间代数不计）
+    uint64_t generation = lease->control_generation;
+    if (generation > applied_generation_.load(std::memory_order_relaxed)) {
+        applied_generation_.store(generation, std::memory_order_relaxed);
+        if (generation == control_generation_.load(std::memory_order_acquire)) {
+            int latency = static_cast<int>(lease->sequence - control_request_sequence_.load(std::memory_order_relaxed));
+            last_control_latency_.store(latency, std::memory_order_relaxed);
+            if (latency > max_control_latency_.load(std::memory_order_relaxed)) {
+                max_control_latency_.store(latency, std::memory_order_relaxed);
+            }
         }
-        return;
+    }
+    last_sequence_.store(lease->sequence, std::memory_order_relaxed);
+    frame_stats_.RecordFrame(lease->sequence, lease->sensor_timestamp_ns);
+
+    // 发布给UI；被换回后台槽的旧帧立即释放，因此预览最多占用两个缓冲
+    if (lease->viewfinder.IsValid()) {
+        preview_frames_.WriteSlot() = lease;
+        preview_frames_.Publish();
+        preview_frames_.WriteSlot().Release();
     }
 
-    try {
-        // 获取缓冲
-        libcamera::FrameBuffer* buffer = request->findBuffer(stream_);
-        if (buffer) {
-            // 映射帧缓冲内存
-            int ret = mapper_->map(buffer);
-            if (ret < 0) {
-                std::cerr << "帧缓冲映射失败" << std::endl;
-            } else {
-                // 获取映射的内存
-                const libcamera::FrameBuffer::Plane &plane = buffer->planes()[0];
-                void *data = mapper_->mappedBuffer(buffer)->planes()[0].data;
-                size_t size = plane.length;
-
-                // 更新当前缓冲
-                current_buffer_ = buffer;
-
-                // 复制数据到预览缓冲区（确保不超过缓冲区大小）
-                size_t copy_size = std::min(size, static_cast<size_t>(params_.width * params_.height * 3));
-                memcpy(preview_buffer_, data, copy_size);
-
-                // 取消映射
-                mapper_->unmap(buffer);
-            }
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "处理请求时发生异常: " << e.what() << std::endl;
+    // 消费者直接读取帧内存，需要保留帧时复制租约
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    if (frame_callback_) {
+        frame_callback_(lease);
     }
 
-    // 重新队列相同的请求继续预览
-    if (is_previewing_) {
-        if (camera_->queueRequest(request) < 0) {
-            std::cerr << "请求队列失败" << std::endl;
-            delete request;
-        }
-    } else {
-        // 如果不再预览，释放请求
-        delete request;
+    // 唤醒UI线程；上一次通知尚未被处理时不再重复推送
+    if (lease->viewfinder.IsValid() && frame_notifier_ && !notify_pending_.exchange(true)) {
+        frame_notifier_();
+    }
+}
+
+void CameraController::releasePreviewLeases() {
+    for (int i = 0; i < 3; ++i) {
+        preview_frames_.Slot(i).Release();
+    }
+}
+
+FrameLeaseStats CameraController::GetLeaseStats() const {
+    if (!source_) {
+        return FrameLeaseStats();
+    }
+    return source_->GetLeaseStats();
+}
+
+ControlLatencyStats CameraController::GetControlLatency() const {
+    ControlLatencyStats stats;
+    stats.requested_generation = control_generation_.load(std::memory_order_relaxed);
+    stats.applied_generation = applied_generation_.load(std::memory_order_relaxed);
+    stats.last_latency_frames = last_control_latency_.load(std::memory_order_relaxed);
+    stats.max_latency_frames = max_control_latency_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+CaptureTimingStats CameraController::GetCaptureTiming() const {
+    if (!source_) {
+        return CaptureTimingStats();
     }
+    return source_->GetCaptureTiming();
 }
 
-const uint8_t* CameraController::GetPreviewFrame() {
+void CameraController::SetFrameCallback(FrameCallback callback) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    frame_callback_ = std::move(callback);
+}
+
+void CameraController::SetFrameNotifier(FrameNotifier notifier) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    frame_notifier_ = std::move(notifier);
+}
+
+const uint8_t* CameraController::GetPreviewFrame(uint64_t* generation) {
     if (!is_initialized_ || !is_previewing_) {
         return nullptr;
     }
 
-    return preview_buffer_;
+    // 先清除通知标志再取帧，之后发布的帧会重新发出通知
+    notify_pending_.store(false);
+
+    // 取最新发布的帧；没有新帧时继续返回上一帧
+    preview_frames_.Update();
+    const FrameLease& lease = preview_frames_.ReadSlot();
+    if (generation) {
+        *generation = preview_frames_.ReadGeneration();
+    }
+    return lease ? lease->viewfinder.data : nullptr;
+}
+
+int CameraController::GetPreviewStride() const {
+    const FrameLease& lease = preview_frames_.ReadSlot();
+    return lease ? static_cast<int>(lease->viewfinder.stride) : params_.width * 3;
+}
+
+void CameraController::NotePreviewPresented() {
+    uint64_t generation = preview_frames_.ReadGeneration();
+    const FrameLease& lease = preview_frames_.ReadSlot();
+    if (!lease || generation == presented_generation_ || lease->sensor_timestamp_ns <= 0) {
+        return;
+    }
+    presented_generation_ = generation;
+    frame_stats_.RecordDisplayLatency(MonotonicNowNs() - lease->sensor_timestamp_ns);
+}
+
+bool CameraController::GetPreviewSize(int& width, int& height) const {
+    const FrameLease& lease = preview_frames_.ReadSlot();
+    if (!lease) {
+        return false;
+    }
+    width = static_cast<int>(lease->viewfinder.width);
+    height = static_cast<int>(lease->viewfinder.height);
+    return true;
+}
+
+FrameLease CameraController::GetLatestFrame(uint64_t* generation) {
+    if (!is_initialized_ || !is_previewing_) {
+        return FrameLease();
+    }
+
+    notify_pending_.store(false);
+    preview_frames_.Update();
+    if (generation) {
+        *generation = preview_frames_.ReadGeneration();
+    }
+    return preview_frames_.ReadSlot();
 }
 
 void CameraController::StartRecording(const std::string& filename) {
@@ -332,23 +312,44 @@ void CameraController::CycleWhiteBalance() {
     std::cout << "白平衡: " << params_.white_balance << "K" << std::endl;
 }
 
-void CameraController::SetResolution(int width, int height) {
+void CameraController::Reconfigure(const CameraParams& params) {
     if (!is_initialized_) {
         throw std::runtime_error("摄像头未初始化");
     }
 
-    // 重新初始化相机以更改分辨率
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    bool was_previewing = is_previewing_;
+
+    // 停止采集并交还预览持有的帧，帧来源只重建发生变化的部分
     StopRecording();
     StopPreview();
-    
-    params_.width = width;
-    params_.height = height;
-    
-    // 重新初始化
-    Initialize(params_);
-    
-    // 重新开始预览
-    StartPreview();
+
+    CameraParams new_params = params;
+    new_params.exposure_compensation = params_.exposure_compensation;
+    new_params.iso = params_.iso;
+    new_params.white_balance = params_.white_balance;
+    source_->Reconfigure(new_params);
+    params_ = new_params;
+    raw_format_ = source_->GetRawFormat();
+    frame_stats_.Reset(params_.fps);
+
+    // 新配置的第一个请求重新携带当前控制参数
+    setupControls();
+
+    if (was_previewing) {
+        StartPreview();
+    }
+
+    last_reconfigure_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    std::cout << "重新配置完成: " << params_.width << "x" << params_.height << " " << params_.bit_depth
+              << "位, 用时 " << last_reconfigure_ms_ << "ms" << std::endl;
+}
+
+void CameraController::SetResolution(int width, int height) {
+    CameraParams params = params_;
+    params.width = width;
+    params.height = height;
+    Reconfigure(params);
 }
 
 void CameraController::SetFPS(int fps) {
@@ -359,8 +360,8 @@ void CameraController::SetFPS(int fps) {
     params_.fps = fps;
     std::cout << "FPS设置为: " << fps << std::endl;
     
-    // libcamera 的帧率控制比较复杂，通常在流配置中设置
-    // 这里只是更新参数，实际效果可能需要重新配置相机
+    // 帧率通过FrameDurationLimits随下一个请求发送
+    setupControls();
 }
 
 void CameraController::SetBitDepth(int bit_depth) {
@@ -368,10 +369,12 @@ void CameraController::SetBitDepth(int bit_depth) {
         throw std::runtime_error("摄像头未初始化");
     }
 
-    params_.bit_depth = bit_depth;
     std::cout << "位深度设置为: " << bit_depth << "位" << std::endl;
     
-    // 位深度通常在流配置中设置，这里只是更新参数
+    // 位深度决定RAW流格式，需要重新配置
+    CameraParams params = params_;
+    params.bit_depth = bit_depth;
+    Reconfigure(params);
 }
 
 void CameraController::SetExposureCompensation(float value) {
@@ -4,33 +4,34 @@
 #ifndef CAMERA_CONTROLLER_H
 #define CAMERA_CONTROLLER_H
 
-// 使用libcamera API
-#include <libcamera/camera.h>
-#include <libcamera/camera_manager.h>
-#include <libcamera/framebuffer.h>
-#include <libcamera/framebuffer_allocator.h>
-#include <libcamera/framebuffer_mapper.h>
-#include <libcamera/request.h>
-#include <libcamera/stream.h>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include "camera_params.h"
+#include "frame_lease.h"
+#include "frame_source.h"
+#include "frame_stats.h"
+#include "frame_types.h"
+#include "triple_buffer.h"
 
 namespace cinepi {
 
-// 摄像头参数结构体
-struct CameraParams {
-    int width;
-    int height;
-    int fps;
-    int bit_depth;
-    float exposure_compensation;
-    int iso;
-    int white_balance;
-
-    CameraParams(int w = 1280, int h = 720, int f = 30, int bd = 12, float ec = 0.0f, int i = 100, int wb = 4000)
-        : width(w), height(h), fps(f), bit_depth(bd), exposure_compensation(ec), iso(i), white_balance(wb) {}
+// 每帧回调，在帧来源的线程中调用；需要在回调之后继续使用帧时复制租约即可
+using FrameCallback = std::function<void(const FrameLease&)>;
+
+// 新预览帧通知，在帧来源的线程中调用，用于唤醒UI线程；UI取帧之前不会重复通知
+using FrameNotifier = std::function<void()>;
+
+// 控制参数生效延迟：从提交参数到第一帧携带该代数所经过的帧数
+struct ControlLatencyStats {
+    uint64_t requested_generation;  // 最近一次提交的代数
+    uint64_t applied_generation;    // 最近一帧携带的代数
+    int last_latency_frames;
+    int max_latency_frames;
 };
 
 // 摄像头控制类
@@ -48,8 +49,52 @@ public:
     // 停止预览
     void StopPreview();
 
-    // 获取预览帧数据
-    const uint8_t* GetPreviewFrame();
+    // 获取最新的完整预览帧（仅限UI线程调用），尚无帧时返回nullptr
+    // generation返回该帧的代数，与上次相同说明没有新帧，可以跳过纹理上传
+    // 返回的指针直接指向传感器缓冲，在下一次调用之前有效
+    const uint8_t* GetPreviewFrame(uint64_t* generation = nullptr);
+
+    // 当前预览帧的行步长（字节）
+    int GetPreviewStride() const;
+
+    // 当前预览帧的尺寸（不同帧来源的预览尺寸可能与窗口不同）
+    bool GetPreviewSize(int& width, int& height) const;
+
+    // 获取最新帧的租约（仅限UI线程调用），持有期间缓冲不会被回收
+    FrameLease GetLatestFrame(uint64_t* generation = nullptr);
+
+    // 获取帧租约统计
+    FrameLeaseStats GetLeaseStats() const;
+
+    // 设置每帧回调（RAW + 取景流），需在StartPreview之前设置
+    void SetFrameCallback(FrameCallback callback);
+
+    // 设置新预览帧通知，需在StartPreview之前设置
+    void SetFrameNotifier(FrameNotifier notifier);
+
+    // 获取采集回调（帧完成到回调返回）的每帧耗时统计
+    CaptureTimingStats GetCaptureTiming() const;
+
+    // 获取控制参数生效延迟
+    ControlLatencyStats GetControlLatency() const;
+
+    // 帧时序统计（丢帧、抖动、延迟），落盘延迟由录制模块记录
+    FrameStats& GetFrameStats() { return frame_stats_; }
+
+    // UI线程在呈现画面之后调用，记录当前预览帧的采集到显示延迟（每帧只记一次）
+    void NotePreviewPresented();
+
+    // 获取RAW流格式
+    const FrameFormat& GetRawFormat() const { return raw_format_; }
+
+    // 每帧RAW数据的字节数，录制模块按此预分配缓冲
+    size_t GetRawFrameBytes() const { return source_ ? source_->GetRawFrameBytes() : 0; }
+
+    // RAW数据的黑电平
+    int GetBlackLevel() const { return source_ ? source_->GetBlackLevel() : 0; }
+
+    // 当前帧来源名称
+    const char* GetSourceName() const { return source_ ? source_->Name() : "none"; }
 
     // 开始录制
     void StartRecording(const std::string& filename);
@@ -67,6 +112,10 @@ public:
     void CycleWhiteBalance();
 
     // 设置参数
+    // 重新配置传感器输出（停止、重建变化的流、恢复预览），记录切换耗时
+    void Reconfigure(const CameraParams& params);
+    double GetReconfigureTime() const { return last_reconfigure_ms_; }
+
     void SetResolution(int width, int height);
     void SetFPS(int fps);
     void SetBitDepth(int bit_depth);
@@ -86,26 +135,44 @@ public:
     bool IsRecording() const { return is_recording_; }
 
 private:
-    // libcamera相关成员
-    std::unique_ptr<libcamera::CameraManager> camera_manager_;
-    std::shared_ptr<libcamera::Camera> camera_;
-    std::unique_ptr<libcamera::CameraConfiguration> config_;
-    std::unique_ptr<libcamera::FrameBufferAllocator> allocator_;
-    std::unique_ptr<libcamera::FrameBufferMapper> mapper_;
-    libcamera::Stream* stream_;
-    libcamera::Request* request_;
-    const libcamera::FrameBuffer* current_buffer_;
-    uint8_t* preview_buffer_;
+    // 帧来源（libcamera、合成图案或回放）
+    std::unique_ptr<FrameSource> source_;
+
+    // 预览帧三缓冲：帧来源线程发布租约，UI线程取最新一帧
+    TripleBuffer<FrameLease> preview_frames_;
+
+    // RAW流格式与每帧回调
+    FrameFormat raw_format_;
+    FrameCallback frame_callback_;
+    FrameNotifier frame_notifier_;
+    std::mutex callback_mutex_;
+    std::atomic<bool> notify_pending_;  // 已通知但UI尚未取帧
+
+    // 控制参数代数与生效延迟（在帧来源线程中更新）
+    std::atomic<uint64_t> control_generation_;
+    std::atomic<uint64_t> applied_generation_;
+    std::atomic<uint32_t> last_sequence_;
+    std::atomic<uint32_t> control_request_sequence_;
+    std::atomic<int> last_control_latency_;
+    std::atomic<int> max_control_latency_;
+
+    // 帧时序统计
+    FrameStats frame_stats_;
+    uint64_t presented_generation_;
+
+    // 最近一次重新配置的耗时（毫秒）
+    double last_reconfigure_ms_;
 
     // 应用参数
     CameraParams params_;
     bool is_initialized_;
-    bool is_previewing_;
+    std::atomic<bool> is_previewing_;
     bool is_recording_;
 
     // 辅助方法
     void setupControls();
-    void processRequest(libcamera::Request* request);
+    void releasePreviewLeases();
+    void handleFrame(const FrameLease& lease);
 };
 
 } // namespace cinepi
@@ -0,0 +1,81 @@
+// camera_params.h
+// 摄像头参数与帧来源选择
+
+#ifndef CAMERA_PARAMS_H
+#define CAMERA_PARAMS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace cinepi {
+
+// 帧来源类型
+enum class FrameSourceType {
+    Libcamera,  // 真实传感器（libcamera）
+    Synthetic,  // 合成测试图案
+    Replay      // 回放已录制的.raw文件
+};
+
+// 摄像头参数结构体
+struct CameraParams {
+    int width;
+    int height;
+    int fps;
+    int bit_depth;
+    float exposure_compensation;
+    int iso;
+    int white_balance;
+
+    // 预览（取景流）尺寸，0表示与传感器输出同比例、宽度不超过MAX_PREVIEW_WIDTH
+    int preview_width;
+    int preview_height;
+
+    // 预览直接由RAW帧去马赛克生成，不输出ISP取景流（取景帧为空）
+    bool raw_preview;
+
+    // 帧来源
+    FrameSourceType source;
+    std::string replay_path;    // 回放文件路径
+    int replay_stride;          // 回放文件的行步长，0表示按文件大小自动判断
+    bool replay_loop;           // 回放到文件末尾后从头开始
+
+    CameraParams(int w = 1280, int h = 720, int f = 30, int bd = 12, float ec = 0.0f, int i = 100, int wb = 4000)
+        : width(w), height(h), fps(f), bit_depth(bd), exposure_compensation(ec), iso(i), white_balance(wb),
+          preview_width(0), preview_height(0), raw_preview(false), source(FrameSourceType::Libcamera),
+          replay_stride(0), replay_loop(true) {}
+
+    static constexpr int MAX_PREVIEW_WIDTH = 1280;
+
+    // 实际使用的预览尺寸（取偶数）
+    int PreviewWidth() const {
+        int preview = preview_width > 0 ? preview_width : std::min(width, MAX_PREVIEW_WIDTH);
+        return std::max(preview & ~1, 2);
+    }
+    int PreviewHeight() const {
+        if (preview_height > 0) {
+            return std::max(preview_height & ~1, 2);
+        }
+        int64_t scaled = (static_cast<int64_t>(height) * PreviewWidth() + width / 2) / std::max(width, 1);
+        return std::max(static_cast<int>(scaled) & ~1, 2);
+    }
+};
+
+// 解析命令行中的帧来源：libcamera、synthetic 或 replay:<文件>
+inline bool ParseFrameSource(const std::string& value, CameraParams& params) {
+    if (value == "libcamera") {
+        params.source = FrameSourceType::Libcamera;
+    } else if (value == "synthetic") {
+        params.source = FrameSourceType::Synthetic;
+    } else if (value.compare(0, 7, "replay:") == 0 && value.size() > 7) {
+        params.source = FrameSourceType::Replay;
+        params.replay_path = value.substr(7);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace cinepi
+
+#endif // CAMERA_PARAMS_H
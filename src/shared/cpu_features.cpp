@@ -0,0 +1,54 @@
+// cpu_features.cpp
+// 运行时CPU特性检测实现
+
+#include "cpu_features.h"
+
+namespace cinepi {
+
+bool SimdLevelSupported(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar:
+            return true;
+#if defined(__x86_64__) || defined(__i386__)
+        case SimdLevel::Ssse3:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("ssse3");
+        case SimdLevel::Avx2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+#if defined(__ARM_NEON)
+        case SimdLevel::Neon:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+SimdLevel DetectSimdLevel() {
+    std::vector<SimdLevel> levels = SupportedSimdLevels();
+    return levels.back();
+}
+
+std::vector<SimdLevel> SupportedSimdLevels() {
+    std::vector<SimdLevel> levels;
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Ssse3, SimdLevel::Avx2, SimdLevel::Neon }) {
+        if (SimdLevelSupported(level)) {
+            levels.push_back(level);
+        }
+    }
+    return levels;
+}
+
+const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::Ssse3:  return "ssse3";
+        case SimdLevel::Avx2:   return "avx2";
+        case SimdLevel::Neon:   return "neon";
+        default:                return "unknown";
+    }
+}
+
+} // namespace cinepi
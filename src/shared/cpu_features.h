@@ -0,0 +1,36 @@
+// cpu_features.h
+// 运行时CPU特性检测，用于在标量与SIMD内核之间选择
+//
+// 同一份二进制需要同时运行在树莓派（NEON）和x86开发机（SSSE3/AVX2）上，
+// x86内核用target属性单独编译，运行时按CPU能力选择；ARM上NEON在编译期确定。
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include <vector>
+
+namespace cinepi {
+
+// SIMD指令集级别
+enum class SimdLevel {
+    Scalar,
+    Ssse3,
+    Avx2,
+    Neon
+};
+
+// 当前CPU支持的最高级别
+SimdLevel DetectSimdLevel();
+
+// 当前CPU是否支持指定级别
+bool SimdLevelSupported(SimdLevel level);
+
+// 当前CPU支持的全部级别（从标量开始）
+std::vector<SimdLevel> SupportedSimdLevels();
+
+// 级别名称，用于日志
+const char* SimdLevelName(SimdLevel level);
+
+} // namespace cinepi
+
+#endif // CPU_FEATURES_H
@@ -0,0 +1,388 @@
+// debayer.cpp
+// 超像素去马赛克实现
+//
+// 半分辨率去马赛克分两步：SIMD内核把两行解包后的数据按2x2块分离为两个颜色通道和绿色平均，
+// 再逐像素查表输出。查表（4096项）没有合适的SIMD实现（NEON没有gather），保持标量。
+
+#include "debayer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+#include "bit_pack.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace cinepi {
+
+namespace {
+
+// 红色和蓝色在2x2块（左上、右上、左下、右下）中的位置，另外两个是绿色
+void bayerIndices(BayerOrder order, int& red_index, int& blue_index) {
+    switch (order) {
+        case BayerOrder::RGGB: red_index = 0; blue_index = 3; break;
+        case BayerOrder::GRBG: red_index = 1; blue_index = 2; break;
+        case BayerOrder::GBRG: red_index = 2; blue_index = 1; break;
+        case BayerOrder::BGGR: red_index = 3; blue_index = 0; break;
+        default:               red_index = 0; blue_index = 3; break;
+    }
+}
+
+// 分离一对Bayer行中的cells个2x2块：first为上一行的颜色，second为下一行的颜色，green为两个绿色的平均（四舍五入）。
+// green_on_diagonal表示绿色在左上和右下（GRBG/GBRG），否则在右上和左下（RGGB/BGGR）
+typedef void (*SplitKernel)(const uint16_t* top, const uint16_t* bottom, unsigned int cells, bool green_on_diagonal,
+                            uint16_t* first, uint16_t* second, uint16_t* green);
+
+// 一组同一指令集级别的内核
+struct DebayerKernels {
+    SimdLevel level;
+    SplitKernel split;
+};
+
+// ---- 标量参考实现 ----
+
+void splitCellsScalar(const uint16_t* top, const uint16_t* bottom, unsigned int cells, bool green_on_diagonal,
+                      uint16_t* first, uint16_t* second, uint16_t* green) {
+    for (unsigned int x = 0; x < cells; ++x, top += 2, bottom += 2) {
+        if (green_on_diagonal) {
+            first[x] = top[1];
+            second[x] = bottom[0];
+            green[x] = static_cast<uint16_t>((top[0] + bottom[1] + 1) >> 1);
+        } else {
+            first[x] = top[0];
+            second[x] = bottom[1];
+            green[x] = static_cast<uint16_t>((top[1] + bottom[0] + 1) >> 1);
+        }
+    }
+}
+
+const DebayerKernels SCALAR_KERNELS = { SimdLevel::Scalar, splitCellsScalar };
+
+// ---- x86：SSSE3 / AVX2 ----
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define CINEPI_TARGET(isa) __attribute__((target(isa)))
+
+// 把8个16位值重排为4个偶数位置、4个奇数位置
+alignas(16) const int8_t DEINTERLEAVE16[16] = { 0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15 };
+
+CINEPI_TARGET("ssse3")
+void splitCellsSsse3(const uint16_t* top, const uint16_t* bottom, unsigned int cells, bool green_on_diagonal,
+                     uint16_t* first, uint16_t* second, uint16_t* green) {
+    const __m128i order = _mm_load_si128(reinterpret_cast<const __m128i*>(DEINTERLEAVE16));
+    unsigned int x = 0;
+    for (; x + 8 <= cells; x += 8) {
+        const __m128i* t = reinterpret_cast<const __m128i*>(top + x * 2);
+        const __m128i* b = reinterpret_cast<const __m128i*>(bottom + x * 2);
+        __m128i t0 = _mm_shuffle_epi8(_mm_loadu_si128(t), order);
+        __m128i t1 = _mm_shuffle_epi8(_mm_loadu_si128(t + 1), order);
+        __m128i b0 = _mm_shuffle_epi8(_mm_loadu_si128(b), order);
+        __m128i b1 = _mm_shuffle_epi8(_mm_loadu_si128(b + 1), order);
+        __m128i top_even = _mm_unpacklo_epi64(t0, t1);
+        __m128i top_odd = _mm_unpackhi_epi64(t0, t1);
+        __m128i bottom_even = _mm_unpacklo_epi64(b0, b1);
+        __m128i bottom_odd = _mm_unpackhi_epi64(b0, b1);
+        __m128i* f = reinterpret_cast<__m128i*>(first + x);
+        __m128i* s = reinterpret_cast<__m128i*>(second + x);
+        __m128i* g = reinterpret_cast<__m128i*>(green + x);
+        // pavgw即(a+b+1)>>1，与标量版本一致
+        if (green_on_diagonal) {
+            _mm_storeu_si128(f, top_odd);
+            _mm_storeu_si128(s, bottom_even);
+            _mm_storeu_si128(g, _mm_avg_epu16(top_even, bottom_odd));
+        } else {
+            _mm_storeu_si128(f, top_even);
+            _mm_storeu_si128(s, bottom_odd);
+            _mm_storeu_si128(g, _mm_avg_epu16(top_odd, bottom_even));
+        }
+    }
+    splitCellsScalar(top + x * 2, bottom + x * 2, cells - x, green_on_diagonal, first + x, second + x, green + x);
+}
+
+const DebayerKernels SSSE3_KERNELS = { SimdLevel::Ssse3, splitCellsSsse3 };
+
+// AVX2的字节重排只在128位通道内进行，合并后再按64位重排回原顺序
+CINEPI_TARGET("avx2")
+void splitCellsAvx2(const uint16_t* top, const uint16_t* bottom, unsigned int cells, bool green_on_diagonal,
+                    uint16_t* first, uint16_t* second, uint16_t* green) {
+    const __m256i order = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(DEINTERLEAVE16)));
+    unsigned int x = 0;
+    for (; x + 16 <= cells; x += 16) {
+        const __m256i* t = reinterpret_cast<const __m256i*>(top + x * 2);
+        const __m256i* b = reinterpret_cast<const __m256i*>(bottom + x * 2);
+        __m256i t0 = _mm256_shuffle_epi8(_mm256_loadu_si256(t), order);
+        __m256i t1 = _mm256_shuffle_epi8(_mm256_loadu_si256(t + 1), order);
+        __m256i b0 = _mm256_shuffle_epi8(_mm256_loadu_si256(b), order);
+        __m256i b1 = _mm256_shuffle_epi8(_mm256_loadu_si256(b + 1), order);
+        __m256i top_even = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(t0, t1), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i top_odd = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(t0, t1), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i bottom_even = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(b0, b1), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i bottom_odd = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(b0, b1), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i* f = reinterpret_cast<__m256i*>(first + x);
+        __m256i* s = reinterpret_cast<__m256i*>(second + x);
+        __m256i* g = reinterpret_cast<__m256i*>(green + x);
+        if (green_on_diagonal) {
+            _mm256_storeu_si256(f, top_odd);
+            _mm256_storeu_si256(s, bottom_even);
+            _mm256_storeu_si256(g, _mm256_avg_epu16(top_even, bottom_odd));
+        } else {
+            _mm256_storeu_si256(f, top_even);
+            _mm256_storeu_si256(s, bottom_odd);
+            _mm256_storeu_si256(g, _mm256_avg_epu16(top_odd, bottom_even));
+        }
+    }
+    splitCellsSsse3(top + x * 2, bottom + x * 2, cells - x, green_on_diagonal, first + x, second + x, green + x);
+}
+
+const DebayerKernels AVX2_KERNELS = { SimdLevel::Avx2, splitCellsAvx2 };
+
+#undef CINEPI_TARGET
+
+#endif // x86
+
+// ---- ARM：NEON ----
+
+#if defined(__ARM_NEON)
+
+void splitCellsNeon(const uint16_t* top, const uint16_t* bottom, unsigned int cells, bool green_on_diagonal,
+                    uint16_t* first, uint16_t* second, uint16_t* green) {
+    unsigned int x = 0;
+    // vld2按偶数/奇数位置解交织，vrhadd即(a+b+1)>>1
+    for (; x + 8 <= cells; x += 8) {
+        uint16x8x2_t t = vld2q_u16(top + x * 2);
+        uint16x8x2_t b = vld2q_u16(bottom + x * 2);
+        if (green_on_diagonal) {
+            vst1q_u16(first + x, t.val[1]);
+            vst1q_u16(second + x, b.val[0]);
+            vst1q_u16(green + x, vrhaddq_u16(t.val[0], b.val[1]));
+        } else {
+            vst1q_u16(first + x, t.val[0]);
+            vst1q_u16(second + x, b.val[1]);
+            vst1q_u16(green + x, vrhaddq_u16(t.val[1], b.val[0]));
+        }
+    }
+    splitCellsScalar(top + x * 2, bottom + x * 2, cells - x, green_on_diagonal, first + x, second + x, green + x);
+}
+
+const DebayerKernels NEON_KERNELS = { SimdLevel::Neon, splitCellsNeon };
+
+#endif // __ARM_NEON
+
+const DebayerKernels* kernelsFor(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return &SCALAR_KERNELS;
+#if defined(__x86_64__) || defined(__i386__)
+        case SimdLevel::Ssse3:  return &SSSE3_KERNELS;
+        case SimdLevel::Avx2:   return &AVX2_KERNELS;
+#endif
+#if defined(__ARM_NEON)
+        case SimdLevel::Neon:   return &NEON_KERNELS;
+#endif
+        default:                return nullptr;
+    }
+}
+
+// CPU支持的最高级别；该级别没有对应内核时退回标量
+const DebayerKernels* bestKernels() {
+    const DebayerKernels* best = kernelsFor(DetectSimdLevel());
+    return best != nullptr ? best : &SCALAR_KERNELS;
+}
+
+std::atomic<const DebayerKernels*>& activeKernels() {
+    static std::atomic<const DebayerKernels*> active(bestKernels());
+    return active;
+}
+
+const DebayerKernels& kernels() {
+    return *activeKernels().load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+void DebayerToRGB888(const FrameView& raw, uint8_t* dst, unsigned int dst_width, unsigned int dst_height, unsigned int dst_stride) {
+    if (!raw.IsValid() || !raw.format.IsBayer() || raw.width < 2 || raw.height < 2) {
+        return;
+    }
+
+    unsigned int cells_x = raw.width / 2;
+    unsigned int cells_y = raw.height / 2;
+    int shift = raw.format.bit_depth > 8 ? raw.format.bit_depth - 8 : 0;
+
+    // 两个绿色取平均
+    int red_index = 0;
+    int blue_index = 3;
+    bayerIndices(raw.format.bayer_order, red_index, blue_index);
+
+    std::vector<uint16_t> rows(static_cast<size_t>(raw.width) * 2);
+    uint16_t* row0 = rows.data();
+    uint16_t* row1 = rows.data() + raw.width;
+    unsigned int current_cell_y = cells_y;
+
+    for (unsigned int y = 0; y < dst_height; ++y) {
+        unsigned int cell_y = static_cast<unsigned int>(static_cast<uint64_t>(y) * cells_y / dst_height);
+        if (cell_y != current_cell_y) {
+            UnpackRow(raw.format.encoding, raw.data + static_cast<size_t>(cell_y) * 2 * raw.stride, row0, raw.width);
+            UnpackRow(raw.format.encoding, raw.data + (static_cast<size_t>(cell_y) * 2 + 1) * raw.stride, row1, raw.width);
+            current_cell_y = cell_y;
+        }
+
+        uint8_t* out = dst + static_cast<size_t>(y) * dst_stride;
+        for (unsigned int x = 0; x < dst_width; ++x) {
+            unsigned int cell_x = static_cast<unsigned int>(static_cast<uint64_t>(x) * cells_x / dst_width) * 2;
+            uint16_t cell[4] = { row0[cell_x], row0[cell_x + 1], row1[cell_x], row1[cell_x + 1] };
+            int green = (cell[0] + cell[1] + cell[2] + cell[3] - cell[red_index] - cell[blue_index]) >> 1;
+            int red = cell[red_index] >> shift;
+            int blue = cell[blue_index] >> shift;
+            green >>= shift;
+            out[0] = static_cast<uint8_t>(blue > 255 ? 255 : blue);
+            out[1] = static_cast<uint8_t>(green > 255 ? 255 : green);
+            out[2] = static_cast<uint8_t>(red > 255 ? 255 : red);
+            out += 3;
+        }
+    }
+}
+
+void BuildDebayerTone(DebayerTone& tone, int bit_depth, int black_level, float red_gain, float blue_gain, float gamma) {
+    size_t size = static_cast<size_t>(1) << bit_depth;
+    double white = static_cast<double>(size - 1);
+    double range = std::max(white - black_level, 1.0);
+    double inverse_gamma = gamma > 0 ? 1.0 / gamma : 1.0;
+    float gains[3] = { red_gain > 0 ? red_gain : 1.0f, 1.0f, blue_gain > 0 ? blue_gain : 1.0f };
+    std::vector<uint8_t>* tables[3] = { &tone.red, &tone.green, &tone.blue };
+
+    for (int channel = 0; channel < 3; ++channel) {
+        std::vector<uint8_t>& table = *tables[channel];
+        table.resize(size);
+        for (size_t value = 0; value < size; ++value) {
+            double linear = std::min(std::max(static_cast<double>(value) - black_level, 0.0) / range * gains[channel], 1.0);
+            table[value] = static_cast<uint8_t>(std::lround(255.0 * std::pow(linear, inverse_gamma)));
+        }
+    }
+}
+
+void DebayerBinned(const FrameView& raw, unsigned int bin, const DebayerTone& tone, uint8_t* dst, unsigned int dst_stride,
+                   unsigned int row_begin, unsigned int row_end) {
+    if (!raw.IsValid() || !raw.format.IsBayer() || bin == 0) {
+        return;
+    }
+    unsigned int out_width = raw.width / 2 / bin;
+    unsigned int out_height = raw.height / 2 / bin;
+    row_end = std::min(row_end, out_height);
+    size_t table_size = tone.green.size();
+    if (out_width == 0 || row_begin >= row_end || table_size == 0) {
+        return;
+    }
+
+    int red_index = 0;
+    int blue_index = 3;
+    bayerIndices(raw.format.bayer_order, red_index, blue_index);
+
+    // 每个输出像素累加bin×bin个块：红蓝各bin²个样本，绿色2×bin²个
+    unsigned int samples = bin * bin;
+    unsigned int used_width = out_width * bin * 2;
+    std::vector<uint16_t> rows(static_cast<size_t>(used_width) * 2);
+    uint16_t* row0 = rows.data();
+    uint16_t* row1 = rows.data() + used_width;
+    std::vector<uint32_t> sums(static_cast<size_t>(out_width) * 3);
+
+    for (unsigned int y = row_begin; y < row_end; ++y) {
+        std::fill(sums.begin(), sums.end(), 0);
+        for (unsigned int cell_row = 0; cell_row < bin; ++cell_row) {
+            size_t raw_y = (static_cast<size_t>(y) * bin + cell_row) * 2;
+            UnpackRow(raw.format.encoding, raw.data + raw_y * raw.stride, row0, used_width);
+            UnpackRow(raw.format.encoding, raw.data + (raw_y + 1) * raw.stride, row1, used_width);
+
+            uint32_t* sum = sums.data();
+            for (unsigned int x = 0; x < out_width; ++x, sum += 3) {
+                const uint16_t* top = row0 + static_cast<size_t>(x) * bin * 2;
+                const uint16_t* bottom = row1 + static_cast<size_t>(x) * bin * 2;
+                for (unsigned int cell = 0; cell < bin; ++cell, top += 2, bottom += 2) {
+                    uint32_t cell_values[4] = { top[0], top[1], bottom[0], bottom[1] };
+                    sum[0] += cell_values[red_index];
+                    sum[2] += cell_values[blue_index];
+                    sum[1] += cell_values[0] + cell_values[1] + cell_values[2] + cell_values[3] -
+                              cell_values[red_index] - cell_values[blue_index];
+                }
+            }
+        }
+
+        uint8_t* out = dst + static_cast<size_t>(y) * dst_stride;
+        const uint32_t* sum = sums.data();
+        for (unsigned int x = 0; x < out_width; ++x, sum += 3, out += 3) {
+            out[0] = tone.blue[std::min<size_t>(sum[2] / samples, table_size - 1)];
+            out[1] = tone.green[std::min<size_t>(sum[1] / (samples * 2), table_size - 1)];
+            out[2] = tone.red[std::min<size_t>(sum[0] / samples, table_size - 1)];
+        }
+    }
+}
+
+void DebayerHalf(const FrameView& raw, const DebayerTone& tone, uint8_t* dst, unsigned int dst_stride,
+                 unsigned int row_begin, unsigned int row_end) {
+    if (!raw.IsValid() || !raw.format.IsBayer()) {
+        return;
+    }
+    unsigned int out_width = raw.width / 2;
+    unsigned int out_height = raw.height / 2;
+    row_end = std::min(row_end, out_height);
+    size_t table_size = tone.green.size();
+    if (out_width == 0 || row_begin >= row_end || table_size == 0 ||
+        tone.red.size() != table_size || tone.blue.size() != table_size) {
+        return;
+    }
+
+    // 红色在块的上一行时对应first，否则对应second；蓝色相反
+    int red_index = 0;
+    int blue_index = 3;
+    bayerIndices(raw.format.bayer_order, red_index, blue_index);
+    bool green_on_diagonal = red_index == 1 || red_index == 2;
+    bool red_on_top = red_index < 2;
+
+    unsigned int used_width = out_width * 2;
+    std::vector<uint16_t> buffer(static_cast<size_t>(used_width) * 2 + static_cast<size_t>(out_width) * 3);
+    uint16_t* row0 = buffer.data();
+    uint16_t* row1 = row0 + used_width;
+    uint16_t* first = row1 + used_width;
+    uint16_t* second = first + out_width;
+    uint16_t* green = second + out_width;
+    const uint16_t* red = red_on_top ? first : second;
+    const uint16_t* blue = red_on_top ? second : first;
+    const uint8_t* red_table = tone.red.data();
+    const uint8_t* green_table = tone.green.data();
+    const uint8_t* blue_table = tone.blue.data();
+    unsigned int max_value = static_cast<unsigned int>(table_size - 1);
+    SplitKernel split = kernels().split;
+
+    for (unsigned int y = row_begin; y < row_end; ++y) {
+        size_t raw_y = static_cast<size_t>(y) * 2;
+        UnpackRow(raw.format.encoding, raw.data + raw_y * raw.stride, row0, used_width);
+        UnpackRow(raw.format.encoding, raw.data + (raw_y + 1) * raw.stride, row1, used_width);
+        split(row0, row1, out_width, green_on_diagonal, first, second, green);
+
+        uint8_t* out = dst + static_cast<size_t>(y) * dst_stride;
+        for (unsigned int x = 0; x < out_width; ++x, out += 3) {
+            out[0] = blue_table[std::min<unsigned int>(blue[x], max_value)];
+            out[1] = green_table[std::min<unsigned int>(green[x], max_value)];
+            out[2] = red_table[std::min<unsigned int>(red[x], max_value)];
+        }
+    }
+}
+
+SimdLevel GetDebayerLevel() {
+    return kernels().level;
+}
+
+bool SetDebayerLevel(SimdLevel level) {
+    const DebayerKernels* selected = kernelsFor(level);
+    if (selected == nullptr || !SimdLevelSupported(level)) {
+        return false;
+    }
+    activeKernels().store(selected, std::memory_order_relaxed);
+    return true;
+}
+
+} // namespace cinepi
@@ -0,0 +1,46 @@
+// debayer.h
+// 从Bayer RAW帧生成预览用的RGB图像
+
+#ifndef DEBAYER_H
+#define DEBAYER_H
+
+#include <cstdint>
+#include <vector>
+#include "cpu_features.h"
+#include "frame_types.h"
+
+namespace cinepi {
+
+// 2x2超像素去马赛克并最近邻缩放到目标尺寸，输出libcamera RGB888（字节顺序B,G,R）
+void DebayerToRGB888(const FrameView& raw, uint8_t* dst, unsigned int dst_width, unsigned int dst_height, unsigned int dst_stride);
+
+// RAW值到8位显示值的查找表：减黑电平、乘通道增益后按gamma映射，每个通道一张表，按RAW值索引
+struct DebayerTone {
+    std::vector<uint8_t> red;
+    std::vector<uint8_t> green;
+    std::vector<uint8_t> blue;
+};
+
+// 生成查找表；增益为0时按1处理
+void BuildDebayerTone(DebayerTone& tone, int bit_depth, int black_level, float red_gain, float blue_gain, float gamma);
+
+// 合并去马赛克：每个输出像素取bin×bin个2x2块的平均（输出尺寸为RAW的1/(2*bin)），查表后输出RGB888（B,G,R）。
+// 只处理输出行[row_begin, row_end)，多个线程可以分块处理同一帧
+void DebayerBinned(const FrameView& raw, unsigned int bin, const DebayerTone& tone, uint8_t* dst, unsigned int dst_stride,
+                   unsigned int row_begin, unsigned int row_end);
+
+// 半分辨率去马赛克：每个2x2块输出一个像素（输出尺寸为RAW的1/2），两个绿色取平均（四舍五入），
+// 查表后输出RGB888（B,G,R）。只处理输出行[row_begin, row_end)，多个线程可以分块处理同一帧。
+// 块内分离颜色和绿色平均有SSSE3、AVX2和NEON版本，结果与标量版本逐字节一致
+void DebayerHalf(const FrameView& raw, const DebayerTone& tone, uint8_t* dst, unsigned int dst_stride,
+                 unsigned int row_begin, unsigned int row_end);
+
+// 半分辨率去马赛克当前使用的内核级别
+SimdLevel GetDebayerLevel();
+
+// 强制使用指定级别的内核（基准测试和对比用），CPU不支持时返回false
+bool SetDebayerLevel(SimdLevel level);
+
+} // namespace cinepi
+
+#endif // DEBAYER_H
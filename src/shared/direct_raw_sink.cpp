@@ -0,0 +1,451 @@
+// direct_raw_sink.cpp
+// O_DIRECT落盘实现
+
+#include "direct_raw_sink.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+#ifdef CINEPI_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace cinepi {
+
+// 在途写请求队列：每个暂存块同一时间最多一个写请求，按暂存块序号提交和等待
+class DirectWriteQueue {
+public:
+    virtual ~DirectWriteQueue() = default;
+
+    // 实现名称，用于日志
+    virtual const char* Name() const = 0;
+
+    // 提交第index块的写请求，立即返回
+    virtual bool Submit(size_t index, int fd, const uint8_t* data, size_t len, uint64_t offset) = 0;
+
+    // 等待第index块的写请求完成，latency_ns返回提交到完成的耗时
+    virtual bool Wait(size_t index, int64_t& latency_ns) = 0;
+};
+
+namespace {
+
+// 写满len字节，处理被信号打断和部分写入
+bool pwriteAll(int fd, const uint8_t* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t written = ::pwrite(fd, data, len, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "直接I/O写入失败: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        data += written;
+        len -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+// pwrite线程池：每个线程一次执行一个写请求，线程数即在途写请求数
+class ThreadWriteQueue : public DirectWriteQueue {
+public:
+    ThreadWriteQueue(size_t slots, size_t threads) : jobs_(slots), stopping_(false) {
+        for (size_t i = 0; i < threads; ++i) {
+            threads_.emplace_back(&ThreadWriteQueue::run, this);
+        }
+    }
+
+    ~ThreadWriteQueue() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_cv_.notify_all();
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    const char* Name() const override { return "pwrite线程池"; }
+
+    bool Submit(size_t index, int fd, const uint8_t* data, size_t len, uint64_t offset) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Job& job = jobs_[index];
+            job.fd = fd;
+            job.data = data;
+            job.len = len;
+            job.offset = offset;
+            job.submit_ns = MonotonicNowNs();
+            job.done = false;
+            pending_.push_back(index);
+        }
+        work_cv_.notify_one();
+        return true;
+    }
+
+    bool Wait(size_t index, int64_t& latency_ns) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this, index] { return jobs_[index].done; });
+        latency_ns = jobs_[index].done_ns - jobs_[index].submit_ns;
+        return jobs_[index].ok;
+    }
+
+private:
+    struct Job {
+        int fd;
+        const uint8_t* data;
+        size_t len;
+        uint64_t offset;
+        int64_t submit_ns;
+        int64_t done_ns;
+        bool done;
+        bool ok;
+
+        Job() : fd(-1), data(nullptr), len(0), offset(0), submit_ns(0), done_ns(0), done(true), ok(true) {}
+    };
+
+    std::vector<Job> jobs_;
+    std::deque<size_t> pending_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    bool stopping_;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            work_cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                return;
+            }
+            size_t index = pending_.front();
+            pending_.pop_front();
+            Job job = jobs_[index];
+
+            lock.unlock();
+            bool ok = pwriteAll(job.fd, job.data, job.len, job.offset);
+            int64_t done_ns = MonotonicNowNs();
+            lock.lock();
+
+            jobs_[index].ok = ok;
+            jobs_[index].done_ns = done_ns;
+            jobs_[index].done = true;
+            done_cv_.notify_all();
+        }
+    }
+};
+
+#ifdef CINEPI_HAVE_LIBURING
+// io_uring：写请求由内核异步执行，写入线程只负责提交和收割完成事件
+class UringWriteQueue : public DirectWriteQueue {
+public:
+    explicit UringWriteQueue(size_t slots)
+        : submit_ns_(slots, 0), done_ns_(slots, 0), expected_(slots, 0), result_(slots, 0), done_(slots, true) {
+        int ret = io_uring_queue_init(static_cast<unsigned>(slots), &ring_, 0);
+        if (ret < 0) {
+            throw std::runtime_error(std::string("io_uring初始化失败: ") + std::strerror(-ret));
+        }
+    }
+
+    ~UringWriteQueue() override {
+        // 关闭前先收割所有在途请求，缓冲在这之后才能释放
+        for (size_t i = 0; i < done_.size(); ++i) {
+            while (!done_[i] && reap(true)) {
+            }
+        }
+        io_uring_queue_exit(&ring_);
+    }
+
+    const char* Name() const override { return "io_uring"; }
+
+    bool Submit(size_t index, int fd, const uint8_t* data, size_t len, uint64_t offset) override {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        if (!sqe) {
+            return false;
+        }
+        io_uring_prep_write(sqe, fd, data, static_cast<unsigned>(len), offset);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(index)));
+        submit_ns_[index] = MonotonicNowNs();
+        expected_[index] = len;
+        done_[index] = false;
+
+        int ret = io_uring_submit(&ring_);
+        if (ret < 0) {
+            std::cerr << "io_uring提交失败: " << std::strerror(-ret) << std::endl;
+            done_[index] = true;
+            result_[index] = ret;
+            return false;
+        }
+
+        // 顺便收割已经完成的请求，让延迟统计更接近真实完成时间
+        reap(false);
+        return true;
+    }
+
+    bool Wait(size_t index, int64_t& latency_ns) override {
+        while (!done_[index]) {
+            if (!reap(true)) {
+                return false;
+            }
+        }
+        latency_ns = done_ns_[index] - submit_ns_[index];
+        if (result_[index] < 0) {
+            std::cerr << "直接I/O写入失败: " << std::strerror(-result_[index]) << std::endl;
+            return false;
+        }
+        if (static_cast<size_t>(result_[index]) != expected_[index]) {
+            std::cerr << "直接I/O写入不完整: " << result_[index] << "/" << expected_[index] << " 字节" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    io_uring ring_;
+    std::vector<int64_t> submit_ns_;
+    std::vector<int64_t> done_ns_;
+    std::vector<size_t> expected_;
+    std::vector<int> result_;
+    std::vector<bool> done_;
+
+    // 收割完成事件；wait为true时至少等到一个
+    bool reap(bool wait) {
+        io_uring_cqe* cqe = nullptr;
+        int ret = wait ? io_uring_wait_cqe(&ring_, &cqe) : io_uring_peek_cqe(&ring_, &cqe);
+        while (ret == -EINTR && wait) {
+            ret = io_uring_wait_cqe(&ring_, &cqe);
+        }
+        if (ret < 0) {
+            return !wait;
+        }
+        while (ret == 0 && cqe) {
+            size_t index = static_cast<size_t>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+            result_[index] = cqe->res;
+            done_ns_[index] = MonotonicNowNs();
+            done_[index] = true;
+            io_uring_cqe_seen(&ring_, cqe);
+            ret = io_uring_peek_cqe(&ring_, &cqe);
+        }
+        return true;
+    }
+};
+#endif
+
+std::unique_ptr<DirectWriteQueue> createWriteQueue(size_t slots) {
+#ifdef CINEPI_HAVE_LIBURING
+    try {
+        return std::unique_ptr<DirectWriteQueue>(new UringWriteQueue(slots));
+    } catch (const std::exception& e) {
+        // 内核未启用io_uring或被seccomp禁止时退回线程池
+        std::cerr << e.what() << "，改用pwrite线程池" << std::endl;
+    }
+#endif
+    return std::unique_ptr<DirectWriteQueue>(new ThreadWriteQueue(slots, slots));
+}
+
+} // namespace
+
+DirectRawSink::DirectRawSink(size_t chunk_bytes, size_t queue_depth)
+    : chunk_bytes_((std::max(chunk_bytes, ALIGNMENT) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT),
+      current_(0),
+      fd_(-1),
+      direct_(false),
+      preallocate_(false),
+      failed_(false),
+      frame_bytes_(0),
+      file_offset_(0),
+      data_bytes_(0),
+      allocated_bytes_(0) {
+    chunks_.resize(std::max<size_t>(queue_depth, 2));
+    for (Chunk& chunk : chunks_) {
+        chunk.data = nullptr;
+        chunk.fill = 0;
+        chunk.submitted = 0;
+        chunk.in_flight = false;
+    }
+}
+
+DirectRawSink::~DirectRawSink() {
+    Close();
+    freeChunks();
+}
+
+void DirectRawSink::freeChunks() {
+    queue_.reset();
+    for (Chunk& chunk : chunks_) {
+        std::free(chunk.data);
+        chunk.data = nullptr;
+    }
+}
+
+void DirectRawSink::Open(const std::string& path, const RecordingInfo& info) {
+    Close();
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    direct_ = fd_ >= 0;
+    if (fd_ < 0 && errno == EINVAL) {
+        // tmpfs等文件系统不支持O_DIRECT，仍按对齐块写入，只是经过页缓存
+        std::cerr << "警告: " << path << " 所在文件系统不支持O_DIRECT，改用普通写入" << std::endl;
+        fd_ = ::open(path.c_str(), flags, 0644);
+    }
+    if (fd_ < 0) {
+        throw std::runtime_error("无法创建录制文件 " + path + ": " + std::strerror(errno));
+    }
+
+    // 暂存块和写请求队列只分配一次，多次录制之间复用
+    for (Chunk& chunk : chunks_) {
+        if (!chunk.data) {
+            void* data = nullptr;
+            if (posix_memalign(&data, ALIGNMENT, chunk_bytes_) != 0) {
+                ::close(fd_);
+                fd_ = -1;
+                throw std::runtime_error("无法分配直接I/O暂存块");
+            }
+            chunk.data = static_cast<uint8_t*>(data);
+        }
+        chunk.fill = 0;
+        chunk.submitted = 0;
+        chunk.in_flight = false;
+    }
+    if (!queue_) {
+        queue_ = createWriteQueue(chunks_.size());
+    }
+
+    path_ = path;
+    frame_bytes_ = info.frame_bytes;
+    current_ = 0;
+    failed_ = false;
+    preallocate_ = true;
+    file_offset_ = 0;
+    data_bytes_ = 0;
+    allocated_bytes_ = 0;
+    preallocate(std::max<uint64_t>(PREALLOCATE_STEP, info.preallocate_bytes));
+
+    std::cout << "直接I/O写入: " << queue_->Name() << ", " << chunks_.size() << " 个在途请求 x "
+              << chunk_bytes_ / (1024 * 1024) << "MB" << (direct_ ? "" : " (无O_DIRECT)") << std::endl;
+}
+
+void DirectRawSink::preallocate(uint64_t end) {
+    if (!preallocate_ || end <= allocated_bytes_) {
+        return;
+    }
+
+    // 保持文件长度不变，只预留磁盘块，写入时不再需要分配块
+    uint64_t new_end = std::max(end, allocated_bytes_ + PREALLOCATE_STEP);
+    if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(allocated_bytes_),
+                    static_cast<off_t>(new_end - allocated_bytes_)) != 0) {
+        std::cerr << "警告: 无法预分配录制文件空间: " << std::strerror(errno) << std::endl;
+        preallocate_ = false;
+        return;
+    }
+    allocated_bytes_ = new_end;
+}
+
+bool DirectRawSink::submitChunk(size_t index) {
+    Chunk& chunk = chunks_[index];
+
+    // 只有最后一块可能不满，补零到对齐长度，关闭时再截断
+    size_t len = (chunk.fill + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    std::memset(chunk.data + chunk.fill, 0, len - chunk.fill);
+
+    preallocate(file_offset_ + len);
+    if (!queue_->Submit(index, fd_, chunk.data, len, file_offset_)) {
+        failed_ = true;
+        return false;
+    }
+    file_offset_ += len;
+    chunk.submitted = len;
+    chunk.fill = 0;
+    chunk.in_flight = true;
+    return true;
+}
+
+bool DirectRawSink::waitChunk(size_t index) {
+    Chunk& chunk = chunks_[index];
+    if (!chunk.in_flight) {
+        return true;
+    }
+
+    int64_t latency_ns = 0;
+    bool ok = queue_->Wait(index, latency_ns);
+    chunk.in_flight = false;
+    if (!ok) {
+        std::cerr << "写入 " << path_ << " 失败" << std::endl;
+        failed_ = true;
+        return false;
+    }
+    recordWrite(chunk.submitted, latency_ns);
+    return true;
+}
+
+bool DirectRawSink::WriteFrame(const FrameLease& frame) {
+    const FrameView& raw = frame->raw;
+    if (fd_ < 0 || failed_ || !raw.IsValid()) {
+        return false;
+    }
+
+    const uint8_t* src = raw.data;
+    size_t remaining = std::min(raw.size, frame_bytes_);
+    while (remaining > 0) {
+        // 暂存块的上一个写请求还没完成时等待，在途请求数因此受限于暂存块数量
+        if (!waitChunk(current_)) {
+            return false;
+        }
+
+        Chunk& chunk = chunks_[current_];
+        size_t n = std::min(remaining, chunk_bytes_ - chunk.fill);
+        std::memcpy(chunk.data + chunk.fill, src, n);
+        chunk.fill += n;
+        src += n;
+        remaining -= n;
+        data_bytes_ += n;
+
+        if (chunk.fill == chunk_bytes_) {
+            if (!submitChunk(current_)) {
+                return false;
+            }
+            current_ = (current_ + 1) % chunks_.size();
+        }
+    }
+    return true;
+}
+
+void DirectRawSink::Close() {
+    if (fd_ < 0) {
+        return;
+    }
+
+    if (!failed_ && chunks_[current_].fill > 0) {
+        submitChunk(current_);
+    }
+    for (size_t i = 0; i < chunks_.size(); ++i) {
+        waitChunk(i);
+    }
+
+    // 去掉最后一块的补齐部分和多余的预分配空间
+    if (::ftruncate(fd_, static_cast<off_t>(data_bytes_)) != 0) {
+        std::cerr << "截断 " << path_ << " 失败: " << std::strerror(errno) << std::endl;
+    }
+    if (::fdatasync(fd_) != 0) {
+        std::cerr << "同步 " << path_ << " 失败: " << std::strerror(errno) << std::endl;
+    }
+    if (::close(fd_) != 0) {
+        std::cerr << "关闭 " << path_ << " 失败: " << std::strerror(errno) << std::endl;
+    }
+    fd_ = -1;
+}
+
+} // namespace cinepi
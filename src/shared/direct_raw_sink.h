@@ -0,0 +1,70 @@
+// direct_raw_sink.h
+// O_DIRECT落盘：绕过页缓存，避免大量脏页回写造成的内存压力和周期性卡顿
+//
+// 帧数据先拼接进页对齐的暂存块，整块以直接I/O写出，同时保持多个写请求在途
+// （有liburing时用io_uring，否则用pwrite线程池）；文件按固定步长用fallocate预分配。
+// 输出文件与普通写入完全相同，最后一块补齐对齐长度写出后再截断到真实长度。
+
+#ifndef DIRECT_RAW_SINK_H
+#define DIRECT_RAW_SINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "raw_sink.h"
+
+namespace cinepi {
+
+// 在途写请求队列，实现见direct_raw_sink.cpp
+class DirectWriteQueue;
+
+class DirectRawSink : public RawSink {
+public:
+    static constexpr size_t ALIGNMENT = 4096;                        // 直接I/O的地址、长度和偏移对齐
+    static constexpr size_t DEFAULT_CHUNK_BYTES = 8 * 1024 * 1024;  // 单个写请求大小
+    static constexpr size_t DEFAULT_QUEUE_DEPTH = 4;                // 同时在途的写请求数
+    static constexpr uint64_t PREALLOCATE_STEP = 1ULL << 30;        // 每次预分配1GB
+
+    explicit DirectRawSink(size_t chunk_bytes = DEFAULT_CHUNK_BYTES, size_t queue_depth = DEFAULT_QUEUE_DEPTH);
+    ~DirectRawSink() override;
+
+    const char* Name() const override { return "direct"; }
+    void Open(const std::string& path, const RecordingInfo& info) override;
+    bool WriteFrame(const FrameLease& frame) override;
+    void Close() override;
+
+private:
+    // 暂存块，写请求在途期间不能修改
+    struct Chunk {
+        uint8_t* data;
+        size_t fill;            // 已拼接的数据长度
+        size_t submitted;       // 在途写请求的长度
+        bool in_flight;
+    };
+
+    std::unique_ptr<DirectWriteQueue> queue_;
+    std::vector<Chunk> chunks_;
+    size_t chunk_bytes_;
+    size_t current_;            // 正在拼接的暂存块
+
+    int fd_;
+    bool direct_;               // 文件系统不支持O_DIRECT时退回普通写入
+    bool preallocate_;          // 文件系统不支持fallocate时不再尝试
+    bool failed_;
+    std::string path_;
+    size_t frame_bytes_;
+    uint64_t file_offset_;      // 下一个写请求的文件偏移
+    uint64_t data_bytes_;       // 已接收的数据总量，即文件最终长度
+    uint64_t allocated_bytes_;  // 已预分配到的位置
+
+    bool submitChunk(size_t index);
+    bool waitChunk(size_t index);
+    void preallocate(uint64_t end);
+    void freeChunks();
+};
+
+} // namespace cinepi
+
+#endif // DIRECT_RAW_SINK_H
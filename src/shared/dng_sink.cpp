@@ -0,0 +1,303 @@
+// dng_sink.cpp
+// CinemaDNG序列落盘实现
+
+#include "dng_sink.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace cinepi {
+
+namespace {
+
+// 当前本地时间对应的时间码（从午夜起的帧数）
+int64_t timeOfDayFrames(int fps) {
+    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+    std::tm local_tm;
+    localtime_r(&seconds, &local_tm);
+    int64_t seconds_of_day = local_tm.tm_hour * 3600 + local_tm.tm_min * 60 + local_tm.tm_sec;
+    double fraction = std::chrono::duration<double>(now - std::chrono::system_clock::from_time_t(seconds)).count();
+    return seconds_of_day * fps + static_cast<int64_t>(fraction * fps);
+}
+
+// 取路径最后一段作为剪辑名
+std::string baseName(const std::string& path) {
+    size_t end = path.find_last_not_of('/');
+    if (end == std::string::npos) {
+        return path;
+    }
+    size_t start = path.find_last_of('/', end);
+    return path.substr(start == std::string::npos ? 0 : start + 1, end - (start == std::string::npos ? 0 : start + 1) + 1);
+}
+
+} // namespace
+
+DngSequenceSink::DngSequenceSink(bool pack_bits, DngCompression compression)
+    : is_open_(false),
+      frame_index_(0),
+      start_timecode_frame_(0),
+      first_timestamp_ns_(0),
+      error_(false),
+      source_bytes_(0),
+      encode_ns_(0) {
+    metadata_.pack_bits = pack_bits;
+    metadata_.compression = compression;
+}
+
+DngSequenceSink::~DngSequenceSink() {
+    Close();
+}
+
+const char* DngSequenceSink::Name() const {
+    if (metadata_.compression == DngCompression::LosslessJpeg) {
+        return "dng-lj92";
+    }
+    return metadata_.pack_bits ? "dng" : "dng16";
+}
+
+double DngSequenceSink::MeasureSustainableFps(const FrameView& sample) {
+    if (is_open_ || !sample.IsValid()) {
+        return 0.0;
+    }
+    if (!workers_) {
+        workers_.reset(new WorkerPool());
+    }
+
+    int64_t start_ns = MonotonicNowNs();
+    size_t frames = 1;
+    if (metadata_.compression == DngCompression::LosslessJpeg) {
+        std::vector<std::vector<uint8_t>> tiles;
+        std::vector<uint8_t> header;
+        if (!EncodeDngTiles(sample, *workers_, tiles) || !EncodeDngHeader(sample, metadata_, 0, tiles, header)) {
+            return 0.0;
+        }
+    } else {
+        frames = workers_->Size();
+        std::vector<std::vector<uint8_t>> buffers(frames);
+        std::atomic<bool> ok(true);
+        for (std::vector<uint8_t>& buffer : buffers) {
+            workers_->Submit([this, &sample, &buffer, &ok]() {
+                if (!EncodeDng(sample, metadata_, 0, buffer)) {
+                    ok = false;
+                }
+            });
+        }
+        workers_->WaitIdle();
+        if (!ok.load()) {
+            return 0.0;
+        }
+    }
+    int64_t elapsed_ns = MonotonicNowNs() - start_ns;
+    return elapsed_ns > 0 ? frames * 1e9 / elapsed_ns : 0.0;
+}
+
+void DngSequenceSink::Open(const std::string& path, const RecordingInfo& info) {
+    Close();
+
+    if (::mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("无法创建DNG剪辑目录 " + path + ": " + std::strerror(errno));
+    }
+
+    // 线程池在第一次测速或录制时创建，之后复用
+    if (!workers_) {
+        workers_.reset(new WorkerPool());
+    }
+
+    metadata_.black_level = info.black_level;
+    metadata_.white_level = 0;
+    metadata_.iso = info.iso;
+    metadata_.fps = std::max(info.fps, 1);
+    FillDngColorMetadata(metadata_, info.white_balance);
+
+    directory_ = path;
+    clip_name_ = baseName(path);
+    frame_index_ = 0;
+    first_timestamp_ns_ = 0;
+    start_timecode_frame_ = timeOfDayFrames(metadata_.fps);
+    error_ = false;
+    source_bytes_ = 0;
+    encode_ns_ = 0;
+    is_open_ = true;
+
+    const char* storage = metadata_.compression == DngCompression::LosslessJpeg ? "无损JPEG压缩" :
+                          metadata_.pack_bits ? "12位打包" : "16位";
+    std::cout << "CinemaDNG序列: " << directory_ << " (" << workers_->Size() << " 个编码线程, " << storage << ")" << std::endl;
+}
+
+bool DngSequenceSink::WriteFrame(const FrameLease& frame) {
+    if (!is_open_ || error_.load(std::memory_order_acquire) || !frame->raw.IsValid()) {
+        return false;
+    }
+
+    // 时间码按传感器时间戳推算，丢帧时时间码随之跳过，与实际拍摄时间一致
+    int64_t timecode_frame = start_timecode_frame_ + static_cast<int64_t>(frame_index_);
+    int64_t timestamp_ns = frame->sensor_timestamp_ns;
+    if (timestamp_ns > 0) {
+        if (first_timestamp_ns_ == 0) {
+            first_timestamp_ns_ = timestamp_ns;
+        }
+        timecode_frame = start_timecode_frame_ + std::llround((timestamp_ns - first_timestamp_ns_) * metadata_.fps / 1e9);
+    }
+
+    uint64_t index = frame_index_++;
+    source_bytes_ += static_cast<uint64_t>(frame->raw.width) * frame->raw.height * frame->raw.format.bit_depth / 8;
+
+    if (metadata_.compression != DngCompression::LosslessJpeg) {
+        workers_->Submit([this, frame, index, timecode_frame]() {
+            encodeFrame(frame, index, timecode_frame);
+        });
+        return true;
+    }
+
+    // 分块分组提交，每组是一个独立任务
+    std::shared_ptr<TileJob> job = std::make_shared<TileJob>();
+    size_t tile_count = DngTileCount(frame->raw);
+    job->frame = frame;
+    job->index = index;
+    job->timecode_frame = timecode_frame;
+    job->tiles.resize(tile_count);
+    job->remaining_tasks = (tile_count + DNG_TILES_PER_TASK - 1) / DNG_TILES_PER_TASK;
+    job->start_ns = 0;
+    job->encode_ns = 0;
+    for (size_t first = 0; first < tile_count; first += DNG_TILES_PER_TASK) {
+        size_t last = std::min(first + DNG_TILES_PER_TASK, tile_count);
+        workers_->Submit([this, job, first, last]() {
+            encodeTiles(job, first, last);
+        });
+    }
+    return true;
+}
+
+void DngSequenceSink::encodeFrame(const FrameLease& frame, uint64_t index, int64_t timecode_frame) {
+    if (error_.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    int64_t start_ns = MonotonicNowNs();
+
+    // 每个工作线程复用自己的编码缓冲
+    thread_local std::vector<uint8_t> buffer;
+    if (!EncodeDng(frame->raw, metadata_, timecode_frame, buffer)) {
+        std::cerr << "DNG编码失败: 不支持的RAW格式 " << PixelEncodingName(frame->raw.format.encoding) << std::endl;
+        error_ = true;
+        return;
+    }
+    encode_ns_ += MonotonicNowNs() - start_ns;
+
+    if (writeFile(index, { &buffer })) {
+        recordWrite(buffer.size(), MonotonicNowNs() - start_ns);
+    }
+}
+
+void DngSequenceSink::encodeTiles(const std::shared_ptr<TileJob>& job, size_t first, size_t last) {
+    int64_t start_ns = MonotonicNowNs();
+    int64_t expected = 0;
+    job->start_ns.compare_exchange_strong(expected, start_ns);
+
+    if (!error_.load(std::memory_order_acquire)) {
+        for (size_t tile = first; tile < last; ++tile) {
+            if (!EncodeDngTile(job->frame->raw, tile, job->tiles[tile])) {
+                std::cerr << "DNG编码失败: 不支持的RAW格式 " << PixelEncodingName(job->frame->raw.format.encoding) << std::endl;
+                error_ = true;
+                break;
+            }
+        }
+    }
+    job->encode_ns += MonotonicNowNs() - start_ns;
+
+    // 最后完成的任务负责拼文件头和写文件
+    if (job->remaining_tasks.fetch_sub(1, std::memory_order_acq_rel) != 1 || error_.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    int64_t header_start_ns = MonotonicNowNs();
+    std::vector<uint8_t> header;
+    EncodeDngHeader(job->frame->raw, metadata_, job->timecode_frame, job->tiles, header);
+    encode_ns_ += job->encode_ns.load() + (MonotonicNowNs() - header_start_ns);
+
+    std::vector<const std::vector<uint8_t>*> parts;
+    parts.reserve(job->tiles.size() + 1);
+    parts.push_back(&header);
+    size_t bytes = header.size();
+    for (const std::vector<uint8_t>& tile : job->tiles) {
+        parts.push_back(&tile);
+        bytes += tile.size();
+    }
+    if (writeFile(job->index, parts)) {
+        recordWrite(bytes, MonotonicNowNs() - job->start_ns.load());
+    }
+}
+
+bool DngSequenceSink::writeFile(uint64_t index, const std::vector<const std::vector<uint8_t>*>& parts) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "_%06llu.dng", static_cast<unsigned long long>(index));
+    std::string path = directory_ + "/" + clip_name_ + name;
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0;
+    for (size_t i = 0; ok && i < parts.size(); ++i) {
+        const uint8_t* data = parts[i]->data();
+        size_t remaining = parts[i]->size();
+        while (ok && remaining > 0) {
+            ssize_t written = ::write(fd, data, remaining);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            ok = written > 0;
+            if (ok) {
+                data += written;
+                remaining -= static_cast<size_t>(written);
+            }
+        }
+    }
+    if (!ok) {
+        std::cerr << "写入 " << path << " 失败: " << std::strerror(errno) << std::endl;
+    }
+    if (fd >= 0 && ::close(fd) != 0 && ok) {
+        std::cerr << "关闭 " << path << " 失败: " << std::strerror(errno) << std::endl;
+        ok = false;
+    }
+    if (!ok) {
+        error_ = true;
+    }
+    return ok;
+}
+
+void DngSequenceSink::Close() {
+    if (!is_open_) {
+        return;
+    }
+
+    // 等待所有帧编码写完，之后租约全部释放
+    workers_->WaitIdle();
+    is_open_ = false;
+
+    RawSinkStats stats = GetStats();
+    std::cout << "CinemaDNG序列: " << stats.writes << " 帧写入 " << directory_ << std::endl;
+    if (stats.writes > 0 && stats.bytes > 0) {
+        // 可持续帧率按所有编码线程满负荷估算，不含写文件
+        double encode_ms = encode_ns_.load() / 1e6 / stats.writes;
+        double sustainable_fps = encode_ms > 0 ? workers_->Size() * 1000.0 / encode_ms : 0.0;
+        std::ostringstream summary;
+        summary << "  压缩比 " << std::fixed << std::setprecision(2)
+                << static_cast<double>(source_bytes_.load()) / stats.bytes << ":1"
+                << "，单帧编码 " << std::setprecision(1) << encode_ms << " ms（单线程）"
+                << "，" << workers_->Size() << " 线程约可持续 " << sustainable_fps << " 帧/秒";
+        std::cout << summary.str() << std::endl;
+    }
+}
+
+} // namespace cinepi
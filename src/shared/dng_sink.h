@@ -0,0 +1,71 @@
+// dng_sink.h
+// CinemaDNG序列落盘：每个剪辑一个目录，每帧一个DNG文件
+//
+// 写入线程只负责把帧租约交给工作线程池，编码和写文件在所有核心上并行进行；
+// 租约在编码完成后才释放，工作线程跟不上时写入队列的内存池随之耗尽，按队列满策略处理。
+// 无损压缩时一帧拆成多组分块分别提交，最后完成的工作线程拼出文件头并写文件，
+// 单帧延迟和同时在途的帧数都随核心数下降。
+
+#ifndef DNG_SINK_H
+#define DNG_SINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "dng_writer.h"
+#include "raw_sink.h"
+#include "worker_pool.h"
+
+namespace cinepi {
+
+class DngSequenceSink : public RawSink {
+public:
+    // pack_bits为true时12位数据按TIFF打包，否则存为16位；无损压缩时忽略pack_bits
+    explicit DngSequenceSink(bool pack_bits, DngCompression compression = DngCompression::None);
+    ~DngSequenceSink() override;
+
+    const char* Name() const override;
+    const char* Extension() const override { return ""; }
+
+    // 在编码线程池中按录制时的任务划分编码样本帧，返回墙钟时间折算的帧率：
+    // 无损压缩时一帧的分块分给所有线程，否则每个线程各编码一帧
+    double MeasureSustainableFps(const FrameView& sample) override;
+
+    void Open(const std::string& path, const RecordingInfo& info) override;
+    bool WriteFrame(const FrameLease& frame) override;
+    void Close() override;
+
+private:
+    // 一帧压缩DNG的编码状态，由该帧的所有分块任务共享
+    struct TileJob {
+        FrameLease frame;
+        uint64_t index;
+        int64_t timecode_frame;
+        std::vector<std::vector<uint8_t>> tiles;
+        std::atomic<size_t> remaining_tasks;
+        std::atomic<int64_t> start_ns;      // 第一个分块开始编码的时间
+        std::atomic<int64_t> encode_ns;     // 所有分块的编码耗时之和
+    };
+
+    std::unique_ptr<WorkerPool> workers_;
+    DngMetadata metadata_;
+    std::string directory_;
+    std::string clip_name_;
+    bool is_open_;
+    uint64_t frame_index_;              // 文件编号，连续递增
+    int64_t start_timecode_frame_;      // 剪辑开始时的时间码（从午夜起的帧数）
+    int64_t first_timestamp_ns_;        // 第一帧的传感器时间戳，之后的时间码按实际时间推算
+    std::atomic<bool> error_;
+    std::atomic<uint64_t> source_bytes_;    // 按传感器位深紧密打包计算的原始数据量，用于压缩比
+    std::atomic<int64_t> encode_ns_;        // 所有帧的编码耗时之和（不含写文件）
+
+    void encodeFrame(const FrameLease& frame, uint64_t index, int64_t timecode_frame);
+    void encodeTiles(const std::shared_ptr<TileJob>& job, size_t first, size_t last);
+    bool writeFile(uint64_t index, const std::vector<const std::vector<uint8_t>*>& parts);
+};
+
+} // namespace cinepi
+
+#endif // DNG_SINK_H
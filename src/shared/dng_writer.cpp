@@ -0,0 +1,510 @@
+// dng_writer.cpp
+// CinemaDNG单帧编码实现
+
+#include "dng_writer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include "bit_pack.h"
+#include "lj92.h"
+#include "sensor_profile.h"
+
+namespace cinepi {
+
+namespace {
+
+// TIFF字段类型
+const uint16_t TIFF_BYTE = 1;
+const uint16_t TIFF_ASCII = 2;
+const uint16_t TIFF_SHORT = 3;
+const uint16_t TIFF_LONG = 4;
+const uint16_t TIFF_RATIONAL = 5;
+const uint16_t TIFF_SRATIONAL = 10;
+
+// 用到的TIFF/DNG标签
+const uint16_t TAG_NEW_SUBFILE_TYPE = 254;
+const uint16_t TAG_IMAGE_WIDTH = 256;
+const uint16_t TAG_IMAGE_LENGTH = 257;
+const uint16_t TAG_BITS_PER_SAMPLE = 258;
+const uint16_t TAG_COMPRESSION = 259;
+const uint16_t TAG_PHOTOMETRIC = 262;
+const uint16_t TAG_MAKE = 271;
+const uint16_t TAG_MODEL = 272;
+const uint16_t TAG_STRIP_OFFSETS = 273;
+const uint16_t TAG_ORIENTATION = 274;
+const uint16_t TAG_SAMPLES_PER_PIXEL = 277;
+const uint16_t TAG_ROWS_PER_STRIP = 278;
+const uint16_t TAG_STRIP_BYTE_COUNTS = 279;
+const uint16_t TAG_PLANAR_CONFIGURATION = 284;
+const uint16_t TAG_SOFTWARE = 305;
+const uint16_t TAG_TILE_WIDTH = 322;
+const uint16_t TAG_TILE_LENGTH = 323;
+const uint16_t TAG_TILE_OFFSETS = 324;
+const uint16_t TAG_TILE_BYTE_COUNTS = 325;
+const uint16_t TAG_CFA_REPEAT_PATTERN_DIM = 33421;
+const uint16_t TAG_CFA_PATTERN = 33422;
+const uint16_t TAG_ISO_SPEED_RATINGS = 34855;
+const uint16_t TAG_DNG_VERSION = 50706;
+const uint16_t TAG_DNG_BACKWARD_VERSION = 50707;
+const uint16_t TAG_UNIQUE_CAMERA_MODEL = 50708;
+const uint16_t TAG_CFA_PLANE_COLOR = 50710;
+const uint16_t TAG_CFA_LAYOUT = 50711;
+const uint16_t TAG_BLACK_LEVEL = 50714;
+const uint16_t TAG_WHITE_LEVEL = 50717;
+const uint16_t TAG_COLOR_MATRIX1 = 50721;
+const uint16_t TAG_COLOR_MATRIX2 = 50722;
+const uint16_t TAG_AS_SHOT_NEUTRAL = 50728;
+const uint16_t TAG_CALIBRATION_ILLUMINANT1 = 50778;
+const uint16_t TAG_CALIBRATION_ILLUMINANT2 = 50779;
+const uint16_t TAG_TIME_CODES = 51043;
+const uint16_t TAG_FRAME_RATE = 51044;
+
+const uint16_t COMPRESSION_NONE = 1;
+const uint16_t COMPRESSION_LOSSLESS_JPEG = 7;
+const uint16_t PHOTOMETRIC_CFA = 32803;
+const uint16_t ILLUMINANT_STANDARD_A = 17;
+const uint16_t ILLUMINANT_D65 = 21;
+
+// 线性sRGB到XYZ（D65）
+const double RGB_TO_XYZ[9] = {
+    0.4124, 0.3576, 0.1805,
+    0.2126, 0.7152, 0.0722,
+    0.0193, 0.1192, 0.9505,
+};
+
+// 小端写入
+void put16(uint8_t* p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+void put32(uint8_t* p, uint32_t v) {
+    put16(p, static_cast<uint16_t>(v));
+    put16(p + 2, static_cast<uint16_t>(v >> 16));
+}
+
+// 单个IFD的构建器：先收集字段，再按标签排序布局，超过4字节的值放在IFD之后
+class IfdBuilder {
+public:
+    void Add(uint16_t tag, uint16_t type, uint32_t count, std::vector<uint8_t> value) {
+        entries_.push_back(Entry{ tag, type, count, std::move(value), 0 });
+    }
+
+    void AddShorts(uint16_t tag, const std::vector<uint16_t>& values) {
+        std::vector<uint8_t> bytes(values.size() * 2);
+        for (size_t i = 0; i < values.size(); ++i) {
+            put16(&bytes[i * 2], values[i]);
+        }
+        Add(tag, TIFF_SHORT, static_cast<uint32_t>(values.size()), std::move(bytes));
+    }
+
+    void AddLong(uint16_t tag, uint32_t value) {
+        std::vector<uint8_t> bytes(4);
+        put32(bytes.data(), value);
+        Add(tag, TIFF_LONG, 1, std::move(bytes));
+    }
+
+    void AddLongs(uint16_t tag, const std::vector<uint32_t>& values) {
+        std::vector<uint8_t> bytes(values.size() * 4);
+        for (size_t i = 0; i < values.size(); ++i) {
+            put32(&bytes[i * 4], values[i]);
+        }
+        Add(tag, TIFF_LONG, static_cast<uint32_t>(values.size()), std::move(bytes));
+    }
+
+    void AddBytes(uint16_t tag, const std::vector<uint8_t>& values) {
+        Add(tag, TIFF_BYTE, static_cast<uint32_t>(values.size()), values);
+    }
+
+    void AddAscii(uint16_t tag, const std::string& text) {
+        std::vector<uint8_t> bytes(text.begin(), text.end());
+        bytes.push_back(0);
+        uint32_t count = static_cast<uint32_t>(bytes.size());
+        Add(tag, TIFF_ASCII, count, std::move(bytes));
+    }
+
+    // 有理数按固定分母量化
+    void AddRationals(uint16_t tag, bool is_signed, const double* values, size_t count) {
+        const int32_t DENOMINATOR = 10000;
+        std::vector<uint8_t> bytes(count * 8);
+        for (size_t i = 0; i < count; ++i) {
+            int64_t numerator = std::llround(values[i] * DENOMINATOR);
+            put32(&bytes[i * 8], static_cast<uint32_t>(is_signed ? numerator : std::max<int64_t>(numerator, 0)));
+            put32(&bytes[i * 8 + 4], DENOMINATOR);
+        }
+        Add(tag, is_signed ? TIFF_SRATIONAL : TIFF_RATIONAL, static_cast<uint32_t>(count), std::move(bytes));
+    }
+
+    // 布局：返回IFD及其附加数据之后的偏移（从文件头算起）
+    size_t Layout(size_t ifd_offset) {
+        std::sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) { return a.tag < b.tag; });
+        size_t offset = ifd_offset + 2 + entries_.size() * 12 + 4;
+        for (Entry& entry : entries_) {
+            entry.offset = 0;
+            if (entry.value.size() > 4) {
+                offset = (offset + 1) & ~static_cast<size_t>(1);
+                entry.offset = static_cast<uint32_t>(offset);
+                offset += entry.value.size();
+            }
+        }
+        return offset;
+    }
+
+    // 修改已添加的LONG字段（布局之后条带/分块偏移才确定），个数必须与添加时相同
+    void SetLong(uint16_t tag, uint32_t value) {
+        SetLongs(tag, { value });
+    }
+
+    void SetLongs(uint16_t tag, const std::vector<uint32_t>& values) {
+        for (Entry& entry : entries_) {
+            if (entry.tag == tag && entry.value.size() == values.size() * 4) {
+                for (size_t i = 0; i < values.size(); ++i) {
+                    put32(&entry.value[i * 4], values[i]);
+                }
+            }
+        }
+    }
+
+    void Write(uint8_t* file, size_t ifd_offset) const {
+        uint8_t* p = file + ifd_offset;
+        put16(p, static_cast<uint16_t>(entries_.size()));
+        p += 2;
+        for (const Entry& entry : entries_) {
+            put16(p, entry.tag);
+            put16(p + 2, entry.type);
+            put32(p + 4, entry.count);
+            std::memset(p + 8, 0, 4);
+            if (entry.value.size() > 4) {
+                put32(p + 8, entry.offset);
+                std::memcpy(file + entry.offset, entry.value.data(), entry.value.size());
+            } else {
+                std::memcpy(p + 8, entry.value.data(), entry.value.size());
+            }
+            p += 12;
+        }
+        put32(p, 0);    // 没有下一个IFD
+    }
+
+private:
+    struct Entry {
+        uint16_t tag;
+        uint16_t type;
+        uint32_t count;
+        std::vector<uint8_t> value;
+        uint32_t offset;
+    };
+
+    std::vector<Entry> entries_;
+};
+
+// 3x3矩阵乘法与求逆（行优先）
+void multiply(const double* a, const double* b, double* out) {
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            out[r * 3 + c] = a[r * 3] * b[c] + a[r * 3 + 1] * b[3 + c] + a[r * 3 + 2] * b[6 + c];
+        }
+    }
+}
+
+void invert(const double* m, double* out) {
+    double det = m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) + m[2] * (m[3] * m[7] - m[4] * m[6]);
+    double inv = std::fabs(det) > 1e-12 ? 1.0 / det : 0.0;
+    out[0] = (m[4] * m[8] - m[5] * m[7]) * inv;
+    out[1] = (m[2] * m[7] - m[1] * m[8]) * inv;
+    out[2] = (m[1] * m[5] - m[2] * m[4]) * inv;
+    out[3] = (m[5] * m[6] - m[3] * m[8]) * inv;
+    out[4] = (m[0] * m[8] - m[2] * m[6]) * inv;
+    out[5] = (m[2] * m[3] - m[0] * m[5]) * inv;
+    out[6] = (m[3] * m[7] - m[4] * m[6]) * inv;
+    out[7] = (m[1] * m[6] - m[0] * m[7]) * inv;
+    out[8] = (m[0] * m[4] - m[1] * m[3]) * inv;
+}
+
+// 指定色温下XYZ到相机RGB的矩阵：相机RGB经白平衡增益和CCM得到线性sRGB，再转XYZ，整体求逆
+void colorMatrixForTemperature(int kelvin, double* out) {
+    float red_gain = 1.0f;
+    float blue_gain = 1.0f;
+    ColourGainsForTemperature(kelvin, red_gain, blue_gain);
+    float ccm[9];
+    ColourCorrectionMatrix(kelvin, ccm);
+
+    double ccm_gains[9];
+    for (int r = 0; r < 3; ++r) {
+        ccm_gains[r * 3] = ccm[r * 3] * red_gain;
+        ccm_gains[r * 3 + 1] = ccm[r * 3 + 1];
+        ccm_gains[r * 3 + 2] = ccm[r * 3 + 2] * blue_gain;
+    }
+    double camera_to_xyz[9];
+    multiply(RGB_TO_XYZ, ccm_gains, camera_to_xyz);
+    invert(camera_to_xyz, out);
+}
+
+// CFA排列（0红 1绿 2蓝）
+std::vector<uint8_t> cfaPattern(BayerOrder order) {
+    switch (order) {
+        case BayerOrder::GRBG: return { 1, 0, 2, 1 };
+        case BayerOrder::GBRG: return { 1, 2, 0, 1 };
+        case BayerOrder::BGGR: return { 2, 1, 1, 0 };
+        case BayerOrder::RGGB:
+        default:               return { 0, 1, 1, 2 };
+    }
+}
+
+uint8_t toBcd(int value) {
+    return static_cast<uint8_t>(((value / 10) << 4) | (value % 10));
+}
+
+// SMPTE 331M二进制时间码（8字节，后4字节用户位为0）
+std::vector<uint8_t> smpteTimecode(int64_t frame, int fps) {
+    fps = std::max(fps, 1);
+    int64_t day_frames = static_cast<int64_t>(fps) * 86400;
+    frame = ((frame % day_frames) + day_frames) % day_frames;
+    int frames = static_cast<int>(frame % fps);
+    int64_t seconds = frame / fps;
+    std::vector<uint8_t> timecode(8, 0);
+    timecode[0] = toBcd(frames) & 0x3F;
+    timecode[1] = toBcd(static_cast<int>(seconds % 60)) & 0x7F;
+    timecode[2] = toBcd(static_cast<int>(seconds / 60 % 60)) & 0x7F;
+    timecode[3] = toBcd(static_cast<int>(seconds / 3600)) & 0x3F;
+    return timecode;
+}
+
+// 文件头8字节，IFD紧随其后
+const size_t IFD_OFFSET = 8;
+
+bool isEncodable(const FrameView& raw) {
+    return raw.IsValid() && raw.format.IsBayer() && raw.width > 0 && raw.height > 0 &&
+           static_cast<size_t>(raw.stride) * (raw.height - 1) + RawRowBytes(raw.format.encoding, raw.width) <= raw.size;
+}
+
+struct TileGrid {
+    unsigned int across;
+    unsigned int down;
+};
+
+TileGrid tileGrid(const FrameView& raw) {
+    TileGrid grid;
+    grid.across = (raw.width + DNG_TILE_SIZE - 1) / DNG_TILE_SIZE;
+    grid.down = (raw.height + DNG_TILE_SIZE - 1) / DNG_TILE_SIZE;
+    return grid;
+}
+
+// 与图像数据存储方式无关的字段
+void addCommonTags(IfdBuilder& ifd, const FrameView& raw, const DngMetadata& metadata, int64_t timecode_frame) {
+    int white_level = metadata.white_level > 0 ? metadata.white_level : (1 << raw.format.bit_depth) - 1;
+    ifd.AddLong(TAG_NEW_SUBFILE_TYPE, 0);
+    ifd.AddLong(TAG_IMAGE_WIDTH, raw.width);
+    ifd.AddLong(TAG_IMAGE_LENGTH, raw.height);
+    ifd.AddShorts(TAG_PHOTOMETRIC, { PHOTOMETRIC_CFA });
+    ifd.AddAscii(TAG_MAKE, SENSOR_MAKE);
+    ifd.AddAscii(TAG_MODEL, SENSOR_MODEL);
+    ifd.AddShorts(TAG_ORIENTATION, { 1 });
+    ifd.AddShorts(TAG_SAMPLES_PER_PIXEL, { 1 });
+    ifd.AddShorts(TAG_PLANAR_CONFIGURATION, { 1 });
+    ifd.AddAscii(TAG_SOFTWARE, "CinePI");
+    ifd.AddShorts(TAG_CFA_REPEAT_PATTERN_DIM, { 2, 2 });
+    ifd.AddBytes(TAG_CFA_PATTERN, cfaPattern(raw.format.bayer_order));
+    ifd.AddShorts(TAG_ISO_SPEED_RATINGS, { static_cast<uint16_t>(metadata.iso) });
+    ifd.AddBytes(TAG_DNG_VERSION, { 1, 4, 0, 0 });
+    ifd.AddBytes(TAG_DNG_BACKWARD_VERSION, { 1, 1, 0, 0 });
+    ifd.AddAscii(TAG_UNIQUE_CAMERA_MODEL, std::string(SENSOR_MAKE) + " " + SENSOR_MODEL);
+    ifd.AddBytes(TAG_CFA_PLANE_COLOR, { 0, 1, 2 });
+    ifd.AddShorts(TAG_CFA_LAYOUT, { 1 });
+    ifd.AddLong(TAG_BLACK_LEVEL, static_cast<uint32_t>(metadata.black_level));
+    ifd.AddLong(TAG_WHITE_LEVEL, static_cast<uint32_t>(white_level));
+    ifd.AddRationals(TAG_COLOR_MATRIX1, true, metadata.color_matrix1, 9);
+    ifd.AddRationals(TAG_COLOR_MATRIX2, true, metadata.color_matrix2, 9);
+    ifd.AddRationals(TAG_AS_SHOT_NEUTRAL, false, metadata.as_shot_neutral, 3);
+    ifd.AddShorts(TAG_CALIBRATION_ILLUMINANT1, { ILLUMINANT_STANDARD_A });
+    ifd.AddShorts(TAG_CALIBRATION_ILLUMINANT2, { ILLUMINANT_D65 });
+    ifd.AddBytes(TAG_TIME_CODES, smpteTimecode(timecode_frame, metadata.fps));
+    double frame_rate = metadata.fps;
+    ifd.AddRationals(TAG_FRAME_RATE, true, &frame_rate, 1);
+}
+
+// 写出TIFF文件头和已布局的IFD
+void writeHeader(const IfdBuilder& ifd, uint8_t* file) {
+    file[0] = 'I';
+    file[1] = 'I';
+    put16(file + 2, 42);
+    put32(file + 4, static_cast<uint32_t>(IFD_OFFSET));
+    ifd.Write(file, IFD_OFFSET);
+}
+
+} // namespace
+
+DngMetadata::DngMetadata()
+    : black_level(0), white_level(0), iso(100), fps(24), pack_bits(true), compression(DngCompression::None) {
+    FillDngColorMetadata(*this, 5000);
+}
+
+void FillDngColorMetadata(DngMetadata& metadata, int white_balance) {
+    colorMatrixForTemperature(2856, metadata.color_matrix1);
+    colorMatrixForTemperature(6504, metadata.color_matrix2);
+
+    float red_gain = 1.0f;
+    float blue_gain = 1.0f;
+    ColourGainsForTemperature(white_balance, red_gain, blue_gain);
+    metadata.as_shot_neutral[0] = 1.0 / red_gain;
+    metadata.as_shot_neutral[1] = 1.0;
+    metadata.as_shot_neutral[2] = 1.0 / blue_gain;
+}
+
+size_t DngTileCount(const FrameView& raw) {
+    TileGrid grid = tileGrid(raw);
+    return static_cast<size_t>(grid.across) * grid.down;
+}
+
+bool EncodeDngTile(const FrameView& raw, size_t tile, std::vector<uint8_t>& out) {
+    out.clear();
+    if (!isEncodable(raw) || tile >= DngTileCount(raw)) {
+        return false;
+    }
+
+    TileGrid grid = tileGrid(raw);
+    unsigned int x0 = static_cast<unsigned int>(tile % grid.across) * DNG_TILE_SIZE;
+    unsigned int y0 = static_cast<unsigned int>(tile / grid.across) * DNG_TILE_SIZE;
+    unsigned int valid_width = std::min(DNG_TILE_SIZE, raw.width - x0);
+    unsigned int valid_height = std::min(DNG_TILE_SIZE, raw.height - y0);
+    // 分块起点是4的倍数，在CSI-2打包数据中正好落在像素组边界上
+    size_t src_offset = RawRowBytes(raw.format.encoding, x0);
+
+    // 边缘分块用同色的相邻像素填充，保持Bayer相位，读取器会丢弃填充部分
+    thread_local std::vector<uint16_t> pixels;
+    pixels.resize(static_cast<size_t>(DNG_TILE_SIZE) * DNG_TILE_SIZE);
+    for (unsigned int y = 0; y < DNG_TILE_SIZE; ++y) {
+        uint16_t* row = pixels.data() + static_cast<size_t>(y) * DNG_TILE_SIZE;
+        if (y >= valid_height) {
+            std::memcpy(row, row - (y >= 2 ? 2 : 1) * DNG_TILE_SIZE, DNG_TILE_SIZE * sizeof(uint16_t));
+            continue;
+        }
+        UnpackRow(raw.format.encoding, raw.data + static_cast<size_t>(y0 + y) * raw.stride + src_offset, row, valid_width);
+        for (unsigned int x = valid_width; x < DNG_TILE_SIZE; ++x) {
+            row[x] = row[x >= 2 ? x - 2 : 0];
+        }
+    }
+
+    EncodeLosslessJpeg(pixels.data(), DNG_TILE_SIZE, DNG_TILE_SIZE, raw.format.bit_depth, out);
+    return true;
+}
+
+bool EncodeDngTiles(const FrameView& raw, WorkerPool& pool, std::vector<std::vector<uint8_t>>& tiles) {
+    if (!isEncodable(raw)) {
+        return false;
+    }
+    size_t tile_count = DngTileCount(raw);
+    tiles.resize(tile_count);
+    std::atomic<bool> ok(true);
+    for (size_t first = 0; first < tile_count; first += DNG_TILES_PER_TASK) {
+        size_t last = std::min(first + DNG_TILES_PER_TASK, tile_count);
+        pool.Submit([&raw, &tiles, &ok, first, last]() {
+            for (size_t tile = first; tile < last; ++tile) {
+                if (!EncodeDngTile(raw, tile, tiles[tile])) {
+                    ok = false;
+                }
+            }
+        });
+    }
+    pool.WaitIdle();
+    return ok.load();
+}
+
+bool EncodeDngHeader(const FrameView& raw, const DngMetadata& metadata, int64_t timecode_frame,
+                     const std::vector<std::vector<uint8_t>>& tiles, std::vector<uint8_t>& header) {
+    if (!isEncodable(raw) || tiles.size() != DngTileCount(raw)) {
+        return false;
+    }
+
+    std::vector<uint32_t> byte_counts(tiles.size());
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        byte_counts[i] = static_cast<uint32_t>(tiles[i].size());
+    }
+
+    IfdBuilder ifd;
+    addCommonTags(ifd, raw, metadata, timecode_frame);
+    ifd.AddShorts(TAG_BITS_PER_SAMPLE, { static_cast<uint16_t>(raw.format.bit_depth) });
+    ifd.AddShorts(TAG_COMPRESSION, { COMPRESSION_LOSSLESS_JPEG });
+    ifd.AddLong(TAG_TILE_WIDTH, DNG_TILE_SIZE);
+    ifd.AddLong(TAG_TILE_LENGTH, DNG_TILE_SIZE);
+    ifd.AddLongs(TAG_TILE_OFFSETS, std::vector<uint32_t>(tiles.size(), 0));
+    ifd.AddLongs(TAG_TILE_BYTE_COUNTS, byte_counts);
+
+    // 分块数据按顺序紧跟在文件头之后
+    size_t data_offset = (ifd.Layout(IFD_OFFSET) + 15) & ~static_cast<size_t>(15);
+    std::vector<uint32_t> offsets(tiles.size());
+    size_t offset = data_offset;
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        offsets[i] = static_cast<uint32_t>(offset);
+        offset += tiles[i].size();
+    }
+    ifd.SetLongs(TAG_TILE_OFFSETS, offsets);
+
+    header.assign(data_offset, 0);
+    writeHeader(ifd, header.data());
+    return true;
+}
+
+bool EncodeDng(const FrameView& raw, const DngMetadata& metadata, int64_t timecode_frame, std::vector<uint8_t>& out) {
+    if (!isEncodable(raw)) {
+        return false;
+    }
+
+    if (metadata.compression == DngCompression::LosslessJpeg) {
+        std::vector<std::vector<uint8_t>> tiles(DngTileCount(raw));
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            EncodeDngTile(raw, i, tiles[i]);
+        }
+        EncodeDngHeader(raw, metadata, timecode_frame, tiles, out);
+        for (const std::vector<uint8_t>& tile : tiles) {
+            out.insert(out.end(), tile.begin(), tile.end());
+        }
+        return true;
+    }
+
+    unsigned int width = raw.width;
+    unsigned int height = raw.height;
+    bool pack12 = metadata.pack_bits && raw.format.bit_depth == 12;
+    int bits = pack12 ? 12 : 16;
+    size_t row_bytes = pack12 ? (static_cast<size_t>(width) * 3 + 1) / 2 : static_cast<size_t>(width) * 2;
+    size_t image_bytes = row_bytes * height;
+
+    IfdBuilder ifd;
+    addCommonTags(ifd, raw, metadata, timecode_frame);
+    ifd.AddShorts(TAG_BITS_PER_SAMPLE, { static_cast<uint16_t>(bits) });
+    ifd.AddShorts(TAG_COMPRESSION, { COMPRESSION_NONE });
+    ifd.AddLong(TAG_STRIP_OFFSETS, 0);
+    ifd.AddLong(TAG_ROWS_PER_STRIP, height);
+    ifd.AddLong(TAG_STRIP_BYTE_COUNTS, static_cast<uint32_t>(image_bytes));
+
+    // 图像数据按16字节对齐放在最后
+    size_t data_offset = (ifd.Layout(IFD_OFFSET) + 15) & ~static_cast<size_t>(15);
+    ifd.SetLong(TAG_STRIP_OFFSETS, static_cast<uint32_t>(data_offset));
+
+    out.assign(data_offset + image_bytes, 0);
+    writeHeader(ifd, out.data());
+
+    // 逐行解包传感器格式，再按TIFF位序写出；16位小端数据直接解包到输出（数据区16字节对齐）
+    std::vector<uint16_t> row(width);
+    uint8_t* dst = out.data() + data_offset;
+    for (unsigned int y = 0; y < height; ++y, dst += row_bytes) {
+        const uint8_t* src = raw.data + static_cast<size_t>(y) * raw.stride;
+        if (pack12) {
+            UnpackRow(raw.format.encoding, src, row.data(), width);
+            PackTiff12Row(row.data(), dst, width);
+        } else {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            UnpackRow(raw.format.encoding, src, reinterpret_cast<uint16_t*>(dst), width);
+#else
+            UnpackRow(raw.format.encoding, src, row.data(), width);
+            for (unsigned int x = 0; x < width; ++x) {
+                put16(dst + x * 2, row[x]);
+            }
+#endif
+        }
+    }
+    return true;
+}
+
+} // namespace cinepi
@@ -0,0 +1,69 @@
+// dng_writer.h
+// CinemaDNG单帧编码：把一帧RAW数据编码为内存中的DNG文件（TIFF小端CFA图像）
+//
+// 写入CFA排列、黑白电平、两组色彩矩阵（标准光源A和D65）、拍摄白平衡、
+// SMPTE时间码和帧率，调色软件可以直接按序列导入。
+// 未压缩时图像为单个条带；无损压缩时图像按DNG_TILE_SIZE见方分块，
+// 每块是独立的无损JPEG，可以分给多个线程并行编码，最后由EncodeDngHeader拼出文件头。
+
+#ifndef DNG_WRITER_H
+#define DNG_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "frame_types.h"
+#include "worker_pool.h"
+
+namespace cinepi {
+
+// 图像数据的压缩方式
+enum class DngCompression {
+    None,
+    LosslessJpeg    // 无损JPEG（DNG压缩类型7）
+};
+
+// 无损压缩的分块边长（像素）
+const unsigned int DNG_TILE_SIZE = 256;
+
+// 并行编码时每个任务包含的分块数（4056x3040一帧192块，分成12个任务）
+const size_t DNG_TILES_PER_TASK = 16;
+
+// 剪辑级DNG元数据，同一剪辑的每一帧相同
+struct DngMetadata {
+    int black_level;
+    int white_level;            // 0表示按位深取最大值
+    int iso;
+    int fps;
+    bool pack_bits;             // 未压缩时12位数据按TIFF位序打包（每像素1.5字节），否则存为16位
+    DngCompression compression;
+    double color_matrix1[9];    // XYZ到相机RGB，标准光源A
+    double color_matrix2[9];    // XYZ到相机RGB，D65
+    double as_shot_neutral[3];  // 拍摄白平衡下中性灰的相机RGB
+
+    DngMetadata();
+};
+
+// 按传感器参数和拍摄白平衡（K）填充色彩相关字段
+void FillDngColorMetadata(DngMetadata& metadata, int white_balance);
+
+// 编码一帧到out（原内容被替换），timecode_frame为从午夜起的帧数；格式不支持时返回false
+bool EncodeDng(const FrameView& raw, const DngMetadata& metadata, int64_t timecode_frame, std::vector<uint8_t>& out);
+
+// 无损压缩时一帧的分块数（按行优先排列）
+size_t DngTileCount(const FrameView& raw);
+
+// 把第tile块编码为无损JPEG，写入out（原内容被替换）；可以在多个线程中同时调用
+bool EncodeDngTile(const FrameView& raw, size_t tile, std::vector<uint8_t>& out);
+
+// 在pool中按DNG_TILES_PER_TASK分组并行编码一帧的全部分块，等待pool空闲后返回；
+// pool中不能有其他任务在进行。格式不支持时返回false
+bool EncodeDngTiles(const FrameView& raw, WorkerPool& pool, std::vector<std::vector<uint8_t>>& tiles);
+
+// 按已编码的全部分块生成压缩DNG的文件头，分块数据按顺序紧跟在文件头之后写出
+bool EncodeDngHeader(const FrameView& raw, const DngMetadata& metadata, int64_t timecode_frame,
+                     const std::vector<std::vector<uint8_t>>& tiles, std::vector<uint8_t>& header);
+
+} // namespace cinepi
+
+#endif // DNG_WRITER_H
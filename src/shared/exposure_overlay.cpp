@@ -0,0 +1,400 @@
+// exposure_overlay.cpp
+// 曝光辅助实现
+
+#include "exposure_overlay.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "bit_pack.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace cinepi {
+
+namespace {
+
+const float OVERLAY_GAMMA = 2.2f;
+const unsigned int CODE_BITS = 12;
+const unsigned int CODE_MAX = EXPOSURE_LUT_SIZE - 1;
+
+// 表项最高字节
+const uint32_t ENTRY_SOLID = 1;
+const uint32_t ENTRY_STRIPE = 2;
+
+// 斑马纹中间一段的宽度（IRE）
+const float ZEBRA_MID_BAND_IRE = 5.0f;
+
+// 伪色分段（IRE，[low, high)）。18%灰在2.2 gamma下约为46 IRE，亮一档约为63 IRE
+struct FalseColourBand {
+    float low_ire;
+    float high_ire;
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+const FalseColourBand FALSE_COLOUR_BANDS[] = {
+    { -1.0f,   2.5f, 128,   0, 128 },   // 紫：死黑
+    {  2.5f,  10.0f,   0,   0, 255 },   // 蓝：接近死黑
+    { 44.0f,  48.0f,   0, 200,   0 },   // 绿：18%灰
+    { 61.0f,  65.0f, 255, 128, 192 },   // 粉：亮一档（肤色）
+    { 97.0f,  99.5f, 255, 255,   0 },   // 黄：接近过曝
+    { 99.5f, 101.0f, 255,   0,   0 },   // 红：过曝
+};
+
+// codes查表写入entries，共count项
+typedef void (*LookupKernel)(const uint16_t* codes, unsigned int count, const uint32_t* lut, uint32_t* entries);
+
+// 一组同一指令集级别的内核
+struct OverlayKernels {
+    SimdLevel level;
+    LookupKernel lookup;
+};
+
+// ---- 标量参考实现 ----
+
+void lookupScalar(const uint16_t* codes, unsigned int count, const uint32_t* lut, uint32_t* entries) {
+    for (unsigned int i = 0; i < count; ++i) {
+        entries[i] = lut[codes[i]];
+    }
+}
+
+const OverlayKernels SCALAR_KERNELS = { SimdLevel::Scalar, lookupScalar };
+
+// ---- x86：SSSE3 / AVX2 ----
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define CINEPI_TARGET(isa) __attribute__((target(isa)))
+
+// SSSE3没有gather指令，逐项查表
+const OverlayKernels SSSE3_KERNELS = { SimdLevel::Ssse3, lookupScalar };
+
+CINEPI_TARGET("avx2")
+void lookupAvx2(const uint16_t* codes, unsigned int count, const uint32_t* lut, uint32_t* entries) {
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)));
+        __m256i entry = _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), index, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(entries + i), entry);
+    }
+    lookupScalar(codes + i, count - i, lut, entries + i);
+}
+
+const OverlayKernels AVX2_KERNELS = { SimdLevel::Avx2, lookupAvx2 };
+
+#undef CINEPI_TARGET
+
+#endif // x86
+
+// ---- ARM：NEON ----
+
+#if defined(__ARM_NEON)
+
+// NEON没有gather指令（vtbl的表最多64字节），逐项查表
+const OverlayKernels NEON_KERNELS = { SimdLevel::Neon, lookupScalar };
+
+#endif // __ARM_NEON
+
+const OverlayKernels* kernelsFor(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return &SCALAR_KERNELS;
+#if defined(__x86_64__) || defined(__i386__)
+        case SimdLevel::Ssse3:  return &SSSE3_KERNELS;
+        case SimdLevel::Avx2:   return &AVX2_KERNELS;
+#endif
+#if defined(__ARM_NEON)
+        case SimdLevel::Neon:   return &NEON_KERNELS;
+#endif
+        default:                return nullptr;
+    }
+}
+
+// CPU支持的最高级别；该级别没有对应内核时退回标量
+const OverlayKernels* bestKernels() {
+    const OverlayKernels* best = kernelsFor(DetectSimdLevel());
+    return best != nullptr ? best : &SCALAR_KERNELS;
+}
+
+std::atomic<const OverlayKernels*>& activeKernels() {
+    static std::atomic<const OverlayKernels*> active(bestKernels());
+    return active;
+}
+
+const OverlayKernels& kernels() {
+    return *activeKernels().load(std::memory_order_relaxed);
+}
+
+// RAW采样的原始位深度：打包格式由编码决定，16位容器按帧格式
+int sampleBitDepth(const FrameFormat& format) {
+    if (format.encoding == PixelEncoding::Bayer16 && format.bit_depth > 0) {
+        return format.bit_depth;
+    }
+    return EncodingBitDepth(format.encoding);
+}
+
+// 读取一行中第x、x + 1个像素（x为偶数），换算为12位码值。按编码展开，避免每个像素判断编码
+template <PixelEncoding Encoding>
+inline void readPair(const uint8_t* row, int shift, unsigned int x, unsigned int& a, unsigned int& b);
+
+template <>
+inline void readPair<PixelEncoding::BayerCsi2p12>(const uint8_t* row, int, unsigned int x, unsigned int& a, unsigned int& b) {
+    const uint8_t* p = row + static_cast<size_t>(x / 2) * 3;
+    a = (p[0] << 4) | (p[2] & 0x0F);
+    b = (p[1] << 4) | (p[2] >> 4);
+}
+
+template <>
+inline void readPair<PixelEncoding::BayerCsi2p10>(const uint8_t* row, int, unsigned int x, unsigned int& a, unsigned int& b) {
+    const uint8_t* p = row + static_cast<size_t>(x / 4) * 5;
+    unsigned int i = x % 4;
+    a = ((p[i] << 2) | ((p[4] >> (2 * i)) & 0x03)) << 2;
+    b = ((p[i + 1] << 2) | ((p[4] >> (2 * i + 2)) & 0x03)) << 2;
+}
+
+// 16位容器按帧格式的位深度换算
+template <>
+inline void readPair<PixelEncoding::Bayer16>(const uint8_t* row, int shift, unsigned int x, unsigned int& a, unsigned int& b) {
+    uint16_t pair[2];
+    memcpy(pair, row + static_cast<size_t>(x) * 2, sizeof(pair));
+    a = std::min(shift >= 0 ? static_cast<unsigned int>(pair[0]) << shift : static_cast<unsigned int>(pair[0]) >> -shift, CODE_MAX);
+    b = std::min(shift >= 0 ? static_cast<unsigned int>(pair[1]) << shift : static_cast<unsigned int>(pair[1]) >> -shift, CODE_MAX);
+}
+
+// 一行采样点的码值：斑马纹取块内最大值，伪色取两个绿色值的平均
+template <PixelEncoding Encoding, bool Maximum>
+void sampleRow(const uint8_t* top, const uint8_t* bottom, const unsigned int* raw_x, unsigned int count, int shift,
+               bool green_first, uint16_t* codes) {
+    for (unsigned int x = 0; x < count; ++x) {
+        unsigned int t0, t1, b0, b1;
+        readPair<Encoding>(top, shift, raw_x[x], t0, t1);
+        readPair<Encoding>(bottom, shift, raw_x[x], b0, b1);
+        unsigned int code;
+        if (Maximum) {
+            unsigned int top_max = t0 > t1 ? t0 : t1;
+            unsigned int bottom_max = b0 > b1 ? b0 : b1;
+            code = top_max > bottom_max ? top_max : bottom_max;
+        } else {
+            code = green_first ? (t0 + b1 + 1) / 2 : (t1 + b0 + 1) / 2;
+        }
+        codes[x] = static_cast<uint16_t>(code);
+    }
+}
+
+// 编码和模式都作为模板参数，内层循环里没有分支（噪声大的画面上分支预测失败会使斑马纹慢3倍）
+template <bool Maximum>
+void sampleRow(PixelEncoding encoding, const uint8_t* top, const uint8_t* bottom, const unsigned int* raw_x, unsigned int count,
+               int shift, bool green_first, uint16_t* codes) {
+    switch (encoding) {
+        case PixelEncoding::BayerCsi2p12:
+            sampleRow<PixelEncoding::BayerCsi2p12, Maximum>(top, bottom, raw_x, count, shift, green_first, codes);
+            break;
+        case PixelEncoding::BayerCsi2p10:
+            sampleRow<PixelEncoding::BayerCsi2p10, Maximum>(top, bottom, raw_x, count, shift, green_first, codes);
+            break;
+        default:
+            sampleRow<PixelEncoding::Bayer16, Maximum>(top, bottom, raw_x, count, shift, green_first, codes);
+            break;
+    }
+}
+
+// 按最近邻把输出位置i映射到源区间中的块（取采样点中心）
+inline unsigned int nearestCell(unsigned int i, unsigned int cells, unsigned int points) {
+    unsigned int cell = static_cast<unsigned int>((static_cast<uint64_t>(i) * 2 + 1) * cells / (static_cast<uint64_t>(points) * 2));
+    return std::min(cell, cells - 1);
+}
+
+// 查找表项按目标图像的字节顺序B,G,R打包（取景流和RAW预览都是这个顺序）
+uint32_t packEntry(uint8_t r, uint8_t g, uint8_t b, uint32_t flag) {
+    return static_cast<uint32_t>(b) | (static_cast<uint32_t>(g) << 8) | (static_cast<uint32_t>(r) << 16) | (flag << 24);
+}
+
+} // namespace
+
+const char* ExposureOverlayModeName(ExposureOverlayMode mode) {
+    switch (mode) {
+        case ExposureOverlayMode::Zebra:       return "斑马纹";
+        case ExposureOverlayMode::FalseColour: return "伪色";
+        default:                               return "关";
+    }
+}
+
+bool ParseZebraLevels(const std::string& text, ExposureOverlayConfig& config) {
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    unsigned long high = std::strtoul(begin, &end, 10);
+    unsigned long mid = 0;
+    if (end == begin) {
+        return false;
+    }
+    if (*end == ',') {
+        begin = end + 1;
+        mid = std::strtoul(begin, &end, 10);
+        if (end == begin) {
+            return false;
+        }
+    }
+    if (*end != '\0' || high == 0 || high > 100 || mid >= high) {
+        return false;
+    }
+    config.zebra_high_ire = static_cast<unsigned int>(high);
+    config.zebra_mid_ire = static_cast<unsigned int>(mid);
+    return true;
+}
+
+void BuildExposureLut(std::vector<uint32_t>& lut, const ExposureOverlayConfig& config, int bit_depth, int black_level) {
+    lut.assign(EXPOSURE_LUT_SIZE, 0);
+    int shift = static_cast<int>(CODE_BITS) - bit_depth;
+    int black = std::max(0, shift >= 0 ? black_level << shift : black_level >> -shift);
+    black = std::min(black, static_cast<int>(CODE_MAX) - 1);
+    float range = static_cast<float>(static_cast<int>(CODE_MAX) - black);
+
+    for (unsigned int code = 0; code < EXPOSURE_LUT_SIZE; ++code) {
+        float level = std::max(0.0f, static_cast<float>(static_cast<int>(code) - black) / range);
+        float ire = 100.0f * std::pow(level, 1.0f / OVERLAY_GAMMA);
+        uint32_t entry = 0;
+        if (config.mode == ExposureOverlayMode::Zebra) {
+            if (ire >= static_cast<float>(config.zebra_high_ire)) {
+                entry = packEntry(255, 0, 0, ENTRY_STRIPE);
+            } else if (config.zebra_mid_ire > 0 && ire >= static_cast<float>(config.zebra_mid_ire) &&
+                       ire < static_cast<float>(config.zebra_mid_ire) + ZEBRA_MID_BAND_IRE) {
+                entry = packEntry(255, 255, 255, ENTRY_STRIPE);
+            }
+        } else if (config.mode == ExposureOverlayMode::FalseColour) {
+            // 不在任何分段内的显示为对应亮度的灰色
+            uint8_t grey = static_cast<uint8_t>(std::min(255.0f, ire * 2.55f + 0.5f));
+            entry = packEntry(grey, grey, grey, ENTRY_SOLID);
+            for (const FalseColourBand& band : FALSE_COLOUR_BANDS) {
+                if (ire >= band.low_ire && ire < band.high_ire) {
+                    entry = packEntry(band.r, band.g, band.b, ENTRY_SOLID);
+                    break;
+                }
+            }
+        }
+        lut[code] = entry;
+    }
+}
+
+void ExposureOverlayRows(const FrameView& raw, const uint32_t* lut, ExposureOverlayMode mode,
+                         uint8_t* dst, unsigned int dst_stride, const ScaleRect& rect,
+                         unsigned int row_begin, unsigned int row_end) {
+    const OverlayKernels& k = kernels();
+    unsigned int cells_width = raw.width / 2;
+    unsigned int cells_height = raw.height / 2;
+    unsigned int points_width = static_cast<unsigned int>(rect.width) / 2;
+    unsigned int points_height = static_cast<unsigned int>(rect.height) / 2;
+    row_end = std::min(row_end, points_height);
+    if (cells_width == 0 || cells_height == 0 || points_width == 0 || row_begin >= row_end) {
+        return;
+    }
+
+    PixelEncoding encoding = raw.format.encoding;
+    int shift = static_cast<int>(CODE_BITS) - sampleBitDepth(raw.format);
+    // 左上角是绿色时两个绿色在主对角线上，否则在副对角线上
+    bool green_first = raw.format.bayer_order == BayerOrder::GRBG || raw.format.bayer_order == BayerOrder::GBRG;
+
+    std::vector<unsigned int> raw_x(points_width);
+    for (unsigned int x = 0; x < points_width; ++x) {
+        raw_x[x] = nearestCell(x, cells_width, points_width) * 2;
+    }
+    std::vector<uint16_t> codes(points_width);
+    std::vector<uint32_t> entries(points_width);
+    // 一行采样点展开成的像素（每点6字节），末尾多留一个字节给4字节写入
+    std::vector<uint8_t> line(static_cast<size_t>(points_width) * 6 + 1);
+    bool maximum = mode == ExposureOverlayMode::Zebra;
+
+    for (unsigned int y = row_begin; y < row_end; ++y) {
+        const uint8_t* top = raw.data + static_cast<size_t>(nearestCell(y, cells_height, points_height)) * 2 * raw.stride;
+        const uint8_t* bottom = top + raw.stride;
+        if (maximum) {
+            sampleRow<true>(encoding, top, bottom, raw_x.data(), points_width, shift, green_first, codes.data());
+        } else {
+            sampleRow<false>(encoding, top, bottom, raw_x.data(), points_width, shift, green_first, codes.data());
+        }
+        k.lookup(codes.data(), points_width, lut, entries.data());
+
+        // 表项低3字节即像素（小端），两次4字节写入展开成两个像素，多出的一个字节由下一个点覆盖
+        uint8_t* pixels = line.data();
+        for (unsigned int x = 0; x < points_width; ++x) {
+            memcpy(pixels + static_cast<size_t>(x) * 6, &entries[x], 4);
+            memcpy(pixels + static_cast<size_t>(x) * 6 + 3, &entries[x], 4);
+        }
+
+        uint8_t* out0 = dst + static_cast<size_t>(rect.y + static_cast<int>(y) * 2) * dst_stride + static_cast<size_t>(rect.x) * 3;
+        uint8_t* out1 = out0 + dst_stride;
+        if (mode == ExposureOverlayMode::FalseColour) {
+            // 伪色的表项都是实心的，整行覆盖
+            memcpy(out0, pixels, static_cast<size_t>(points_width) * 6);
+            memcpy(out1, pixels, static_cast<size_t>(points_width) * 6);
+            continue;
+        }
+        for (unsigned int x = 0; x < points_width; ++x) {
+            uint32_t flag = entries[x] >> 24;
+            // 斜条纹：沿对角线每两个采样点（4个像素）交替
+            if (flag == 0 || (flag == ENTRY_STRIPE && ((x + y) & 2) != 0)) {
+                continue;
+            }
+            memcpy(out0 + static_cast<size_t>(x) * 6, pixels + static_cast<size_t>(x) * 6, 6);
+            memcpy(out1 + static_cast<size_t>(x) * 6, pixels + static_cast<size_t>(x) * 6, 6);
+        }
+    }
+}
+
+SimdLevel GetExposureOverlayLevel() {
+    return kernels().level;
+}
+
+bool SetExposureOverlayLevel(SimdLevel level) {
+    const OverlayKernels* selected = kernelsFor(level);
+    if (selected == nullptr || !SimdLevelSupported(level)) {
+        return false;
+    }
+    activeKernels().store(selected, std::memory_order_relaxed);
+    return true;
+}
+
+ExposureOverlay::ExposureOverlay(WorkerPool& pool)
+    : pool_(pool),
+      lut_bit_depth_(0),
+      lut_black_level_(-1) {
+}
+
+void ExposureOverlay::SetConfig(const ExposureOverlayConfig& config) {
+    config_ = config;
+    lut_.clear();
+}
+
+bool ExposureOverlay::Apply(const FrameView& raw, int black_level, uint8_t* dst, unsigned int dst_stride, const ScaleRect& rect) {
+    if (config_.mode == ExposureOverlayMode::Off || !dst || !raw.IsValid() || !raw.format.IsBayer() ||
+        raw.width < 2 || raw.height < 2 || rect.width < 2 || rect.height < 2) {
+        return false;
+    }
+
+    // 查找表按RAW位深度和黑电平生成，参数不变时沿用
+    int bit_depth = sampleBitDepth(raw.format);
+    if (lut_.empty() || bit_depth != lut_bit_depth_ || black_level != lut_black_level_) {
+        BuildExposureLut(lut_, config_, bit_depth, black_level);
+        lut_bit_depth_ = bit_depth;
+        lut_black_level_ = black_level;
+    }
+
+    // 每个线程一段连续的采样行
+    unsigned int rows = static_cast<unsigned int>(rect.height) / 2;
+    unsigned int bands = static_cast<unsigned int>(std::min<size_t>(pool_.Size(), rows));
+    unsigned int band_rows = (rows + bands - 1) / bands;
+    const uint32_t* lut = lut_.data();
+    ExposureOverlayMode mode = config_.mode;
+    for (unsigned int begin = 0; begin < rows; begin += band_rows) {
+        unsigned int end = std::min(begin + band_rows, rows);
+        pool_.Submit([raw, lut, mode, dst, dst_stride, rect, begin, end]() {
+            ExposureOverlayRows(raw, lut, mode, dst, dst_stride, rect, begin, end);
+        });
+    }
+    pool_.WaitIdle();
+    return true;
+}
+
+} // namespace cinepi
@@ -0,0 +1,89 @@
+// exposure_overlay.h
+// 曝光辅助：由RAW值（ISP之前）生成斑马纹或伪色，叠加到预览图像上
+//
+// 预览图像每个2x2像素对应一个采样点，按位置取最近的RAW 2x2 Bayer块：
+// 斑马纹取块内四个值的最大值（任一通道过曝都会标出），伪色取两个绿色值的平均。
+// 采样值统一换算为12位码值后查4096项的表得到叠加色；查表表项按黑电平和IRE阈值生成，
+// IRE按与RAW预览相同的2.2 gamma由线性值换算（RAW白电平为100 IRE），所以过曝反映的是传感器而不是ISP的色调曲线。
+// AVX2用gather查表，其他级别逐项查表（表只有16KB，常驻L1）。只写不读目标图像，可以直接写入锁定的纹理。
+
+#ifndef EXPOSURE_OVERLAY_H
+#define EXPOSURE_OVERLAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cpu_features.h"
+#include "frame_types.h"
+#include "preview_scaler.h"
+#include "worker_pool.h"
+
+namespace cinepi {
+
+// 查找表项数（12位码值）
+const unsigned int EXPOSURE_LUT_SIZE = 4096;
+
+// 叠加模式
+enum class ExposureOverlayMode {
+    Off,
+    Zebra,          // 超过阈值的区域画斜条纹
+    FalseColour     // 按IRE分段着色，其余部分显示为灰度
+};
+
+// 叠加模式名称，用于界面显示
+const char* ExposureOverlayModeName(ExposureOverlayMode mode);
+
+// 叠加参数
+struct ExposureOverlayConfig {
+    ExposureOverlayMode mode;
+    unsigned int zebra_high_ire;    // 高于此值画红色斑马纹（过曝警告）
+    unsigned int zebra_mid_ire;     // 在[mid, mid + 5)之间画白色斑马纹（如70用于肤色），0表示不画
+
+    ExposureOverlayConfig() : mode(ExposureOverlayMode::Off), zebra_high_ire(95), zebra_mid_ire(0) {}
+};
+
+// 解析斑马纹阈值"<高>"或"<高>,<中>"（IRE），格式无效或超出0~100时返回false
+bool ParseZebraLevels(const std::string& text, ExposureOverlayConfig& config);
+
+// 生成查找表：每项低3字节为叠加色（B,G,R字节顺序，与取景流和RAW预览一致），最高字节为0（不叠加）、1（实心）或2（斜条纹）。
+// black_level按bit_depth位计
+void BuildExposureLut(std::vector<uint32_t>& lut, const ExposureOverlayConfig& config, int bit_depth, int black_level);
+
+// 叠加rect内的采样行[row_begin, row_end)（每行对应图像的两行，共rect.height / 2行）。
+// raw整幅拉伸到rect，假定与预览图像的视野相同
+void ExposureOverlayRows(const FrameView& raw, const uint32_t* lut, ExposureOverlayMode mode,
+                         uint8_t* dst, unsigned int dst_stride, const ScaleRect& rect,
+                         unsigned int row_begin, unsigned int row_end);
+
+// 曝光叠加当前使用的内核级别
+SimdLevel GetExposureOverlayLevel();
+
+// 强制使用指定级别的内核（基准测试和对比用），CPU不支持时返回false
+bool SetExposureOverlayLevel(SimdLevel level);
+
+class ExposureOverlay {
+public:
+    // 在pool的线程中并行处理，pool需比叠加存活更久
+    explicit ExposureOverlay(WorkerPool& pool);
+
+    ExposureOverlay(const ExposureOverlay&) = delete;
+    ExposureOverlay& operator=(const ExposureOverlay&) = delete;
+
+    // 把raw的斑马纹或伪色叠加到dst中rect所在的区域。
+    // 模式为Off、raw不是Bayer格式或区域太小时返回false，dst不变
+    bool Apply(const FrameView& raw, int black_level, uint8_t* dst, unsigned int dst_stride, const ScaleRect& rect);
+
+    const ExposureOverlayConfig& Config() const { return config_; }
+    void SetConfig(const ExposureOverlayConfig& config);
+
+private:
+    WorkerPool& pool_;
+    ExposureOverlayConfig config_;
+    std::vector<uint32_t> lut_;
+    int lut_bit_depth_;         // 查找表对应的RAW位深度和黑电平，变化或参数修改时重建
+    int lut_black_level_;
+};
+
+} // namespace cinepi
+
+#endif // EXPOSURE_OVERLAY_H
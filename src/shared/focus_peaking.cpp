@@ -0,0 +1,334 @@
+// focus_peaking.cpp
+// 峰值对焦实现
+
+#include "focus_peaking.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace cinepi {
+
+namespace {
+
+// 梯度阈值的上限（8位亮度），抽取后的亮度是8位值的16倍，|dx| + |dy| <= 510 * 16 不会超出int16
+const unsigned int MAX_THRESHOLD = 510;
+const unsigned int LUMA_SCALE = 16;
+
+// 由相邻两行图像抽取一行亮度：每个2x2块求B + 2G + R之和（0~4080），共width个输出
+typedef void (*DecimateKernel)(const uint8_t* row0, const uint8_t* row1, unsigned int width, uint16_t* luma);
+// mask[x] = |mid[x+1] - mid[x-1]| + |down[x] - up[x]| > threshold ? 0xFF : 0，首尾两点为0
+typedef void (*EdgeKernel)(const uint16_t* up, const uint16_t* mid, const uint16_t* down, unsigned int width,
+                           uint16_t threshold, uint8_t* mask);
+
+// 一组同一指令集级别的内核
+struct PeakingKernels {
+    SimdLevel level;
+    DecimateKernel decimate;
+    EdgeKernel edge;
+};
+
+// ---- 标量参考实现 ----
+
+void decimateScalar(const uint8_t* row0, const uint8_t* row1, unsigned int width, uint16_t* luma) {
+    for (unsigned int x = 0; x < width; ++x) {
+        const uint8_t* a = row0 + static_cast<size_t>(x) * 6;
+        const uint8_t* b = row1 + static_cast<size_t>(x) * 6;
+        luma[x] = static_cast<uint16_t>(a[0] + 2 * a[1] + a[2] + a[3] + 2 * a[4] + a[5] +
+                                        b[0] + 2 * b[1] + b[2] + b[3] + 2 * b[4] + b[5]);
+    }
+}
+
+inline unsigned int absDiff(uint16_t a, uint16_t b) {
+    return a > b ? a - b : b - a;
+}
+
+// 计算[begin, end)内的点，调用者保证1 <= begin且end <= width - 1
+void edgeRange(const uint16_t* up, const uint16_t* mid, const uint16_t* down, unsigned int begin, unsigned int end,
+               uint16_t threshold, uint8_t* mask) {
+    for (unsigned int x = begin; x < end; ++x) {
+        unsigned int gradient = absDiff(mid[x + 1], mid[x - 1]) + absDiff(down[x], up[x]);
+        mask[x] = gradient > threshold ? 0xFF : 0;
+    }
+}
+
+// 首尾两点没有左右邻居，不标记；返回false表示行太窄，没有内部点
+bool edgeBorders(unsigned int width, uint8_t* mask) {
+    if (width == 0) {
+        return false;
+    }
+    mask[0] = 0;
+    mask[width - 1] = 0;
+    return width > 2;
+}
+
+void edgeScalar(const uint16_t* up, const uint16_t* mid, const uint16_t* down, unsigned int width,
+                uint16_t threshold, uint8_t* mask) {
+    if (edgeBorders(width, mask)) {
+        edgeRange(up, mid, down, 1, width - 1, threshold, mask);
+    }
+}
+
+const PeakingKernels SCALAR_KERNELS = { SimdLevel::Scalar, decimateScalar, edgeScalar };
+
+// ---- x86：SSSE3 / AVX2 ----
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define CINEPI_TARGET(isa) __attribute__((target(isa)))
+
+// 8个点的梯度与阈值比较，结果为0或0xFFFF（梯度不超过8160，按有符号比较即可）
+CINEPI_TARGET("ssse3")
+inline __m128i edgeMask8(const uint16_t* up, const uint16_t* mid, const uint16_t* down, unsigned int x, __m128i threshold) {
+    __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x - 1));
+    __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x + 1));
+    __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x));
+    __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(down + x));
+    __m128i gradient = _mm_add_epi16(_mm_abs_epi16(_mm_sub_epi16(right, left)), _mm_abs_epi16(_mm_sub_epi16(bottom, top)));
+    return _mm_cmpgt_epi16(gradient, threshold);
+}
+
+CINEPI_TARGET("ssse3")
+void edgeSsse3(const uint16_t* up, const uint16_t* mid, const uint16_t* down, unsigned int width,
+               uint16_t threshold, uint8_t* mask) {
+    if (!edgeBorders(width, mask)) {
+        return;
+    }
+    const __m128i limit = _mm_set1_epi16(static_cast<short>(threshold));
+    unsigned int x = 1;
+    // 最右读到mid[x + 16]，必须在width - 1以内
+    for (; x + 16 <= width - 1; x += 16) {
+        __m128i lo = edgeMask8(up, mid, down, x, limit);
+        __m128i hi = edgeMask8(up, mid, down, x + 8, limit);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x), _mm_packs_epi16(lo, hi));
+    }
+    edgeRange(up, mid, down, x, width - 1, threshold, mask);
+}
+
+const PeakingKernels SSSE3_KERNELS = { SimdLevel::Ssse3, decimateScalar, edgeSsse3 };
+
+CINEPI_TARGET("avx2")
+inline __m256i edgeMask16(const uint16_t* up, const uint16_t* mid, const uint16_t* down, unsigned int x, __m256i threshold) {
+    __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mid + x - 1));
+    __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mid + x + 1));
+    __m256i top = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x));
+    __m256i bottom = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + x));
+    __m256i gradient = _mm256_add_epi16(_mm256_abs_epi16(_mm256_sub_epi16(right, left)),
+                                        _mm256_abs_epi16(_mm256_sub_epi16(bottom, top)));
+    return _mm256_cmpgt_epi16(gradient, threshold);
+}
+
+CINEPI_TARGET("avx2")
+void edgeAvx2(const uint16_t* up, const uint16_t* mid, const uint16_t* down, unsigned int width,
+              uint16_t threshold, uint8_t* mask) {
+    if (!edgeBorders(width, mask)) {
+        return;
+    }
+    const __m256i limit = _mm256_set1_epi16(static_cast<short>(threshold));
+    unsigned int x = 1;
+    for (; x + 32 <= width - 1; x += 32) {
+        __m256i lo = edgeMask16(up, mid, down, x, limit);
+        __m256i hi = edgeMask16(up, mid, down, x + 16, limit);
+        // packs按128位通道交错，重排回原顺序
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mask + x), packed);
+    }
+    edgeRange(up, mid, down, x, width - 1, threshold, mask);
+}
+
+const PeakingKernels AVX2_KERNELS = { SimdLevel::Avx2, decimateScalar, edgeAvx2 };
+
+#undef CINEPI_TARGET
+
+#endif // x86
+
+// ---- ARM：NEON ----
+
+#if defined(__ARM_NEON)
+
+void decimateNeon(const uint8_t* row0, const uint8_t* row1, unsigned int width, uint16_t* luma) {
+    unsigned int x = 0;
+    // vld3把16个像素解交织成B、G、R三个向量，vpaddl把相邻两个像素相加得到8个输出
+    for (; x + 8 <= width; x += 8) {
+        uint8x16x3_t a = vld3q_u8(row0 + static_cast<size_t>(x) * 6);
+        uint8x16x3_t b = vld3q_u8(row1 + static_cast<size_t>(x) * 6);
+        uint16x8_t sum = vaddq_u16(vpaddlq_u8(a.val[0]), vpaddlq_u8(a.val[2]));
+        sum = vaddq_u16(sum, vshlq_n_u16(vpaddlq_u8(a.val[1]), 1));
+        sum = vaddq_u16(sum, vaddq_u16(vpaddlq_u8(b.val[0]), vpaddlq_u8(b.val[2])));
+        sum = vaddq_u16(sum, vshlq_n_u16(vpaddlq_u8(b.val[1]), 1));
+        vst1q_u16(luma + x, sum);
+    }
+    decimateScalar(row0 + static_cast<size_t>(x) * 6, row1 + static_cast<size_t>(x) * 6, width - x, luma + x);
+}
+
+inline uint16x8_t edgeMask8(const uint16_t* up, const uint16_t* mid, const uint16_t* down, unsigned int x, uint16x8_t threshold) {
+    uint16x8_t gradient = vaddq_u16(vabdq_u16(vld1q_u16(mid + x + 1), vld1q_u16(mid + x - 1)),
+                                    vabdq_u16(vld1q_u16(down + x), vld1q_u16(up + x)));
+    return vcgtq_u16(gradient, threshold);
+}
+
+void edgeNeon(const uint16_t* up, const uint16_t* mid, const uint16_t* down, unsigned int width,
+              uint16_t threshold, uint8_t* mask) {
+    if (!edgeBorders(width, mask)) {
+        return;
+    }
+    const uint16x8_t limit = vdupq_n_u16(threshold);
+    unsigned int x = 1;
+    for (; x + 16 <= width - 1; x += 16) {
+        uint8x8_t lo = vmovn_u16(edgeMask8(up, mid, down, x, limit));
+        uint8x8_t hi = vmovn_u16(edgeMask8(up, mid, down, x + 8, limit));
+        vst1q_u8(mask + x, vcombine_u8(lo, hi));
+    }
+    edgeRange(up, mid, down, x, width - 1, threshold, mask);
+}
+
+const PeakingKernels NEON_KERNELS = { SimdLevel::Neon, decimateNeon, edgeNeon };
+
+#endif // __ARM_NEON
+
+const PeakingKernels* kernelsFor(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return &SCALAR_KERNELS;
+#if defined(__x86_64__) || defined(__i386__)
+        case SimdLevel::Ssse3:  return &SSSE3_KERNELS;
+        case SimdLevel::Avx2:   return &AVX2_KERNELS;
+#endif
+#if defined(__ARM_NEON)
+        case SimdLevel::Neon:   return &NEON_KERNELS;
+#endif
+        default:                return nullptr;
+    }
+}
+
+// CPU支持的最高级别；该级别没有对应内核时退回标量
+const PeakingKernels* bestKernels() {
+    const PeakingKernels* best = kernelsFor(DetectSimdLevel());
+    return best != nullptr ? best : &SCALAR_KERNELS;
+}
+
+std::atomic<const PeakingKernels*>& activeKernels() {
+    static std::atomic<const PeakingKernels*> active(bestKernels());
+    return active;
+}
+
+const PeakingKernels& kernels() {
+    return *activeKernels().load(std::memory_order_relaxed);
+}
+
+// 把抽取后第x个点对应的2x2块涂成标记色
+inline void paintBlock(uint8_t* row0, uint8_t* row1, unsigned int x, const uint8_t* colour) {
+    uint8_t* a = row0 + static_cast<size_t>(x) * 6;
+    uint8_t* b = row1 + static_cast<size_t>(x) * 6;
+    for (int i = 0; i < 6; ++i) {
+        a[i] = colour[i % 3];
+        b[i] = colour[i % 3];
+    }
+}
+
+} // namespace
+
+void FocusPeakingRows(const uint8_t* src, unsigned int width, unsigned int height, unsigned int src_stride,
+                      uint8_t* dst, unsigned int dst_stride, const PeakingConfig& config,
+                      unsigned int row_begin, unsigned int row_end) {
+    const PeakingKernels& k = kernels();
+    unsigned int luma_width = width / 2;
+    unsigned int luma_height = height / 2;
+    size_t row_bytes = static_cast<size_t>(width) * 3;
+    uint16_t threshold = static_cast<uint16_t>(std::min(config.threshold, MAX_THRESHOLD) * LUMA_SCALE);
+
+    // 三行亮度轮流使用：第y行放在y % 3，处理第y行时需要y - 1、y、y + 1
+    std::vector<uint16_t> luma(static_cast<size_t>(luma_width) * 3);
+    std::vector<uint8_t> mask(luma_width);
+    auto lumaRow = [&](unsigned int y) {
+        return luma.data() + static_cast<size_t>(y % 3) * luma_width;
+    };
+    auto decimate = [&](unsigned int y) {
+        const uint8_t* row0 = src + static_cast<size_t>(y) * 2 * src_stride;
+        k.decimate(row0, row0 + src_stride, luma_width, lumaRow(y));
+    };
+
+    row_end = std::min(row_end, luma_height);
+    if (row_begin < row_end) {
+        if (row_begin > 0) {
+            decimate(row_begin - 1);
+        }
+        decimate(row_begin);
+    }
+    for (unsigned int y = row_begin; y < row_end; ++y) {
+        if (y + 1 < luma_height) {
+            decimate(y + 1);
+        }
+        // 图像上下边缘用本行代替缺少的邻行
+        const uint16_t* up = lumaRow(y > 0 ? y - 1 : y);
+        const uint16_t* down = lumaRow(y + 1 < luma_height ? y + 1 : y);
+        k.edge(up, lumaRow(y), down, luma_width, threshold, mask.data());
+
+        uint8_t* out0 = dst + static_cast<size_t>(y) * 2 * dst_stride;
+        uint8_t* out1 = out0 + dst_stride;
+        memcpy(out0, src + static_cast<size_t>(y) * 2 * src_stride, row_bytes);
+        memcpy(out1, src + (static_cast<size_t>(y) * 2 + 1) * src_stride, row_bytes);
+
+        // 合焦的边缘通常很稀疏，按8个点一组跳过没有标记的部分
+        for (unsigned int x = 0; x < luma_width; x += 8) {
+            unsigned int count = std::min(8u, luma_width - x);
+            uint64_t word = 0;
+            memcpy(&word, mask.data() + x, count);
+            if (word == 0) {
+                continue;
+            }
+            for (unsigned int i = x; i < x + count; ++i) {
+                if (mask[i]) {
+                    paintBlock(out0, out1, i, config.colour);
+                }
+            }
+        }
+    }
+    if (row_end == luma_height && height % 2 != 0) {
+        memcpy(dst + static_cast<size_t>(height - 1) * dst_stride, src + static_cast<size_t>(height - 1) * src_stride, row_bytes);
+    }
+}
+
+SimdLevel GetFocusPeakingLevel() {
+    return kernels().level;
+}
+
+bool SetFocusPeakingLevel(SimdLevel level) {
+    const PeakingKernels* selected = kernelsFor(level);
+    if (selected == nullptr || !SimdLevelSupported(level)) {
+        return false;
+    }
+    activeKernels().store(selected, std::memory_order_relaxed);
+    return true;
+}
+
+FocusPeaking::FocusPeaking(WorkerPool& pool) : pool_(pool) {
+}
+
+bool FocusPeaking::Apply(const uint8_t* src, unsigned int width, unsigned int height, unsigned int src_stride,
+                         uint8_t* dst, unsigned int dst_stride) {
+    if (!src || !dst || src == dst || width < 2 || height < 2) {
+        return false;
+    }
+
+    // 每个线程一段连续的抽取行
+    unsigned int rows = height / 2;
+    unsigned int bands = static_cast<unsigned int>(std::min<size_t>(pool_.Size(), rows));
+    unsigned int band_rows = (rows + bands - 1) / bands;
+    const PeakingConfig config = config_;
+    for (unsigned int begin = 0; begin < rows; begin += band_rows) {
+        unsigned int end = std::min(begin + band_rows, rows);
+        pool_.Submit([src, width, height, src_stride, dst, dst_stride, config, begin, end]() {
+            FocusPeakingRows(src, width, height, src_stride, dst, dst_stride, config, begin, end);
+        });
+    }
+    pool_.WaitIdle();
+    return true;
+}
+
+} // namespace cinepi
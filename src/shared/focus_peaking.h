@@ -0,0 +1,62 @@
+// focus_peaking.h
+// 峰值对焦：在预览图像上用颜色标出合焦的边缘
+//
+// 每个2x2像素块抽取一个亮度值（B + 2G + R，抽取后1280x960的预览只有640x480个点），
+// 对抽取后的亮度平面求梯度 |dx| + |dy|（中心差分），超过阈值的点把对应的2x2块涂成标记色。
+// 梯度和阈值比较用SSSE3/AVX2/NEON；亮度抽取在NEON上用vld3解交织，x86只有标量实现（x86只用于开发）。
+// 全部是整数运算，各指令集级别的结果逐字节一致。按抽取后的行分块在工作线程中并行。
+
+#ifndef FOCUS_PEAKING_H
+#define FOCUS_PEAKING_H
+
+#include <cstdint>
+#include "cpu_features.h"
+#include "worker_pool.h"
+
+namespace cinepi {
+
+// 峰值对焦参数
+struct PeakingConfig {
+    unsigned int threshold;     // 梯度阈值，按8位亮度计（|dx| + |dy|，0~510），越小标出的边缘越多
+    uint8_t colour[3];          // 标记色，按图像的字节顺序
+
+    PeakingConfig() : threshold(40), colour{ 0, 0, 255 } {}
+};
+
+// 处理抽取后的亮度行[row_begin, row_end)，即图像的第2*row_begin到2*row_end-1行，像素为3字节：
+// 把这些行从src复制到dst再上色。相邻分段会读对方的源行，所以dst不能与src重叠。
+// 最后一段（row_end为height / 2）同时复制高度为奇数时多出的一行
+void FocusPeakingRows(const uint8_t* src, unsigned int width, unsigned int height, unsigned int src_stride,
+                      uint8_t* dst, unsigned int dst_stride, const PeakingConfig& config,
+                      unsigned int row_begin, unsigned int row_end);
+
+// 峰值对焦当前使用的内核级别
+SimdLevel GetFocusPeakingLevel();
+
+// 强制使用指定级别的内核（基准测试和对比用），CPU不支持时返回false
+bool SetFocusPeakingLevel(SimdLevel level);
+
+class FocusPeaking {
+public:
+    // 在pool的线程中并行处理，pool需比峰值对焦存活更久
+    explicit FocusPeaking(WorkerPool& pool);
+
+    FocusPeaking(const FocusPeaking&) = delete;
+    FocusPeaking& operator=(const FocusPeaking&) = delete;
+
+    // 把src复制到dst并标出边缘。dst可以是锁定的流式纹理（只写不读），不能与src重叠。
+    // 尺寸无效时返回false，dst不变
+    bool Apply(const uint8_t* src, unsigned int width, unsigned int height, unsigned int src_stride,
+               uint8_t* dst, unsigned int dst_stride);
+
+    const PeakingConfig& Config() const { return config_; }
+    void SetConfig(const PeakingConfig& config) { config_ = config; }
+
+private:
+    WorkerPool& pool_;
+    PeakingConfig config_;
+};
+
+} // namespace cinepi
+
+#endif // FOCUS_PEAKING_H
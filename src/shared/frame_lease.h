@@ -0,0 +1,147 @@
+// frame_lease.h
+// 帧租约：以RAII方式持有一个采集缓冲，最后一个持有者释放时缓冲才被回收
+//
+// 显示、录制、分析等消费者各自持有租约，直接读取传感器内存而无需复制。
+// 缓冲池大小固定，租约只是引用计数，不会分配新的帧内存。
+
+#ifndef FRAME_LEASE_H
+#define FRAME_LEASE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "frame_types.h"
+
+namespace cinepi {
+
+class FrameRecycler;
+
+// 帧槽：缓冲池中的一项，对应一个可重复使用的采集请求
+struct FrameSlot {
+    CapturedFrame frame;
+    std::atomic<int> lease_count;
+    std::atomic<FrameRecycler*> recycler;  // 所有者关闭时仍被租用的帧槽置空，之后释放租约不再回收
+    void* cookie;       // 帧来源的私有数据（例如libcamera::Request*）
+
+    FrameSlot() : lease_count(0), recycler(nullptr), cookie(nullptr) {}
+};
+
+// 帧回收接口，由缓冲池的拥有者实现
+class FrameRecycler {
+public:
+    virtual ~FrameRecycler() = default;
+
+    // 最后一个租约释放时调用，可能发生在任意线程
+    virtual void RecycleFrame(FrameSlot* slot) = 0;
+};
+
+// 帧租约
+class FrameLease {
+public:
+    FrameLease() : slot_(nullptr) {}
+
+    explicit FrameLease(FrameSlot* slot) : slot_(slot) {
+        if (slot_) {
+            slot_->lease_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    FrameLease(const FrameLease& other) : FrameLease(other.slot_) {}
+
+    FrameLease(FrameLease&& other) noexcept : slot_(other.slot_) {
+        other.slot_ = nullptr;
+    }
+
+    FrameLease& operator=(const FrameLease& other) {
+        if (this != &other) {
+            FrameLease copy(other);
+            std::swap(slot_, copy.slot_);
+        }
+        return *this;
+    }
+
+    FrameLease& operator=(FrameLease&& other) noexcept {
+        if (this != &other) {
+            Release();
+            slot_ = other.slot_;
+            other.slot_ = nullptr;
+        }
+        return *this;
+    }
+
+    ~FrameLease() {
+        Release();
+    }
+
+    // 提前释放租约
+    void Release() {
+        if (slot_) {
+            FrameSlot* slot = slot_;
+            slot_ = nullptr;
+            // 回收方在归还前读取：最后一个租约归还后帧槽可能随即被所有者释放
+            FrameRecycler* recycler = slot->recycler.load(std::memory_order_acquire);
+            if (slot->lease_count.fetch_sub(1, std::memory_order_acq_rel) == 1 && recycler) {
+                recycler->RecycleFrame(slot);
+            }
+        }
+    }
+
+    bool IsValid() const { return slot_ != nullptr; }
+    explicit operator bool() const { return IsValid(); }
+
+    const CapturedFrame& Frame() const { return slot_->frame; }
+    const CapturedFrame* operator->() const { return &slot_->frame; }
+
+private:
+    FrameSlot* slot_;
+};
+
+// 所有者关闭时等待租约归还的最长时间
+const std::chrono::milliseconds LEASE_RELEASE_TIMEOUT(2000);
+
+// 仍被租用的帧槽数
+inline size_t LeasedSlotCount(const std::vector<std::unique_ptr<FrameSlot>>& slots) {
+    size_t leased = 0;
+    for (const std::unique_ptr<FrameSlot>& slot : slots) {
+        if (slot->lease_count.load(std::memory_order_acquire) > 0) {
+            ++leased;
+        }
+    }
+    return leased;
+}
+
+// 等待租约全部归还，最多等待timeout；返回仍被租用的帧槽数
+inline size_t WaitForLeases(const std::vector<std::unique_ptr<FrameSlot>>& slots, std::chrono::milliseconds timeout) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+    size_t leased = LeasedSlotCount(slots);
+    while (leased > 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        leased = LeasedSlotCount(slots);
+    }
+    return leased;
+}
+
+// 把仍被租用的帧槽从slots中移出并故意泄漏：断开回收方，持有者之后释放租约时不会访问已关闭的所有者。
+// 帧槽引用的帧内存同样不能释放，由调用者按返回的帧槽保留；返回移出的帧槽
+inline std::vector<FrameSlot*> AbandonLeasedSlots(std::vector<std::unique_ptr<FrameSlot>>& slots) {
+    std::vector<FrameSlot*> abandoned;
+    std::vector<std::unique_ptr<FrameSlot>> kept;
+    for (std::unique_ptr<FrameSlot>& slot : slots) {
+        slot->recycler.store(nullptr, std::memory_order_release);
+        if (slot->lease_count.load(std::memory_order_acquire) > 0) {
+            abandoned.push_back(slot.release());
+        } else {
+            kept.push_back(std::move(slot));
+        }
+    }
+    slots.swap(kept);
+    return abandoned;
+}
+
+} // namespace cinepi
+
+#endif // FRAME_LEASE_H
@@ -0,0 +1,198 @@
+// frame_pool.cpp
+// 预分配帧内存池实现
+
+#include "frame_pool.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+
+namespace cinepi {
+
+FramePool::FramePool() : frame_bytes_(0) {
+}
+
+FramePool::~FramePool() {
+    Free();
+}
+
+uint8_t* FramePool::allocateFrame(size_t bytes) {
+    void* data = nullptr;
+    if (posix_memalign(&data, ALIGNMENT, bytes) != 0) {
+        throw std::bad_alloc();
+    }
+    return static_cast<uint8_t*>(data);
+}
+
+void FramePool::freeFrame(uint8_t* data, size_t) {
+    std::free(data);
+}
+
+void FramePool::Allocate(size_t count, size_t frame_bytes) {
+    // 帧大小按页对齐，整帧写入时满足直接I/O的长度要求
+    size_t bytes = (frame_bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    if (count == slots_.size() && bytes == frame_bytes_) {
+        return;
+    }
+
+    // 编码线程或代理旁路仍持有的帧不能随旧内存一起释放
+    size_t outstanding = 0;
+    {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        outstanding = slots_.size() - free_slots_.size();
+    }
+    if (outstanding > 0) {
+        throw std::runtime_error("仍有" + std::to_string(outstanding) + "帧未归还，无法重新分配帧内存池");
+    }
+
+    Free();
+    if (count == 0 || bytes == 0) {
+        return;
+    }
+
+    try {
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t* data = allocateFrame(bytes);
+            buffers_.push_back(data);
+
+            std::unique_ptr<FrameSlot> slot(new FrameSlot());
+            slot->recycler = this;
+            slot->cookie = data;
+            slots_.push_back(std::move(slot));
+        }
+    } catch (...) {
+        frame_bytes_ = bytes;
+        Free();
+        throw std::runtime_error("无法分配帧内存池: " + std::to_string(count) + " x " + std::to_string(bytes) + " 字节");
+    }
+
+    frame_bytes_ = bytes;
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    free_slots_.clear();
+    for (const std::unique_ptr<FrameSlot>& slot : slots_) {
+        free_slots_.push_back(slot.get());
+    }
+}
+
+void FramePool::Free() {
+    // 仍被租用的帧（析构时持有者还没归还）连同帧内存故意泄漏，持有者之后归还时不再访问内存池
+    std::vector<FrameSlot*> abandoned = AbandonLeasedSlots(slots_);
+    if (!abandoned.empty()) {
+        std::cerr << "错误: 释放帧内存池时仍有" << abandoned.size() << "帧未归还，保留这些帧不释放" << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        free_slots_.clear();
+    }
+    slots_.clear();
+    for (uint8_t* data : buffers_) {
+        bool leased = std::find_if(abandoned.begin(), abandoned.end(),
+                                   [data](const FrameSlot* slot) { return slot->cookie == data; }) != abandoned.end();
+        if (!leased) {
+            freeFrame(data, frame_bytes_);
+        }
+    }
+    buffers_.clear();
+    frame_bytes_ = 0;
+}
+
+size_t FramePool::FreeCount() const {
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    return free_slots_.size();
+}
+
+FrameSlot* FramePool::takeFreeSlot() {
+    if (free_slots_.empty()) {
+        return nullptr;
+    }
+    FrameSlot* slot = free_slots_.back();
+    free_slots_.pop_back();
+    return slot;
+}
+
+FrameLease FramePool::copyInto(FrameSlot* slot, const CapturedFrame& frame) {
+    // 只保留RAW流，取景流在录制路径上用不到
+    CapturedFrame& copy = slot->frame;
+    copy = frame;
+    copy.viewfinder = FrameView();
+    uint8_t* data = static_cast<uint8_t*>(slot->cookie);
+    copy.raw.size = std::min(frame.raw.size, frame_bytes_);
+    if (frame.raw.data && copy.raw.size > 0) {
+        std::memcpy(data, frame.raw.data, copy.raw.size);
+    }
+    copy.raw.data = data;
+    return FrameLease(slot);
+}
+
+FrameLease FramePool::TryCopy(const CapturedFrame& frame) {
+    FrameSlot* slot;
+    {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        slot = takeFreeSlot();
+    }
+    return slot ? copyInto(slot, frame) : FrameLease();
+}
+
+FrameLease FramePool::CopyWait(const CapturedFrame& frame, std::chrono::milliseconds timeout) {
+    FrameSlot* slot;
+    {
+        std::unique_lock<std::mutex> lock(free_mutex_);
+        free_cv_.wait_for(lock, timeout, [this] { return !free_slots_.empty(); });
+        slot = takeFreeSlot();
+    }
+    return slot ? copyInto(slot, frame) : FrameLease();
+}
+
+void FramePool::RecycleFrame(FrameSlot* slot) {
+    {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        free_slots_.push_back(slot);
+    }
+    free_cv_.notify_one();
+}
+
+LockedFramePool::LockedFramePool() : lock_failures_(0) {
+}
+
+LockedFramePool::~LockedFramePool() {
+    // 基类析构时虚函数已不再分派到派生类，这里先释放
+    Free();
+}
+
+uint8_t* LockedFramePool::allocateFrame(size_t bytes) {
+    uint8_t* data = FramePool::allocateFrame(bytes);
+    if (mlock(data, bytes) != 0) {
+        if (lock_failures_++ == 0) {
+            std::cerr << "警告: 无法锁定帧内存（" << std::strerror(errno) << "），可用 ulimit -l unlimited 提高限制" << std::endl;
+        }
+        // 未锁定时也先写一遍，避免采集线程第一次复制时缺页
+        std::memset(data, 0, bytes);
+    }
+    return data;
+}
+
+void LockedFramePool::freeFrame(uint8_t* data, size_t bytes) {
+    munlock(data, bytes);
+    FramePool::freeFrame(data, bytes);
+}
+
+uint64_t AvailableMemoryBytes() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    uint64_t value = 0;
+    std::string unit;
+    while (meminfo >> key >> value >> unit) {
+        if (key == "MemAvailable:") {
+            return value * 1024;
+        }
+    }
+    return 0;
+}
+
+} // namespace cinepi
@@ -0,0 +1,92 @@
+// frame_pool.h
+// 预分配的帧内存池
+//
+// 传感器缓冲数量很少（每个流6个），不能长时间被录制队列占用。
+// 录制时把RAW数据复制到池中的帧（页对齐，可直接用于O_DIRECT），
+// 立即归还传感器缓冲；池中的帧同样以租约形式传递，最后一个持有者释放后回到空闲列表。
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "frame_lease.h"
+
+namespace cinepi {
+
+class FramePool : public FrameRecycler {
+public:
+    // 帧内存对齐（页大小）
+    static constexpr size_t ALIGNMENT = 4096;
+
+    FramePool();
+    ~FramePool() override;
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // 分配count帧，每帧至少frame_bytes字节；数量和大小不变时保留已有内存。
+    // 需要重新分配而仍有未归还的帧时抛出异常，已有内存不变
+    void Allocate(size_t count, size_t frame_bytes);
+
+    // 释放全部内存；仍未归还的帧连同其内存保留不释放（打印错误）
+    void Free();
+
+    // 把一帧的元数据和RAW数据复制到空闲帧；没有空闲帧时返回无效租约
+    FrameLease TryCopy(const CapturedFrame& frame);
+
+    // 同上，但最多等待timeout
+    FrameLease CopyWait(const CapturedFrame& frame, std::chrono::milliseconds timeout);
+
+    size_t Count() const { return slots_.size(); }
+    size_t FrameBytes() const { return frame_bytes_; }
+    size_t FreeCount() const;
+
+protected:
+    // 分配/释放单帧内存，派生类可以改变内存属性（例如锁定到物理内存）
+    virtual uint8_t* allocateFrame(size_t bytes);
+    virtual void freeFrame(uint8_t* data, size_t bytes);
+
+private:
+    std::vector<std::unique_ptr<FrameSlot>> slots_;
+    std::vector<uint8_t*> buffers_;
+    size_t frame_bytes_;
+
+    mutable std::mutex free_mutex_;
+    std::condition_variable free_cv_;
+    std::vector<FrameSlot*> free_slots_;
+
+    FrameSlot* takeFreeSlot();
+    FrameLease copyInto(FrameSlot* slot, const CapturedFrame& frame);
+    void RecycleFrame(FrameSlot* slot) override;
+};
+
+// 锁定到物理内存的帧池：录制队列和预卷缓冲不能被换出，否则采集线程复制时会缺页阻塞。
+// 超出RLIMIT_MEMLOCK时只打印一次警告并退回普通内存，页面在分配时预先写入
+class LockedFramePool : public FramePool {
+public:
+    LockedFramePool();
+    ~LockedFramePool() override;
+
+    // 是否所有帧都已锁定
+    bool IsLocked() const { return lock_failures_ == 0; }
+
+protected:
+    uint8_t* allocateFrame(size_t bytes) override;
+    void freeFrame(uint8_t* data, size_t bytes) override;
+
+private:
+    size_t lock_failures_;
+};
+
+// 系统当前可用内存（/proc/meminfo的MemAvailable，字节），无法读取时返回0
+uint64_t AvailableMemoryBytes();
+
+} // namespace cinepi
+
+#endif // FRAME_POOL_H
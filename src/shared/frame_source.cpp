@@ -0,0 +1,102 @@
+// frame_source.cpp
+// 帧来源基类与工厂
+
+#include "frame_source.h"
+#include <iostream>
+#include <stdexcept>
+#include "replay_frame_source.h"
+#include "synthetic_frame_source.h"
+#ifdef CINEPI_HAVE_LIBCAMERA
+#include "libcamera_frame_source.h"
+#endif
+
+namespace cinepi {
+
+FrameSource::FrameSource()
+    : has_pending_controls_(false),
+      starvation_events_(0),
+      capture_frames_(0),
+      capture_total_ns_(0),
+      capture_max_ns_(0),
+      capture_last_ns_(0) {
+}
+
+void FrameSource::deliverFrame(const FrameLease& lease, std::chrono::steady_clock::time_point start_time) {
+    try {
+        if (handler_) {
+            handler_(lease);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "处理帧时发生异常: " << e.what() << std::endl;
+    }
+
+    // 记录本帧耗时
+    uint64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+    capture_frames_.fetch_add(1, std::memory_order_relaxed);
+    capture_total_ns_.fetch_add(elapsed_ns, std::memory_order_relaxed);
+    capture_last_ns_.store(elapsed_ns, std::memory_order_relaxed);
+    if (elapsed_ns > capture_max_ns_.load(std::memory_order_relaxed)) {
+        capture_max_ns_.store(elapsed_ns, std::memory_order_relaxed);
+    }
+}
+
+void FrameSource::reportStarvation() {
+    uint64_t events = starvation_events_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (events == 1 || events % 100 == 0) {
+        std::cerr << "警告: 所有帧缓冲均被租用，" << Name() << "无可用缓冲 (" << events << "次)" << std::endl;
+    }
+}
+
+void FrameSource::Reconfigure(const CameraParams& params) {
+    Close();
+    Open(params);
+}
+
+void FrameSource::SetControls(const ControlSettings& controls) {
+    std::lock_guard<std::mutex> lock(controls_mutex_);
+    pending_controls_ = controls;
+    has_pending_controls_.store(true, std::memory_order_release);
+}
+
+bool FrameSource::takePendingControls(ControlSettings& controls) {
+    // 绝大多数帧没有新参数，先无锁检查
+    if (!has_pending_controls_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(controls_mutex_);
+    if (!has_pending_controls_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    controls = pending_controls_;
+    has_pending_controls_.store(false, std::memory_order_relaxed);
+    return true;
+}
+
+CaptureTimingStats FrameSource::GetCaptureTiming() const {
+    CaptureTimingStats stats;
+    stats.frames = capture_frames_.load(std::memory_order_relaxed);
+    uint64_t total_ns = capture_total_ns_.load(std::memory_order_relaxed);
+    stats.average_us = stats.frames > 0 ? total_ns / 1000.0 / stats.frames : 0.0;
+    stats.max_us = capture_max_ns_.load(std::memory_order_relaxed) / 1000.0;
+    stats.last_us = capture_last_ns_.load(std::memory_order_relaxed) / 1000.0;
+    return stats;
+}
+
+std::unique_ptr<FrameSource> CreateFrameSource(const CameraParams& params) {
+    switch (params.source) {
+        case FrameSourceType::Synthetic:
+            return std::unique_ptr<FrameSource>(new SyntheticFrameSource());
+        case FrameSourceType::Replay:
+            return std::unique_ptr<FrameSource>(new ReplayFrameSource());
+        case FrameSourceType::Libcamera:
+        default:
+#ifdef CINEPI_HAVE_LIBCAMERA
+            return std::unique_ptr<FrameSource>(new LibcameraFrameSource());
+#else
+            throw std::runtime_error("未启用libcamera支持，请使用 --source synthetic 或 replay:<文件>");
+#endif
+    }
+}
+
+} // namespace cinepi
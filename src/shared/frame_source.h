@@ -0,0 +1,122 @@
+// frame_source.h
+// 帧来源抽象：libcamera传感器、合成图案或文件回放
+//
+// 帧来源负责缓冲池和帧的产生，每帧以租约形式交给处理函数；
+// CameraController只依赖这个接口，因此在没有传感器的机器上也能完整运行。
+
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "camera_params.h"
+#include "frame_lease.h"
+#include "frame_types.h"
+
+namespace cinepi {
+
+// 采集回调耗时统计
+struct CaptureTimingStats {
+    uint64_t frames;
+    double average_us;
+    double max_us;
+    double last_us;
+};
+
+// 帧租约统计
+struct FrameLeaseStats {
+    int pool_size;              // 缓冲池大小
+    int queued;                 // 等待填充的缓冲数
+    int leased;                 // 被消费者持有的帧数
+    uint64_t starvation_events; // 无可用缓冲的次数（全部被租出）
+};
+
+// 传感器控制参数；每次修改generation递增，帧上记录拍摄时使用的代数
+struct ControlSettings {
+    uint64_t generation;
+    float exposure_compensation;
+    int iso;
+    int white_balance;      // 色温（K）
+    int fps;
+
+    ControlSettings() : generation(0), exposure_compensation(0.0f), iso(100), white_balance(4000), fps(30) {}
+};
+
+// 帧来源基类
+class FrameSource {
+public:
+    using FrameHandler = std::function<void(const FrameLease&)>;
+
+    FrameSource();
+    virtual ~FrameSource() = default;
+
+    // 来源名称，用于日志
+    virtual const char* Name() const = 0;
+
+    // 打开设备、配置流并分配缓冲
+    virtual void Open(const CameraParams& params) = 0;
+
+    // 开始/停止产生帧
+    virtual void Start() = 0;
+    virtual void Stop() = 0;
+
+    // 释放设备和缓冲
+    virtual void Close() = 0;
+
+    // 在停止状态下按新参数重新配置；默认关闭后重新打开
+    virtual void Reconfigure(const CameraParams& params);
+
+    // RAW流格式
+    virtual FrameFormat GetRawFormat() const = 0;
+
+    // 每帧RAW数据的字节数（步长×高度，含行尾填充）
+    virtual size_t GetRawFrameBytes() const = 0;
+
+    // RAW数据的黑电平，未知（合成图案、回放）时为0
+    virtual int GetBlackLevel() const { return 0; }
+
+    // 缓冲池状态
+    virtual FrameLeaseStats GetLeaseStats() const = 0;
+
+    // 设置帧处理函数，需在Start之前设置；在来源的线程中调用
+    void SetFrameHandler(FrameHandler handler) { handler_ = std::move(handler); }
+
+    // 每帧处理耗时（从帧完成到处理函数返回）
+    CaptureTimingStats GetCaptureTiming() const;
+
+    // 提交控制参数；尚未发送的旧参数直接被覆盖，每帧最多发送一组（线程安全）
+    void SetControls(const ControlSettings& controls);
+
+protected:
+    // 取出待发送的控制参数，没有新参数时返回false
+    bool takePendingControls(ControlSettings& controls);
+
+    // 把一帧交给处理函数并记录耗时
+    void deliverFrame(const FrameLease& lease, std::chrono::steady_clock::time_point start_time);
+
+    // 记录一次缓冲耗尽
+    void reportStarvation();
+
+    uint64_t starvationEvents() const { return starvation_events_.load(std::memory_order_relaxed); }
+
+private:
+    FrameHandler handler_;
+    std::mutex controls_mutex_;
+    ControlSettings pending_controls_;
+    std::atomic<bool> has_pending_controls_;
+    std::atomic<uint64_t> starvation_events_;
+    std::atomic<uint64_t> capture_frames_;
+    std::atomic<uint64_t> capture_total_ns_;
+    std::atomic<uint64_t> capture_max_ns_;
+    std::atomic<uint64_t> capture_last_ns_;
+};
+
+// 根据参数创建帧来源
+std::unique_ptr<FrameSource> CreateFrameSource(const CameraParams& params);
+
+} // namespace cinepi
+
+#endif // FRAME_SOURCE_H
@@ -0,0 +1,167 @@
+// frame_stats.cpp
+// 帧时序统计实现
+
+#include "frame_stats.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+
+namespace cinepi {
+
+FrameStats::FrameStats() {
+    Reset(30);
+}
+
+void FrameStats::resetWindow(LatencyWindow& window) {
+    window.samples.assign(LATENCY_WINDOW_SIZE, 0);
+    window.next = 0;
+    window.count = 0;
+}
+
+void FrameStats::addSample(LatencyWindow& window, int64_t value) {
+    window.samples[window.next] = value;
+    window.next = (window.next + 1) % window.samples.size();
+    window.count = std::min(window.count + 1, window.samples.size());
+}
+
+LatencyPercentiles FrameStats::percentiles(const LatencyWindow& window) {
+    LatencyPercentiles result = { window.count, 0.0, 0.0, 0.0, 0.0 };
+    if (window.count == 0) {
+        return result;
+    }
+
+    std::vector<int64_t> sorted(window.samples.begin(), window.samples.begin() + window.count);
+    std::sort(sorted.begin(), sorted.end());
+    auto at = [&sorted](double fraction) {
+        size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+        return sorted[index] / 1e6;
+    };
+    result.p50_ms = at(0.50);
+    result.p95_ms = at(0.95);
+    result.p99_ms = at(0.99);
+    result.max_ms = sorted.back() / 1e6;
+    return result;
+}
+
+void FrameStats::Reset(int fps) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    nominal_interval_ns_ = 1000000000LL / std::max(fps, 1);
+    frames_ = 0;
+    dropped_frames_ = 0;
+    sequence_resets_ = 0;
+    has_last_ = false;
+    last_sequence_ = 0;
+    last_timestamp_ns_ = 0;
+    interval_total_ns_ = 0;
+    interval_count_ = 0;
+    max_jitter_ns_ = 0;
+    std::fill(jitter_histogram_, jitter_histogram_ + JITTER_BUCKET_COUNT, 0);
+    resetWindow(display_latency_);
+    resetWindow(disk_latency_);
+}
+
+void FrameStats::RecordFrame(uint32_t sequence, int64_t sensor_timestamp_ns) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++frames_;
+
+    if (has_last_) {
+        if (sequence > last_sequence_) {
+            // 序号跳过的帧即传感器已曝光但没有交付的帧
+            uint32_t gap = sequence - last_sequence_ - 1;
+            dropped_frames_ += gap;
+
+            // 丢帧造成的间隔按理论帧数扣除，只统计剩余的抖动
+            if (sensor_timestamp_ns > 0 && last_timestamp_ns_ > 0) {
+                int64_t interval = sensor_timestamp_ns - last_timestamp_ns_;
+                interval_total_ns_ += interval / (gap + 1);
+                ++interval_count_;
+
+                int64_t jitter = std::llabs(interval - nominal_interval_ns_ * (gap + 1));
+                max_jitter_ns_ = std::max(max_jitter_ns_, jitter);
+                size_t bucket = 0;
+                while (bucket < JITTER_BUCKET_COUNT - 1 && jitter > JITTER_BUCKET_LIMITS_US[bucket] * 1000LL) {
+                    ++bucket;
+                }
+                ++jitter_histogram_[bucket];
+            }
+        } else {
+            ++sequence_resets_;
+        }
+    }
+
+    has_last_ = true;
+    last_sequence_ = sequence;
+    last_timestamp_ns_ = sensor_timestamp_ns;
+}
+
+void FrameStats::RecordDisplayLatency(int64_t latency_ns) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    addSample(display_latency_, latency_ns);
+}
+
+void FrameStats::RecordDiskLatency(int64_t latency_ns) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    addSample(disk_latency_, latency_ns);
+}
+
+FrameStatsSnapshot FrameStats::Snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FrameStatsSnapshot snapshot;
+    snapshot.frames = frames_;
+    snapshot.dropped_frames = dropped_frames_;
+    snapshot.sequence_resets = sequence_resets_;
+    snapshot.nominal_interval_ms = nominal_interval_ns_ / 1e6;
+    snapshot.mean_interval_ms = interval_count_ > 0 ? interval_total_ns_ / 1e6 / interval_count_ : 0.0;
+    snapshot.max_jitter_ms = max_jitter_ns_ / 1e6;
+    std::copy(jitter_histogram_, jitter_histogram_ + JITTER_BUCKET_COUNT, snapshot.jitter_histogram);
+    snapshot.display_latency = percentiles(display_latency_);
+    snapshot.disk_latency = percentiles(disk_latency_);
+    return snapshot;
+}
+
+namespace {
+
+void writeLatency(std::ofstream& out, const char* name, const LatencyPercentiles& latency) {
+    out << "  \"" << name << "\": { \"samples\": " << latency.samples
+        << ", \"p50_ms\": " << latency.p50_ms << ", \"p95_ms\": " << latency.p95_ms
+        << ", \"p99_ms\": " << latency.p99_ms << ", \"max_ms\": " << latency.max_ms << " }";
+}
+
+} // namespace
+
+bool FrameStats::WriteJson(const std::string& path) const {
+    FrameStatsSnapshot snapshot = Snapshot();
+
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\n";
+    out << "  \"frames\": " << snapshot.frames << ",\n";
+    out << "  \"dropped_frames\": " << snapshot.dropped_frames << ",\n";
+    out << "  \"sequence_resets\": " << snapshot.sequence_resets << ",\n";
+    out << "  \"nominal_interval_ms\": " << snapshot.nominal_interval_ms << ",\n";
+    out << "  \"mean_interval_ms\": " << snapshot.mean_interval_ms << ",\n";
+    out << "  \"max_jitter_ms\": " << snapshot.max_jitter_ms << ",\n";
+    out << "  \"jitter_histogram\": [";
+    for (size_t i = 0; i < JITTER_BUCKET_COUNT; ++i) {
+        out << (i ? ", " : "") << "{ \"le_us\": ";
+        if (i < JITTER_BUCKET_COUNT - 1) {
+            out << JITTER_BUCKET_LIMITS_US[i];
+        } else {
+            out << "null";
+        }
+        out << ", \"count\": " << snapshot.jitter_histogram[i] << " }";
+    }
+    out << "],\n";
+    writeLatency(out, "display_latency", snapshot.display_latency);
+    out << ",\n";
+    writeLatency(out, "disk_latency", snapshot.disk_latency);
+    out << "\n}\n";
+    return static_cast<bool>(out);
+}
+
+} // namespace cinepi
@@ -0,0 +1,95 @@
+// frame_stats.h
+// 帧时序统计：序号间隙丢帧、帧间隔抖动直方图、采集到显示/落盘的延迟分位数
+//
+// 采集线程每帧调用RecordFrame，UI线程和写入线程分别记录显示和落盘延迟；
+// 帧率只有几十fps，统一用一把锁保护，读取时取快照。
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cinepi {
+
+// 抖动直方图分档上限（微秒），最后一档为超过最大上限
+const int JITTER_BUCKET_LIMITS_US[] = { 100, 250, 500, 1000, 2000, 5000, 10000 };
+const size_t JITTER_BUCKET_COUNT = sizeof(JITTER_BUCKET_LIMITS_US) / sizeof(JITTER_BUCKET_LIMITS_US[0]) + 1;
+
+// 延迟分位数（毫秒）
+struct LatencyPercentiles {
+    size_t samples;
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+    double max_ms;
+};
+
+// 统计快照
+struct FrameStatsSnapshot {
+    uint64_t frames;
+    uint64_t dropped_frames;        // 由序号间隙推算
+    uint64_t sequence_resets;       // 序号回退（重新启动或重新配置）
+    double nominal_interval_ms;     // 按帧率计算的理论帧间隔
+    double mean_interval_ms;
+    double max_jitter_ms;           // 帧间隔与理论值之差的最大绝对值
+    uint64_t jitter_histogram[JITTER_BUCKET_COUNT];
+    LatencyPercentiles display_latency;  // 传感器时间戳到画面呈现
+    LatencyPercentiles disk_latency;     // 传感器时间戳到写入完成
+};
+
+class FrameStats {
+public:
+    FrameStats();
+
+    // 清空统计并设置理论帧率
+    void Reset(int fps);
+
+    // 采集线程：记录一帧的传感器序号和时间戳（单调时钟纳秒）
+    void RecordFrame(uint32_t sequence, int64_t sensor_timestamp_ns);
+
+    // 记录采集到显示、采集到落盘的延迟
+    void RecordDisplayLatency(int64_t latency_ns);
+    void RecordDiskLatency(int64_t latency_ns);
+
+    FrameStatsSnapshot Snapshot() const;
+
+    // 写出JSON，失败时返回false
+    bool WriteJson(const std::string& path) const;
+
+private:
+    // 最近若干个延迟样本的环形窗口
+    struct LatencyWindow {
+        std::vector<int64_t> samples;
+        size_t next;
+        size_t count;
+    };
+
+    static constexpr size_t LATENCY_WINDOW_SIZE = 1024;
+
+    mutable std::mutex mutex_;
+    int64_t nominal_interval_ns_;
+    uint64_t frames_;
+    uint64_t dropped_frames_;
+    uint64_t sequence_resets_;
+    bool has_last_;
+    uint32_t last_sequence_;
+    int64_t last_timestamp_ns_;
+    int64_t interval_total_ns_;
+    uint64_t interval_count_;
+    int64_t max_jitter_ns_;
+    uint64_t jitter_histogram_[JITTER_BUCKET_COUNT];
+    LatencyWindow display_latency_;
+    LatencyWindow disk_latency_;
+
+    static void resetWindow(LatencyWindow& window);
+    static void addSample(LatencyWindow& window, int64_t value);
+    static LatencyPercentiles percentiles(const LatencyWindow& window);
+};
+
+} // namespace cinepi
+
+#endif // FRAME_STATS_H
@@ -0,0 +1,96 @@
+// frame_types.h
+// 帧数据描述类型，用于在摄像头、预览和录制模块之间传递帧
+
+#ifndef FRAME_TYPES_H
+#define FRAME_TYPES_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace cinepi {
+
+// 像素编码
+enum class PixelEncoding {
+    Unknown,
+    RGB888,         // libcamera RGB888，内存字节顺序为 B,G,R
+    BayerCsi2p10,   // MIPI CSI-2 10位打包Bayer（4像素5字节）
+    BayerCsi2p12,   // MIPI CSI-2 12位打包Bayer（2像素3字节）
+    Bayer16         // 16位容器Bayer
+};
+
+// Bayer排列顺序（左上角2x2块）
+enum class BayerOrder {
+    RGGB,
+    GRBG,
+    GBRG,
+    BGGR
+};
+
+// 帧格式
+struct FrameFormat {
+    PixelEncoding encoding;
+    BayerOrder bayer_order;
+    int bit_depth;
+    uint32_t fourcc;
+
+    FrameFormat(PixelEncoding enc = PixelEncoding::Unknown, BayerOrder order = BayerOrder::RGGB, int bd = 0, uint32_t fcc = 0)
+        : encoding(enc), bayer_order(order), bit_depth(bd), fourcc(fcc) {}
+
+    bool IsBayer() const {
+        return encoding == PixelEncoding::BayerCsi2p10 ||
+               encoding == PixelEncoding::BayerCsi2p12 ||
+               encoding == PixelEncoding::Bayer16;
+    }
+};
+
+// 单个流的一帧数据视图，不拥有内存
+struct FrameView {
+    const uint8_t* data;
+    size_t size;
+    unsigned int width;
+    unsigned int height;
+    unsigned int stride;
+    FrameFormat format;
+
+    FrameView() : data(nullptr), size(0), width(0), height(0), stride(0) {}
+
+    bool IsValid() const { return data != nullptr && size > 0; }
+};
+
+// 同一个请求产出的一组帧（RAW + 取景流）
+struct CapturedFrame {
+    FrameView raw;
+    FrameView viewfinder;
+    uint32_t sequence;              // 传感器帧序号，出现间隙说明丢帧
+    uint64_t control_generation;    // 拍摄时随请求发送的控制参数代数
+    int64_t sensor_timestamp_ns;    // 传感器时间戳（单调时钟），0表示未知
+    int64_t completion_time_ns;     // 帧交付给应用的时间（单调时钟）
+    int32_t exposure_time_us;       // 实际曝光时间（微秒），0表示未知
+    float analogue_gain;            // 实际模拟增益，0表示未知
+    float colour_gains[2];          // 红/蓝增益（相对绿通道），0表示未知
+
+    CapturedFrame() : sequence(0), control_generation(0), sensor_timestamp_ns(0), completion_time_ns(0),
+                      exposure_time_us(0), analogue_gain(0.0f), colour_gains{ 0.0f, 0.0f } {}
+};
+
+// 单调时钟当前时间（纳秒），与libcamera的SensorTimestamp同源（CLOCK_MONOTONIC）
+inline int64_t MonotonicNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 像素编码名称，用于日志
+inline const char* PixelEncodingName(PixelEncoding encoding) {
+    switch (encoding) {
+        case PixelEncoding::RGB888:       return "RGB888";
+        case PixelEncoding::BayerCsi2p10: return "Bayer10_CSI2P";
+        case PixelEncoding::BayerCsi2p12: return "Bayer12_CSI2P";
+        case PixelEncoding::Bayer16:      return "Bayer16";
+        default:                          return "Unknown";
+    }
+}
+
+} // namespace cinepi
+
+#endif // FRAME_TYPES_H
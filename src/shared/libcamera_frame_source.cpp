@@ -0,0 +1,606 @@
+// libcamera_frame_source.cpp
+// 基于libcamera的帧来源实现
+
+#include "libcamera_frame_source.h"
+#include "bit_pack.h"
+#include "sensor_profile.h"
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <libcamera/control_ids.h>
+#include <libcamera/formats.h>
+#include <sys/mman.h>
+
+namespace cinepi {
+
+namespace {
+
+// 每个流的缓冲数量：预览最多占用两个，其余供录制/分析租用和相机填充
+const unsigned int STREAM_BUFFER_COUNT = 6;
+
+// libcamera像素格式到帧格式的映射
+struct FormatMapping {
+    const libcamera::PixelFormat* pixel_format;
+    PixelEncoding encoding;
+    BayerOrder bayer_order;
+    int bit_depth;
+};
+
+const FormatMapping FORMAT_MAPPINGS[] = {
+    { &libcamera::formats::RGB888,        PixelEncoding::RGB888,       BayerOrder::RGGB, 8 },
+    { &libcamera::formats::SRGGB12_CSI2P, PixelEncoding::BayerCsi2p12, BayerOrder::RGGB, 12 },
+    { &libcamera::formats::SGRBG12_CSI2P, PixelEncoding::BayerCsi2p12, BayerOrder::GRBG, 12 },
+    { &libcamera::formats::SGBRG12_CSI2P, PixelEncoding::BayerCsi2p12, BayerOrder::GBRG, 12 },
+    { &libcamera::formats::SBGGR12_CSI2P, PixelEncoding::BayerCsi2p12, BayerOrder::BGGR, 12 },
+    { &libcamera::formats::SRGGB10_CSI2P, PixelEncoding::BayerCsi2p10, BayerOrder::RGGB, 10 },
+    { &libcamera::formats::SGRBG10_CSI2P, PixelEncoding::BayerCsi2p10, BayerOrder::GRBG, 10 },
+    { &libcamera::formats::SGBRG10_CSI2P, PixelEncoding::BayerCsi2p10, BayerOrder::GBRG, 10 },
+    { &libcamera::formats::SBGGR10_CSI2P, PixelEncoding::BayerCsi2p10, BayerOrder::BGGR, 10 },
+    { &libcamera::formats::SRGGB16,       PixelEncoding::Bayer16,      BayerOrder::RGGB, 16 },
+    { &libcamera::formats::SGRBG16,       PixelEncoding::Bayer16,      BayerOrder::GRBG, 16 },
+    { &libcamera::formats::SGBRG16,       PixelEncoding::Bayer16,      BayerOrder::GBRG, 16 },
+    { &libcamera::formats::SBGGR16,       PixelEncoding::Bayer16,      BayerOrder::BGGR, 16 },
+};
+
+FrameFormat toFrameFormat(const libcamera::PixelFormat& format) {
+    for (const FormatMapping& mapping : FORMAT_MAPPINGS) {
+        if (*mapping.pixel_format == format) {
+            return FrameFormat(mapping.encoding, mapping.bayer_order, mapping.bit_depth, format.fourcc());
+        }
+    }
+    return FrameFormat(PixelEncoding::Unknown, BayerOrder::RGGB, 0, format.fourcc());
+}
+
+} // namespace
+
+LibcameraFrameSource::LibcameraFrameSource()
+    : camera_manager_(nullptr),
+      camera_(nullptr),
+      config_(nullptr),
+      allocator_(nullptr),
+      stream_(nullptr),
+      raw_stream_(nullptr),
+      queued_requests_(0),
+      sent_generation_(0),
+      is_acquired_(false),
+      is_running_(false) {
+}
+
+LibcameraFrameSource::~LibcameraFrameSource() {
+    Close();
+}
+
+void LibcameraFrameSource::Open(const CameraParams& params) {
+    params_ = params;
+
+    try {
+        // 初始化相机管理器
+        camera_manager_.reset(new libcamera::CameraManager());
+        if (camera_manager_->start()) {
+            throw std::runtime_error("相机管理器初始化失败");
+        }
+
+        // 获取相机列表
+        auto cameras = camera_manager_->cameras();
+        if (cameras.empty()) {
+            throw std::runtime_error("未找到相机");
+        }
+
+        // 获取第一个相机
+        camera_ = cameras[0];
+        std::cout << "使用相机: " << camera_->id() << std::endl;
+
+        // 激活相机
+        if (camera_->acquire()) {
+            throw std::runtime_error("相机获取失败");
+        }
+        is_acquired_ = true;
+
+        // 配置流并分配缓冲
+        configureStreams();
+    } catch (const std::exception& e) {
+        Close();
+        throw;
+    }
+}
+
+void LibcameraFrameSource::Reconfigure(const CameraParams& params) {
+    if (!camera_) {
+        Open(params);
+        return;
+    }
+    if (is_running_) {
+        throw std::runtime_error("相机运行中，无法重新配置");
+    }
+    if (outstandingLeases() > 0) {
+        throw std::runtime_error("仍有帧租约未释放，无法重新配置");
+    }
+
+    // 复用相机管理器和已获取的相机，只重新配置流
+    params_ = params;
+    configureStreams();
+}
+
+void LibcameraFrameSource::configureStreams() {
+    // RAW预览时不需要ISP输出取景流，只配置RAW流
+    bool want_viewfinder = !params_.raw_preview;
+    std::vector<libcamera::StreamRole> roles;
+    if (want_viewfinder) {
+        roles.push_back(libcamera::StreamRole::Viewfinder);
+    }
+    roles.push_back(libcamera::StreamRole::Raw);
+
+    // 生成相机配置
+    std::unique_ptr<libcamera::CameraConfiguration> config = camera_->generateConfiguration(roles);
+    if (!config || config->size() < roles.size()) {
+        throw std::runtime_error("相机配置无效");
+    }
+    size_t raw_index = roles.size() - 1;
+
+    // 配置预览流
+    libcamera::StreamConfiguration* viewfinder_config = nullptr;
+    if (want_viewfinder) {
+        viewfinder_config = &config->at(0);
+        viewfinder_config->size = libcamera::Size(params_.PreviewWidth(), params_.PreviewHeight());
+        viewfinder_config->pixelFormat = libcamera::formats::RGB888;
+        viewfinder_config->bufferCount = STREAM_BUFFER_COUNT;
+    }
+
+    // 配置RAW流
+    libcamera::StreamConfiguration &raw_config = config->at(raw_index);
+    configureRawStream(raw_config);
+
+    // 校验配置，驱动可能会调整尺寸、格式或步长
+    libcamera::CameraConfiguration::Status status = config->validate();
+    if (status == libcamera::CameraConfiguration::Invalid) {
+        throw std::runtime_error("相机配置无效");
+    }
+    if (status == libcamera::CameraConfiguration::Adjusted) {
+        std::cout << "相机配置已被调整: " << (viewfinder_config ? viewfinder_config->toString() + ", " : std::string())
+                  << raw_config.toString() << std::endl;
+    }
+
+    // 与当前配置相同时不做任何事；取景流的有无变化时两个流都重建
+    bool had_viewfinder = config_ && config_->size() > 1;
+    bool layout_changed = !config_ || had_viewfinder != want_viewfinder;
+    bool viewfinder_changed = layout_changed || (want_viewfinder && !sameStreamConfig(config_->at(0), *viewfinder_config));
+    bool raw_changed = layout_changed || !sameStreamConfig(config_->at(config_->size() - 1), raw_config);
+    if (!viewfinder_changed && !raw_changed) {
+        std::cout << "相机配置未变化，保留现有缓冲" << std::endl;
+        return;
+    }
+
+    // 请求引用旧缓冲，需要重建；只释放配置发生变化的流的缓冲
+    releaseRequests();
+    if (allocator_) {
+        if (viewfinder_changed && stream_) {
+            unmapStream(stream_);
+            allocator_->free(stream_);
+        }
+        if (raw_changed && raw_stream_) {
+            unmapStream(raw_stream_);
+            allocator_->free(raw_stream_);
+        }
+    }
+
+    // 配置相机
+    if (camera_->configure(config.get())) {
+        throw std::runtime_error("相机配置失败");
+    }
+    config_ = std::move(config);
+
+    // 获取预览流和RAW流；流对象发生变化时也需要重新分配
+    libcamera::Stream* new_stream = want_viewfinder ? config_->at(0).stream() : nullptr;
+    libcamera::Stream* new_raw_stream = config_->at(raw_index).stream();
+    viewfinder_changed = viewfinder_changed || new_stream != stream_;
+    raw_changed = raw_changed || new_raw_stream != raw_stream_;
+    stream_ = new_stream;
+    raw_stream_ = new_raw_stream;
+
+    const libcamera::StreamConfiguration& configured_raw = config_->at(raw_index);
+    raw_format_ = toFrameFormat(configured_raw.pixelFormat);
+    if (!raw_format_.IsBayer()) {
+        throw std::runtime_error("RAW流格式不受支持: " + configured_raw.pixelFormat.toString());
+    }
+    std::cout << "RAW流: " << configured_raw.size.width << "x" << configured_raw.size.height
+              << " " << configured_raw.pixelFormat.toString()
+              << " 步长 " << configured_raw.stride << (stream_ ? "" : "（无取景流）") << std::endl;
+
+    // 创建帧缓冲分配器，两个流各自分配缓冲
+    if (!allocator_) {
+        allocator_.reset(new libcamera::FrameBufferAllocator(camera_));
+    }
+    if (viewfinder_changed && stream_ && allocator_->allocate(stream_) < 0) {
+        throw std::runtime_error("帧缓冲分配失败");
+    }
+    if (raw_changed && allocator_->allocate(raw_stream_) < 0) {
+        throw std::runtime_error("RAW帧缓冲分配失败");
+    }
+
+    // 映射新分配的帧缓冲，未变化的流沿用原映射
+    mapBuffers();
+}
+
+bool LibcameraFrameSource::sameStreamConfig(const libcamera::StreamConfiguration& a, const libcamera::StreamConfiguration& b) {
+    return a.size == b.size && a.pixelFormat == b.pixelFormat && a.stride == b.stride && a.bufferCount == b.bufferCount;
+}
+
+void LibcameraFrameSource::configureRawStream(libcamera::StreamConfiguration& raw_config) {
+    // 优先选择与位深度匹配的CSI-2打包格式（传感器原生格式），否则退回16位容器格式
+    PixelEncoding wanted = PackedEncodingForBitDepth(params_.bit_depth);
+    libcamera::PixelFormat fallback;
+    bool found = false;
+
+    for (const libcamera::PixelFormat& format : raw_config.formats().pixelformats()) {
+        PixelEncoding encoding = toFrameFormat(format).encoding;
+        if (encoding == wanted) {
+            raw_config.pixelFormat = format;
+            found = true;
+            break;
+        }
+        if (encoding == PixelEncoding::Bayer16 && !fallback.isValid()) {
+            fallback = format;
+        }
+    }
+
+    if (!found && fallback.isValid()) {
+        std::cerr << "警告: 传感器不支持" << params_.bit_depth << "位打包RAW，使用 " << fallback.toString() << std::endl;
+        raw_config.pixelFormat = fallback;
+    }
+
+    raw_config.size = libcamera::Size(params_.width, params_.height);
+    raw_config.bufferCount = STREAM_BUFFER_COUNT;
+}
+
+void LibcameraFrameSource::Start() {
+    if (!camera_ || is_running_) {
+        return;
+    }
+
+    // 上次运行的帧若仍被租用，不能重建请求
+    if (outstandingLeases() > 0) {
+        throw std::runtime_error("仍有帧租约未释放，无法重新启动");
+    }
+
+    createRequests();
+
+    // 连接请求完成信号
+    camera_->requestCompleted.connect(this, &LibcameraFrameSource::processRequest);
+
+    // 启动控制只打开自动曝光；ISO、曝光补偿、白平衡和帧率随请求发送
+    libcamera::ControlList controls(camera_->controls());
+    controls.set(libcamera::controls::AeEnable, true);
+
+    // 启动相机
+    is_running_ = true;
+    if (camera_->start(&controls) != 0) {
+        is_running_ = false;
+        camera_->requestCompleted.disconnect(this);
+        throw std::runtime_error("相机启动失败");
+    }
+
+    // 发送所有请求，请求对象仍由requests_持有
+    for (std::unique_ptr<libcamera::Request>& request : requests_) {
+        attachControls(request.get());
+        queued_requests_.fetch_add(1, std::memory_order_acq_rel);
+        if (camera_->queueRequest(request.get()) < 0) {
+            queued_requests_.fetch_sub(1, std::memory_order_acq_rel);
+            Stop();
+            throw std::runtime_error("请求发送失败");
+        }
+    }
+}
+
+void LibcameraFrameSource::Stop() {
+    if (!is_running_) {
+        return;
+    }
+    is_running_ = false;
+
+    // 停止相机，未完成的请求会以取消状态返回
+    int ret = camera_->stop();
+
+    // 断开请求完成信号
+    camera_->requestCompleted.disconnect(this);
+    queued_requests_ = 0;
+
+    if (ret != 0) {
+        throw std::runtime_error("相机停止失败");
+    }
+}
+
+void LibcameraFrameSource::Close() {
+    try {
+        Stop();
+    } catch (const std::exception& e) {
+        std::cerr << "停止相机时发生错误: " << e.what() << std::endl;
+    }
+
+    // 消费者仍持有帧时不能释放帧槽和缓冲映射：先等待归还，超时后把这些帧槽连同它们的映射故意泄漏
+    if (WaitForLeases(frame_slots_, LEASE_RELEASE_TIMEOUT) > 0) {
+        std::vector<FrameSlot*> abandoned = AbandonLeasedSlots(frame_slots_);
+        for (FrameSlot* slot : abandoned) {
+            const libcamera::Request* request = static_cast<const libcamera::Request*>(slot->cookie);
+            for (const auto& entry : request->buffers()) {
+                mapped_buffers_.erase(entry.second);
+            }
+            slot->cookie = nullptr;
+        }
+        std::cerr << "错误: 关闭相机时仍有" << abandoned.size() << "个帧租约未释放，保留这些帧和缓冲映射不释放" << std::endl;
+    }
+
+    // 请求和缓冲需先于相机释放
+    releaseRequests();
+    unmapBuffers();
+    allocator_.reset();
+    config_.reset();
+    if (camera_) {
+        if (is_acquired_) {
+            camera_->release();
+            is_acquired_ = false;
+        }
+        camera_.reset();
+    }
+    if (camera_manager_) {
+        camera_manager_->stop();
+        camera_manager_.reset();
+    }
+}
+
+void LibcameraFrameSource::createRequests() {
+    releaseRequests();
+
+    // 获取缓冲列表；没有取景流时（RAW预览）请求只携带RAW缓冲
+    static const std::vector<std::unique_ptr<libcamera::FrameBuffer>> no_buffers;
+    const std::vector<std::unique_ptr<libcamera::FrameBuffer>> &buffers = stream_ ? allocator_->buffers(stream_) : no_buffers;
+    const std::vector<std::unique_ptr<libcamera::FrameBuffer>> &raw_buffers = allocator_->buffers(raw_stream_);
+    if ((stream_ && buffers.empty()) || raw_buffers.empty()) {
+        throw std::runtime_error("没有可用的缓冲");
+    }
+
+    // 每个请求同时携带一个取景缓冲和一个RAW缓冲
+    size_t request_count = stream_ ? std::min(buffers.size(), raw_buffers.size()) : raw_buffers.size();
+    for (size_t i = 0; i < request_count; ++i) {
+        std::unique_ptr<libcamera::Request> request = camera_->createRequest(i);
+        if (!request) {
+            throw std::runtime_error("请求创建失败");
+        }
+        if ((stream_ && request->addBuffer(stream_, buffers[i].get()) < 0) ||
+            request->addBuffer(raw_stream_, raw_buffers[i].get()) < 0) {
+            throw std::runtime_error("请求缓冲设置失败");
+        }
+
+        // 请求对应的帧槽，cookie即槽下标
+        std::unique_ptr<FrameSlot> slot(new FrameSlot());
+        slot->recycler = this;
+        slot->cookie = request.get();
+        frame_slots_.push_back(std::move(slot));
+        requests_.push_back(std::move(request));
+    }
+    request_generations_.assign(requests_.size(), sent_generation_);
+}
+
+void LibcameraFrameSource::releaseRequests() {
+    frame_slots_.clear();
+    requests_.clear();
+    request_generations_.clear();
+}
+
+void LibcameraFrameSource::mapBuffers() {
+    for (libcamera::Stream* stream : { stream_, raw_stream_ }) {
+        if (!stream) {
+            continue;
+        }
+        for (const std::unique_ptr<libcamera::FrameBuffer>& buffer : allocator_->buffers(stream)) {
+            // 已映射的缓冲（配置未变化的流）直接沿用
+            if (mapped_buffers_.count(buffer.get())) {
+                continue;
+            }
+            MappedBuffer& mapped = mapped_buffers_[buffer.get()];
+
+            // 同一个dmabuf上的多个平面只映射一次，长度取各平面末尾的最大值
+            std::unordered_map<int, size_t> fd_lengths;
+            for (const libcamera::FrameBuffer::Plane& plane : buffer->planes()) {
+                size_t& length = fd_lengths[plane.fd.get()];
+                length = std::max(length, static_cast<size_t>(plane.offset) + plane.length);
+            }
+
+            std::unordered_map<int, const uint8_t*> fd_addresses;
+            for (const std::pair<const int, size_t>& entry : fd_lengths) {
+                void* address = mmap(nullptr, entry.second, PROT_READ, MAP_SHARED, entry.first, 0);
+                if (address == MAP_FAILED) {
+                    throw std::runtime_error("帧缓冲映射失败");
+                }
+                mapped.regions.emplace_back(address, entry.second);
+                fd_addresses[entry.first] = static_cast<const uint8_t*>(address);
+            }
+
+            for (const libcamera::FrameBuffer::Plane& plane : buffer->planes()) {
+                mapped.planes.push_back(fd_addresses[plane.fd.get()] + plane.offset);
+            }
+        }
+    }
+}
+
+void LibcameraFrameSource::unmapBuffer(MappedBuffer& mapped) {
+    for (const std::pair<void*, size_t>& region : mapped.regions) {
+        munmap(region.first, region.second);
+    }
+    mapped.regions.clear();
+    mapped.planes.clear();
+}
+
+void LibcameraFrameSource::unmapStream(libcamera::Stream* stream) {
+    for (const std::unique_ptr<libcamera::FrameBuffer>& buffer : allocator_->buffers(stream)) {
+        auto it = mapped_buffers_.find(buffer.get());
+        if (it != mapped_buffers_.end()) {
+            unmapBuffer(it->second);
+            mapped_buffers_.erase(it);
+        }
+    }
+}
+
+void LibcameraFrameSource::unmapBuffers() {
+    for (std::pair<const libcamera::FrameBuffer* const, MappedBuffer>& entry : mapped_buffers_) {
+        unmapBuffer(entry.second);
+    }
+    mapped_buffers_.clear();
+}
+
+bool LibcameraFrameSource::mapFrameView(libcamera::FrameBuffer* buffer, libcamera::Stream* stream, FrameView& view) {
+    // 映射在启动时已建立，这里只做一次查找
+    auto it = mapped_buffers_.find(buffer);
+    if (it == mapped_buffers_.end() || it->second.planes.empty()) {
+        std::cerr << "帧缓冲未映射" << std::endl;
+        return false;
+    }
+
+    const libcamera::StreamConfiguration& stream_config = stream->configuration();
+    view.data = it->second.planes[0];
+    view.size = buffer->planes()[0].length;
+    view.width = stream_config.size.width;
+    view.height = stream_config.size.height;
+    view.stride = stream_config.stride;
+    view.format = stream == raw_stream_ ? raw_format_ : toFrameFormat(stream_config.pixelFormat);
+    return true;
+}
+
+void LibcameraFrameSource::processRequest(libcamera::Request* request) {
+    if (!request) {
+        return;
+    }
+
+    // 请求已离开相机队列；队列为空说明所有缓冲都被租用，相机将无缓冲可填
+    int queued = queued_requests_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+
+    // 请求由requests_持有，这里不释放
+    if (request->status() == libcamera::Request::RequestCancelled) {
+        return;
+    }
+
+    if (queued <= 0) {
+        reportStarvation();
+    }
+
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    FrameSlot* slot = frame_slots_[request->cookie()].get();
+
+    // 帧槽此时未被租用，可以安全改写
+    CapturedFrame& frame = slot->frame;
+    frame = CapturedFrame();
+    frame.sequence = request->sequence();
+    frame.control_generation = request_generations_[request->cookie()];
+    frame.completion_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start_time.time_since_epoch()).count();
+
+    libcamera::FrameBuffer* buffer = stream_ ? request->findBuffer(stream_) : nullptr;
+    libcamera::FrameBuffer* raw_buffer = request->findBuffer(raw_stream_);
+
+    // 传感器序号来自RAW缓冲的元数据，请求序号不反映传感器丢帧
+    if (raw_buffer) {
+        frame.sequence = raw_buffer->metadata().sequence;
+        frame.sensor_timestamp_ns = static_cast<int64_t>(raw_buffer->metadata().timestamp);
+    }
+    std::optional<int64_t> sensor_timestamp = request->metadata().get(libcamera::controls::SensorTimestamp);
+    if (sensor_timestamp) {
+        frame.sensor_timestamp_ns = *sensor_timestamp;
+    }
+
+    // 实际生效的曝光参数，写入录制文件的每帧元数据
+    const libcamera::ControlList& metadata = request->metadata();
+    std::optional<int32_t> exposure_time = metadata.get(libcamera::controls::ExposureTime);
+    if (exposure_time) {
+        frame.exposure_time_us = *exposure_time;
+    }
+    std::optional<float> analogue_gain = metadata.get(libcamera::controls::AnalogueGain);
+    if (analogue_gain) {
+        frame.analogue_gain = *analogue_gain;
+    }
+    std::optional<libcamera::Span<const float, 2>> colour_gains = metadata.get(libcamera::controls::ColourGains);
+    if (colour_gains) {
+        frame.colour_gains[0] = (*colour_gains)[0];
+        frame.colour_gains[1] = (*colour_gains)[1];
+    }
+    if (buffer) {
+        mapFrameView(buffer, stream_, frame.viewfinder);
+    }
+    if (raw_buffer) {
+        mapFrameView(raw_buffer, raw_stream_, frame.raw);
+    }
+
+    // 本函数持有一个租约，所有租约释放后请求才会重新排队
+    FrameLease lease(slot);
+    deliverFrame(lease, start_time);
+}
+
+void LibcameraFrameSource::RecycleFrame(FrameSlot* slot) {
+    // 最后一个租约已释放，请求重新交给相机
+    libcamera::Request* request = static_cast<libcamera::Request*>(slot->cookie);
+    if (request && is_running_) {
+        queueRequest(request);
+    }
+}
+
+void LibcameraFrameSource::attachControls(libcamera::Request* request) {
+    std::lock_guard<std::mutex> lock(controls_mutex_);
+
+    // 连续调整只保留最新一组，挂到下一个排队的请求上
+    ControlSettings settings;
+    if (takePendingControls(settings)) {
+        libcamera::ControlList& controls = request->controls();
+        controls.set(libcamera::controls::AnalogueGain, settings.iso / 100.0f);
+        controls.set(libcamera::controls::ExposureValue, settings.exposure_compensation);
+        controls.set(libcamera::controls::AwbEnable, false);
+        if (camera_->controls().count(&libcamera::controls::ColourTemperature)) {
+            controls.set(libcamera::controls::ColourTemperature, static_cast<int32_t>(settings.white_balance));
+        } else {
+            float red_gain = 1.0f;
+            float blue_gain = 1.0f;
+            ColourGainsForTemperature(settings.white_balance, red_gain, blue_gain);
+            controls.set(libcamera::controls::ColourGains, libcamera::Span<const float, 2>({ red_gain, blue_gain }));
+        }
+        int64_t frame_time = 1000000 / std::max(settings.fps, 1);
+        controls.set(libcamera::controls::FrameDurationLimits, libcamera::Span<const int64_t, 2>({ frame_time, frame_time }));
+        sent_generation_ = settings.generation;
+    }
+
+    request_generations_[request->cookie()] = sent_generation_;
+}
+
+void LibcameraFrameSource::queueRequest(libcamera::Request* request) {
+    request->reuse(libcamera::Request::ReuseBuffers);
+    attachControls(request);
+    queued_requests_.fetch_add(1, std::memory_order_acq_rel);
+    if (camera_->queueRequest(request) < 0) {
+        queued_requests_.fetch_sub(1, std::memory_order_acq_rel);
+        std::cerr << "请求队列失败" << std::endl;
+    }
+}
+
+int LibcameraFrameSource::outstandingLeases() const {
+    return static_cast<int>(LeasedSlotCount(frame_slots_));
+}
+
+size_t LibcameraFrameSource::GetRawFrameBytes() const {
+    // RAW流在配置中的位置取决于是否有取景流（RAW预览时只有RAW流），直接取流自己的配置
+    if (!raw_stream_) {
+        return 0;
+    }
+    const libcamera::StreamConfiguration& raw_config = raw_stream_->configuration();
+    return static_cast<size_t>(raw_config.stride) * raw_config.size.height;
+}
+
+int LibcameraFrameSource::GetBlackLevel() const {
+    return SensorBlackLevel(raw_format_.bit_depth);
+}
+
+FrameLeaseStats LibcameraFrameSource::GetLeaseStats() const {
+    FrameLeaseStats stats;
+    stats.pool_size = static_cast<int>(frame_slots_.size());
+    stats.queued = std::max(0, queued_requests_.load(std::memory_order_relaxed));
+    stats.leased = outstandingLeases();
+    stats.starvation_events = starvationEvents();
+    return stats;
+}
+
+} // namespace cinepi
@@ -0,0 +1,89 @@
+// libcamera_frame_source.h
+// 基于libcamera的帧来源：同时配置取景流和RAW流
+
+#ifndef LIBCAMERA_FRAME_SOURCE_H
+#define LIBCAMERA_FRAME_SOURCE_H
+
+#include <libcamera/camera.h>
+#include <libcamera/camera_manager.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/framebuffer_allocator.h>
+#include <libcamera/request.h>
+#include <libcamera/stream.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "frame_source.h"
+
+namespace cinepi {
+
+class LibcameraFrameSource : public FrameSource, public FrameRecycler {
+public:
+    LibcameraFrameSource();
+    ~LibcameraFrameSource() override;
+
+    const char* Name() const override { return "libcamera"; }
+    void Open(const CameraParams& params) override;
+    void Reconfigure(const CameraParams& params) override;
+    void Start() override;
+    void Stop() override;
+    void Close() override;
+    FrameFormat GetRawFormat() const override { return raw_format_; }
+    size_t GetRawFrameBytes() const override;
+    int GetBlackLevel() const override;
+    FrameLeaseStats GetLeaseStats() const override;
+
+private:
+    // libcamera相关成员
+    std::unique_ptr<libcamera::CameraManager> camera_manager_;
+    std::shared_ptr<libcamera::Camera> camera_;
+    std::unique_ptr<libcamera::CameraConfiguration> config_;
+    std::unique_ptr<libcamera::FrameBufferAllocator> allocator_;
+    libcamera::Stream* stream_;
+    libcamera::Stream* raw_stream_;
+    std::vector<std::unique_ptr<libcamera::Request>> requests_;
+
+    // 每个请求对应一个帧槽，租约全部释放后请求才重新排队
+    std::vector<std::unique_ptr<FrameSlot>> frame_slots_;
+    std::atomic<int> queued_requests_;
+
+    // 每个请求携带的控制参数代数（按cookie索引），发送新参数与标记代数需要互斥
+    std::vector<uint64_t> request_generations_;
+    uint64_t sent_generation_;
+    std::mutex controls_mutex_;
+
+    // 帧缓冲持久映射：每个FrameBuffer只mmap一次，按指针查找各平面地址
+    struct MappedBuffer {
+        std::vector<const uint8_t*> planes;
+        std::vector<std::pair<void*, size_t>> regions;
+    };
+    std::unordered_map<const libcamera::FrameBuffer*, MappedBuffer> mapped_buffers_;
+
+    CameraParams params_;
+    FrameFormat raw_format_;
+    bool is_acquired_;
+    std::atomic<bool> is_running_;
+
+    // 辅助方法
+    void configureStreams();
+    void configureRawStream(libcamera::StreamConfiguration& raw_config);
+    static bool sameStreamConfig(const libcamera::StreamConfiguration& a, const libcamera::StreamConfiguration& b);
+    void createRequests();
+    void releaseRequests();
+    void mapBuffers();
+    void unmapBuffer(MappedBuffer& mapped);
+    void unmapStream(libcamera::Stream* stream);
+    void unmapBuffers();
+    bool mapFrameView(libcamera::FrameBuffer* buffer, libcamera::Stream* stream, FrameView& view);
+    int outstandingLeases() const;
+    void attachControls(libcamera::Request* request);
+    void queueRequest(libcamera::Request* request);
+    void processRequest(libcamera::Request* request);
+    void RecycleFrame(FrameSlot* slot) override;
+};
+
+} // namespace cinepi
+
+#endif // LIBCAMERA_FRAME_SOURCE_H
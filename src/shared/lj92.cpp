@@ -0,0 +1,481 @@
+// lj92.cpp
+// 无损JPEG编解码实现
+//
+// 编码分两遍：第一遍计算预测差值并统计类别（SSSS）分布，生成限长16位的最优哈夫曼表（T.81 K.2），
+// 第二遍输出熵编码数据。两个分量共用一张哈夫曼表。
+
+#include "lj92.h"
+#include <cstring>
+
+namespace cinepi {
+
+namespace {
+
+// JPEG标记
+const uint8_t MARKER_SOI = 0xD8;
+const uint8_t MARKER_EOI = 0xD9;
+const uint8_t MARKER_SOF3 = 0xC3;
+const uint8_t MARKER_DHT = 0xC4;
+const uint8_t MARKER_SOS = 0xDA;
+
+const int COMPONENTS = 2;
+const int CATEGORIES = 17;          // 差值类别0~16
+const int MAX_CODE_LENGTH = 16;
+
+// 哈夫曼表：bits[n]为长度n的码字个数，values按码长排列
+struct HuffmanTable {
+    uint8_t bits[MAX_CODE_LENGTH + 1];
+    uint8_t values[CATEGORIES];
+    int value_count;
+    uint16_t code[CATEGORIES];
+    uint8_t size[CATEGORIES];
+};
+
+// 每个类别附加的差值位数：类别16不带附加位
+const uint8_t EXTRA_BITS[CATEGORIES] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0 };
+
+// 差值的类别：表示绝对值所需的位数；差值按2^16取模，32768用类别16表示
+// 噪声使类别随机变化，这里和下面都写成无分支形式
+inline int diffCategory(int diff) {
+    unsigned int magnitude = static_cast<unsigned int>(diff < 0 ? -diff : diff);
+    return 31 - __builtin_clz(magnitude * 2 + 1);
+}
+
+inline int wrapDiff(int diff) {
+    return static_cast<int16_t>(static_cast<uint16_t>(diff));
+}
+
+// 按频率生成限长最优哈夫曼表（T.81 K.2，与libjpeg的jpeg_gen_optimal_table相同）
+void buildHuffmanTable(const uint32_t* frequencies, HuffmanTable& table) {
+    // 多一个频率为1的保留符号，保证不会出现全1码字
+    const int SYMBOLS = CATEGORIES + 1;
+    uint64_t freq[SYMBOLS];
+    int code_size[SYMBOLS];
+    int others[SYMBOLS];
+    for (int i = 0; i < CATEGORIES; ++i) {
+        freq[i] = frequencies[i];
+    }
+    freq[CATEGORIES] = 1;
+    for (int i = 0; i < SYMBOLS; ++i) {
+        code_size[i] = 0;
+        others[i] = -1;
+    }
+
+    for (;;) {
+        // 找出频率最小的两个符号（相同时取编号大的）
+        int c1 = -1;
+        int c2 = -1;
+        for (int i = 0; i < SYMBOLS; ++i) {
+            if (freq[i] != 0 && (c1 < 0 || freq[i] <= freq[c1])) {
+                c1 = i;
+            }
+        }
+        for (int i = 0; i < SYMBOLS; ++i) {
+            if (freq[i] != 0 && i != c1 && (c2 < 0 || freq[i] <= freq[c2])) {
+                c2 = i;
+            }
+        }
+        if (c2 < 0) {
+            break;
+        }
+
+        freq[c1] += freq[c2];
+        freq[c2] = 0;
+        ++code_size[c1];
+        while (others[c1] >= 0) {
+            c1 = others[c1];
+            ++code_size[c1];
+        }
+        others[c1] = c2;
+        ++code_size[c2];
+        while (others[c2] >= 0) {
+            c2 = others[c2];
+            ++code_size[c2];
+        }
+    }
+
+    int bits[SYMBOLS * 2 + 1] = { 0 };
+    for (int i = 0; i < SYMBOLS; ++i) {
+        if (code_size[i] > 0) {
+            ++bits[code_size[i]];
+        }
+    }
+
+    // 把超过16位的码字调整到16位以内
+    for (int i = SYMBOLS * 2; i > MAX_CODE_LENGTH; --i) {
+        while (bits[i] > 0) {
+            int j = i - 2;
+            while (bits[j] == 0) {
+                --j;
+            }
+            bits[i] -= 2;
+            ++bits[i - 1];
+            bits[j + 1] += 2;
+            --bits[j];
+        }
+    }
+    // 去掉保留符号（最长的码字之一）
+    int longest = MAX_CODE_LENGTH;
+    while (bits[longest] == 0) {
+        --longest;
+    }
+    --bits[longest];
+
+    for (int i = 0; i <= MAX_CODE_LENGTH; ++i) {
+        table.bits[i] = static_cast<uint8_t>(bits[i]);
+    }
+    table.value_count = 0;
+    for (int length = 1; length <= SYMBOLS * 2; ++length) {
+        for (int symbol = 0; symbol < CATEGORIES; ++symbol) {
+            if (code_size[symbol] == length) {
+                table.values[table.value_count++] = static_cast<uint8_t>(symbol);
+            }
+        }
+    }
+
+    // 规范哈夫曼码（T.81 C.2）
+    std::memset(table.size, 0, sizeof(table.size));
+    std::memset(table.code, 0, sizeof(table.code));
+    uint32_t code = 0;
+    int k = 0;
+    for (int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+        for (int i = 0; i < table.bits[length]; ++i, ++k) {
+            table.code[table.values[k]] = static_cast<uint16_t>(code);
+            table.size[table.values[k]] = static_cast<uint8_t>(length);
+            ++code;
+        }
+        code <<= 1;
+    }
+}
+
+// 熵编码数据的位写入器，0xFF之后插入0x00
+// 攒满32位一次写出；四个字节都不是0xFF时（绝大多数情况）不需要逐字节检查
+class BitWriter {
+public:
+    explicit BitWriter(uint8_t* out) : out_(out), start_(out), buffer_(0), count_(0) {}
+
+    // bits的高位必须为0，length不超过32
+    void Put(uint32_t bits, int length) {
+        buffer_ = (buffer_ << length) | bits;
+        count_ += length;
+        if (count_ >= 32) {
+            count_ -= 32;
+            uint32_t word = static_cast<uint32_t>(buffer_ >> count_);
+            uint32_t inverted = ~word;
+            if (((inverted - 0x01010101u) & ~inverted & 0x80808080u) == 0) {
+                out_[0] = static_cast<uint8_t>(word >> 24);
+                out_[1] = static_cast<uint8_t>(word >> 16);
+                out_[2] = static_cast<uint8_t>(word >> 8);
+                out_[3] = static_cast<uint8_t>(word);
+                out_ += 4;
+            } else {
+                putByte(static_cast<uint8_t>(word >> 24));
+                putByte(static_cast<uint8_t>(word >> 16));
+                putByte(static_cast<uint8_t>(word >> 8));
+                putByte(static_cast<uint8_t>(word));
+            }
+        }
+    }
+
+    // 写出剩余的位并用1填充到字节边界，返回写入的字节数
+    size_t Finish() {
+        while (count_ >= 8) {
+            count_ -= 8;
+            putByte(static_cast<uint8_t>(buffer_ >> count_));
+        }
+        if (count_ > 0) {
+            putByte(static_cast<uint8_t>((buffer_ << (8 - count_)) | (0xFFu >> count_)));
+            count_ = 0;
+        }
+        return static_cast<size_t>(out_ - start_);
+    }
+
+private:
+    uint8_t* out_;
+    uint8_t* start_;
+    uint64_t buffer_;
+    int count_;
+
+    void putByte(uint8_t byte) {
+        *out_++ = byte;
+        if (byte == 0xFF) {
+            *out_++ = 0;
+        }
+    }
+};
+
+void putMarker(std::vector<uint8_t>& out, uint8_t marker) {
+    out.push_back(0xFF);
+    out.push_back(marker);
+}
+
+void put16BigEndian(std::vector<uint8_t>& out, unsigned int value) {
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// 解码用的位读取器：跳过填充的0x00，遇到标记后返回0
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data_(data), end_(data + size), buffer_(0), count_(0) {}
+
+    int Bit() {
+        if (count_ == 0) {
+            uint8_t byte = 0;
+            if (data_ < end_) {
+                byte = *data_;
+                if (byte == 0xFF) {
+                    if (data_ + 1 < end_ && data_[1] == 0) {
+                        data_ += 2;
+                    } else {
+                        byte = 0;   // 标记，不再前进
+                    }
+                } else {
+                    ++data_;
+                }
+            }
+            buffer_ = byte;
+            count_ = 8;
+        }
+        --count_;
+        return (buffer_ >> count_) & 1;
+    }
+
+    int Bits(int length) {
+        int value = 0;
+        for (int i = 0; i < length; ++i) {
+            value = (value << 1) | Bit();
+        }
+        return value;
+    }
+
+private:
+    const uint8_t* data_;
+    const uint8_t* end_;
+    uint32_t buffer_;
+    int count_;
+};
+
+// 解码表：每种码长的最小/最大码字和对应的values起始位置
+struct HuffmanDecoder {
+    int min_code[MAX_CODE_LENGTH + 1];
+    int max_code[MAX_CODE_LENGTH + 1];
+    int first_index[MAX_CODE_LENGTH + 1];
+    uint8_t values[256];
+    bool valid;
+
+    HuffmanDecoder() : valid(false) {}
+
+    void Build(const uint8_t* bits, const uint8_t* symbols) {
+        int code = 0;
+        int k = 0;
+        for (int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+            first_index[length] = k;
+            min_code[length] = code;
+            code += bits[length - 1];
+            k += bits[length - 1];
+            max_code[length] = bits[length - 1] > 0 ? code - 1 : -1;
+            code <<= 1;
+        }
+        std::memcpy(values, symbols, static_cast<size_t>(k));
+        valid = true;
+    }
+
+    int Decode(BitReader& reader) const {
+        int code = 0;
+        for (int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+            code = (code << 1) | reader.Bit();
+            if (max_code[length] >= 0 && code <= max_code[length]) {
+                return values[first_index[length] + code - min_code[length]];
+            }
+        }
+        return -1;
+    }
+};
+
+} // namespace
+
+void EncodeLosslessJpeg(const uint16_t* pixels, unsigned int width, unsigned int height, int precision,
+                        std::vector<uint8_t>& out) {
+    unsigned int jpeg_width = width / COMPONENTS;
+    int initial = 1 << (precision - 1);
+    size_t samples = static_cast<size_t>(width) * height;
+
+    // 第一遍：预测差值和类别分布；缓冲按线程复用
+    thread_local std::vector<int32_t> diffs;
+    thread_local std::vector<uint8_t> entropy;
+    diffs.resize(samples);
+    uint32_t frequencies[CATEGORIES] = { 0 };
+    for (unsigned int y = 0; y < height; ++y) {
+        const uint16_t* row = pixels + static_cast<size_t>(y) * width;
+        const uint16_t* previous_row = row - width;
+        int32_t* diff_row = diffs.data() + static_cast<size_t>(y) * width;
+        // 每行开头的两列用上一行同列预测，其余用同一分量左侧的像素
+        for (unsigned int x = 0; x < COMPONENTS && x < width; ++x) {
+            int predictor = y > 0 ? previous_row[x] : initial;
+            diff_row[x] = wrapDiff(row[x] - predictor);
+            ++frequencies[diffCategory(diff_row[x])];
+        }
+        for (unsigned int x = COMPONENTS; x < width; ++x) {
+            int diff = wrapDiff(row[x] - row[x - COMPONENTS]);
+            diff_row[x] = diff;
+            ++frequencies[diffCategory(diff)];
+        }
+    }
+
+    HuffmanTable table;
+    buildHuffmanTable(frequencies, table);
+
+    // 文件头：SOI、SOF3、DHT、SOS
+    putMarker(out, MARKER_SOI);
+    putMarker(out, MARKER_SOF3);
+    put16BigEndian(out, 8 + 3 * COMPONENTS);
+    out.push_back(static_cast<uint8_t>(precision));
+    put16BigEndian(out, height);
+    put16BigEndian(out, jpeg_width);
+    out.push_back(COMPONENTS);
+    for (int c = 0; c < COMPONENTS; ++c) {
+        out.push_back(static_cast<uint8_t>(c + 1));     // 分量编号
+        out.push_back(0x11);                            // 采样因子1x1
+        out.push_back(0);                               // 量化表（无损时不用）
+    }
+
+    putMarker(out, MARKER_DHT);
+    put16BigEndian(out, 2 + 1 + MAX_CODE_LENGTH + table.value_count);
+    out.push_back(0x00);                                // DC表0
+    out.insert(out.end(), table.bits + 1, table.bits + 1 + MAX_CODE_LENGTH);
+    out.insert(out.end(), table.values, table.values + table.value_count);
+
+    putMarker(out, MARKER_SOS);
+    put16BigEndian(out, 6 + 2 * COMPONENTS);
+    out.push_back(COMPONENTS);
+    for (int c = 0; c < COMPONENTS; ++c) {
+        out.push_back(static_cast<uint8_t>(c + 1));
+        out.push_back(0x00);                            // 两个分量都用表0
+    }
+    out.push_back(1);                                   // 预测器1
+    out.push_back(0);
+    out.push_back(0);                                   // 点变换0
+
+    // 第二遍：熵编码。码字和附加位合并成一次写入（最多16+15位），加上0xFF填充每个样本最多8字节
+    entropy.resize(samples * 8 + 16);
+    BitWriter writer(entropy.data());
+    for (size_t i = 0; i < samples; ++i) {
+        int diff = diffs[i];
+        int category = diffCategory(diff);
+        int extra_bits = EXTRA_BITS[category];
+        // 负差值写入diff-1的低位
+        uint32_t extra = static_cast<uint32_t>(diff + (diff >> 31)) & ((1u << extra_bits) - 1);
+        writer.Put((static_cast<uint32_t>(table.code[category]) << extra_bits) | extra,
+                   table.size[category] + extra_bits);
+    }
+    size_t entropy_bytes = writer.Finish();
+    out.insert(out.end(), entropy.data(), entropy.data() + entropy_bytes);
+    putMarker(out, MARKER_EOI);
+}
+
+bool DecodeLosslessJpeg(const uint8_t* data, size_t size, std::vector<uint16_t>& pixels,
+                        unsigned int& width, unsigned int& height) {
+    HuffmanDecoder decoders[4];
+    int component_count = 0;
+    int table_of[4] = { 0, 0, 0, 0 };
+    int precision = 0;
+    unsigned int jpeg_width = 0;
+    height = 0;
+    width = 0;
+
+    size_t pos = 0;
+    if (size < 4 || data[0] != 0xFF || data[1] != MARKER_SOI) {
+        return false;
+    }
+    pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = data[pos + 1];
+        size_t length = (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+        const uint8_t* segment = data + pos + 4;
+        if (length < 2 || pos + 2 + length > size) {
+            return false;
+        }
+        size_t segment_bytes = length - 2;
+
+        if (marker == MARKER_SOF3) {
+            if (segment_bytes < 6) {
+                return false;
+            }
+            precision = segment[0];
+            height = (static_cast<unsigned int>(segment[1]) << 8) | segment[2];
+            jpeg_width = (static_cast<unsigned int>(segment[3]) << 8) | segment[4];
+            component_count = segment[5];
+            if (component_count < 1 || component_count > 4 || precision < 2 || precision > 16) {
+                return false;
+            }
+        } else if (marker == MARKER_DHT) {
+            size_t offset = 0;
+            while (offset + 17 <= segment_bytes) {
+                int id = segment[offset] & 0x0F;
+                const uint8_t* bits = segment + offset + 1;
+                size_t total = 0;
+                for (int i = 0; i < MAX_CODE_LENGTH; ++i) {
+                    total += bits[i];
+                }
+                if (id > 3 || total > 256 || offset + 17 + total > segment_bytes) {
+                    return false;
+                }
+                decoders[id].Build(bits, segment + offset + 17);
+                offset += 17 + total;
+            }
+        } else if (marker == MARKER_SOS) {
+            if (segment_bytes < 1 || segment[0] != component_count || segment_bytes < 4 + 2u * component_count) {
+                return false;
+            }
+            for (int c = 0; c < component_count; ++c) {
+                table_of[c] = (segment[2 + c * 2] >> 4) & 0x03;
+                if (!decoders[table_of[c]].valid) {
+                    return false;
+                }
+            }
+            if (segment[1 + component_count * 2] != 1) {
+                return false;   // 只支持预测器1
+            }
+            pos += 2 + length;
+            break;
+        }
+        pos += 2 + length;
+    }
+    if (jpeg_width == 0 || height == 0 || component_count == 0 || pos > size) {
+        return false;
+    }
+
+    width = jpeg_width * static_cast<unsigned int>(component_count);
+    pixels.assign(static_cast<size_t>(width) * height, 0);
+    BitReader reader(data + pos, size - pos);
+    int initial = 1 << (precision - 1);
+    for (unsigned int y = 0; y < height; ++y) {
+        uint16_t* row = pixels.data() + static_cast<size_t>(y) * width;
+        const uint16_t* previous_row = y > 0 ? row - width : nullptr;
+        for (unsigned int x = 0; x < width; ++x) {
+            int category = decoders[table_of[x % component_count]].Decode(reader);
+            if (category < 0 || category > 16) {
+                return false;
+            }
+            int diff = 0;
+            if (category == 16) {
+                diff = 32768;
+            } else if (category > 0) {
+                diff = reader.Bits(category);
+                if (diff < (1 << (category - 1))) {
+                    diff -= (1 << category) - 1;
+                }
+            }
+            int predictor = x >= static_cast<unsigned int>(component_count) ? row[x - component_count] :
+                            (previous_row != nullptr ? previous_row[x] : initial);
+            row[x] = static_cast<uint16_t>((predictor + diff) & 0xFFFF);
+        }
+    }
+    return true;
+}
+
+} // namespace cinepi
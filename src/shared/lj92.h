@@ -0,0 +1,27 @@
+// lj92.h
+// 无损JPEG（ITU T.81 process 14，俗称LJ92）编解码，用于CinemaDNG无损压缩
+//
+// Bayer数据按两个交错分量编码：每行的偶数列和奇数列各为一个分量，JPEG宽度为像素宽度的一半，
+// 解码后按行展开即得到原始像素，与DNG读取器的约定一致。
+// 使用预测器1（同一分量左侧的像素），每次编码按差值分布生成最优哈夫曼表。
+
+#ifndef LJ92_H
+#define LJ92_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cinepi {
+
+// 编码width x height的像素（width为偶数），precision为有效位深（2~16），结果追加到out末尾
+void EncodeLosslessJpeg(const uint16_t* pixels, unsigned int width, unsigned int height, int precision,
+                        std::vector<uint8_t>& out);
+
+// 解码EncodeLosslessJpeg的输出（只支持预测器1），width为展开后的像素宽度；数据无效时返回false
+bool DecodeLosslessJpeg(const uint8_t* data, size_t size, std::vector<uint16_t>& pixels,
+                        unsigned int& width, unsigned int& height);
+
+} // namespace cinepi
+
+#endif // LJ92_H
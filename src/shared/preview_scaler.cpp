@@ -0,0 +1,285 @@
+// preview_scaler.cpp
+// 预览缩放实现
+
+#include "preview_scaler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace cinepi {
+
+namespace {
+
+// acc[i] += src[i]，共count个字节
+typedef void (*AccumulateKernel)(const uint8_t* src, uint16_t* acc, size_t count);
+
+// 一组同一指令集级别的内核
+struct ScalerKernels {
+    SimdLevel level;
+    AccumulateKernel accumulate;
+};
+
+// ---- 标量参考实现 ----
+
+void accumulateScalar(const uint8_t* src, uint16_t* acc, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        acc[i] = static_cast<uint16_t>(acc[i] + src[i]);
+    }
+}
+
+const ScalerKernels SCALAR_KERNELS = { SimdLevel::Scalar, accumulateScalar };
+
+// ---- x86：SSSE3 / AVX2 ----
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define CINEPI_TARGET(isa) __attribute__((target(isa)))
+
+CINEPI_TARGET("ssse3")
+void accumulateSsse3(const uint8_t* src, uint16_t* acc, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i* lo = reinterpret_cast<__m128i*>(acc + i);
+        __m128i* hi = reinterpret_cast<__m128i*>(acc + i + 8);
+        _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(v, zero)));
+    }
+    accumulateScalar(src + i, acc + i, count - i);
+}
+
+const ScalerKernels SSSE3_KERNELS = { SimdLevel::Ssse3, accumulateSsse3 };
+
+CINEPI_TARGET("avx2")
+void accumulateAvx2(const uint8_t* src, uint16_t* acc, size_t count) {
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i lo_src = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        __m256i hi_src = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16)));
+        __m256i* lo = reinterpret_cast<__m256i*>(acc + i);
+        __m256i* hi = reinterpret_cast<__m256i*>(acc + i + 16);
+        _mm256_storeu_si256(lo, _mm256_add_epi16(_mm256_loadu_si256(lo), lo_src));
+        _mm256_storeu_si256(hi, _mm256_add_epi16(_mm256_loadu_si256(hi), hi_src));
+    }
+    accumulateSsse3(src + i, acc + i, count - i);
+}
+
+const ScalerKernels AVX2_KERNELS = { SimdLevel::Avx2, accumulateAvx2 };
+
+#undef CINEPI_TARGET
+
+#endif // x86
+
+// ---- ARM：NEON ----
+
+#if defined(__ARM_NEON)
+
+void accumulateNeon(const uint8_t* src, uint16_t* acc, size_t count) {
+    size_t i = 0;
+    // vaddw把8位值加宽后加到16位累加器
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        vst1q_u16(acc + i, vaddw_u8(vld1q_u16(acc + i), vget_low_u8(v)));
+        vst1q_u16(acc + i + 8, vaddw_u8(vld1q_u16(acc + i + 8), vget_high_u8(v)));
+    }
+    accumulateScalar(src + i, acc + i, count - i);
+}
+
+const ScalerKernels NEON_KERNELS = { SimdLevel::Neon, accumulateNeon };
+
+#endif // __ARM_NEON
+
+const ScalerKernels* kernelsFor(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return &SCALAR_KERNELS;
+#if defined(__x86_64__) || defined(__i386__)
+        case SimdLevel::Ssse3:  return &SSSE3_KERNELS;
+        case SimdLevel::Avx2:   return &AVX2_KERNELS;
+#endif
+#if defined(__ARM_NEON)
+        case SimdLevel::Neon:   return &NEON_KERNELS;
+#endif
+        default:                return nullptr;
+    }
+}
+
+// CPU支持的最高级别；该级别没有对应内核时退回标量
+const ScalerKernels* bestKernels() {
+    const ScalerKernels* best = kernelsFor(DetectSimdLevel());
+    return best != nullptr ? best : &SCALAR_KERNELS;
+}
+
+std::atomic<const ScalerKernels*>& activeKernels() {
+    static std::atomic<const ScalerKernels*> active(bestKernels());
+    return active;
+}
+
+const ScalerKernels& kernels() {
+    return *activeKernels().load(std::memory_order_relaxed);
+}
+
+// 输出位置i覆盖的源区间[begin, end)，至少一个源像素（放大时退化为最近邻）
+void sourceSpan(unsigned int i, unsigned int src_size, unsigned int dst_size, unsigned int& begin, unsigned int& end) {
+    begin = static_cast<unsigned int>(static_cast<uint64_t>(i) * src_size / dst_size);
+    end = static_cast<unsigned int>(static_cast<uint64_t>(i + 1) * src_size / dst_size);
+    begin = std::min(begin, src_size - 1);
+    end = std::min(std::max(end, begin + 1), src_size);
+}
+
+} // namespace
+
+ScaleRect FitScaleRect(int src_width, int src_height, int dst_width, int dst_height) {
+    ScaleRect rect = { 0, 0, dst_width, dst_height };
+    if (src_width <= 0 || src_height <= 0) {
+        return rect;
+    }
+
+    // 以较小的缩放比例为准，另一方向留黑边
+    if (static_cast<int64_t>(dst_width) * src_height > static_cast<int64_t>(dst_height) * src_width) {
+        rect.width = static_cast<int>(static_cast<int64_t>(dst_height) * src_width / src_height);
+        rect.x = (dst_width - rect.width) / 2;
+    } else {
+        rect.height = static_cast<int>(static_cast<int64_t>(dst_width) * src_height / src_width);
+        rect.y = (dst_height - rect.height) / 2;
+    }
+    return rect;
+}
+
+void BoxScaleRows(const uint8_t* src, unsigned int src_width, unsigned int src_height, unsigned int src_stride,
+                  uint8_t* dst, unsigned int dst_stride, const ScaleRect& rect, unsigned int row_begin, unsigned int row_end) {
+    if (!src || !dst || src_width == 0 || src_height == 0 || rect.width <= 0 || rect.height <= 0) {
+        return;
+    }
+    unsigned int out_width = static_cast<unsigned int>(rect.width);
+    unsigned int out_height = static_cast<unsigned int>(rect.height);
+    row_end = std::min(row_end, out_height);
+
+    // 列窗口对所有输出行相同
+    std::vector<unsigned int> column_begin(out_width);
+    std::vector<unsigned int> column_count(out_width);
+    unsigned int max_columns = 1;
+    for (unsigned int x = 0; x < out_width; ++x) {
+        unsigned int end = 0;
+        sourceSpan(x, src_width, out_width, column_begin[x], end);
+        column_count[x] = end - column_begin[x];
+        max_columns = std::max(max_columns, column_count[x]);
+    }
+
+    size_t row_bytes = static_cast<size_t>(src_width) * 3;
+    std::vector<uint16_t> acc(row_bytes);
+    std::vector<uint64_t> inverse(max_columns + 1);
+    AccumulateKernel accumulate = kernels().accumulate;
+
+    for (unsigned int y = row_begin; y < row_end; ++y) {
+        unsigned int src_begin = 0;
+        unsigned int src_end = 0;
+        sourceSpan(y, src_height, out_height, src_begin, src_end);
+        unsigned int rows = src_end - src_begin;
+
+        // 纵向：覆盖的源行逐字节累加
+        std::fill(acc.begin(), acc.end(), 0);
+        for (unsigned int sy = src_begin; sy < src_end; ++sy) {
+            accumulate(src + static_cast<size_t>(sy) * src_stride, acc.data(), row_bytes);
+        }
+
+        // 横向：按列窗口求和，乘以2^32/样本数的倒数代替除法（四舍五入）
+        for (unsigned int columns = 1; columns <= max_columns; ++columns) {
+            uint64_t count = static_cast<uint64_t>(rows) * columns;
+            inverse[columns] = ((static_cast<uint64_t>(1) << 32) + count / 2) / count;
+        }
+        // 结果不会超过255（sum <= 255 * 样本数）
+        const uint64_t half = static_cast<uint64_t>(1) << 31;
+        uint8_t* out = dst + static_cast<size_t>(rect.y + static_cast<int>(y)) * dst_stride + static_cast<size_t>(rect.x) * 3;
+        for (unsigned int x = 0; x < out_width; ++x, out += 3) {
+            const uint16_t* cell = acc.data() + static_cast<size_t>(column_begin[x]) * 3;
+            unsigned int columns = column_count[x];
+            uint32_t sum0 = cell[0];
+            uint32_t sum1 = cell[1];
+            uint32_t sum2 = cell[2];
+            for (unsigned int c = 1; c < columns; ++c) {
+                cell += 3;
+                sum0 += cell[0];
+                sum1 += cell[1];
+                sum2 += cell[2];
+            }
+            uint64_t inv = inverse[columns];
+            out[0] = static_cast<uint8_t>((sum0 * inv + half) >> 32);
+            out[1] = static_cast<uint8_t>((sum1 * inv + half) >> 32);
+            out[2] = static_cast<uint8_t>((sum2 * inv + half) >> 32);
+        }
+    }
+}
+
+SimdLevel GetPreviewScalerLevel() {
+    return kernels().level;
+}
+
+bool SetPreviewScalerLevel(SimdLevel level) {
+    const ScalerKernels* selected = kernelsFor(level);
+    if (selected == nullptr || !SimdLevelSupported(level)) {
+        return false;
+    }
+    activeKernels().store(selected, std::memory_order_relaxed);
+    return true;
+}
+
+PreviewScaler::PreviewScaler(WorkerPool& pool) : pool_(pool) {
+}
+
+bool PreviewScaler::Scale(const uint8_t* src, unsigned int src_width, unsigned int src_height, unsigned int src_stride,
+                          uint8_t* dst, unsigned int dst_width, unsigned int dst_height, unsigned int dst_stride) {
+    if (!src || !dst || src_width == 0 || src_height == 0 || dst_width == 0 || dst_height == 0) {
+        return false;
+    }
+    ScaleRect rect = FitScaleRect(static_cast<int>(src_width), static_cast<int>(src_height),
+                                  static_cast<int>(dst_width), static_cast<int>(dst_height));
+    if (rect.width <= 0 || rect.height <= 0 ||
+        src_height > static_cast<uint64_t>(rect.height) * MAX_SHRINK) {
+        return false;
+    }
+
+    // 锁定的纹理内容未定义，黑边每帧都要写
+    size_t dst_row_bytes = static_cast<size_t>(dst_width) * 3;
+    size_t left_bytes = static_cast<size_t>(rect.x) * 3;
+    size_t right_offset = left_bytes + static_cast<size_t>(rect.width) * 3;
+    for (unsigned int y = 0; y < dst_height; ++y) {
+        uint8_t* row = dst + static_cast<size_t>(y) * dst_stride;
+        if (static_cast<int>(y) < rect.y || static_cast<int>(y) >= rect.y + rect.height) {
+            memset(row, 0, dst_row_bytes);
+        } else {
+            memset(row, 0, left_bytes);
+            memset(row + right_offset, 0, dst_row_bytes - right_offset);
+        }
+    }
+
+    // 尺寸相同时直接复制
+    if (static_cast<unsigned int>(rect.width) == src_width && static_cast<unsigned int>(rect.height) == src_height) {
+        for (unsigned int y = 0; y < src_height; ++y) {
+            memcpy(dst + static_cast<size_t>(rect.y + static_cast<int>(y)) * dst_stride + left_bytes,
+                   src + static_cast<size_t>(y) * src_stride, static_cast<size_t>(src_width) * 3);
+        }
+        return true;
+    }
+
+    // 每个线程一段连续的输出行
+    unsigned int rows = static_cast<unsigned int>(rect.height);
+    unsigned int bands = static_cast<unsigned int>(std::min<size_t>(pool_.Size(), rows));
+    unsigned int band_rows = (rows + bands - 1) / bands;
+    for (unsigned int begin = 0; begin < rows; begin += band_rows) {
+        unsigned int end = std::min(begin + band_rows, rows);
+        pool_.Submit([src, src_width, src_height, src_stride, dst, dst_stride, rect, begin, end]() {
+            BoxScaleRows(src, src_width, src_height, src_stride, dst, dst_stride, rect, begin, end);
+        });
+    }
+    pool_.WaitIdle();
+    return true;
+}
+
+} // namespace cinepi
@@ -0,0 +1,63 @@
+// preview_scaler.h
+// 预览缩放：把任意尺寸的RGB888帧（取景流或RAW预览）一次缩放到显示纹理尺寸
+//
+// 采集分辨率与显示分辨率无关：源图按宽高比缩放后居中放进目标区域，其余部分填黑（信箱/邮筒）。
+// 缩小使用盒式滤波（面积平均）：每个输出像素取它覆盖的源像素块的平均，任意缩放比例下每个源像素只读一次。
+// 先把一个输出行覆盖的源行逐字节累加（SSSE3/AVX2/NEON），再按列窗口求和并乘倒数；
+// 累加是精确的整数运算，各指令集级别的结果逐字节一致。输出按行分块在工作线程中并行。
+
+#ifndef PREVIEW_SCALER_H
+#define PREVIEW_SCALER_H
+
+#include <cstdint>
+#include <vector>
+#include "cpu_features.h"
+#include "worker_pool.h"
+
+namespace cinepi {
+
+// 目标区域中的矩形
+struct ScaleRect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// 按宽高比缩放src_width x src_height并居中放进dst_width x dst_height后的区域
+ScaleRect FitScaleRect(int src_width, int src_height, int dst_width, int dst_height);
+
+// 盒式滤波缩放rect内的输出行[row_begin, row_end)（相对rect），像素为3字节。
+// src的每个像素按宽高比映射到rect，行外的黑边由调用者处理
+void BoxScaleRows(const uint8_t* src, unsigned int src_width, unsigned int src_height, unsigned int src_stride,
+                  uint8_t* dst, unsigned int dst_stride, const ScaleRect& rect, unsigned int row_begin, unsigned int row_end);
+
+// 预览缩放当前使用的内核级别
+SimdLevel GetPreviewScalerLevel();
+
+// 强制使用指定级别的内核（基准测试和对比用），CPU不支持时返回false
+bool SetPreviewScalerLevel(SimdLevel level);
+
+class PreviewScaler {
+public:
+    // 在pool的线程中并行处理，pool需比缩放器存活更久
+    explicit PreviewScaler(WorkerPool& pool);
+
+    PreviewScaler(const PreviewScaler&) = delete;
+    PreviewScaler& operator=(const PreviewScaler&) = delete;
+
+    // 把src缩放进dst（dst_width x dst_height，每行dst_stride字节），黑边一并写入，
+    // 适合直接写入锁定的流式纹理。尺寸无效或缩小倍数超过MAX_SHRINK时返回false
+    bool Scale(const uint8_t* src, unsigned int src_width, unsigned int src_height, unsigned int src_stride,
+               uint8_t* dst, unsigned int dst_width, unsigned int dst_height, unsigned int dst_stride);
+
+    // 16位累加器的上限：255 * 257 < 65536
+    static const unsigned int MAX_SHRINK = 257;
+
+private:
+    WorkerPool& pool_;
+};
+
+} // namespace cinepi
+
+#endif // PREVIEW_SCALER_H
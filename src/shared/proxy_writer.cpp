@@ -0,0 +1,399 @@
+// proxy_writer.cpp
+// 代理流实现
+
+#include "proxy_writer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef CINEPI_HAVE_LIBJPEG
+#include <csetjmp>
+#include <cstdlib>
+#include <jpeglib.h>
+#endif
+
+namespace cinepi {
+
+namespace {
+
+// 代理线程的nice值，RAW写入线程和采集线程保持默认优先级
+const int PROXY_NICE = 10;
+
+// 每隔多少次跳过打印一次日志
+const uint64_t SKIP_LOG_INTERVAL = 24;
+
+// 写入队列占用超过1/4时不再接收代理帧
+const size_t BACKLOG_DIVISOR = 4;
+
+// 代理预览的显示gamma
+const float PROXY_GAMMA = 2.2f;
+
+bool writeAll(const std::string& path, const std::vector<uint8_t>& data) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    const uint8_t* p = data.data();
+    size_t remaining = data.size();
+    bool ok = true;
+    while (ok && remaining > 0) {
+        ssize_t written = ::write(fd, p, remaining);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        ok = written > 0;
+        if (ok) {
+            p += written;
+            remaining -= static_cast<size_t>(written);
+        }
+    }
+    return ::close(fd) == 0 && ok;
+}
+
+#ifdef CINEPI_HAVE_LIBJPEG
+// libjpeg默认出错时退出进程，这里跳回编码函数
+struct JpegError {
+    jpeg_error_mgr manager;
+    std::jmp_buf jump;
+    // jpeg_mem_dest的输出在setjmp之后由libjpeg写入；放在这里而不是局部变量，
+    // 出错跳回时释放的是实际分配的缓冲
+    unsigned char* buffer;
+    unsigned long size;
+};
+
+void jpegErrorExit(j_common_ptr cinfo) {
+    std::longjmp(reinterpret_cast<JpegError*>(cinfo->err)->jump, 1);
+}
+#endif
+
+} // namespace
+
+bool ParseProxyFormat(const std::string& name, ProxyFormat& format) {
+    if (name == "mjpeg") {
+        format = ProxyFormat::Mjpeg;
+    } else if (name == "yuv") {
+        format = ProxyFormat::Yuv;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+ProxyWriter::ProxyWriter()
+    : width_(0),
+      height_(0),
+      is_open_(false),
+      pending_index_(0),
+      has_pending_(false),
+      stop_(false),
+      tone_gains_{ -1.0f, -1.0f },
+      last_written_(-1),
+      encoded_frames_(0),
+      skipped_busy_(0),
+      skipped_backlog_(0),
+      linked_frames_(0),
+      encode_ns_(0),
+      error_(false) {
+}
+
+ProxyWriter::~ProxyWriter() {
+    Close(0);
+}
+
+void ProxyWriter::Open(const std::string& directory, const RecordingInfo& info, const ProxyConfig& config) {
+    Close(0);
+    if (config.scale < 2 || config.scale % 2 != 0) {
+        throw std::runtime_error("代理缩小倍数必须是不小于2的偶数");
+    }
+    if (!info.format.IsBayer()) {
+        throw std::runtime_error("代理流需要Bayer RAW帧");
+    }
+#ifndef CINEPI_HAVE_LIBJPEG
+    if (config.format == ProxyFormat::Mjpeg) {
+        throw std::runtime_error("编译时未找到libjpeg，代理流请使用yuv格式");
+    }
+#endif
+
+    // 合并去马赛克的输出宽高，YUV420要求偶数
+    unsigned int bin = config.scale / 2;
+    unsigned int binned_width = info.width / 2 / bin;
+    unsigned int binned_height = info.height / 2 / bin;
+    width_ = binned_width & ~1u;
+    height_ = binned_height & ~1u;
+    if (width_ == 0 || height_ == 0) {
+        throw std::runtime_error("代理分辨率过小");
+    }
+
+    if (::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("无法创建代理目录 " + directory + ": " + std::strerror(errno));
+    }
+    directory_ = directory;
+    std::string name = directory.substr(directory.find_last_of('/') + 1);
+    size_t suffix = name.rfind(".proxy");
+    clip_name_ = suffix != std::string::npos && suffix > 0 ? name.substr(0, suffix) : name;
+
+    config_ = config;
+    info_ = info;
+    bgr_.assign(static_cast<size_t>(binned_width) * 3 * binned_height, 0);
+    tone_gains_[0] = -1.0f;
+    tone_gains_[1] = -1.0f;
+    last_written_ = -1;
+    encoded_frames_ = 0;
+    skipped_busy_ = 0;
+    skipped_backlog_ = 0;
+    linked_frames_ = 0;
+    encode_ns_ = 0;
+    error_ = false;
+
+    // 描述文件：YUV没有文件头，尺寸只记录在这里
+    std::ofstream desc(directory_ + "/proxy.json");
+    desc << "{\n"
+         << "  \"clip\": \"" << clip_name_ << "\",\n"
+         << "  \"format\": \"" << (config_.format == ProxyFormat::Mjpeg ? "mjpeg" : "yuv420p") << "\",\n"
+         << "  \"width\": " << width_ << ",\n"
+         << "  \"height\": " << height_ << ",\n"
+         << "  \"fps\": " << info_.fps << ",\n"
+         << "  \"source_width\": " << info_.width << ",\n"
+         << "  \"source_height\": " << info_.height << "\n"
+         << "}\n";
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        has_pending_ = false;
+        stop_ = false;
+    }
+    thread_ = std::thread(&ProxyWriter::run, this);
+    is_open_ = true;
+
+    std::cout << "代理流: " << width_ << "x" << height_ << " "
+              << (config_.format == ProxyFormat::Mjpeg ? "MJPEG" : "YUV420") << " -> " << directory_ << std::endl;
+}
+
+void ProxyWriter::Close(uint64_t frame_count) {
+    if (!thread_.joinable()) {
+        return;
+    }
+    is_open_ = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+
+    // 结尾跳过的帧用最后一个代理补齐
+    if (last_written_ >= 0 && frame_count > static_cast<uint64_t>(last_written_) + 1) {
+        fillGap(static_cast<uint64_t>(last_written_) + 1, frame_count - 1, static_cast<uint64_t>(last_written_));
+    }
+
+    uint64_t encoded = encoded_frames_.load();
+    std::cout << "代理流: 编码 " << encoded << " 帧, 跳过 " << skipped_busy_.load() + skipped_backlog_.load()
+              << " 帧 (代理忙 " << skipped_busy_.load() << ", RAW队列积压 " << skipped_backlog_.load() << "), 补齐 "
+              << linked_frames_.load() << " 帧";
+    if (encoded > 0) {
+        std::cout << ", 平均 " << encode_ns_.load() / 1e6 / encoded << "ms/帧";
+    }
+    std::cout << std::endl;
+}
+
+void ProxyWriter::logSkip(uint64_t index, const char* reason, uint64_t total) {
+    if (total == 1 || total % SKIP_LOG_INTERVAL == 0) {
+        std::cerr << "代理流: 跳过帧 " << index << " (" << reason << ", 累计 " << total << " 帧)" << std::endl;
+    }
+}
+
+void ProxyWriter::OnFrameWritten(const FrameLease& frame, uint64_t index, size_t queued, size_t capacity) {
+    if (!is_open_.load(std::memory_order_acquire) || error_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // RAW写入已经落后时不再从队列内存池多占一帧
+    if (queued * BACKLOG_DIVISOR > capacity) {
+        logSkip(index, "RAW队列积压", skipped_backlog_.fetch_add(1) + 1);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (has_pending_) {
+            logSkip(index, "代理忙", skipped_busy_.fetch_add(1) + 1);
+            return;
+        }
+        pending_ = frame;
+        pending_index_ = index;
+        has_pending_ = true;
+    }
+    cv_.notify_one();
+}
+
+void ProxyWriter::run() {
+    // 降低代理线程的优先级，CPU紧张时先让给采集和RAW写入
+    if (::setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), PROXY_NICE) != 0) {
+        std::cerr << "警告: 无法降低代理线程优先级: " << std::strerror(errno) << std::endl;
+    }
+
+    while (true) {
+        FrameLease frame;
+        uint64_t index = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return has_pending_ || stop_; });
+            if (!has_pending_) {
+                break;
+            }
+            frame = std::move(pending_);
+            index = pending_index_;
+        }
+
+        processFrame(std::move(frame), index);
+
+        // 处理完才接收下一帧，代理同一时间最多持有一帧
+        std::lock_guard<std::mutex> lock(mutex_);
+        has_pending_ = false;
+    }
+}
+
+std::string ProxyWriter::framePath(uint64_t index) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "_%06llu%s", static_cast<unsigned long long>(index),
+                  config_.format == ProxyFormat::Mjpeg ? ".jpg" : ".yuv");
+    return directory_ + "/" + clip_name_ + name;
+}
+
+void ProxyWriter::processFrame(FrameLease frame, uint64_t index) {
+    int64_t start_ns = MonotonicNowNs();
+
+    // 白平衡随帧变化时重建查找表
+    const float* gains = frame->colour_gains;
+    if (gains[0] != tone_gains_[0] || gains[1] != tone_gains_[1]) {
+        BuildDebayerTone(tone_, info_.format.bit_depth, info_.black_level, gains[0], gains[1], PROXY_GAMMA);
+        tone_gains_[0] = gains[0];
+        tone_gains_[1] = gains[1];
+    }
+    unsigned int bin = config_.scale / 2;
+    unsigned int binned_width = info_.width / 2 / bin;
+    DebayerBinned(frame->raw, bin, tone_, bgr_.data(), binned_width * 3, 0, info_.height / 2 / bin);
+
+    // RAW数据已经用完，尽早归还写入队列的内存
+    frame.Release();
+
+    // 中间跳过的帧用上一个代理补齐（此时encoded_还是上一帧的内容）
+    if (last_written_ >= 0 && index > static_cast<uint64_t>(last_written_) + 1) {
+        fillGap(static_cast<uint64_t>(last_written_) + 1, index - 1, static_cast<uint64_t>(last_written_));
+    }
+
+    if (!encode() || !writeAll(framePath(index), encoded_)) {
+        std::cerr << "代理流: 写入 " << framePath(index) << " 失败，停止代理: " << std::strerror(errno) << std::endl;
+        error_ = true;
+        return;
+    }
+    encode_ns_ += MonotonicNowNs() - start_ns;
+    ++encoded_frames_;
+
+    // 开头跳过的帧用第一个代理补齐
+    if (last_written_ < 0 && index > 0) {
+        fillGap(0, index - 1, index);
+    }
+    last_written_ = static_cast<int64_t>(index);
+}
+
+void ProxyWriter::fillGap(uint64_t first, uint64_t last, uint64_t source) {
+    // 优先硬链接，不占空间；文件系统不支持（如exFAT）时写入encoded_中的同一帧
+    std::string source_path = framePath(source);
+    for (uint64_t i = first; i <= last; ++i) {
+        std::string path = framePath(i);
+        if (::link(source_path.c_str(), path.c_str()) != 0 && !writeAll(path, encoded_)) {
+            std::cerr << "代理流: 无法补齐 " << path << ": " << std::strerror(errno) << std::endl;
+            return;
+        }
+        ++linked_frames_;
+    }
+}
+
+bool ProxyWriter::encode() {
+    unsigned int stride = info_.width / 2 / (config_.scale / 2) * 3;
+
+    if (config_.format == ProxyFormat::Yuv) {
+        // I420，BT.709有限范围；色度取2x2像素的平均
+        size_t luma_size = static_cast<size_t>(width_) * height_;
+        encoded_.resize(luma_size + luma_size / 2);
+        uint8_t* y_plane = encoded_.data();
+        uint8_t* u_plane = y_plane + luma_size;
+        uint8_t* v_plane = u_plane + luma_size / 4;
+        for (unsigned int y = 0; y < height_; ++y) {
+            const uint8_t* src = bgr_.data() + static_cast<size_t>(y) * stride;
+            uint8_t* dst = y_plane + static_cast<size_t>(y) * width_;
+            for (unsigned int x = 0; x < width_; ++x, src += 3) {
+                dst[x] = static_cast<uint8_t>(((47 * src[2] + 157 * src[1] + 16 * src[0] + 128) >> 8) + 16);
+            }
+        }
+        for (unsigned int y = 0; y < height_; y += 2) {
+            const uint8_t* top = bgr_.data() + static_cast<size_t>(y) * stride;
+            const uint8_t* bottom = top + stride;
+            uint8_t* u = u_plane + static_cast<size_t>(y / 2) * (width_ / 2);
+            uint8_t* v = v_plane + static_cast<size_t>(y / 2) * (width_ / 2);
+            for (unsigned int x = 0; x < width_; x += 2, top += 6, bottom += 6) {
+                int b = (top[0] + top[3] + bottom[0] + bottom[3] + 2) >> 2;
+                int g = (top[1] + top[4] + bottom[1] + bottom[4] + 2) >> 2;
+                int r = (top[2] + top[5] + bottom[2] + bottom[5] + 2) >> 2;
+                u[x / 2] = static_cast<uint8_t>(((-26 * r - 87 * g + 112 * b + 128) >> 8) + 128);
+                v[x / 2] = static_cast<uint8_t>(((112 * r - 102 * g - 10 * b + 128) >> 8) + 128);
+            }
+        }
+        return true;
+    }
+
+#ifdef CINEPI_HAVE_LIBJPEG
+    jpeg_compress_struct cinfo;
+    JpegError error;
+    cinfo.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = jpegErrorExit;
+    error.buffer = nullptr;
+    error.size = 0;
+    std::vector<uint8_t> row(static_cast<size_t>(width_) * 3);
+
+    if (setjmp(error.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        std::free(error.buffer);
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &error.buffer, &error.size);
+    cinfo.image_width = width_;
+    cinfo.image_height = height_;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, config_.quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        // 去马赛克输出B,G,R，JPEG输入按R,G,B
+        const uint8_t* src = bgr_.data() + static_cast<size_t>(cinfo.next_scanline) * stride;
+        for (unsigned int x = 0; x < width_; ++x) {
+            row[x * 3] = src[x * 3 + 2];
+            row[x * 3 + 1] = src[x * 3 + 1];
+            row[x * 3 + 2] = src[x * 3];
+        }
+        JSAMPROW rows[1] = { row.data() };
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    encoded_.assign(error.buffer, error.buffer + error.size);
+    jpeg_destroy_compress(&cinfo);
+    std::free(error.buffer);
+    return true;
+#else
+    return false;
+#endif
+}
+
+} // namespace cinepi
@@ -0,0 +1,105 @@
+// proxy_writer.h
+// 代理流：录制RAW的同时从同一批帧生成低分辨率8位代理，供剪辑使用
+//
+// 写入线程每落盘一帧就把帧租约交给代理（见FrameTap），代理在自己的低优先级线程中
+// 合并去马赛克、缩小、编码为JPEG或YUV420并写入 <剪辑名>.proxy/ 目录，文件编号与RAW帧号一致。
+// 代理同一时间最多持有一帧：上一帧还没处理完，或RAW写入队列开始积压时，新帧直接跳过并记录，
+// 代理不会占用写入队列的内存，也不会拖慢RAW落盘。跳过的帧号用前一个代理文件的硬链接补齐，
+// 代理序列始终连续，可以直接按帧号与RAW对齐。
+
+#ifndef PROXY_WRITER_H
+#define PROXY_WRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "debayer.h"
+#include "raw_sink.h"
+#include "raw_writer.h"
+
+namespace cinepi {
+
+// 代理格式
+enum class ProxyFormat {
+    Mjpeg,  // 每帧一个JPEG（需要libjpeg）
+    Yuv     // 每帧一个I420（YUV 4:2:0，BT.709有限范围）
+};
+
+// 解析代理格式名称（mjpeg/yuv），未知名称返回false
+bool ParseProxyFormat(const std::string& name, ProxyFormat& format);
+
+// 代理配置
+struct ProxyConfig {
+    ProxyFormat format;
+    unsigned int scale;         // 缩小倍数（偶数），4表示1/4分辨率
+    int quality;                // JPEG质量
+
+    ProxyConfig() : format(ProxyFormat::Mjpeg), scale(4), quality(75) {}
+};
+
+class ProxyWriter : public FrameTap {
+public:
+    ProxyWriter();
+    ~ProxyWriter() override;
+
+    ProxyWriter(const ProxyWriter&) = delete;
+    ProxyWriter& operator=(const ProxyWriter&) = delete;
+
+    // 创建代理目录并启动代理线程；失败时抛出异常
+    void Open(const std::string& directory, const RecordingInfo& info, const ProxyConfig& config);
+
+    // 处理完当前帧后停止，补齐到frame_count帧（RAW写入的总帧数）
+    void Close(uint64_t frame_count);
+
+    bool IsOpen() const { return is_open_.load(std::memory_order_acquire); }
+
+    // 写入线程调用：代理空闲且写入队列没有积压时接收这一帧，否则跳过
+    void OnFrameWritten(const FrameLease& frame, uint64_t index, size_t queued, size_t capacity) override;
+
+private:
+    ProxyConfig config_;
+    RecordingInfo info_;
+    std::string directory_;
+    std::string clip_name_;
+    unsigned int width_;
+    unsigned int height_;
+    std::atomic<bool> is_open_;
+
+    // 待处理的帧，最多一帧
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    FrameLease pending_;
+    uint64_t pending_index_;
+    bool has_pending_;
+    bool stop_;
+    std::thread thread_;
+
+    // 只在代理线程中使用
+    DebayerTone tone_;
+    float tone_gains_[2];
+    std::vector<uint8_t> bgr_;
+    std::vector<uint8_t> encoded_;
+    int64_t last_written_;          // 最近写出的帧号，-1表示还没有
+
+    std::atomic<uint64_t> encoded_frames_;
+    std::atomic<uint64_t> skipped_busy_;        // 代理还在处理上一帧
+    std::atomic<uint64_t> skipped_backlog_;     // RAW写入队列积压
+    std::atomic<uint64_t> linked_frames_;
+    std::atomic<int64_t> encode_ns_;
+    std::atomic<bool> error_;
+
+    void run();
+    void processFrame(FrameLease frame, uint64_t index);
+    bool encode();
+    std::string framePath(uint64_t index) const;
+    void fillGap(uint64_t first, uint64_t last, uint64_t source);
+    void logSkip(uint64_t index, const char* reason, uint64_t total);
+};
+
+} // namespace cinepi
+
+#endif // PROXY_WRITER_H
@@ -0,0 +1,384 @@
+// raw_container.cpp
+// 带索引的RAW容器实现
+
+#include "raw_container.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cinepi {
+
+namespace {
+
+const char CONTAINER_MAGIC[8] = { 'C', 'I', 'N', 'E', 'P', 'I', 'R', 'W' };
+const uint32_t RECORD_MAGIC = 0x52465043;   // "CPFR"
+const uint32_t INDEX_MAGIC = 0x58495043;    // "CPIX"
+
+static_assert(sizeof(RawContainerHeader) == 104, "文件头布局变化需要提升版本号");
+static_assert(sizeof(RawFrameRecord) == 48, "记录头布局变化需要提升版本号");
+static_assert(sizeof(RawIndexHeader) == 16 && sizeof(RawIndexEntry) == 24, "索引布局变化需要提升版本号");
+
+uint64_t alignPage(uint64_t bytes) {
+    return (bytes + RAW_CONTAINER_PAGE - 1) / RAW_CONTAINER_PAGE * RAW_CONTAINER_PAGE;
+}
+
+// FNV-1a，只覆盖几十字节的记录头，不校验帧数据
+uint32_t recordChecksum(const RawFrameRecord& record) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+    uint32_t hash = 2166136261u;
+    for (size_t i = offsetof(RawFrameRecord, frame_index); i < sizeof(RawFrameRecord); ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// 写满len字节，处理被信号打断和部分写入
+bool pwriteAll(int fd, const void* buffer, size_t len, uint64_t offset) {
+    const uint8_t* data = static_cast<const uint8_t*>(buffer);
+    while (len > 0) {
+        ssize_t written = ::pwrite(fd, data, len, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        len -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+// 在offset处写入索引，落盘后再回写文件头：文件头指向索引时索引一定完整
+bool finalize(int fd, RawContainerHeader& header, const std::vector<RawIndexEntry>& index, uint64_t offset) {
+    RawIndexHeader index_header;
+    index_header.magic = INDEX_MAGIC;
+    index_header.version = RAW_CONTAINER_VERSION;
+    index_header.count = index.size();
+    if (!pwriteAll(fd, &index_header, sizeof(index_header), offset) ||
+        !pwriteAll(fd, index.data(), index.size() * sizeof(RawIndexEntry), offset + sizeof(index_header)) ||
+        ::ftruncate(fd, static_cast<off_t>(offset + sizeof(index_header) + index.size() * sizeof(RawIndexEntry))) != 0 ||
+        ::fdatasync(fd) != 0) {
+        return false;
+    }
+
+    header.frame_count = index.size();
+    header.index_offset = offset;
+    return pwriteAll(fd, &header, sizeof(header), 0) && ::fdatasync(fd) == 0;
+}
+
+} // namespace
+
+bool IsRawContainer(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    char magic[sizeof(CONTAINER_MAGIC)] = {};
+    bool match = ::pread(fd, magic, sizeof(magic), 0) == static_cast<ssize_t>(sizeof(magic)) &&
+                 std::memcmp(magic, CONTAINER_MAGIC, sizeof(magic)) == 0;
+    ::close(fd);
+    return match;
+}
+
+ContainerRawSink::ContainerRawSink() : fd_(-1), header_(), record_page_(RAW_CONTAINER_PAGE, 0), file_offset_(0) {
+}
+
+ContainerRawSink::~ContainerRawSink() {
+    Close();
+}
+
+uint64_t ContainerRawSink::RecordBytes(const RecordingInfo& info) const {
+    // 记录头页 + 按页对齐的数据，关闭时每帧还有一个索引项
+    return RAW_CONTAINER_PAGE + alignPage(info.frame_bytes) + sizeof(RawIndexEntry);
+}
+
+uint64_t ContainerRawSink::OverheadBytes(const RecordingInfo&) const {
+    // 文件头页和关闭时写出的索引头
+    return RAW_CONTAINER_PAGE + sizeof(RawIndexHeader);
+}
+
+void ContainerRawSink::Open(const std::string& path, const RecordingInfo& info) {
+    Close();
+    if (info.height == 0 || info.frame_bytes == 0) {
+        throw std::runtime_error("RAW容器参数无效");
+    }
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("无法创建录制文件 " + path + ": " + std::strerror(errno));
+    }
+    path_ = path;
+
+    header_ = RawContainerHeader();
+    std::memcpy(header_.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+    header_.version = RAW_CONTAINER_VERSION;
+    header_.header_bytes = static_cast<uint32_t>(RAW_CONTAINER_PAGE);
+    header_.width = info.width;
+    header_.height = info.height;
+    header_.stride = static_cast<uint32_t>(info.frame_bytes / info.height);
+    header_.encoding = static_cast<uint32_t>(info.format.encoding);
+    header_.bayer_order = static_cast<uint32_t>(info.format.bayer_order);
+    header_.bit_depth = static_cast<uint32_t>(info.format.bit_depth);
+    header_.fourcc = info.format.fourcc;
+    header_.black_level = info.black_level;
+    header_.fps = info.fps;
+    header_.iso = info.iso;
+    header_.white_balance = info.white_balance;
+    header_.exposure_compensation = info.exposure_compensation;
+    header_.frame_bytes = info.frame_bytes;
+    header_.record_bytes = RAW_CONTAINER_PAGE + alignPage(info.frame_bytes);
+    header_.created_unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // 文件头先以“未关闭”状态写出，断电后读取器据此扫描记录
+    std::vector<uint8_t> page(RAW_CONTAINER_PAGE, 0);
+    std::memcpy(page.data(), &header_, sizeof(header_));
+    if (!pwriteAll(fd_, page.data(), page.size(), 0)) {
+        std::string error = std::strerror(errno);
+        ::close(fd_);
+        fd_ = -1;
+        throw std::runtime_error("写入文件头失败 " + path + ": " + error);
+    }
+    file_offset_ = RAW_CONTAINER_PAGE;
+
+    // 预留磁盘块但不改变文件长度，关闭写索引时截掉多余部分
+    if (info.preallocate_bytes > 0 &&
+        ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(info.preallocate_bytes)) != 0) {
+        std::cerr << "警告: 无法预分配 " << path << ": " << std::strerror(errno) << std::endl;
+    }
+
+    // 按默认队列内存预留索引，录制中途一般不再分配
+    index_.clear();
+    index_.reserve(4096);
+}
+
+bool ContainerRawSink::WriteFrame(const FrameLease& frame) {
+    const CapturedFrame& captured = frame.Frame();
+    const FrameView& raw = captured.raw;
+    if (fd_ < 0 || !raw.IsValid()) {
+        return false;
+    }
+
+    size_t len = std::min<size_t>(raw.size, header_.frame_bytes);
+    RawFrameRecord record = RawFrameRecord();
+    record.magic = RECORD_MAGIC;
+    record.frame_index = index_.size();
+    record.sensor_timestamp_ns = captured.sensor_timestamp_ns;
+    record.sequence = captured.sequence;
+    record.exposure_time_us = captured.exposure_time_us;
+    record.analogue_gain = captured.analogue_gain;
+    record.colour_gains[0] = captured.colour_gains[0];
+    record.colour_gains[1] = captured.colour_gains[1];
+    record.data_bytes = static_cast<uint32_t>(len);
+    record.checksum = recordChecksum(record);
+    std::memcpy(record_page_.data(), &record, sizeof(record));
+
+    // 记录头页和数据连续写出；数据不足一帧或不满一页的部分补零
+    int64_t start_ns = MonotonicNowNs();
+    uint64_t offset = file_offset_;
+    bool ok = pwriteAll(fd_, record_page_.data(), record_page_.size(), offset) &&
+              pwriteAll(fd_, raw.data, len, offset + RAW_CONTAINER_PAGE);
+    uint64_t written = RAW_CONTAINER_PAGE + len;
+    while (ok && written < header_.record_bytes) {
+        static const uint8_t zeros[RAW_CONTAINER_PAGE] = {};
+        size_t n = static_cast<size_t>(std::min<uint64_t>(header_.record_bytes - written, sizeof(zeros)));
+        ok = pwriteAll(fd_, zeros, n, offset + written);
+        written += n;
+    }
+    if (!ok) {
+        std::cerr << "写入 " << path_ << " 失败: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    RawIndexEntry entry = RawIndexEntry();
+    entry.offset = offset;
+    entry.sensor_timestamp_ns = captured.sensor_timestamp_ns;
+    entry.sequence = captured.sequence;
+    index_.push_back(entry);
+    file_offset_ += header_.record_bytes;
+    recordWrite(static_cast<size_t>(header_.record_bytes), MonotonicNowNs() - start_ns);
+    return true;
+}
+
+void ContainerRawSink::Close() {
+    if (fd_ < 0) {
+        return;
+    }
+    if (!finalize(fd_, header_, index_, file_offset_)) {
+        std::cerr << "写入 " << path_ << " 的帧索引失败: " << std::strerror(errno) << std::endl;
+    }
+    if (::close(fd_) != 0) {
+        std::cerr << "关闭 " << path_ << " 失败: " << std::strerror(errno) << std::endl;
+    }
+    fd_ = -1;
+    std::cout << "RAW容器: " << path_ << " (" << index_.size() << " 帧, 每帧记录 "
+              << header_.record_bytes / 1024 << "KB)" << std::endl;
+}
+
+RawContainerReader::RawContainerReader() : map_(nullptr), map_bytes_(0), header_(), recovered_(false) {
+}
+
+RawContainerReader::~RawContainerReader() {
+    Close();
+}
+
+void RawContainerReader::Open(const std::string& path) {
+    Close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("无法打开RAW容器 " + path + ": " + std::strerror(errno));
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<uint64_t>(file_stat.st_size) < sizeof(RawContainerHeader)) {
+        ::close(fd);
+        throw std::runtime_error("RAW容器文件不完整: " + path);
+    }
+
+    // 映射整个文件，帧数据直接从映射内存读取（64位系统上长剪辑也不受地址空间限制）
+    map_bytes_ = static_cast<size_t>(file_stat.st_size);
+    void* address = mmap(nullptr, map_bytes_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        map_bytes_ = 0;
+        throw std::runtime_error("无法映射RAW容器 " + path + ": " + std::strerror(errno));
+    }
+    map_ = static_cast<const uint8_t*>(address);
+
+    std::memcpy(&header_, map_, sizeof(header_));
+    std::string error;
+    if (std::memcmp(header_.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) != 0) {
+        error = "不是RAW容器: ";
+    } else if (header_.version == 0 || header_.version > RAW_CONTAINER_VERSION) {
+        error = "不支持的RAW容器版本 " + std::to_string(header_.version) + ": ";
+    } else if (header_.header_bytes < sizeof(RawContainerHeader) || header_.height == 0 ||
+               header_.frame_bytes == 0 || header_.record_bytes < RAW_CONTAINER_PAGE + header_.frame_bytes) {
+        error = "RAW容器文件头无效: ";
+    }
+    if (!error.empty()) {
+        Close();
+        throw std::runtime_error(error + path);
+    }
+
+    // 索引缺失或与文件不一致时按记录头扫描
+    recovered_ = !loadIndex();
+    if (recovered_) {
+        scanRecords();
+        std::cerr << "警告: " << path << " 未正常关闭，扫描恢复 " << index_.size() << " 帧" << std::endl;
+    }
+}
+
+void RawContainerReader::Close() {
+    if (map_) {
+        munmap(const_cast<uint8_t*>(map_), map_bytes_);
+        map_ = nullptr;
+    }
+    map_bytes_ = 0;
+    index_.clear();
+    recovered_ = false;
+}
+
+bool RawContainerReader::loadIndex() {
+    uint64_t offset = header_.index_offset;
+    if (offset == 0 || offset + sizeof(RawIndexHeader) > map_bytes_) {
+        return false;
+    }
+    RawIndexHeader index_header;
+    std::memcpy(&index_header, map_ + offset, sizeof(index_header));
+    uint64_t entries_bytes = index_header.count * sizeof(RawIndexEntry);
+    if (index_header.magic != INDEX_MAGIC || index_header.count != header_.frame_count ||
+        offset + sizeof(index_header) + entries_bytes > map_bytes_) {
+        return false;
+    }
+
+    index_.resize(index_header.count);
+    std::memcpy(index_.data(), map_ + offset + sizeof(index_header), entries_bytes);
+    for (const RawIndexEntry& entry : index_) {
+        if (entry.offset + header_.record_bytes > offset) {
+            index_.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void RawContainerReader::scanRecords() {
+    // 记录定长，从第一条开始逐条检查记录头，遇到第一条无效或不完整的记录为止。
+    // 记录头校验只能发现没写完的记录头；断电前已分配长度但数据未落盘的尾帧可能包含零数据
+    index_.clear();
+    for (uint64_t offset = header_.header_bytes; offset + header_.record_bytes <= map_bytes_;
+         offset += header_.record_bytes) {
+        RawFrameRecord record;
+        std::memcpy(&record, map_ + offset, sizeof(record));
+        if (record.magic != RECORD_MAGIC || record.checksum != recordChecksum(record) ||
+            record.frame_index != index_.size() || record.data_bytes > header_.frame_bytes) {
+            break;
+        }
+        RawIndexEntry entry = RawIndexEntry();
+        entry.offset = offset;
+        entry.sensor_timestamp_ns = record.sensor_timestamp_ns;
+        entry.sequence = record.sequence;
+        index_.push_back(entry);
+    }
+}
+
+FrameFormat RawContainerReader::Format() const {
+    return FrameFormat(static_cast<PixelEncoding>(header_.encoding), static_cast<BayerOrder>(header_.bayer_order),
+                       static_cast<int>(header_.bit_depth), header_.fourcc);
+}
+
+bool RawContainerReader::ReadFrame(uint64_t n, FrameView& raw, RawFrameRecord& record) const {
+    if (!map_ || n >= index_.size()) {
+        return false;
+    }
+    const uint8_t* base = map_ + index_[n].offset;
+    std::memcpy(&record, base, sizeof(record));
+
+    raw = FrameView();
+    raw.data = base + RAW_CONTAINER_PAGE;
+    raw.size = std::min<size_t>(record.data_bytes, header_.frame_bytes);
+    raw.width = header_.width;
+    raw.height = header_.height;
+    raw.stride = header_.stride;
+    raw.format = Format();
+    return true;
+}
+
+uint64_t RepairRawContainer(const std::string& path) {
+    RawContainerHeader header;
+    std::vector<RawIndexEntry> index;
+    {
+        RawContainerReader reader;
+        reader.Open(path);
+        if (!reader.Recovered()) {
+            return reader.FrameCount();
+        }
+        header = reader.Header();
+        index = reader.Index();
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("无法打开RAW容器 " + path + ": " + std::strerror(errno));
+    }
+    // 索引紧跟在最后一条有效记录之后，覆盖掉不完整的尾部
+    uint64_t end = header.header_bytes + index.size() * header.record_bytes;
+    bool ok = finalize(fd, header, index, end);
+    std::string error = std::strerror(errno);
+    ::close(fd);
+    if (!ok) {
+        throw std::runtime_error("修复RAW容器失败 " + path + ": " + error);
+    }
+    return index.size();
+}
+
+} // namespace cinepi
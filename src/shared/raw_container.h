@@ -0,0 +1,145 @@
+// raw_container.h
+// 带索引的RAW容器（.cpr）：文件头 + 定长页对齐的帧记录 + 尾部帧索引
+//
+// 文件头占一页，记录分辨率、步长、像素编码、CFA排列和剪辑参数；每帧一条记录，
+// 记录头占一页，携带时间戳、序号、曝光时间、增益和白平衡，随后是整帧RAW数据（按步长，含行尾填充），
+// 补齐到页边界。记录长度固定，第N帧的位置可以直接算出，数据在文件中页对齐，可以直接mmap读取。
+// 关闭时在末尾写入帧索引并回写文件头；断电留下的文件没有索引，读取时逐条扫描记录头恢复。
+// 所有字段按小端存储（树莓派和x86相同）。
+
+#ifndef RAW_CONTAINER_H
+#define RAW_CONTAINER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "frame_types.h"
+#include "raw_sink.h"
+
+namespace cinepi {
+
+const uint32_t RAW_CONTAINER_VERSION = 1;
+const size_t RAW_CONTAINER_PAGE = 4096;     // 文件头、记录头和记录长度的对齐单位
+
+// 文件头，位于文件开头，之后补零到header_bytes
+struct RawContainerHeader {
+    char magic[8];                  // "CINEPIRW"
+    uint32_t version;
+    uint32_t header_bytes;          // 文件头长度，即第一条记录的偏移
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t encoding;              // PixelEncoding
+    uint32_t bayer_order;           // BayerOrder
+    uint32_t bit_depth;
+    uint32_t fourcc;
+    int32_t black_level;
+    int32_t fps;
+    int32_t iso;                    // 开始录制时的参数，逐帧的实际值见记录头
+    int32_t white_balance;
+    float exposure_compensation;
+    uint64_t frame_bytes;           // 每帧数据长度（步长×高度）
+    uint64_t record_bytes;          // 每条记录长度（记录头页 + 数据 + 补齐）
+    uint64_t frame_count;           // 正常关闭时的帧数
+    uint64_t index_offset;          // 帧索引的偏移，0表示文件未正常关闭
+    int64_t created_unix_ns;        // 开始录制的时间（Unix时间）
+};
+
+// 帧记录头，位于每条记录开头，之后补零到一页
+struct RawFrameRecord {
+    uint32_t magic;                 // "CPFR"
+    uint32_t checksum;              // 记录头其余字段的校验和，用于恢复时识别有效记录
+    uint64_t frame_index;           // 记录在文件中的序号，从0开始
+    int64_t sensor_timestamp_ns;
+    uint32_t sequence;              // 传感器帧序号
+    int32_t exposure_time_us;       // 0表示未知
+    float analogue_gain;
+    float colour_gains[2];          // 红/蓝增益
+    uint32_t data_bytes;            // 本帧实际数据长度（不超过frame_bytes）
+};
+
+// 帧索引：索引头之后是frame_count个索引项
+struct RawIndexHeader {
+    uint32_t magic;                 // "CPIX"
+    uint32_t version;
+    uint64_t count;
+};
+
+struct RawIndexEntry {
+    uint64_t offset;                // 记录在文件中的偏移
+    int64_t sensor_timestamp_ns;
+    uint32_t sequence;
+    uint32_t reserved;
+};
+
+// 判断文件是否为RAW容器（只检查魔数）
+bool IsRawContainer(const std::string& path);
+
+// 容器落盘：每帧一次写入记录头和数据，关闭时写索引并回写文件头
+class ContainerRawSink : public RawSink {
+public:
+    ContainerRawSink();
+    ~ContainerRawSink() override;
+
+    const char* Name() const override { return "container"; }
+    const char* Extension() const override { return ".cpr"; }
+    uint64_t RecordBytes(const RecordingInfo& info) const override;
+    uint64_t OverheadBytes(const RecordingInfo& info) const override;
+    void Open(const std::string& path, const RecordingInfo& info) override;
+    bool WriteFrame(const FrameLease& frame) override;
+    void Close() override;
+
+private:
+    int fd_;
+    std::string path_;
+    RawContainerHeader header_;
+    std::vector<RawIndexEntry> index_;
+    std::vector<uint8_t> record_page_;      // 记录头页，每帧复用
+    uint64_t file_offset_;
+};
+
+// 容器读取：整个文件只读mmap，按帧号O(1)定位
+class RawContainerReader {
+public:
+    RawContainerReader();
+    ~RawContainerReader();
+
+    RawContainerReader(const RawContainerReader&) = delete;
+    RawContainerReader& operator=(const RawContainerReader&) = delete;
+
+    // 打开并校验文件头；没有索引时扫描记录恢复帧列表。失败时抛出异常
+    void Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return map_ != nullptr; }
+    const RawContainerHeader& Header() const { return header_; }
+    FrameFormat Format() const;
+    uint64_t FrameCount() const { return index_.size(); }
+
+    // 文件未正常关闭，帧列表由扫描记录得到
+    bool Recovered() const { return recovered_; }
+
+    // 第n帧的数据视图（指向映射内存，读取器关闭前有效）和记录头；n越界时返回false
+    bool ReadFrame(uint64_t n, FrameView& raw, RawFrameRecord& record) const;
+
+    const std::vector<RawIndexEntry>& Index() const { return index_; }
+
+private:
+    const uint8_t* map_;
+    size_t map_bytes_;
+    RawContainerHeader header_;
+    std::vector<RawIndexEntry> index_;
+    bool recovered_;
+
+    bool loadIndex();
+    void scanRecords();
+};
+
+// 修复未正常关闭的文件：截掉不完整的尾部记录，写入索引并回写文件头。
+// 返回恢复的帧数，文件已正常关闭时不做修改；失败时抛出异常
+uint64_t RepairRawContainer(const std::string& path);
+
+} // namespace cinepi
+
+#endif // RAW_CONTAINER_H
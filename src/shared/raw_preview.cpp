@@ -0,0 +1,64 @@
+// raw_preview.cpp
+// RAW预览实现
+
+#include "raw_preview.h"
+#include <algorithm>
+
+namespace cinepi {
+
+namespace {
+
+const float PREVIEW_GAMMA = 2.2f;
+
+} // namespace
+
+RawPreview::RawPreview(WorkerPool& pool)
+    : pool_(pool),
+      tone_bit_depth_(0),
+      tone_black_level_(-1),
+      tone_gains_{ -1.0f, -1.0f } {
+}
+
+bool RawPreview::OutputSize(const FrameView& raw, int& width, int& height) {
+    if (!raw.IsValid() || !raw.format.IsBayer() || raw.width < 2 || raw.height < 2) {
+        return false;
+    }
+    width = static_cast<int>(raw.width / 2);
+    height = static_cast<int>(raw.height / 2);
+    return true;
+}
+
+bool RawPreview::Render(const CapturedFrame& frame, int black_level, uint8_t* dst, unsigned int dst_stride) {
+    int width = 0;
+    int height = 0;
+    if (!dst || !OutputSize(frame.raw, width, height)) {
+        return false;
+    }
+
+    // 查找表按RAW位深度、黑电平和白平衡增益生成，参数不变时沿用
+    const float* gains = frame.colour_gains;
+    if (frame.raw.format.bit_depth != tone_bit_depth_ || black_level != tone_black_level_ ||
+        gains[0] != tone_gains_[0] || gains[1] != tone_gains_[1]) {
+        BuildDebayerTone(tone_, frame.raw.format.bit_depth, black_level, gains[0], gains[1], PREVIEW_GAMMA);
+        tone_bit_depth_ = frame.raw.format.bit_depth;
+        tone_black_level_ = black_level;
+        tone_gains_[0] = gains[0];
+        tone_gains_[1] = gains[1];
+    }
+
+    // 每个线程一段连续的输出行
+    unsigned int rows = static_cast<unsigned int>(height);
+    unsigned int bands = static_cast<unsigned int>(std::min<size_t>(pool_.Size(), rows));
+    unsigned int band_rows = (rows + bands - 1) / bands;
+    const FrameView raw = frame.raw;
+    for (unsigned int begin = 0; begin < rows; begin += band_rows) {
+        unsigned int end = std::min(begin + band_rows, rows);
+        pool_.Submit([this, raw, dst, dst_stride, begin, end]() {
+            DebayerHalf(raw, tone_, dst, dst_stride, begin, end);
+        });
+    }
+    pool_.WaitIdle();
+    return true;
+}
+
+} // namespace cinepi
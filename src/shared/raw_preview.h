@@ -0,0 +1,45 @@
+// raw_preview.h
+// RAW预览：直接由RAW帧半分辨率去马赛克生成预览图像，不依赖ISP输出的取景流
+//
+// 输出按行分块交给工作线程并行处理（见DebayerHalf），调用者等待整帧完成后才返回。
+// 输出尺寸固定为RAW的1/2，缩放到显示尺寸见PreviewScaler。白平衡增益或黑电平变化时重建查找表。
+// 只在UI线程调用。
+
+#ifndef RAW_PREVIEW_H
+#define RAW_PREVIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include "debayer.h"
+#include "frame_types.h"
+#include "worker_pool.h"
+
+namespace cinepi {
+
+class RawPreview {
+public:
+    // 在pool的线程中并行处理，pool需比预览存活更久
+    explicit RawPreview(WorkerPool& pool);
+
+    RawPreview(const RawPreview&) = delete;
+    RawPreview& operator=(const RawPreview&) = delete;
+
+    // RAW帧对应的预览尺寸（RAW的1/2），不是Bayer格式时返回false
+    static bool OutputSize(const FrameView& raw, int& width, int& height);
+
+    // 渲染一帧到dst（字节顺序B,G,R，每行dst_stride字节，至少OutputSize大小）
+    bool Render(const CapturedFrame& frame, int black_level, uint8_t* dst, unsigned int dst_stride);
+
+    size_t Threads() const { return pool_.Size(); }
+
+private:
+    WorkerPool& pool_;
+    DebayerTone tone_;
+    int tone_bit_depth_;
+    int tone_black_level_;
+    float tone_gains_[2];
+};
+
+} // namespace cinepi
+
+#endif // RAW_PREVIEW_H
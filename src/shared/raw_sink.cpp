@@ -0,0 +1,155 @@
+// raw_sink.cpp
+// RAW帧落盘实现
+
+#include "raw_sink.h"
+#include "direct_raw_sink.h"
+#include "dng_sink.h"
+#include "raw_container.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace cinepi {
+
+namespace {
+
+// 写满len字节，处理被信号打断和部分写入
+bool writeAll(int fd, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        ssize_t written = ::write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        len -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+} // namespace
+
+bool ParseRawSinkType(const std::string& name, RawSinkType& type) {
+    if (name == "buffered") {
+        type = RawSinkType::Buffered;
+    } else if (name == "direct") {
+        type = RawSinkType::Direct;
+    } else if (name == "dng") {
+        type = RawSinkType::Dng;
+    } else if (name == "dng16") {
+        type = RawSinkType::Dng16;
+    } else if (name == "dng-lj92") {
+        type = RawSinkType::DngLj92;
+    } else if (name == "container") {
+        type = RawSinkType::Container;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool IsFileRawSink(RawSinkType type) {
+    return type == RawSinkType::Buffered || type == RawSinkType::Direct || type == RawSinkType::Container;
+}
+
+RawSink::RawSink() : writes_(0), bytes_(0), total_write_ns_(0), max_write_ns_(0) {
+}
+
+void RawSink::recordWrite(size_t bytes, int64_t latency_ns) {
+    writes_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    total_write_ns_.fetch_add(latency_ns, std::memory_order_relaxed);
+    int64_t max_ns = max_write_ns_.load(std::memory_order_relaxed);
+    while (latency_ns > max_ns && !max_write_ns_.compare_exchange_weak(max_ns, latency_ns, std::memory_order_relaxed)) {
+    }
+}
+
+RawSinkStats RawSink::GetStats() const {
+    RawSinkStats stats;
+    stats.writes = writes_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.mean_write_ms = stats.writes > 0 ? total_write_ns_.load(std::memory_order_relaxed) / 1e6 / stats.writes : 0.0;
+    stats.max_write_ms = max_write_ns_.load(std::memory_order_relaxed) / 1e6;
+    return stats;
+}
+
+FileRawSink::FileRawSink() : fd_(-1), frame_bytes_(0), data_bytes_(0), preallocated_(false) {
+}
+
+FileRawSink::~FileRawSink() {
+    Close();
+}
+
+void FileRawSink::Open(const std::string& path, const RecordingInfo& info) {
+    Close();
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("无法创建录制文件 " + path + ": " + std::strerror(errno));
+    }
+    frame_bytes_ = info.frame_bytes;
+    data_bytes_ = 0;
+    path_ = path;
+
+    // 预留磁盘块但不改变文件长度，写入时不再边写边分配
+    preallocated_ = false;
+    if (info.preallocate_bytes > 0) {
+        preallocated_ = ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(info.preallocate_bytes)) == 0;
+        if (!preallocated_) {
+            std::cerr << "警告: 无法预分配 " << path << ": " << std::strerror(errno) << std::endl;
+        }
+    }
+}
+
+bool FileRawSink::WriteFrame(const FrameLease& frame) {
+    const FrameView& raw = frame->raw;
+    if (fd_ < 0 || !raw.IsValid()) {
+        return false;
+    }
+    size_t len = std::min(raw.size, frame_bytes_);
+    int64_t start_ns = MonotonicNowNs();
+    if (!writeAll(fd_, raw.data, len)) {
+        std::cerr << "写入 " << path_ << " 失败: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    recordWrite(len, MonotonicNowNs() - start_ns);
+    data_bytes_ += len;
+    return true;
+}
+
+void FileRawSink::Close() {
+    if (fd_ >= 0) {
+        if (preallocated_ && ::ftruncate(fd_, static_cast<off_t>(data_bytes_)) != 0) {
+            std::cerr << "截断 " << path_ << " 失败: " << std::strerror(errno) << std::endl;
+        }
+        if (::close(fd_) != 0) {
+            std::cerr << "关闭 " << path_ << " 失败: " << std::strerror(errno) << std::endl;
+        }
+        fd_ = -1;
+    }
+}
+
+std::unique_ptr<RawSink> CreateRawSink(RawSinkType type) {
+    switch (type) {
+        case RawSinkType::Direct:
+            return std::unique_ptr<RawSink>(new DirectRawSink());
+        case RawSinkType::Dng:
+            return std::unique_ptr<RawSink>(new DngSequenceSink(true));
+        case RawSinkType::Dng16:
+            return std::unique_ptr<RawSink>(new DngSequenceSink(false));
+        case RawSinkType::DngLj92:
+            return std::unique_ptr<RawSink>(new DngSequenceSink(true, DngCompression::LosslessJpeg));
+        case RawSinkType::Container:
+            return std::unique_ptr<RawSink>(new ContainerRawSink());
+        case RawSinkType::Buffered:
+        default:
+            return std::unique_ptr<RawSink>(new FileRawSink());
+    }
+}
+
+} // namespace cinepi
@@ -0,0 +1,130 @@
+// raw_sink.h
+// RAW帧落盘接口
+//
+// 写入线程只通过这个接口写帧，不同的落盘方式（普通文件、直接I/O、DNG序列等）各自实现；
+// 所有调用都在写入线程中进行，实现需要并行处理时自行持有帧租约。
+
+#ifndef RAW_SINK_H
+#define RAW_SINK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "frame_lease.h"
+#include "frame_types.h"
+
+namespace cinepi {
+
+// 落盘方式
+enum class RawSinkType {
+    Buffered,   // 普通文件写入，经过页缓存
+    Direct,     // O_DIRECT对齐写入，多个写请求并行，绕过页缓存
+    Dng,        // CinemaDNG序列，每帧一个文件，12位数据按TIFF打包
+    Dng16,      // CinemaDNG序列，数据存为16位
+    DngLj92,    // CinemaDNG序列，分块无损JPEG压缩
+    Container   // 带文件头、逐帧元数据和帧索引的RAW容器
+};
+
+// 解析落盘方式名称（buffered/direct/dng/dng16/dng-lj92/container），未知名称返回false
+bool ParseRawSinkType(const std::string& name, RawSinkType& type);
+
+// 录制描述，打开输出时传给落盘实现
+struct RecordingInfo {
+    FrameFormat format;
+    unsigned int width;
+    unsigned int height;
+    size_t frame_bytes;             // 每帧字节数（步长×高度，含行尾填充）
+    int fps;
+    int black_level;
+    int iso;
+    int white_balance;              // 色温（K）
+    float exposure_compensation;
+    uint64_t preallocate_bytes;     // 打开时预分配的磁盘空间（字节），0表示按落盘方式的默认值
+
+    RecordingInfo() : width(0), height(0), frame_bytes(0), fps(30), black_level(0), iso(100), white_balance(4000),
+                      exposure_compensation(0.0f), preallocate_bytes(0) {}
+};
+
+// 写请求统计，用于比较不同落盘方式在同一块盘上的表现
+struct RawSinkStats {
+    uint64_t writes;        // 完成的写请求数
+    uint64_t bytes;
+    double mean_write_ms;   // 单次写请求从提交到完成的平均耗时
+    double max_write_ms;
+};
+
+// RAW帧落盘基类
+class RawSink {
+public:
+    RawSink();
+    virtual ~RawSink() = default;
+
+    // 名称，用于日志
+    virtual const char* Name() const = 0;
+
+    // 输出路径的扩展名，为空表示输出是一个目录
+    virtual const char* Extension() const { return ".raw"; }
+
+    // 每帧在文件中占用的字节数（含记录头、对齐填充和索引项），分段按此折算每段帧数
+    virtual uint64_t RecordBytes(const RecordingInfo& info) const { return info.frame_bytes; }
+
+    // 与帧数无关的文件开销（文件头、索引头等）
+    virtual uint64_t OverheadBytes(const RecordingInfo&) const { return 0; }
+
+    // 落盘前需要在CPU上编码的实现用样本帧实测能持续的帧率（不含写文件），只能在打开前调用；
+    // 不编码的实现返回0，只受存储带宽限制
+    virtual double MeasureSustainableFps(const FrameView&) { return 0.0; }
+
+    // 打开输出；失败时抛出异常
+    virtual void Open(const std::string& path, const RecordingInfo& info) = 0;
+
+    // 写入一帧，失败时返回false；异步处理的实现可以复制租约，返回后帧仍然有效
+    virtual bool WriteFrame(const FrameLease& frame) = 0;
+
+    // 刷新并关闭输出
+    virtual void Close() = 0;
+
+    // 写请求统计（线程安全）；组合多个输出的实现汇总各自的统计
+    virtual RawSinkStats GetStats() const;
+
+protected:
+    // 记录一次完成的写请求
+    void recordWrite(size_t bytes, int64_t latency_ns);
+
+private:
+    std::atomic<uint64_t> writes_;
+    std::atomic<uint64_t> bytes_;
+    std::atomic<int64_t> total_write_ns_;
+    std::atomic<int64_t> max_write_ns_;
+};
+
+// 输出是否为单个文件（可以按分段切换）
+bool IsFileRawSink(RawSinkType type);
+
+// 普通文件写入：write()直接写入内核，不在用户态再做一层缓冲
+class FileRawSink : public RawSink {
+public:
+    FileRawSink();
+    ~FileRawSink() override;
+
+    const char* Name() const override { return "file"; }
+    void Open(const std::string& path, const RecordingInfo& info) override;
+    bool WriteFrame(const FrameLease& frame) override;
+    void Close() override;
+
+private:
+    int fd_;
+    size_t frame_bytes_;
+    uint64_t data_bytes_;       // 已写入的长度，关闭时截掉多余的预分配
+    bool preallocated_;
+    std::string path_;
+};
+
+// 根据类型创建落盘实现
+std::unique_ptr<RawSink> CreateRawSink(RawSinkType type);
+
+} // namespace cinepi
+
+#endif // RAW_SINK_H
@@ -0,0 +1,325 @@
+// raw_writer.cpp
+// 异步RAW写入实现
+
+#include "raw_writer.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace cinepi {
+
+namespace {
+
+// 队列满时每隔多少次丢帧打印一次日志
+const uint64_t DROP_LOG_INTERVAL = 24;
+
+// BlockCapture策略下单次等待空位的时长，期间会检查是否已停止
+const std::chrono::milliseconds BLOCK_WAIT(100);
+
+// 分配队列后至少留给系统和其他进程的内存
+const uint64_t MEMORY_RESERVE_BYTES = 512ULL * 1024 * 1024;
+
+// 录制队列容量：显式帧数优先，否则按内存上限折算，至少两帧
+size_t queueCapacity(const RawWriterConfig& config, size_t frame_bytes) {
+    size_t capacity = config.ring_frames;
+    if (capacity == 0) {
+        capacity = config.ring_megabytes * 1024 * 1024 / frame_bytes;
+    }
+    return std::max<size_t>(capacity, 2);
+}
+
+} // namespace
+
+bool ParseOverrunPolicy(const std::string& name, OverrunPolicy& policy) {
+    if (name == "block") {
+        policy = OverrunPolicy::BlockCapture;
+    } else if (name == "drop") {
+        policy = OverrunPolicy::DropAndLog;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+RawWriter::RawWriter()
+    : sink_name_("none"),
+      last_sink_stats_(),
+      frame_bytes_(0),
+      running_(false),
+      armed_(false),
+      stop_requested_(false),
+      error_(false),
+      high_water_(0),
+      frames_written_(0),
+      frames_dropped_(0),
+      bytes_written_(0),
+      blocked_ns_(0),
+      preroll_flushed_(0),
+      start_time_ns_(0),
+      stop_time_ns_(0) {
+}
+
+RawWriter::~RawWriter() {
+    Stop();
+}
+
+void RawWriter::allocateQueue(size_t frame_bytes, const RawWriterConfig& config) {
+    size_t capacity = queueCapacity(config, frame_bytes) + config.preroll_frames;
+    size_t aligned_bytes = (frame_bytes + FramePool::ALIGNMENT - 1) / FramePool::ALIGNMENT * FramePool::ALIGNMENT;
+    // 比较内存池本身的帧数：上次重新分配因仍有帧未归还而失败时，这次要重试
+    if (capacity == ring_.Capacity() && capacity == pool_.Count() && aligned_bytes == pool_.FrameBytes()) {
+        ring_.Reset(capacity);
+        return;
+    }
+
+    // 已分配的队列释放后可以重新使用，按差额检查可用内存
+    uint64_t required = static_cast<uint64_t>(capacity) * aligned_bytes;
+    uint64_t current = static_cast<uint64_t>(pool_.Count()) * pool_.FrameBytes();
+    uint64_t available = AvailableMemoryBytes();
+    if (available > 0 && required > current && required - current + MEMORY_RESERVE_BYTES > available) {
+        throw std::runtime_error("写入队列需要 " + std::to_string(required / (1024 * 1024)) + "MB（含预卷 " +
+                                 std::to_string(config.preroll_frames) + " 帧），系统可用内存只有 " +
+                                 std::to_string(available / (1024 * 1024)) + "MB，请减小--preroll或--ring-mb");
+    }
+
+    // 先清空队列归还所有帧，内存池才能重新分配；编码线程或代理旁路仍持有帧时Allocate抛出异常
+    ring_.Reset(capacity);
+    pool_.Allocate(capacity, frame_bytes);
+}
+
+void RawWriter::Arm(const RecordingInfo& info, const RawWriterConfig& config) {
+    if (thread_.joinable() || info.frame_bytes == 0) {
+        throw std::runtime_error("RAW写入参数无效");
+    }
+
+    // 分配期间采集线程的Submit等待，分配完成后直接进入预卷
+    std::lock_guard<std::mutex> lock(submit_mutex_);
+    armed_ = false;
+    allocateQueue(info.frame_bytes, config);
+    config_ = config;
+    frame_bytes_ = info.frame_bytes;
+    armed_ = config.preroll_frames > 0;
+
+    if (armed_) {
+        std::cout << "RAW预卷: " << config.preroll_frames << " 帧 ("
+                  << config.preroll_frames * pool_.FrameBytes() / (1024 * 1024) << "MB"
+                  << (pool_.IsLocked() ? ", 已锁定内存" : ", 内存未锁定") << ")" << std::endl;
+    }
+}
+
+void RawWriter::Start(std::unique_ptr<RawSink> sink, const std::string& path, const RecordingInfo& info,
+                      const RawWriterConfig& config) {
+    Stop();
+    size_t frame_bytes = info.frame_bytes;
+    if (!sink || frame_bytes == 0) {
+        throw std::runtime_error("RAW写入参数无效");
+    }
+
+    sink->Open(path, info);
+
+    // 预卷的帧格式和队列配置不变时保留队列内容，否则丢弃预卷重新分配
+    bool keep_preroll = armed_.load(std::memory_order_acquire) && frame_bytes == frame_bytes_ &&
+                        config.preroll_frames == config_.preroll_frames &&
+                        queueCapacity(config, frame_bytes) == queueCapacity(config_, frame_bytes_);
+    if (!keep_preroll) {
+        try {
+            std::lock_guard<std::mutex> lock(submit_mutex_);
+            armed_ = false;
+            allocateQueue(frame_bytes, config);
+        } catch (...) {
+            sink->Close();
+            throw;
+        }
+    }
+
+    sink_ = std::move(sink);
+    sink_name_ = sink_->Name();
+    error_ = false;
+    stop_requested_ = false;
+    high_water_ = 0;
+    frames_written_ = 0;
+    frames_dropped_ = 0;
+    bytes_written_ = 0;
+    blocked_ns_ = 0;
+    start_time_ns_ = MonotonicNowNs();
+    stop_time_ns_ = 0;
+
+    // 在入队锁内从预卷切换到录制：此后的帧都排在预卷帧之后
+    {
+        std::lock_guard<std::mutex> lock(submit_mutex_);
+        config_ = config;
+        frame_bytes_ = frame_bytes;
+        preroll_flushed_ = keep_preroll ? ring_.Size() : 0;
+        armed_ = false;
+        running_ = true;
+    }
+    thread_ = std::thread(&RawWriter::run, this);
+
+    std::cout << "RAW写入(" << sink_->Name() << "): 队列 " << ring_.Capacity() << " 帧 ("
+              << ring_.Capacity() * pool_.FrameBytes() / (1024 * 1024) << "MB), 队列满时"
+              << (config_.policy == OverrunPolicy::BlockCapture ? "阻塞采集" : "丢帧");
+    if (preroll_flushed_ > 0) {
+        std::cout << ", 预卷 " << preroll_flushed_ << " 帧";
+    }
+    std::cout << std::endl;
+}
+
+void RawWriter::Stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+
+    // 先拒绝新帧，等正在入队的Submit返回后再通知写入线程收尾
+    running_ = false;
+    {
+        std::lock_guard<std::mutex> lock(submit_mutex_);
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stop_requested_ = true;
+    }
+    wake_cv_.notify_one();
+    thread_.join();
+
+    sink_->Close();
+    last_sink_stats_ = sink_->GetStats();
+    sink_.reset();
+    stop_time_ns_ = MonotonicNowNs();
+
+    // 队列已写空，重新开始积累下一次录制的预卷
+    if (config_.preroll_frames > 0) {
+        std::lock_guard<std::mutex> lock(submit_mutex_);
+        armed_ = true;
+    }
+}
+
+bool RawWriter::submitPreroll(const CapturedFrame& frame) {
+    // 写入线程未运行，采集线程同时是队列的消费者：先淘汰到上限以下，再复制新帧
+    FrameLease oldest;
+    while (ring_.Size() >= config_.preroll_frames && ring_.TryPop(oldest)) {
+        oldest.Release();
+    }
+    FrameLease copy = pool_.TryCopy(frame);
+    while (!copy && ring_.TryPop(oldest)) {
+        oldest.Release();
+        copy = pool_.TryCopy(frame);
+    }
+    return copy && ring_.TryPush(std::move(copy));
+}
+
+bool RawWriter::Submit(const FrameLease& lease) {
+    std::lock_guard<std::mutex> lock(submit_mutex_);
+    if (!lease || !lease->raw.IsValid()) {
+        return false;
+    }
+    const CapturedFrame& frame = lease.Frame();
+    if (armed_.load(std::memory_order_relaxed)) {
+        return submitPreroll(frame);
+    }
+    if (!running_.load(std::memory_order_acquire) || error_.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    // 复制到内存池后传感器缓冲立即归还，队列深度不受传感器缓冲数量限制
+    FrameLease copy = pool_.TryCopy(frame);
+    if (!copy && config_.policy == OverrunPolicy::BlockCapture) {
+        int64_t wait_start = MonotonicNowNs();
+        while (!copy && running_.load(std::memory_order_acquire) && !error_.load(std::memory_order_acquire)) {
+            copy = pool_.CopyWait(frame, BLOCK_WAIT);
+        }
+        blocked_ns_.fetch_add(MonotonicNowNs() - wait_start, std::memory_order_relaxed);
+        if (!copy) {
+            return false;   // 等待期间停止或出错，不算作丢帧
+        }
+    }
+
+    // 内存池与队列容量相同，拿到空闲帧就一定能入队
+    if (!copy || !ring_.TryPush(std::move(copy))) {
+        uint64_t dropped = frames_dropped_.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (dropped == 1 || dropped % DROP_LOG_INTERVAL == 0) {
+            std::cerr << "警告: RAW写入队列已满，丢弃帧 " << frame.sequence << " (累计 " << dropped << " 帧)" << std::endl;
+        }
+        return false;
+    }
+
+    size_t queued = ring_.Size();
+    size_t high_water = high_water_.load(std::memory_order_relaxed);
+    while (queued > high_water && !high_water_.compare_exchange_weak(high_water, queued, std::memory_order_relaxed)) {
+    }
+
+    {
+        std::lock_guard<std::mutex> wake_lock(wake_mutex_);
+    }
+    wake_cv_.notify_one();
+    return true;
+}
+
+void RawWriter::run() {
+    FrameLease lease;
+    while (true) {
+        // 先读停止标志再取帧：标志置位时所有入队都已完成，取不到即为写完
+        bool stopping = stop_requested_.load(std::memory_order_acquire);
+        if (ring_.TryPop(lease)) {
+            // 出错后继续取出剩余帧，只释放不写入
+            if (!error_.load(std::memory_order_acquire)) {
+                writeFrame(lease);
+            }
+            lease.Release();
+            continue;
+        }
+        if (stopping) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_cv_.wait_for(lock, BLOCK_WAIT, [this] {
+            return ring_.Size() > 0 || stop_requested_.load(std::memory_order_acquire);
+        });
+    }
+}
+
+bool RawWriter::writeFrame(const FrameLease& lease) {
+    const CapturedFrame& frame = lease.Frame();
+    if (!sink_->WriteFrame(lease)) {
+        std::cerr << "RAW写入失败，停止接收新帧" << std::endl;
+        error_ = true;
+        return false;
+    }
+
+    uint64_t index = frames_written_.fetch_add(1, std::memory_order_relaxed);
+    bytes_written_.fetch_add(std::min(frame.raw.size, frame_bytes_), std::memory_order_relaxed);
+
+    // 采集到落盘（交给内核或设备）的延迟；预卷帧在开始录制前就已采集，不计入
+    if (config_.stats && frame.sensor_timestamp_ns >= start_time_ns_) {
+        config_.stats->RecordDiskLatency(MonotonicNowNs() - frame.sensor_timestamp_ns);
+    }
+    if (config_.tap) {
+        config_.tap->OnFrameWritten(lease, index, ring_.Size(), ring_.Capacity());
+    }
+    return true;
+}
+
+RawWriterStats RawWriter::GetStats() const {
+    RawWriterStats stats;
+    stats.capacity = ring_.Capacity();
+    stats.queued = IsRunning() ? ring_.Size() : 0;
+    stats.high_water = high_water_.load(std::memory_order_relaxed);
+    stats.frames_written = frames_written_.load(std::memory_order_relaxed);
+    stats.frames_dropped = frames_dropped_.load(std::memory_order_relaxed);
+    stats.bytes_written = bytes_written_.load(std::memory_order_relaxed);
+    stats.blocked_ms = blocked_ns_.load(std::memory_order_relaxed) / 1e6;
+    stats.preroll_held = armed_.load(std::memory_order_relaxed) ? ring_.Size() : 0;
+    stats.preroll_capacity = config_.preroll_frames;
+    stats.preroll_flushed = preroll_flushed_;
+    stats.sink = sink_ ? sink_->GetStats() : last_sink_stats_;
+
+    int64_t end_ns = stop_time_ns_.load(std::memory_order_relaxed);
+    if (end_ns == 0) {
+        end_ns = MonotonicNowNs();
+    }
+    double seconds = (end_ns - start_time_ns_) / 1e9;
+    stats.write_mb_per_s = seconds > 0 ? stats.bytes_written / (1024.0 * 1024.0) / seconds : 0.0;
+    return stats;
+}
+
+} // namespace cinepi
@@ -0,0 +1,151 @@
+// raw_writer.h
+// 异步RAW写入：采集线程把帧复制进预分配的内存池并压入有界环形队列，
+// 专用写入线程取出后落盘，UI线程和采集线程都不接触磁盘
+//
+// 队列容量按帧数或内存大小设置；存储跟不上时按策略阻塞采集或丢帧并记录。
+//
+// 预卷：未录制时队列保持最近preroll_frames帧，采集线程自己淘汰最旧的帧；
+// 开始录制时只是启动写入线程，队列中的预卷帧先于新帧落盘，不复制也不阻塞采集。
+// 队列内存锁定在物理内存中，预卷期间也可能随时开始录制。
+
+#ifndef RAW_WRITER_H
+#define RAW_WRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "frame_lease.h"
+#include "frame_pool.h"
+#include "frame_stats.h"
+#include "raw_sink.h"
+#include "spsc_ring.h"
+
+namespace cinepi {
+
+// 队列满时的处理策略
+enum class OverrunPolicy {
+    BlockCapture,   // 阻塞采集线程直到有空位，传感器侧随之丢帧
+    DropAndLog      // 丢弃新帧并记录，采集不受影响
+};
+
+// 解析策略名称（block/drop），未知名称返回false
+bool ParseOverrunPolicy(const std::string& name, OverrunPolicy& policy);
+
+// 旁路处理：写入线程每落盘一帧调用一次，从同一帧派生其他输出（如代理流）。
+// 调用在写入线程中进行，实现必须立即返回，需要保留帧时复制租约
+class FrameTap {
+public:
+    virtual ~FrameTap() = default;
+
+    // index为帧在本次录制中的序号（与落盘输出中的帧号一致），queued/capacity为此时写入队列的占用
+    virtual void OnFrameWritten(const FrameLease& frame, uint64_t index, size_t queued, size_t capacity) = 0;
+};
+
+// 写入配置
+struct RawWriterConfig {
+    size_t ring_frames;         // 队列容量（帧），0表示按ring_megabytes计算
+    size_t ring_megabytes;      // 队列内存上限（MB）
+    OverrunPolicy policy;
+    size_t preroll_frames;      // 预卷帧数，0表示不预卷；队列总容量为预卷加上ring_frames
+    FrameStats* stats;          // 可选，记录采集到落盘的延迟
+    FrameTap* tap;              // 可选，每帧落盘后的旁路处理
+
+    RawWriterConfig() : ring_frames(0), ring_megabytes(512), policy(OverrunPolicy::DropAndLog), preroll_frames(0),
+                        stats(nullptr), tap(nullptr) {}
+};
+
+// 写入统计
+struct RawWriterStats {
+    size_t capacity;            // 队列容量（帧）
+    size_t queued;              // 当前排队帧数
+    size_t high_water;          // 排队帧数的最大值
+    uint64_t frames_written;
+    uint64_t frames_dropped;    // 队列满被丢弃的帧
+    uint64_t bytes_written;
+    double blocked_ms;          // 采集线程因队列满被阻塞的总时间
+    double write_mb_per_s;      // 录制开始以来的平均写入速度
+    size_t preroll_held;        // 未录制时队列中保存的预卷帧数
+    size_t preroll_capacity;    // 预卷帧数上限
+    uint64_t preroll_flushed;   // 本次录制开头写入的预卷帧数
+    RawSinkStats sink;          // 落盘写请求统计
+};
+
+class RawWriter {
+public:
+    RawWriter();
+    ~RawWriter();
+
+    RawWriter(const RawWriter&) = delete;
+    RawWriter& operator=(const RawWriter&) = delete;
+
+    // 分配队列并开始预卷（config.preroll_frames为0时只预先分配队列），只能在未录制时调用。
+    // 队列内存超出系统可用内存时抛出异常
+    void Arm(const RecordingInfo& info, const RawWriterConfig& config);
+
+    // 打开输出、分配队列并启动写入线程；失败时抛出异常
+    // 已预卷且帧格式未变时，队列中的预卷帧成为录制的开头
+    void Start(std::unique_ptr<RawSink> sink, const std::string& path, const RecordingInfo& info,
+               const RawWriterConfig& config);
+
+    // 停止接收新帧，写完队列中剩余的帧后关闭输出；配置了预卷时重新开始预卷
+    void Stop();
+
+    bool IsRunning() const { return running_.load(std::memory_order_acquire); }
+
+    // 采集线程：提交一帧，帧数据被复制后立即返回（BlockCapture策略下队列满时等待）
+    // 返回false表示没有写入队列
+    bool Submit(const FrameLease& lease);
+
+    // 写入失败后不再接收新帧
+    bool HasError() const { return error_.load(std::memory_order_acquire); }
+
+    // 写入统计，与Start/Stop在同一线程调用
+    RawWriterStats GetStats() const;
+
+    // 当前（或上一次）使用的落盘方式名称
+    const char* GetSinkName() const { return sink_name_; }
+
+private:
+    std::unique_ptr<RawSink> sink_;
+    RawWriterConfig config_;
+    const char* sink_name_;
+    RawSinkStats last_sink_stats_;     // 停止时保存，sink_释放后仍可查询
+    LockedFramePool pool_;
+    SpscRing<FrameLease> ring_;
+    size_t frame_bytes_;
+    std::thread thread_;
+
+    // 停止时等待正在进行的Submit返回，之后不会再有帧入队；预卷和录制之间的切换也在这个锁内完成
+    std::mutex submit_mutex_;
+
+    // 写入线程在队列空时等待
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+
+    std::atomic<bool> running_;
+    std::atomic<bool> armed_;           // 预卷中：采集线程入队并淘汰最旧的帧，写入线程未运行
+    std::atomic<bool> stop_requested_;
+    std::atomic<bool> error_;
+    std::atomic<size_t> high_water_;
+    std::atomic<uint64_t> frames_written_;
+    std::atomic<uint64_t> frames_dropped_;
+    std::atomic<uint64_t> bytes_written_;
+    std::atomic<int64_t> blocked_ns_;
+    uint64_t preroll_flushed_;
+    int64_t start_time_ns_;
+    std::atomic<int64_t> stop_time_ns_;
+
+    void run();
+    bool writeFrame(const FrameLease& lease);
+    bool submitPreroll(const CapturedFrame& frame);
+    void allocateQueue(size_t frame_bytes, const RawWriterConfig& config);
+};
+
+} // namespace cinepi
+
+#endif // RAW_WRITER_H
@@ -0,0 +1,196 @@
+// replay_frame_source.cpp
+// 回放帧来源实现
+//
+// .raw文件没有文件头，分辨率和位深度取自CameraParams，帧间隔按params.fps。
+// 行步长依次尝试：显式指定、32字节对齐（录制程序写入的格式）、紧密排列，取能整除文件大小的一个。
+// RAW容器的分辨率、步长、格式和帧率都取自文件头，未正常关闭的文件按扫描恢复的帧回放；
+// 帧间隔和帧序号按每条记录的传感器时间戳和序号，源录像中的丢帧间隙和帧间隔抖动原样重现。
+
+#include "replay_frame_source.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bit_pack.h"
+#include "debayer.h"
+
+namespace cinepi {
+
+ReplayFrameSource::ReplayFrameSource() : fd_(-1), frame_count_(0), loop_(true), loop_ns_(0), loop_sequences_(0) {
+}
+
+ReplayFrameSource::~ReplayFrameSource() {
+    Close();
+}
+
+void ReplayFrameSource::Open(const CameraParams& params) {
+    path_ = params.replay_path;
+    loop_ = params.replay_loop;
+
+    if (IsRawContainer(path_)) {
+        openContainer(params);
+        return;
+    }
+
+    fd_ = ::open(path_.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        throw std::runtime_error("无法打开回放文件: " + path_);
+    }
+
+    struct stat file_stat;
+    if (fstat(fd_, &file_stat) != 0 || file_stat.st_size <= 0) {
+        Close();
+        throw std::runtime_error("回放文件为空: " + path_);
+    }
+    uint64_t file_size = static_cast<uint64_t>(file_stat.st_size);
+
+    unsigned int width = static_cast<unsigned int>(params.width) & ~1u;
+    unsigned int height = static_cast<unsigned int>(params.height) & ~1u;
+    PixelEncoding encoding = PackedEncodingForBitDepth(params.bit_depth);
+    int bit_depth = EncodingBitDepth(encoding);
+
+    // 确定行步长
+    unsigned int candidates[3] = {
+        static_cast<unsigned int>(params.replay_stride),
+        AlignedRawStride(encoding, width),
+        static_cast<unsigned int>(RawRowBytes(encoding, width))
+    };
+    unsigned int stride = 0;
+    for (unsigned int candidate : candidates) {
+        uint64_t frame_size = static_cast<uint64_t>(candidate) * height;
+        if (candidate > 0 && file_size >= frame_size && file_size % frame_size == 0) {
+            stride = candidate;
+            break;
+        }
+    }
+    if (stride == 0) {
+        Close();
+        throw std::runtime_error("回放文件大小与分辨率/位深度不匹配: " + path_);
+    }
+    frame_count_ = file_size / (static_cast<uint64_t>(stride) * height);
+
+    // RAW预览时不生成取景帧
+    unsigned int preview_width = params.raw_preview ? 0 : static_cast<unsigned int>(params.PreviewWidth());
+    unsigned int preview_height = params.raw_preview ? 0 : static_cast<unsigned int>(params.PreviewHeight());
+
+    fps_ = params.fps;
+    allocatePool(FrameFormat(encoding, BayerOrder::RGGB, bit_depth), width, height, stride, preview_width, preview_height);
+    std::cout << "回放: " << path_ << " (" << frame_count_ << "帧)" << std::endl;
+}
+
+void ReplayFrameSource::openContainer(const CameraParams& params) {
+    container_.Open(path_);
+    const RawContainerHeader& header = container_.Header();
+    frame_count_ = container_.FrameCount();
+    if (frame_count_ == 0) {
+        Close();
+        throw std::runtime_error("回放文件没有完整的帧: " + path_);
+    }
+
+    // 预览宽度按参数，高度按容器的宽高比
+    CameraParams preview_params = params;
+    preview_params.width = static_cast<int>(header.width);
+    preview_params.height = static_cast<int>(header.height);
+    preview_params.preview_height = 0;
+
+    fps_ = header.fps > 0 ? header.fps : params.fps;
+
+    // 时间戳或序号缺失、不递增时（例如外部工具生成的文件）退回按文件头帧率回放
+    const std::vector<RawIndexEntry>& index = container_.Index();
+    frame_times_ns_.clear();
+    frame_sequences_.clear();
+    bool timed = !index.empty() && index.front().sensor_timestamp_ns > 0;
+    for (size_t i = 1; timed && i < index.size(); ++i) {
+        timed = index[i].sensor_timestamp_ns > index[i - 1].sensor_timestamp_ns &&
+                index[i].sequence > index[i - 1].sequence;
+    }
+    if (timed) {
+        frame_times_ns_.reserve(index.size());
+        frame_sequences_.reserve(index.size());
+        for (const RawIndexEntry& entry : index) {
+            frame_times_ns_.push_back(entry.sensor_timestamp_ns - index.front().sensor_timestamp_ns);
+            frame_sequences_.push_back(entry.sequence - index.front().sequence);
+        }
+        int64_t span_ns = frame_times_ns_.back();
+        uint32_t span_sequences = frame_sequences_.back();
+        loop_ns_ = span_ns + (span_sequences > 0 ? span_ns / span_sequences : 1000000000LL / std::max(fps_, 1));
+        loop_sequences_ = span_sequences + 1;
+    }
+
+    allocatePool(container_.Format(), header.width, header.height, header.stride,
+                 params.raw_preview ? 0 : static_cast<unsigned int>(preview_params.PreviewWidth()),
+                 params.raw_preview ? 0 : static_cast<unsigned int>(preview_params.PreviewHeight()));
+    std::cout << "回放: " << path_ << " (RAW容器, " << frame_count_ << "帧, "
+              << (timed ? "按逐帧时间戳" : "按固定帧率") << ")" << std::endl;
+}
+
+std::chrono::nanoseconds ReplayFrameSource::frameTime(uint64_t index) const {
+    if (frame_times_ns_.empty() || frame_count_ == 0) {
+        return SoftwareFrameSource::frameTime(index);
+    }
+    uint64_t pass = index / frame_count_;
+    return std::chrono::nanoseconds(static_cast<int64_t>(pass) * loop_ns_ + frame_times_ns_[index % frame_count_]);
+}
+
+uint32_t ReplayFrameSource::frameSequence(uint64_t index) const {
+    if (frame_sequences_.empty() || frame_count_ == 0) {
+        return SoftwareFrameSource::frameSequence(index);
+    }
+    uint64_t pass = index / frame_count_;
+    return static_cast<uint32_t>(pass * loop_sequences_ + frame_sequences_[index % frame_count_]);
+}
+
+void ReplayFrameSource::Close() {
+    SoftwareFrameSource::Close();
+    container_.Close();
+    frame_times_ns_.clear();
+    frame_sequences_.clear();
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool ReplayFrameSource::fillFrame(PoolBuffer& buffer, uint64_t index) {
+    if ((fd_ < 0 && !container_.IsOpen()) || frame_count_ == 0 || (!loop_ && index >= frame_count_)) {
+        return false;
+    }
+
+    uint64_t frame_index = index % frame_count_;
+    size_t frame_size = raw_template_.size;
+    if (container_.IsOpen()) {
+        // 容器按帧号直接定位，从映射内存复制整帧
+        FrameView view;
+        RawFrameRecord record;
+        if (!container_.ReadFrame(frame_index, view, record)) {
+            return false;
+        }
+        std::memcpy(buffer.raw.data(), view.data, std::min(view.size, frame_size));
+    } else {
+        // 读取整帧到缓冲池
+        off_t offset = static_cast<off_t>(frame_index * frame_size);
+        size_t done = 0;
+        while (done < frame_size) {
+            ssize_t ret = pread(fd_, buffer.raw.data() + done, frame_size - done, offset + static_cast<off_t>(done));
+            if (ret <= 0) {
+                std::cerr << "读取回放文件失败: " << path_ << std::endl;
+                return false;
+            }
+            done += static_cast<size_t>(ret);
+        }
+    }
+
+    // 生成预览（RAW预览时没有取景帧）
+    if (!buffer.viewfinder.empty()) {
+        FrameView raw_view = raw_template_;
+        raw_view.data = buffer.raw.data();
+        DebayerToRGB888(raw_view, buffer.viewfinder.data(), viewfinder_template_.width,
+                        viewfinder_template_.height, viewfinder_template_.stride);
+    }
+    return true;
+}
+
+} // namespace cinepi
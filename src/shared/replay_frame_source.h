@@ -0,0 +1,43 @@
+// replay_frame_source.h
+// 回放帧来源：按录制帧率流式读取已有的.raw录像，或按逐帧时间戳回放RAW容器（.cpr）
+
+#ifndef REPLAY_FRAME_SOURCE_H
+#define REPLAY_FRAME_SOURCE_H
+
+#include <string>
+#include <vector>
+#include "raw_container.h"
+#include "software_frame_source.h"
+
+namespace cinepi {
+
+class ReplayFrameSource : public SoftwareFrameSource {
+public:
+    ReplayFrameSource();
+    ~ReplayFrameSource() override;
+
+    const char* Name() const override { return "replay"; }
+    void Open(const CameraParams& params) override;
+    void Close() override;
+
+protected:
+    bool fillFrame(PoolBuffer& buffer, uint64_t index) override;
+    std::chrono::nanoseconds frameTime(uint64_t index) const override;
+    uint32_t frameSequence(uint64_t index) const override;
+
+private:
+    void openContainer(const CameraParams& params);
+    int fd_;
+    RawContainerReader container_;     // 容器文件的格式取自文件头，帧数据从映射内存复制
+    std::string path_;
+    uint64_t frame_count_;
+    bool loop_;
+    std::vector<int64_t> frame_times_ns_;       // 容器每帧相对第一帧的传感器时间，为空时按固定帧率
+    std::vector<uint32_t> frame_sequences_;     // 容器每帧相对第一帧的帧序号
+    int64_t loop_ns_;                           // 循环回放时一遍的时长（最后一帧之后再隔一个平均帧间隔）
+    uint32_t loop_sequences_;                   // 循环回放时一遍的帧序号跨度
+};
+
+} // namespace cinepi
+
+#endif // REPLAY_FRAME_SOURCE_H
@@ -0,0 +1,313 @@
+// scopes.cpp
+// 示波器实现
+
+#include "scopes.h"
+#include <algorithm>
+#include <cstdlib>
+#include "frame_types.h"
+
+namespace cinepi {
+
+namespace {
+
+// 直方图分档（8位亮度）
+const unsigned int HISTOGRAM_BINS = 256;
+// 直方图累加时交替使用的子直方图个数：连续相同的值（平坦画面）不会反复读写同一个计数，避免存储到加载的依赖
+const unsigned int HISTOGRAM_LANES = 4;
+// 波形图每列的电平级数，8位值的两级对应一行
+const unsigned int WAVEFORM_LEVELS = SCOPE_HEIGHT;
+const unsigned int WAVEFORM_CELLS = SCOPE_WIDTH * WAVEFORM_LEVELS;
+// 分量图每个通道的列数
+const unsigned int PARADE_COLUMNS = SCOPE_WIDTH / 3;
+const uint32_t PARADE_CHANNEL_CELLS = PARADE_COLUMNS * WAVEFORM_LEVELS;
+
+// 采样网格步长和统计间隔的上限
+const unsigned int MAX_STEP = 16;
+const unsigned int MAX_INTERVAL = 60;
+
+// 按键循环的统计频率档位：{ 每N帧, 网格步长 }
+const unsigned int SCOPE_RATES[][2] = { { 1, 1 }, { 1, 2 }, { 1, 4 }, { 2, 2 }, { 4, 4 } };
+const size_t SCOPE_RATE_COUNT = sizeof(SCOPE_RATES) / sizeof(SCOPE_RATES[0]);
+
+// ARGB8888颜色
+const uint32_t BACKGROUND_PIXEL = 0xB0101010;
+const uint32_t GRID_PIXEL = 0xFF404040;
+const uint32_t HISTOGRAM_PIXEL = 0xFFD0D0D0;
+// 波形点的最低亮度，只有一个采样点落入的位置也能看见
+const unsigned int TRACE_BASE = 48;
+
+// 每种示波器的计数个数（直方图包含全部子直方图）
+unsigned int cellCount(ScopeMode mode) {
+    return mode == ScopeMode::Histogram ? HISTOGRAM_BINS * HISTOGRAM_LANES : WAVEFORM_CELLS;
+}
+
+// Rec.709亮度，定点系数之和为256
+inline unsigned int luma(unsigned int r, unsigned int g, unsigned int b) {
+    return (54 * r + 183 * g + 19 * b + 128) >> 8;
+}
+
+// 统计采样行[row_begin, row_end)，第y个采样行是图像的第y * step行，每行count个采样点。
+// 像素按B,G,R排列；columns为每个采样点所在波形列的计数偏移（直方图不使用）
+void accumulateRows(const uint8_t* src, unsigned int stride, ScopeMode mode, unsigned int step,
+                    const uint16_t* columns, unsigned int count, uint32_t* counts,
+                    unsigned int row_begin, unsigned int row_end) {
+    size_t pixel_step = static_cast<size_t>(step) * 3;
+    for (unsigned int y = row_begin; y < row_end; ++y) {
+        const uint8_t* p = src + static_cast<size_t>(y) * step * stride;
+        switch (mode) {
+            case ScopeMode::Histogram:
+                for (unsigned int i = 0; i < count; ++i, p += pixel_step) {
+                    ++counts[(i % HISTOGRAM_LANES) * HISTOGRAM_BINS + luma(p[2], p[1], p[0])];
+                }
+                break;
+            case ScopeMode::Waveform:
+                for (unsigned int i = 0; i < count; ++i, p += pixel_step) {
+                    ++counts[columns[i] + (luma(p[2], p[1], p[0]) >> 1)];
+                }
+                break;
+            default:
+                for (unsigned int i = 0; i < count; ++i, p += pixel_step) {
+                    uint32_t* column = counts + columns[i];
+                    ++column[p[2] >> 1];
+                    ++column[PARADE_CHANNEL_CELLS + (p[1] >> 1)];
+                    ++column[2 * PARADE_CHANNEL_CELLS + (p[0] >> 1)];
+                }
+                break;
+        }
+    }
+}
+
+// 电平值所在的示波器行（上方为高电平）
+inline unsigned int levelRow(unsigned int value) {
+    return SCOPE_HEIGHT - 1 - (value >> 1);
+}
+
+} // namespace
+
+const char* ScopeModeName(ScopeMode mode) {
+    switch (mode) {
+        case ScopeMode::Histogram: return "直方图";
+        case ScopeMode::Waveform:  return "波形";
+        case ScopeMode::Parade:    return "RGB分量";
+        default:                   return "关";
+    }
+}
+
+bool ParseScopeRate(const std::string& text, ScopeConfig& config) {
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    unsigned long interval = std::strtoul(begin, &end, 10);
+    unsigned long step = config.step;
+    if (end == begin) {
+        return false;
+    }
+    if (*end == ',') {
+        begin = end + 1;
+        step = std::strtoul(begin, &end, 10);
+        if (end == begin) {
+            return false;
+        }
+    }
+    if (*end != '\0' || interval == 0 || interval > MAX_INTERVAL || step == 0 || step > MAX_STEP) {
+        return false;
+    }
+    config.interval = static_cast<unsigned int>(interval);
+    config.step = static_cast<unsigned int>(step);
+    return true;
+}
+
+void NextScopeRate(ScopeConfig& config) {
+    // 当前不在档位中（命令行指定）时从第一档开始
+    size_t next = 0;
+    for (size_t i = 0; i < SCOPE_RATE_COUNT; ++i) {
+        if (SCOPE_RATES[i][0] == config.interval && SCOPE_RATES[i][1] == config.step) {
+            next = (i + 1) % SCOPE_RATE_COUNT;
+            break;
+        }
+    }
+    config.interval = SCOPE_RATES[next][0];
+    config.step = SCOPE_RATES[next][1];
+}
+
+Scopes::Scopes(WorkerPool& pool)
+    : pool_(pool), frame_counter_(0), columns_width_(0), columns_step_(0), columns_mode_(ScopeMode::Off),
+      result_mode_(ScopeMode::Off), result_samples_(0), pending_ns_(0) {
+    resetCosts();
+}
+
+void Scopes::SetConfig(const ScopeConfig& config) {
+    if (config.interval != config_.interval || config.step != config_.step) {
+        resetCosts();
+    }
+    config_ = config;
+    config_.interval = std::max(1u, std::min(config_.interval, MAX_INTERVAL));
+    config_.step = std::max(1u, std::min(config_.step, MAX_STEP));
+    frame_counter_ = 0;
+}
+
+void Scopes::resetCosts() {
+    for (unsigned int i = 0; i < SCOPE_MODE_COUNT; ++i) {
+        costs_[i] = CostTotals{ 0, 0, 0 };
+    }
+}
+
+ScopeCost Scopes::Cost(ScopeMode mode) const {
+    const CostTotals& totals = costs_[static_cast<unsigned int>(mode)];
+    ScopeCost cost = { totals.updates, 0.0, totals.max_ns / 1e6 };
+    if (totals.updates > 0) {
+        cost.average_ms = totals.total_ns / 1e6 / totals.updates;
+    }
+    return cost;
+}
+
+bool Scopes::Update(const uint8_t* src, unsigned int width, unsigned int height, unsigned int stride) {
+    ScopeMode mode = config_.mode;
+    if (mode == ScopeMode::Off || !src || width == 0 || height == 0) {
+        return false;
+    }
+    if (frame_counter_++ % config_.interval != 0) {
+        return false;
+    }
+    int64_t start_ns = MonotonicNowNs();
+
+    unsigned int step = config_.step;
+    unsigned int count = (width + step - 1) / step;
+    unsigned int rows = (height + step - 1) / step;
+
+    // 采样点到波形列的映射只在尺寸、步长或示波器变化时重建
+    if (mode != columns_mode_ || width != columns_width_ || step != columns_step_) {
+        unsigned int column_count = mode == ScopeMode::Parade ? PARADE_COLUMNS : SCOPE_WIDTH;
+        columns_.resize(count);
+        for (unsigned int i = 0; i < count; ++i) {
+            uint64_t column = static_cast<uint64_t>(i) * step * column_count / width;
+            columns_[i] = static_cast<uint16_t>(column * WAVEFORM_LEVELS);
+        }
+        columns_mode_ = mode;
+        columns_width_ = width;
+        columns_step_ = step;
+    }
+
+    // 每个线程一段连续的采样行，累加到自己的部分计数中
+    unsigned int cells = cellCount(mode);
+    unsigned int bands = static_cast<unsigned int>(std::min<size_t>(pool_.Size(), rows));
+    unsigned int band_rows = (rows + bands - 1) / bands;
+    bands = (rows + band_rows - 1) / band_rows;
+    partial_.resize(static_cast<size_t>(bands) * cells);
+    const uint16_t* columns = columns_.data();
+    for (unsigned int band = 0; band < bands; ++band) {
+        uint32_t* counts = partial_.data() + static_cast<size_t>(band) * cells;
+        unsigned int begin = band * band_rows;
+        unsigned int end = std::min(begin + band_rows, rows);
+        pool_.Submit([src, stride, mode, step, columns, count, counts, cells, begin, end]() {
+            std::fill(counts, counts + cells, 0u);
+            accumulateRows(src, stride, mode, step, columns, count, counts, begin, end);
+        });
+    }
+    pool_.WaitIdle();
+
+    // 合并：按计数区间分给各线程，每个线程把所有分段的同一区间相加
+    counts_.resize(cells);
+    uint32_t* merged = counts_.data();
+    const uint32_t* partial = partial_.data();
+    unsigned int slice = (cells + bands - 1) / bands;
+    for (unsigned int begin = 0; begin < cells; begin += slice) {
+        unsigned int end = std::min(begin + slice, cells);
+        pool_.Submit([merged, partial, cells, bands, begin, end]() {
+            std::copy(partial + begin, partial + end, merged + begin);
+            for (unsigned int band = 1; band < bands; ++band) {
+                const uint32_t* counts = partial + static_cast<size_t>(band) * cells;
+                for (unsigned int i = begin; i < end; ++i) {
+                    merged[i] += counts[i];
+                }
+            }
+        });
+    }
+    pool_.WaitIdle();
+    if (mode == ScopeMode::Histogram) {
+        for (unsigned int lane = 1; lane < HISTOGRAM_LANES; ++lane) {
+            for (unsigned int bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+                merged[bin] += merged[lane * HISTOGRAM_BINS + bin];
+            }
+        }
+    }
+
+    result_mode_ = mode;
+    result_samples_ = static_cast<uint64_t>(count) * rows;
+    pending_ns_ = MonotonicNowNs() - start_ns;
+    return true;
+}
+
+void Scopes::Render(uint8_t* pixels, unsigned int pitch) {
+    int64_t start_ns = MonotonicNowNs();
+    ScopeMode mode = result_mode_;
+
+    if (mode == ScopeMode::Histogram) {
+        // 按1~254档的最大值归一化，大面积的纯黑或过曝不会把其余部分压扁（这两档超出时截顶）
+        uint32_t peak = *std::max_element(counts_.begin() + 1, counts_.begin() + HISTOGRAM_BINS - 1);
+        peak = std::max(peak, 1u);
+        unsigned int heights[SCOPE_WIDTH];
+        for (unsigned int x = 0; x < SCOPE_WIDTH; ++x) {
+            uint64_t count = counts_[x * HISTOGRAM_BINS / SCOPE_WIDTH];
+            heights[x] = static_cast<unsigned int>(std::min<uint64_t>(count * SCOPE_HEIGHT / peak, SCOPE_HEIGHT));
+        }
+        for (unsigned int y = 0; y < SCOPE_HEIGHT; ++y) {
+            uint32_t* row = reinterpret_cast<uint32_t*>(pixels + static_cast<size_t>(y) * pitch);
+            unsigned int level = SCOPE_HEIGHT - y;
+            for (unsigned int x = 0; x < SCOPE_WIDTH; ++x) {
+                row[x] = heights[x] >= level ? HISTOGRAM_PIXEL : BACKGROUND_PIXEL;
+            }
+            // 25%、50%、75%刻度
+            for (unsigned int quarter = 1; quarter < 4; ++quarter) {
+                uint32_t& pixel = row[quarter * SCOPE_WIDTH / 4];
+                pixel = pixel == BACKGROUND_PIXEL ? GRID_PIXEL : pixel;
+            }
+        }
+    } else if (mode != ScopeMode::Off) {
+        // 亮度随落入的采样点数增加：按每列的平均采样点数归一化，与分辨率和步长无关
+        unsigned int column_count = mode == ScopeMode::Parade ? PARADE_COLUMNS : SCOPE_WIDTH;
+        uint64_t per_column = std::max<uint64_t>(result_samples_ / column_count, 1);
+        uint64_t gain = (static_cast<uint64_t>(255 * 32) << 16) / per_column;
+        for (unsigned int y = 0; y < SCOPE_HEIGHT; ++y) {
+            uint32_t* row = reinterpret_cast<uint32_t*>(pixels + static_cast<size_t>(y) * pitch);
+            unsigned int level = SCOPE_HEIGHT - 1 - y;
+            bool grid = y == levelRow(0) || y == levelRow(64) || y == levelRow(128) || y == levelRow(191) || y == levelRow(255);
+            for (unsigned int x = 0; x < SCOPE_WIDTH; ++x) {
+                uint32_t count = counts_[x * WAVEFORM_LEVELS + level];
+                if (count == 0) {
+                    row[x] = grid ? GRID_PIXEL : BACKGROUND_PIXEL;
+                    continue;
+                }
+                uint32_t value = TRACE_BASE + static_cast<uint32_t>(std::min<uint64_t>((count * gain) >> 16, 255 - TRACE_BASE));
+                if (mode == ScopeMode::Waveform) {
+                    row[x] = 0xFF000000 | (value << 16) | (value << 8) | value;
+                } else {
+                    // 分量图中另外两个通道取四分之一亮度，蓝色在黑底上也看得清
+                    uint32_t dim = value / 4;
+                    unsigned int channel = x / PARADE_COLUMNS;
+                    uint32_t r = channel == 0 ? value : dim;
+                    uint32_t g = channel == 1 ? value : dim;
+                    uint32_t b = channel == 2 ? value : dim;
+                    row[x] = 0xFF000000 | (r << 16) | (g << 8) | b;
+                }
+            }
+            if (mode == ScopeMode::Parade) {
+                row[PARADE_COLUMNS] = GRID_PIXEL;
+                row[2 * PARADE_COLUMNS] = GRID_PIXEL;
+            }
+        }
+    } else {
+        for (unsigned int y = 0; y < SCOPE_HEIGHT; ++y) {
+            uint32_t* row = reinterpret_cast<uint32_t*>(pixels + static_cast<size_t>(y) * pitch);
+            std::fill(row, row + SCOPE_WIDTH, BACKGROUND_PIXEL);
+        }
+        return;
+    }
+
+    int64_t cost_ns = pending_ns_ + (MonotonicNowNs() - start_ns);
+    CostTotals& totals = costs_[static_cast<unsigned int>(mode)];
+    ++totals.updates;
+    totals.total_ns += cost_ns;
+    totals.max_ns = std::max(totals.max_ns, cost_ns);
+}
+
+} // namespace cinepi
@@ -0,0 +1,105 @@
+// scopes.h
+// 示波器：亮度直方图、波形图和RGB分量图（parade）
+//
+// 预览图像按行分段，每个工作线程把自己的一段累加到独立的部分计数中（无锁、无共享写入），
+// 全部完成后合并，再画成SCOPE_WIDTH x SCOPE_HEIGHT的ARGB8888小图，可以直接写入锁定的流式纹理。
+// 可以只每N帧统计一次，或在隔step个像素的网格上采样，运行中切换；每种示波器分别记录统计和绘制的耗时。
+
+#ifndef SCOPES_H
+#define SCOPES_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "worker_pool.h"
+
+namespace cinepi {
+
+// 示波器图像尺寸：波形图每列对应图像的一段竖条，每行对应两级8位值；分量图三个通道各占三分之一宽度
+const unsigned int SCOPE_WIDTH = 384;
+const unsigned int SCOPE_HEIGHT = 128;
+
+// 示波器类型
+enum class ScopeMode {
+    Off,
+    Histogram,      // 亮度直方图
+    Waveform,       // 亮度波形图
+    Parade          // R、G、B三个通道的波形图并排
+};
+
+const unsigned int SCOPE_MODE_COUNT = 4;
+
+// 示波器名称，用于界面显示
+const char* ScopeModeName(ScopeMode mode);
+
+// 示波器参数
+struct ScopeConfig {
+    ScopeMode mode;
+    unsigned int interval;      // 每interval帧统计一次，其余帧沿用上次的图像
+    unsigned int step;          // 横纵每隔step个像素取一个采样点
+
+    ScopeConfig() : mode(ScopeMode::Off), interval(1), step(2) {}
+};
+
+// 解析统计频率"<N>"或"<N>,<步长>"（每N帧统计一次，采样网格步长），格式无效或超出范围时返回false
+bool ParseScopeRate(const std::string& text, ScopeConfig& config);
+
+// 切换到下一档预设的统计频率（每帧/全部像素 → ... → 每4帧/隔4像素），供按键循环使用
+void NextScopeRate(ScopeConfig& config);
+
+// 一种示波器的耗时（统计 + 合并 + 绘制，不含纹理上传）
+struct ScopeCost {
+    uint64_t updates;
+    double average_ms;
+    double max_ms;
+};
+
+class Scopes {
+public:
+    // 在pool的线程中并行统计，pool需比示波器存活更久
+    explicit Scopes(WorkerPool& pool);
+
+    Scopes(const Scopes&) = delete;
+    Scopes& operator=(const Scopes&) = delete;
+
+    // 每个新预览帧调用一次（像素为3字节，按B,G,R排列，与取景流和RAW预览一致）。按interval跳过的帧、模式为Off或尺寸无效时返回false，
+    // 上一次的统计结果不变；返回true时应调用Render更新纹理
+    bool Update(const uint8_t* src, unsigned int width, unsigned int height, unsigned int stride);
+
+    // 把最近一次的统计结果画成SCOPE_WIDTH x SCOPE_HEIGHT的ARGB8888图像（只写不读），耗时计入该次统计
+    void Render(uint8_t* pixels, unsigned int pitch);
+
+    const ScopeConfig& Config() const { return config_; }
+
+    // 修改参数后下一帧立即统计；统计频率变化时清空各示波器的耗时
+    void SetConfig(const ScopeConfig& config);
+
+    ScopeCost Cost(ScopeMode mode) const;
+
+private:
+    struct CostTotals {
+        uint64_t updates;
+        int64_t total_ns;
+        int64_t max_ns;
+    };
+
+    WorkerPool& pool_;
+    ScopeConfig config_;
+    uint64_t frame_counter_;
+    std::vector<uint32_t> partial_;     // 每个分段一份计数，合并前各线程只写自己的一份
+    std::vector<uint32_t> counts_;      // 合并后的计数
+    std::vector<uint16_t> columns_;     // 采样点所在的波形列，按图像宽度和步长生成
+    unsigned int columns_width_;
+    unsigned int columns_step_;
+    ScopeMode columns_mode_;
+    ScopeMode result_mode_;             // counts_对应的示波器
+    uint64_t result_samples_;           // 该次统计的采样点数
+    int64_t pending_ns_;                // 该次统计的耗时，Render时加上绘制耗时后记入
+    CostTotals costs_[SCOPE_MODE_COUNT];
+
+    void resetCosts();
+};
+
+} // namespace cinepi
+
+#endif // SCOPES_H
@@ -2,11 +2,47 @@
 // SDL辅助类实现
 
 #include "sdl_helper.h"
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <iterator>
 
 namespace cinepi {
 
-SDLHelper::SDLHelper() : initialized_(false), ttf_initialized_(false) {
+namespace {
+
+// 文字纹理缓存的默认条目数：两个应用每帧约20~30行文字，去掉数字后每行分成几段固定的文本
+const size_t DEFAULT_TEXT_CACHE_CAPACITY = 256;
+
+// 单独按字形绘制的字符，顺序即字形在GlyphSet中的下标
+const char NUMERIC_GLYPHS[] = "0123456789.+-";
+
+// 字符在NUMERIC_GLYPHS中的下标，不是数字字形时返回-1；UTF-8多字节字符的各字节都不会匹配
+int numericGlyphIndex(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    switch (c) {
+        case '.': return 10;
+        case '+': return 11;
+        case '-': return 12;
+        default:  return -1;
+    }
+}
+
+size_t textHash(SDL_Renderer* renderer, TTF_Font* font, Uint32 color, const std::string& text) {
+    size_t hash = std::hash<std::string>()(text);
+    size_t parts[] = { reinterpret_cast<size_t>(renderer), reinterpret_cast<size_t>(font), static_cast<size_t>(color) };
+    for (size_t part : parts) {
+        hash ^= std::hash<size_t>()(part) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+} // namespace
+
+SDLHelper::SDLHelper() : initialized_(false), ttf_initialized_(false), headless_(false),
+                         text_cache_capacity_(DEFAULT_TEXT_CACHE_CAPACITY), text_stats_{ 0, 0, 0, 0 } {
 }
 
 SDLHelper::~SDLHelper() {
@@ -18,6 +54,11 @@ void SDLHelper::Initialize() {
         return;
     }
 
+    // 无界面模式下不需要显示服务器
+    if (headless_) {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    }
+
     // 初始化SDL
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_EVENTS) < 0) {
         throw std::runtime_error("SDL初始化失败: " + std::string(SDL_GetError()));
@@ -58,6 +99,11 @@ SDL_Renderer* SDLHelper::CreateRenderer(SDL_Window* window, int index, Uint32 fl
         throw std::runtime_error("无效的窗口指针");
     }
 
+    // dummy驱动只支持软件渲染，且没有垂直同步
+    if (headless_) {
+        flags = SDL_RENDERER_SOFTWARE;
+    }
+
     SDL_Renderer* renderer = SDL_CreateRenderer(window, index, flags);
     if (!renderer) {
         throw std::runtime_error("渲染器创建失败: " + std::string(SDL_GetError()));
@@ -109,34 +155,204 @@ TTF_Font* SDLHelper::LoadFont(const std::string& fontPath, int fontSize) {
     return font;
 }
 
+Uint32 SDLHelper::RegisterEvent() {
+    if (!initialized_) {
+        Initialize();
+    }
+
+    Uint32 type = SDL_RegisterEvents(1);
+    if (type == static_cast<Uint32>(-1)) {
+        throw std::runtime_error("无法注册自定义事件: " + std::string(SDL_GetError()));
+    }
+    return type;
+}
+
+void SDLHelper::PushEvent(Uint32 type) {
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = type;
+    if (SDL_PushEvent(&event) < 0) {
+        std::cerr << "推送事件失败: " << SDL_GetError() << std::endl;
+    }
+}
+
+SDL_Rect SDLHelper::FitRect(int srcWidth, int srcHeight, int dstWidth, int dstHeight) {
+    SDL_Rect rect = { 0, 0, dstWidth, dstHeight };
+    if (srcWidth <= 0 || srcHeight <= 0) {
+        return rect;
+    }
+
+    // 以较小的缩放比例为准，另一方向留黑边
+    if (static_cast<int64_t>(dstWidth) * srcHeight > static_cast<int64_t>(dstHeight) * srcWidth) {
+        rect.w = static_cast<int>(static_cast<int64_t>(dstHeight) * srcWidth / srcHeight);
+        rect.x = (dstWidth - rect.w) / 2;
+    } else {
+        rect.h = static_cast<int>(static_cast<int64_t>(dstWidth) * srcHeight / srcWidth);
+        rect.y = (dstHeight - rect.h) / 2;
+    }
+    return rect;
+}
+
 void SDLHelper::RenderText(SDL_Renderer* renderer, TTF_Font* font, const std::string& text, int x, int y, const Color& color) {
-    if (!renderer || !font) {
+    if (!renderer || !font || text.empty()) {
         return;
     }
+    ++text_stats_.draws;
+
+    Uint32 packedColor = (static_cast<Uint32>(color.r) << 24) | (static_cast<Uint32>(color.g) << 16) |
+                         (static_cast<Uint32>(color.b) << 8) | color.a;
+
+    // 按数字/非数字分段，从左到右依次绘制
+    int pen = x;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        bool numeric = numericGlyphIndex(text[begin]) >= 0;
+        size_t end = begin + 1;
+        while (end < text.size() && (numericGlyphIndex(text[end]) >= 0) == numeric) {
+            ++end;
+        }
+
+        const GlyphSet* glyphs = numeric ? glyphSet(renderer, font, color, packedColor) : nullptr;
+        if (glyphs) {
+            for (size_t i = begin; i < end; ++i) {
+                int index = numericGlyphIndex(text[i]);
+                SDL_Rect glyphRect = { pen, y, glyphs->widths[index], glyphs->heights[index] };
+                SDL_RenderCopy(renderer, glyphs->textures[index], nullptr, &glyphRect);
+                pen += glyphs->widths[index];
+            }
+        } else {
+            pen += renderCachedText(renderer, font, text.substr(begin, end - begin), pen, y, color, packedColor);
+        }
+        begin = end;
+    }
+}
+
+int SDLHelper::renderCachedText(SDL_Renderer* renderer, TTF_Font* font, const std::string& text, int x, int y,
+                                const Color& color, Uint32 packedColor) {
+    size_t hash = textHash(renderer, font, packedColor, text);
+    auto found = text_index_.find(hash);
+    if (found != text_index_.end()) {
+        std::list<TextEntry>::iterator entry = found->second;
+        if (entry->renderer == renderer && entry->font == font && entry->color == packedColor && entry->text == text) {
+            text_entries_.splice(text_entries_.begin(), text_entries_, entry);
+            SDL_Rect textRect = { x, y, entry->width, entry->height };
+            SDL_RenderCopy(renderer, entry->texture, nullptr, &textRect);
+            return entry->width;
+        }
+    }
 
     SDL_Color sdlColor = { color.r, color.g, color.b, color.a };
     
     SDL_Surface* textSurface = TTF_RenderUTF8_Solid(font, text.c_str(), sdlColor);
     if (!textSurface) {
         std::cerr << "文本表面创建失败: " << TTF_GetError() << std::endl;
-        return;
+        return 0;
     }
 
     SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
     if (!textTexture) {
         std::cerr << "文本纹理创建失败: " << SDL_GetError() << std::endl;
         SDL_FreeSurface(textSurface);
-        return;
+        return 0;
     }
+    ++text_stats_.uploads;
 
-    SDL_Rect textRect = { x, y, textSurface->w, textSurface->h };
-    SDL_RenderCopy(renderer, textTexture, nullptr, &textRect);
-
-    SDL_DestroyTexture(textTexture);
+    // 哈希冲突时替换旧条目
+    if (found != text_index_.end()) {
+        evictTextEntry(found->second);
+    }
+    text_entries_.push_front(TextEntry{ hash, renderer, font, packedColor, text, textTexture, textSurface->w, textSurface->h });
+    text_index_[hash] = text_entries_.begin();
     SDL_FreeSurface(textSurface);
+
+    while (text_entries_.size() > text_cache_capacity_) {
+        evictTextEntry(std::prev(text_entries_.end()));
+        ++text_stats_.evictions;
+    }
+
+    const TextEntry& entry = text_entries_.front();
+    SDL_Rect textRect = { x, y, entry.width, entry.height };
+    SDL_RenderCopy(renderer, entry.texture, nullptr, &textRect);
+    return entry.width;
+}
+
+const SDLHelper::GlyphSet* SDLHelper::glyphSet(SDL_Renderer* renderer, TTF_Font* font, const Color& color, Uint32 packedColor) {
+    for (const GlyphSet& set : glyph_sets_) {
+        if (set.renderer == renderer && set.font == font && set.color == packedColor) {
+            return &set;
+        }
+    }
+
+    // 每个字形单独光栅化，宽度即该字形在整段文字中的步进，高度与整段文字相同
+    GlyphSet set;
+    set.renderer = renderer;
+    set.font = font;
+    set.color = packedColor;
+    SDL_Color sdlColor = { color.r, color.g, color.b, color.a };
+    for (size_t i = 0; i < NUMERIC_GLYPH_COUNT; ++i) {
+        char glyph[2] = { NUMERIC_GLYPHS[i], '\0' };
+        SDL_Surface* surface = TTF_RenderUTF8_Solid(font, glyph, sdlColor);
+        SDL_Texture* texture = surface ? SDL_CreateTextureFromSurface(renderer, surface) : nullptr;
+        if (!texture) {
+            std::cerr << "数字字形创建失败: " << (surface ? SDL_GetError() : TTF_GetError()) << std::endl;
+            if (surface) {
+                SDL_FreeSurface(surface);
+            }
+            for (size_t j = 0; j < i; ++j) {
+                SDL_DestroyTexture(set.textures[j]);
+            }
+            return nullptr;
+        }
+        set.textures[i] = texture;
+        set.widths[i] = surface->w;
+        set.heights[i] = surface->h;
+        SDL_FreeSurface(surface);
+        ++text_stats_.uploads;
+    }
+    glyph_sets_.push_back(set);
+    return &glyph_sets_.back();
+}
+
+void SDLHelper::SetTextCacheCapacity(size_t capacity) {
+    text_cache_capacity_ = std::max<size_t>(capacity, 1);
+    while (text_entries_.size() > text_cache_capacity_) {
+        evictTextEntry(std::prev(text_entries_.end()));
+        ++text_stats_.evictions;
+    }
+}
+
+void SDLHelper::ClearTextCache() {
+    for (TextEntry& entry : text_entries_) {
+        SDL_DestroyTexture(entry.texture);
+    }
+    text_entries_.clear();
+    text_index_.clear();
+    for (GlyphSet& set : glyph_sets_) {
+        for (SDL_Texture* texture : set.textures) {
+            SDL_DestroyTexture(texture);
+        }
+    }
+    glyph_sets_.clear();
+}
+
+TextCacheStats SDLHelper::GetTextCacheStats() const {
+    TextCacheStats stats = text_stats_;
+    stats.entries = text_entries_.size();
+    return stats;
+}
+
+void SDLHelper::evictTextEntry(std::list<TextEntry>::iterator entry) {
+    SDL_DestroyTexture(entry->texture);
+    text_index_.erase(entry->hash);
+    text_entries_.erase(entry);
 }
 
 void SDLHelper::Cleanup() {
+    // 应用应已调用ClearTextCache；否则这些纹理已随渲染器一起释放，这里只丢弃指针
+    text_entries_.clear();
+    text_index_.clear();
+    glyph_sets_.clear();
+
     if (ttf_initialized_) {
         TTF_Quit();
         ttf_initialized_ = false;
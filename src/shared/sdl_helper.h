@@ -6,9 +6,14 @@
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
 #include <string>
 #include <memory>
 #include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
 namespace cinepi {
 
@@ -19,6 +24,14 @@ struct Color {
         : r(red), g(green), b(blue), a(alpha) {}
 };
 
+// 文字纹理缓存统计
+struct TextCacheStats {
+    uint64_t draws;         // RenderText调用次数
+    uint64_t uploads;       // 未命中缓存、重新光栅化并上传纹理的次数
+    uint64_t evictions;     // 超出容量被淘汰的条目
+    size_t entries;
+};
+
 // SDL辅助类
 class SDLHelper {
 public:
@@ -28,6 +41,10 @@ public:
     // 初始化SDL
     void Initialize();
 
+    // 无界面模式：使用dummy视频驱动和软件渲染器，需在Initialize之前调用
+    void SetHeadless(bool headless) { headless_ = headless; }
+    bool IsHeadless() const { return headless_; }
+
     // 创建窗口
     SDL_Window* CreateWindow(const std::string& title, int width, int height, Uint32 flags = SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
 
@@ -40,15 +57,71 @@ public:
     // 加载字体
     TTF_Font* LoadFont(const std::string& fontPath, int fontSize);
 
-    // 渲染文本
+    // 注册一个自定义事件类型，用于从其他线程唤醒事件循环
+    Uint32 RegisterEvent();
+
+    // 推送自定义事件（线程安全）
+    static void PushEvent(Uint32 type);
+
+    // 按比例缩放并居中到目标区域（信箱/邮筒模式）
+    static SDL_Rect FitRect(int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+    // 渲染文本。文本按数字（0-9 . + -）和其余部分分段：其余部分按(渲染器, 字体, 文本, 颜色)缓存光栅化后的纹理，
+    // 超出容量时淘汰最久未使用的条目；数字逐个字形从按(渲染器, 字体, 颜色)缓存的字形纹理绘制。
+    // 每帧变化的统计数值因此不需要重新光栅化和上传，稳定后每帧上传次数为0
     void RenderText(SDL_Renderer* renderer, TTF_Font* font, const std::string& text, int x, int y, const Color& color);
 
+    // 文字纹理缓存的条目上限
+    void SetTextCacheCapacity(size_t capacity);
+
+    // 销毁缓存的文字和字形纹理，需在渲染器销毁之前调用；更换渲染器或字体后也应调用
+    void ClearTextCache();
+
+    TextCacheStats GetTextCacheStats() const;
+
     // 清理资源
     void Cleanup();
 
 private:
+    // 缓存的一条文字纹理，最近使用的排在链表前面
+    struct TextEntry {
+        size_t hash;
+        SDL_Renderer* renderer;
+        TTF_Font* font;
+        Uint32 color;
+        std::string text;
+        SDL_Texture* texture;
+        int width;
+        int height;
+    };
+
+    // 一种颜色的数字字形，每个字形一个纹理，按字形宽度逐个排列
+    static const size_t NUMERIC_GLYPH_COUNT = 13;
+    struct GlyphSet {
+        SDL_Renderer* renderer;
+        TTF_Font* font;
+        Uint32 color;
+        SDL_Texture* textures[NUMERIC_GLYPH_COUNT];
+        int widths[NUMERIC_GLYPH_COUNT];
+        int heights[NUMERIC_GLYPH_COUNT];
+    };
+
     bool initialized_;
     bool ttf_initialized_;
+    bool headless_;
+    std::list<TextEntry> text_entries_;
+    // 按哈希索引，命中时不需要复制文本；哈希相同但内容不同时当作未命中并替换
+    std::unordered_map<size_t, std::list<TextEntry>::iterator> text_index_;
+    size_t text_cache_capacity_;
+    TextCacheStats text_stats_;
+    std::vector<GlyphSet> glyph_sets_;
+
+    void evictTextEntry(std::list<TextEntry>::iterator entry);
+    // 绘制一段非数字文本（经文字纹理缓存），返回绘制宽度
+    int renderCachedText(SDL_Renderer* renderer, TTF_Font* font, const std::string& text, int x, int y,
+                         const Color& color, Uint32 packedColor);
+    // 取得该颜色的数字字形，第一次使用时光栅化；失败时返回nullptr
+    const GlyphSet* glyphSet(SDL_Renderer* renderer, TTF_Font* font, const Color& color, Uint32 packedColor);
 };
 
 // RAII包装器，自动管理SDL资源
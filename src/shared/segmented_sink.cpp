@@ -0,0 +1,285 @@
+// segmented_sink.cpp
+// 分段落盘实现
+
+#include "segmented_sink.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace cinepi {
+
+namespace {
+
+// 路径中的文件名部分
+std::string fileName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+} // namespace
+
+RawSinkStats CombineSinkStats(const RawSinkStats& a, const RawSinkStats& b) {
+    RawSinkStats combined;
+    combined.writes = a.writes + b.writes;
+    combined.bytes = a.bytes + b.bytes;
+    combined.mean_write_ms = combined.writes > 0 ?
+        (a.mean_write_ms * a.writes + b.mean_write_ms * b.writes) / combined.writes : 0.0;
+    combined.max_write_ms = std::max(a.max_write_ms, b.max_write_ms);
+    return combined;
+}
+
+SegmentedRawSink::SegmentedRawSink(RawSinkType type, const SegmentConfig& config)
+    : type_(type),
+      config_(config),
+      segment_frames_(0),
+      total_frames_(0),
+      is_open_(false),
+      closed_stats_() {
+    if (!IsFileRawSink(type)) {
+        throw std::runtime_error("分段只支持输出单个文件的落盘方式");
+    }
+    extension_ = CreateRawSink(type)->Extension();
+}
+
+SegmentedRawSink::~SegmentedRawSink() {
+    Close();
+}
+
+std::string SegmentedRawSink::segmentPath(size_t index) const {
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "_%03zu", index);
+    return base_path_ + suffix + extension_;
+}
+
+std::unique_ptr<RawSink> SegmentedRawSink::openSegment(size_t index) {
+    std::unique_ptr<RawSink> sink = CreateRawSink(type_);
+    sink->Open(segmentPath(index), info_);
+    return sink;
+}
+
+void SegmentedRawSink::Open(const std::string& path, const RecordingInfo& info) {
+    Close();
+    if (info.frame_bytes == 0) {
+        throw std::runtime_error("分段参数无效");
+    }
+
+    base_path_ = path;
+    if (!extension_.empty() && base_path_.size() > extension_.size() &&
+        base_path_.compare(base_path_.size() - extension_.size(), extension_.size(), extension_) == 0) {
+        base_path_.resize(base_path_.size() - extension_.size());
+    }
+
+    // 按内层落盘方式在磁盘上的实际占用折算（容器每帧有记录头、页对齐和索引项，另有文件头），
+    // 整段文件不超过max_bytes
+    std::unique_ptr<RawSink> layout = CreateRawSink(type_);
+    uint64_t record_bytes = std::max<uint64_t>(layout->RecordBytes(info), 1);
+    uint64_t overhead_bytes = layout->OverheadBytes(info);
+
+    // 每段帧数取大小和时长两个条件中较小的一个，切换总在帧边界上
+    segment_frames_ = std::numeric_limits<uint64_t>::max();
+    if (config_.max_bytes > 0) {
+        uint64_t available = config_.max_bytes > overhead_bytes ? config_.max_bytes - overhead_bytes : 0;
+        segment_frames_ = std::min<uint64_t>(segment_frames_, std::max<uint64_t>(available / record_bytes, 1));
+    }
+    if (config_.max_seconds > 0) {
+        uint64_t frames = static_cast<uint64_t>(std::ceil(config_.max_seconds * std::max(info.fps, 1)));
+        segment_frames_ = std::min<uint64_t>(segment_frames_, std::max<uint64_t>(frames, 1));
+    }
+
+    // 每段按整段大小预分配，文件在磁盘上尽量连续
+    info_ = info;
+    if (segment_frames_ != std::numeric_limits<uint64_t>::max()) {
+        info_.preallocate_bytes = overhead_bytes + segment_frames_ * record_bytes;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        closed_stats_ = RawSinkStats();
+        current_ = openSegment(0);
+    }
+    segments_.clear();
+    segments_.push_back(Segment{ fileName(segmentPath(0)), 0, 0, 0, 0, 0, 0 });
+    total_frames_ = 0;
+    is_open_ = true;
+    writeManifest(false);
+
+    std::cout << "分段录制: 每段 " << segment_frames_ << " 帧 ("
+              << (overhead_bytes + segment_frames_ * record_bytes) / (1024 * 1024) << "MB), 清单 " << base_path_ << ".clip.json" << std::endl;
+}
+
+bool SegmentedRawSink::WriteFrame(const FrameLease& frame) {
+    if (!is_open_) {
+        return false;
+    }
+    if (segments_.back().frames >= segment_frames_ && !rollOver()) {
+        return false;
+    }
+    if (!current_->WriteFrame(frame)) {
+        return false;
+    }
+
+    Segment& segment = segments_.back();
+    if (segment.frames == 0) {
+        segment.first_sequence = frame->sequence;
+        segment.first_timestamp_ns = frame->sensor_timestamp_ns;
+    }
+    segment.last_timestamp_ns = frame->sensor_timestamp_ns;
+    segment.bytes += std::min(frame->raw.size, info_.frame_bytes);
+    ++segment.frames;
+    ++total_frames_;
+
+    // 当前段过半时打开下一段，打开和预分配的耗时不落在切换那一帧上
+    if (!next_ && segment.frames * 2 >= segment_frames_ && segment_frames_ != std::numeric_limits<uint64_t>::max()) {
+        try {
+            next_ = openSegment(segments_.size());
+        } catch (const std::exception& e) {
+            std::cerr << "警告: 提前打开下一分段失败，切换时重试: " << e.what() << std::endl;
+        }
+    }
+    return true;
+}
+
+bool SegmentedRawSink::rollOver() {
+    if (!next_) {
+        try {
+            next_ = openSegment(segments_.size());
+        } catch (const std::exception& e) {
+            std::cerr << "打开分段失败: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    std::unique_ptr<RawSink> previous;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        previous = std::move(current_);
+        current_ = std::move(next_);
+    }
+    retire(std::move(previous));
+
+    Segment& finished = segments_.back();
+    std::cout << "分段完成: " << finished.file << " (" << finished.frames << " 帧)" << std::endl;
+    segments_.push_back(Segment{ fileName(segmentPath(segments_.size())), total_frames_, 0, 0, 0, 0, 0 });
+    if (!writeManifest(false)) {
+        std::cerr << "警告: 无法更新剪辑清单 " << base_path_ << ".clip.json" << std::endl;
+    }
+    return true;
+}
+
+void SegmentedRawSink::retire(std::unique_ptr<RawSink> sink) {
+    // 同一时间只有一个旧段在关闭；上一段还没关完时等它结束
+    if (closer_.joinable()) {
+        closer_.join();
+    }
+    closer_ = std::thread([this](std::unique_ptr<RawSink> old) {
+        old->Close();
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        closed_stats_ = CombineSinkStats(closed_stats_, old->GetStats());
+    }, std::move(sink));
+}
+
+void SegmentedRawSink::Close() {
+    if (!is_open_) {
+        return;
+    }
+    is_open_ = false;
+
+    current_->Close();
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        closed_stats_ = CombineSinkStats(closed_stats_, current_->GetStats());
+        current_.reset();
+    }
+    if (next_) {
+        // 提前打开但没有用到的分段
+        next_->Close();
+        next_.reset();
+        std::remove(segmentPath(segments_.size()).c_str());
+    }
+    if (closer_.joinable()) {
+        closer_.join();
+    }
+
+    if (!writeManifest(true)) {
+        std::cerr << "警告: 无法写入剪辑清单 " << base_path_ << ".clip.json" << std::endl;
+    }
+    std::cout << "分段录制: " << segments_.size() << " 段, " << total_frames_ << " 帧" << std::endl;
+}
+
+RawSinkStats SegmentedRawSink::GetStats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return current_ ? CombineSinkStats(closed_stats_, current_->GetStats()) : closed_stats_;
+}
+
+bool SegmentedRawSink::writeManifest(bool complete) const {
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"clip\": \"" << fileName(base_path_) << "\",\n";
+    out << "  \"complete\": " << (complete ? "true" : "false") << ",\n";
+    out << "  \"writer\": \"" << CreateRawSink(type_)->Name() << "\",\n";
+    out << "  \"width\": " << info_.width << ",\n";
+    out << "  \"height\": " << info_.height << ",\n";
+    out << "  \"encoding\": \"" << PixelEncodingName(info_.format.encoding) << "\",\n";
+    out << "  \"bit_depth\": " << info_.format.bit_depth << ",\n";
+    out << "  \"fps\": " << info_.fps << ",\n";
+    out << "  \"frame_bytes\": " << info_.frame_bytes << ",\n";
+    out << "  \"frames\": " << total_frames_ << ",\n";
+    out << "  \"segments\": [";
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        const Segment& segment = segments_[i];
+        out << (i ? ",\n" : "\n") << "    { \"file\": \"" << segment.file << "\", \"first_frame\": " << segment.first_frame
+            << ", \"frames\": " << segment.frames << ", \"bytes\": " << segment.bytes
+            << ", \"first_sequence\": " << segment.first_sequence
+            << ", \"first_timestamp_ns\": " << segment.first_timestamp_ns
+            << ", \"last_timestamp_ns\": " << segment.last_timestamp_ns << " }";
+    }
+    out << "\n  ]\n}\n";
+
+    // 临时文件写完并落盘后再改名，改名后同步目录项：断电时清单要么是旧版本要么是新版本
+    std::string path = base_path_ + ".clip.json";
+    std::string temp_path = path + ".tmp";
+    std::string text = out.str();
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = true;
+    const char* data = text.data();
+    size_t remaining = text.size();
+    while (ok && remaining > 0) {
+        ssize_t written = ::write(fd, data, remaining);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        ok = written > 0;
+        if (ok) {
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+    }
+    ok = ok && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int dir_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) {
+        return false;
+    }
+    ok = ::fsync(dir_fd) == 0;
+    ::close(dir_fd);
+    return ok;
+}
+
+} // namespace cinepi
@@ -0,0 +1,89 @@
+// segmented_sink.h
+// 分段落盘：长镜头按大小或时长在帧边界切换到新的分段文件，并用剪辑清单串联各段
+//
+// 分段由同一种文件落盘方式（buffered/direct/container）写出，每段都是独立可读的文件。
+// 写入线程在当前段写到一半时打开下一段并预分配整段空间，切换时只交换输出，不丢帧；
+// 旧段在后台线程关闭，关闭时的同步和截断不占用写入线程。
+// 每次切换后重写剪辑清单（<剪辑名>.clip.json），断电后清单仍包含已完成的分段。
+
+#ifndef SEGMENTED_SINK_H
+#define SEGMENTED_SINK_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "raw_sink.h"
+
+namespace cinepi {
+
+// 分段条件，两者都为0表示不分段；同时设置时先达到的生效
+struct SegmentConfig {
+    uint64_t max_bytes;     // 单段数据量上限
+    double max_seconds;     // 单段时长上限（按录制帧率折算帧数）
+
+    SegmentConfig() : max_bytes(0), max_seconds(0.0) {}
+
+    bool IsEnabled() const { return max_bytes > 0 || max_seconds > 0; }
+};
+
+class SegmentedRawSink : public RawSink {
+public:
+    // type必须是输出单个文件的落盘方式
+    SegmentedRawSink(RawSinkType type, const SegmentConfig& config);
+    ~SegmentedRawSink() override;
+
+    const char* Name() const override { return "segmented"; }
+    const char* Extension() const override { return extension_.c_str(); }
+    void Open(const std::string& path, const RecordingInfo& info) override;
+    bool WriteFrame(const FrameLease& frame) override;
+    void Close() override;
+    RawSinkStats GetStats() const override;
+
+private:
+    // 剪辑清单中的一段
+    struct Segment {
+        std::string file;
+        uint64_t first_frame;
+        uint64_t frames;
+        uint64_t bytes;
+        uint32_t first_sequence;
+        int64_t first_timestamp_ns;
+        int64_t last_timestamp_ns;
+    };
+
+    RawSinkType type_;
+    SegmentConfig config_;
+    std::string extension_;
+    std::string base_path_;         // 不含扩展名的输出路径
+    RecordingInfo info_;
+    uint64_t segment_frames_;       // 每段帧数
+
+    std::unique_ptr<RawSink> current_;
+    std::unique_ptr<RawSink> next_;     // 提前打开的下一段
+    std::vector<Segment> segments_;     // 最后一项是正在写的段
+    uint64_t total_frames_;
+    bool is_open_;
+
+    // 正在后台关闭的旧段
+    std::thread closer_;
+
+    // 保护current_的切换和已关闭分段的统计，UI线程查询统计时使用
+    mutable std::mutex stats_mutex_;
+    RawSinkStats closed_stats_;
+
+    std::string segmentPath(size_t index) const;
+    std::unique_ptr<RawSink> openSegment(size_t index);
+    bool rollOver();
+    void retire(std::unique_ptr<RawSink> sink);
+    bool writeManifest(bool complete) const;
+};
+
+// 合并两组写请求统计
+RawSinkStats CombineSinkStats(const RawSinkStats& a, const RawSinkStats& b);
+
+} // namespace cinepi
+
+#endif // SEGMENTED_SINK_H
@@ -0,0 +1,76 @@
+// sensor_profile.cpp
+// IMX477传感器参数实现
+
+#include "sensor_profile.h"
+#include <algorithm>
+
+namespace cinepi {
+
+namespace {
+
+// IMX477调校文件中的色温曲线（K, r/g, b/g），增益取倒数
+struct ColourTemperaturePoint {
+    float kelvin;
+    float r;
+    float b;
+};
+
+const ColourTemperaturePoint CT_CURVE[] = {
+    { 2360.0f, 0.6009f, 0.3093f },
+    { 2848.0f, 0.5071f, 0.4000f },
+    { 3628.0f, 0.4261f, 0.5564f },
+    { 4660.0f, 0.3529f, 0.6800f },
+    { 5579.0f, 0.3227f, 0.7000f },
+    { 6671.0f, 0.3065f, 0.7200f },
+    { 7763.0f, 0.2950f, 0.7400f },
+};
+
+// 按色温排列的色彩校正矩阵（近似IMX477调校文件中的值，每行之和为1，保持白点）
+struct CcmPoint {
+    float kelvin;
+    float ccm[9];
+};
+
+const CcmPoint CCM_CURVE[] = {
+    { 3000.0f, { 1.84f, -0.62f, -0.22f, -0.41f, 1.70f, -0.29f, -0.06f, -0.74f, 1.80f } },
+    { 5000.0f, { 1.70f, -0.52f, -0.18f, -0.32f, 1.63f, -0.31f, -0.03f, -0.52f, 1.55f } },
+    { 6500.0f, { 1.64f, -0.46f, -0.18f, -0.28f, 1.60f, -0.32f, -0.02f, -0.46f, 1.48f } },
+};
+
+// 在按色温排列的表中查找插值区间，返回右端下标和插值系数
+template <typename Point, size_t N>
+size_t findSegment(const Point (&curve)[N], int kelvin, float& t) {
+    float k = std::min(std::max(static_cast<float>(kelvin), curve[0].kelvin), curve[N - 1].kelvin);
+    size_t i = 1;
+    while (i < N - 1 && curve[i].kelvin < k) {
+        ++i;
+    }
+    t = (k - curve[i - 1].kelvin) / (curve[i].kelvin - curve[i - 1].kelvin);
+    return i;
+}
+
+} // namespace
+
+int SensorBlackLevel(int bit_depth) {
+    // 16位容器中的数据左对齐，黑电平按16位计算
+    return bit_depth >= 12 ? 256 << (bit_depth - 12) : 256 >> (12 - bit_depth);
+}
+
+void ColourGainsForTemperature(int kelvin, float& red_gain, float& blue_gain) {
+    float t = 0.0f;
+    size_t i = findSegment(CT_CURVE, kelvin, t);
+    const ColourTemperaturePoint& a = CT_CURVE[i - 1];
+    const ColourTemperaturePoint& b = CT_CURVE[i];
+    red_gain = 1.0f / (a.r + (b.r - a.r) * t);
+    blue_gain = 1.0f / (a.b + (b.b - a.b) * t);
+}
+
+void ColourCorrectionMatrix(int kelvin, float ccm[9]) {
+    float t = 0.0f;
+    size_t i = findSegment(CCM_CURVE, kelvin, t);
+    for (int j = 0; j < 9; ++j) {
+        ccm[j] = CCM_CURVE[i - 1].ccm[j] + (CCM_CURVE[i].ccm[j] - CCM_CURVE[i - 1].ccm[j]) * t;
+    }
+}
+
+} // namespace cinepi
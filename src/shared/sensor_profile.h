@@ -0,0 +1,26 @@
+// sensor_profile.h
+// IMX477传感器参数：黑电平、色温曲线和色彩校正矩阵
+//
+// 下发白平衡控制和写入DNG色彩元数据都使用这里的数据，保证两者一致。
+
+#ifndef SENSOR_PROFILE_H
+#define SENSOR_PROFILE_H
+
+namespace cinepi {
+
+// 相机型号，写入DNG的Make/Model/UniqueCameraModel
+const char* const SENSOR_MAKE = "Raspberry Pi";
+const char* const SENSOR_MODEL = "IMX477";
+
+// 传感器黑电平（按位深缩放，12位时为256）
+int SensorBlackLevel(int bit_depth);
+
+// 色温到红/蓝增益（相对绿通道）
+void ColourGainsForTemperature(int kelvin, float& red_gain, float& blue_gain);
+
+// 色温对应的色彩校正矩阵（白平衡后的相机RGB到线性sRGB，行优先3x3）
+void ColourCorrectionMatrix(int kelvin, float ccm[9]);
+
+} // namespace cinepi
+
+#endif // SENSOR_PROFILE_H
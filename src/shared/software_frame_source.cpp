@@ -0,0 +1,215 @@
+// software_frame_source.cpp
+// 软件帧来源基类实现
+
+#include "software_frame_source.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "sensor_profile.h"
+
+namespace cinepi {
+
+namespace {
+
+// 缓冲池大小，与libcamera每个流的缓冲数保持一致
+const size_t POOL_SIZE = 6;
+
+} // namespace
+
+SoftwareFrameSource::SoftwareFrameSource() : fps_(30), running_(false) {
+}
+
+SoftwareFrameSource::~SoftwareFrameSource() {
+    // 派生类析构时已调用Close，这里只确保线程退出
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void SoftwareFrameSource::allocatePool(const FrameFormat& raw_format, unsigned int raw_width, unsigned int raw_height,
+                                       unsigned int raw_stride, unsigned int preview_width, unsigned int preview_height) {
+    raw_format_ = raw_format;
+
+    raw_template_ = FrameView();
+    raw_template_.width = raw_width;
+    raw_template_.height = raw_height;
+    raw_template_.stride = raw_stride;
+    raw_template_.size = static_cast<size_t>(raw_stride) * raw_height;
+    raw_template_.format = raw_format;
+
+    viewfinder_template_ = FrameView();
+    viewfinder_template_.width = preview_width;
+    viewfinder_template_.height = preview_height;
+    viewfinder_template_.stride = preview_width * 3;
+    viewfinder_template_.size = static_cast<size_t>(viewfinder_template_.stride) * preview_height;
+    viewfinder_template_.format = FrameFormat(PixelEncoding::RGB888, BayerOrder::RGGB, 8);
+
+    // 一次性分配全部帧内存，运行期间不再分配
+    if (LeasedSlotCount(slots_) > 0) {
+        throw std::runtime_error("仍有帧租约未释放，无法重新分配缓冲池");
+    }
+    buffers_.clear();
+    slots_.clear();
+    free_slots_.clear();
+    buffers_.resize(POOL_SIZE);
+    for (PoolBuffer& buffer : buffers_) {
+        buffer.raw.assign(raw_template_.size, 0);
+        buffer.viewfinder.assign(viewfinder_template_.size, 0);
+
+        std::unique_ptr<FrameSlot> slot(new FrameSlot());
+        slot->recycler = this;
+        slot->cookie = &buffer;
+        free_slots_.push_back(slot.get());
+        slots_.push_back(std::move(slot));
+    }
+
+    std::cout << Name() << " RAW: " << raw_width << "x" << raw_height << " " << PixelEncodingName(raw_format.encoding)
+              << " 步长 " << raw_stride << ", 预览 " << preview_width << "x" << preview_height
+              << ", " << fps_ << "fps" << std::endl;
+}
+
+std::chrono::nanoseconds SoftwareFrameSource::frameTime(uint64_t index) const {
+    return std::chrono::nanoseconds(static_cast<int64_t>(index * 1000000000ULL / static_cast<uint64_t>(std::max(fps_, 1))));
+}
+
+uint32_t SoftwareFrameSource::frameSequence(uint64_t index) const {
+    return static_cast<uint32_t>(index);
+}
+
+void SoftwareFrameSource::Start() {
+    if (running_ || slots_.empty()) {
+        return;
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    running_ = true;
+    thread_ = std::thread(&SoftwareFrameSource::run, this);
+}
+
+void SoftwareFrameSource::Stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void SoftwareFrameSource::Close() {
+    Stop();
+
+    // 消费者仍持有帧时不能释放帧槽和帧内存：先等待归还，超时后把这些帧槽连同帧内存故意泄漏；
+    // 等待期间不持有free_mutex_，归还的帧要进入空闲列表
+    if (WaitForLeases(slots_, LEASE_RELEASE_TIMEOUT) > 0) {
+        std::vector<FrameSlot*> abandoned = AbandonLeasedSlots(slots_);
+        for (FrameSlot* slot : abandoned) {
+            // 移动后数据指针不变，帧中的视图仍然有效
+            slot->cookie = new PoolBuffer(std::move(*static_cast<PoolBuffer*>(slot->cookie)));
+        }
+        std::cerr << "错误: 关闭" << Name() << "时仍有" << abandoned.size() << "个帧租约未释放，保留这些帧不释放" << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    free_slots_.clear();
+    slots_.clear();
+    buffers_.clear();
+}
+
+void SoftwareFrameSource::run() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds period(1000000000LL / std::max(fps_, 1));
+    uint64_t index = 0;
+    uint64_t control_generation = 0;
+    ControlSettings controls;
+    float red_gain = 1.0f;
+    float blue_gain = 1.0f;
+    ColourGainsForTemperature(controls.white_balance, red_gain, blue_gain);
+
+    while (running_) {
+        std::chrono::steady_clock::time_point due = start + frameTime(index);
+        std::this_thread::sleep_until(due);
+        if (!running_) {
+            break;
+        }
+        std::chrono::steady_clock::time_point wake_time = std::chrono::steady_clock::now();
+
+        // 与传感器一样，没有空闲缓冲时丢掉这一帧
+        FrameSlot* slot = takeFreeSlot();
+        if (!slot) {
+            reportStarvation();
+            ++index;
+            continue;
+        }
+
+        // 软件来源没有传感器流水线，新参数从下一帧起生效
+        if (takePendingControls(controls)) {
+            control_generation = controls.generation;
+            ColourGainsForTemperature(controls.white_balance, red_gain, blue_gain);
+        }
+
+        PoolBuffer& buffer = *static_cast<PoolBuffer*>(slot->cookie);
+        if (!fillFrame(buffer, index)) {
+            RecycleFrame(slot);
+            std::cout << Name() << ": 没有更多帧" << std::endl;
+            running_ = false;
+            break;
+        }
+
+        CapturedFrame& frame = slot->frame;
+        frame = CapturedFrame();
+        frame.sequence = frameSequence(index);
+        frame.control_generation = control_generation;
+        frame.sensor_timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wake_time.time_since_epoch()).count();
+        frame.completion_time_ns = MonotonicNowNs();
+        // 软件来源按控制参数填写曝光元数据，与传感器报告的格式一致
+        frame.exposure_time_us = 1000000 / std::max(fps_, 1);
+        frame.analogue_gain = controls.iso / 100.0f;
+        frame.colour_gains[0] = red_gain;
+        frame.colour_gains[1] = blue_gain;
+        frame.raw = raw_template_;
+        frame.raw.data = buffer.raw.data();
+        frame.viewfinder = viewfinder_template_;
+        frame.viewfinder.data = buffer.viewfinder.data();
+
+        FrameLease lease(slot);
+        deliverFrame(lease, std::chrono::steady_clock::now());
+        lease.Release();
+        ++index;
+
+        // 传感器不会等待应用：落后超过一帧时跳过错过的帧，序号间隙与真实丢帧一致
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        while (start + frameTime(index) + period < now) {
+            ++index;
+        }
+    }
+}
+
+FrameSlot* SoftwareFrameSource::takeFreeSlot() {
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    if (free_slots_.empty()) {
+        return nullptr;
+    }
+    FrameSlot* slot = free_slots_.back();
+    free_slots_.pop_back();
+    return slot;
+}
+
+void SoftwareFrameSource::RecycleFrame(FrameSlot* slot) {
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    free_slots_.push_back(slot);
+}
+
+int SoftwareFrameSource::outstandingLeases() const {
+    return static_cast<int>(LeasedSlotCount(slots_));
+}
+
+FrameLeaseStats SoftwareFrameSource::GetLeaseStats() const {
+    FrameLeaseStats stats;
+    stats.pool_size = static_cast<int>(slots_.size());
+    stats.leased = outstandingLeases();
+    stats.queued = stats.pool_size - stats.leased;
+    stats.starvation_events = starvationEvents();
+    return stats;
+}
+
+} // namespace cinepi
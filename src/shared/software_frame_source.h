@@ -0,0 +1,72 @@
+// software_frame_source.h
+// 软件帧来源基类：固定大小的内存缓冲池 + 按帧率节拍产生帧的线程
+//
+// 合成图案和文件回放共用这套机制，缓冲池和租约行为与libcamera一致，
+// 因此录制和预览的吞吐量可以在没有传感器的机器上测量。
+
+#ifndef SOFTWARE_FRAME_SOURCE_H
+#define SOFTWARE_FRAME_SOURCE_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "frame_source.h"
+
+namespace cinepi {
+
+class SoftwareFrameSource : public FrameSource, public FrameRecycler {
+public:
+    SoftwareFrameSource();
+    ~SoftwareFrameSource() override;
+
+    void Start() override;
+    void Stop() override;
+    void Close() override;
+    FrameFormat GetRawFormat() const override { return raw_format_; }
+    size_t GetRawFrameBytes() const override { return raw_template_.size; }
+    FrameLeaseStats GetLeaseStats() const override;
+
+protected:
+    // 缓冲池中每一帧的内存
+    struct PoolBuffer {
+        std::vector<uint8_t> raw;
+        std::vector<uint8_t> viewfinder;
+    };
+
+    // 派生类在Open中调用，分配缓冲池并设置帧格式
+    void allocatePool(const FrameFormat& raw_format, unsigned int raw_width, unsigned int raw_height,
+                      unsigned int raw_stride, unsigned int preview_width, unsigned int preview_height);
+
+    // 填充第index帧，返回false表示没有更多帧
+    virtual bool fillFrame(PoolBuffer& buffer, uint64_t index) = 0;
+
+    // 第index帧相对于开始时刻的时间，默认按固定帧率
+    virtual std::chrono::nanoseconds frameTime(uint64_t index) const;
+
+    // 第index帧的帧序号，默认与index相同
+    virtual uint32_t frameSequence(uint64_t index) const;
+
+    int fps_;
+    FrameFormat raw_format_;
+    FrameView raw_template_;
+    FrameView viewfinder_template_;
+
+private:
+    std::vector<std::unique_ptr<FrameSlot>> slots_;
+    std::vector<PoolBuffer> buffers_;
+    std::mutex free_mutex_;
+    std::vector<FrameSlot*> free_slots_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+
+    void run();
+    FrameSlot* takeFreeSlot();
+    int outstandingLeases() const;
+    void RecycleFrame(FrameSlot* slot) override;
+};
+
+} // namespace cinepi
+
+#endif // SOFTWARE_FRAME_SOURCE_H
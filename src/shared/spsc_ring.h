@@ -0,0 +1,83 @@
+// spsc_ring.h
+// 有界无锁环形队列，单生产者/单消费者
+//
+// 采集线程压入帧租约，写入线程取出；两端各自只修改自己的索引，
+// 队列满或空时立即返回，等待策略由调用者决定。
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace cinepi {
+
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity = 0) : head_(0), tail_(0) {
+        Reset(capacity);
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // 重新设置容量，只能在两端都停止时调用
+    void Reset(size_t capacity) {
+        // 多留一个空位区分满和空
+        slots_.clear();
+        slots_.resize(capacity + 1);
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    size_t Capacity() const { return slots_.size() - 1; }
+
+    // 生产者：压入一项，队列满时返回false且不移动value
+    bool TryPush(T&& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t next = advance(tail);
+        if (next == head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        slots_[tail] = std::move(value);
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者：取出一项，队列空时返回false
+    bool TryPop(T& value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(slots_[head]);
+        slots_[head] = T();
+        head_.store(advance(head), std::memory_order_release);
+        return true;
+    }
+
+    // 当前队列长度（两端并发时只是近似值）
+    size_t Size() const {
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        return tail >= head ? tail - head : tail + slots_.size() - head;
+    }
+
+private:
+    size_t advance(size_t index) const {
+        return index + 1 == slots_.size() ? 0 : index + 1;
+    }
+
+    std::vector<T> slots_;
+
+    // 消费者写head_，生产者写tail_，分开缓存行避免互相失效
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+};
+
+} // namespace cinepi
+
+#endif // SPSC_RING_H
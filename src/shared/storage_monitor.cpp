@@ -0,0 +1,253 @@
+// storage_monitor.cpp
+// 录制存储监视实现
+
+#include "storage_monitor.h"
+#include "frame_types.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+namespace cinepi {
+
+namespace {
+
+const double MB = 1024.0 * 1024.0;
+const size_t PROBE_CHUNK = 4 * 1024 * 1024;            // 测速单次写入长度
+const uint64_t MIN_PROBE_BYTES = 16 * 1024 * 1024;      // 中止时至少写了这么多才采用结果
+const int64_t BANDWIDTH_WINDOW_NS = 1000000000;         // 实测带宽的采样窗口
+const int64_t SPACE_INTERVAL_NS = 250000000;            // statvfs采样间隔
+const double MIN_RECORD_SECONDS = 10.0;                 // 剩余空间至少能录这么久才开始录制
+const double MIN_SUSTAINED_SECONDS = 5.0;               // 录制短于此时不采用其平均速度
+const double BANDWIDTH_HEADROOM = 1.2;                  // 低于需求的1.2倍时提示余量不足
+
+} // namespace
+
+StorageMonitor::StorageMonitor()
+    : probe_cancel_(false),
+      probing_(false),
+      probe_mb_per_s_(0.0),
+      snapshot_(),
+      recording_(false),
+      sustained_mb_per_s_(0.0),
+      pending_bytes_(0),
+      last_space_ns_(0),
+      window_start_ns_(0),
+      window_start_bytes_(0),
+      record_start_ns_(0) {
+}
+
+StorageMonitor::~StorageMonitor() {
+    stopProbe();
+}
+
+void StorageMonitor::Open(const std::string& dir, const StorageConfig& config) {
+    stopProbe();
+    dir_ = dir;
+    config_ = config;
+    snapshot_ = StorageSnapshot();
+    recording_ = false;
+    pending_bytes_ = 0;
+    sampleSpace(MonotonicNowNs());
+
+    {
+        std::lock_guard<std::mutex> lock(probe_mutex_);
+        probe_mb_per_s_ = 0.0;
+    }
+    if (config_.probe_bytes > 0) {
+        probe_cancel_.store(false);
+        probing_.store(true);
+        probe_thread_ = std::thread(&StorageMonitor::probe, this);
+    }
+}
+
+void StorageMonitor::stopProbe() {
+    probe_cancel_.store(true);
+    if (probe_thread_.joinable()) {
+        probe_thread_.join();
+    }
+}
+
+void StorageMonitor::probe() {
+    std::string path = dir_ + "/.cinepi_probe.tmp";
+    void* buffer = nullptr;
+    int fd = -1;
+
+    struct statvfs vfs;
+    if (::statvfs(dir_.c_str(), &vfs) == 0 &&
+        static_cast<uint64_t>(vfs.f_bavail) * vfs.f_frsize < config_.probe_bytes + config_.reserve_bytes) {
+        std::cerr << "警告: 剩余空间不足，跳过存储测速" << std::endl;
+        probing_.store(false);
+        return;
+    }
+
+    // 用O_DIRECT绕过页缓存，最后fdatasync，测到的是盘的持续写入速度
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (fd < 0 && errno == EINVAL) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (fd < 0 || posix_memalign(&buffer, 4096, PROBE_CHUNK) != 0) {
+        std::cerr << "警告: 无法进行存储测速: " << path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            ::close(fd);
+            ::unlink(path.c_str());
+        }
+        probing_.store(false);
+        return;
+    }
+    std::memset(buffer, 0x5a, PROBE_CHUNK);
+
+    uint64_t written = 0;
+    int64_t start_ns = MonotonicNowNs();
+    while (written < config_.probe_bytes && !probe_cancel_.load()) {
+        ssize_t n = ::write(fd, buffer, PROBE_CHUNK);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            std::cerr << "警告: 存储测速写入失败: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        written += static_cast<uint64_t>(n);
+    }
+    ::fdatasync(fd);
+    double seconds = (MonotonicNowNs() - start_ns) / 1e9;
+    ::close(fd);
+    ::unlink(path.c_str());
+    std::free(buffer);
+
+    if (written >= MIN_PROBE_BYTES && seconds > 0) {
+        double rate = written / MB / seconds;
+        {
+            std::lock_guard<std::mutex> lock(probe_mutex_);
+            probe_mb_per_s_ = rate;
+        }
+        std::cout << "存储测速: " << static_cast<int>(rate) << "MB/s (写入 " << written / (1024 * 1024) << "MB)" << std::endl;
+    }
+    probing_.store(false);
+}
+
+double StorageMonitor::knownBandwidth() const {
+    double probe_rate;
+    {
+        std::lock_guard<std::mutex> lock(probe_mutex_);
+        probe_rate = probe_mb_per_s_;
+    }
+    // 两者都有时取较小值：页缓存会让短录制的平均速度偏高
+    if (probe_rate > 0 && sustained_mb_per_s_ > 0) {
+        return std::min(probe_rate, sustained_mb_per_s_);
+    }
+    return std::max(probe_rate, sustained_mb_per_s_);
+}
+
+void StorageMonitor::sampleSpace(int64_t now_ns) {
+    last_space_ns_ = now_ns;
+    struct statvfs vfs;
+    if (::statvfs(dir_.c_str(), &vfs) != 0) {
+        return;
+    }
+    snapshot_.total_bytes = static_cast<uint64_t>(vfs.f_blocks) * vfs.f_frsize;
+    snapshot_.free_bytes = static_cast<uint64_t>(vfs.f_bavail) * vfs.f_frsize;
+
+    // 队列中的帧停止录制后仍要落盘，保留线要把它们算进去
+    uint64_t floor = config_.reserve_bytes + (recording_ ? pending_bytes_ : 0);
+    uint64_t usable = snapshot_.free_bytes > floor ? snapshot_.free_bytes - floor : 0;
+    snapshot_.remaining_seconds = snapshot_.required_mb_per_s > 0 ? usable / MB / snapshot_.required_mb_per_s : 0.0;
+    snapshot_.reserve_reached = recording_ && snapshot_.free_bytes <= floor;
+}
+
+bool StorageMonitor::Admit(double required_mb_per_s, uint64_t buffer_bytes, std::string& message) {
+    message.clear();
+    if (probing_.load()) {
+        std::cerr << "存储测速未完成，使用已测得的部分" << std::endl;
+    }
+    stopProbe();
+
+    snapshot_.required_mb_per_s = required_mb_per_s;
+    sampleSpace(MonotonicNowNs());
+
+    std::ostringstream text;
+    text.setf(std::ios::fixed);
+    text.precision(1);
+    if (snapshot_.remaining_seconds < MIN_RECORD_SECONDS) {
+        text << "剩余空间不足: 可用 " << snapshot_.free_bytes / MB / 1024.0 << "GB, 保留 "
+             << config_.reserve_bytes / MB / 1024.0 << "GB, 可录制 " << snapshot_.remaining_seconds << "s";
+        message = text.str();
+        return false;
+    }
+
+    double bandwidth = knownBandwidth();
+    if (bandwidth <= 0) {
+        text << "未测得存储带宽，无法确认能否持续写入 " << required_mb_per_s << "MB/s";
+        message = text.str();
+        return true;
+    }
+    if (bandwidth < required_mb_per_s) {
+        // 写入队列能吸收的时长：队列按需求与实际带宽之差填满
+        double buffer_seconds = buffer_bytes / MB / (required_mb_per_s - bandwidth);
+        text << "存储带宽不足: 实测 " << bandwidth << "MB/s, 需要 " << required_mb_per_s << "MB/s, 写入队列约 "
+             << buffer_seconds << "s 后开始丢帧";
+        message = text.str();
+        return !config_.require_bandwidth;
+    }
+    if (bandwidth < required_mb_per_s * BANDWIDTH_HEADROOM) {
+        text << "存储带宽余量不足: 实测 " << bandwidth << "MB/s, 需要 " << required_mb_per_s << "MB/s";
+        message = text.str();
+    }
+    return true;
+}
+
+void StorageMonitor::BeginRecording() {
+    int64_t now_ns = MonotonicNowNs();
+    recording_ = true;
+    record_start_ns_ = now_ns;
+    window_start_ns_ = now_ns;
+    window_start_bytes_ = 0;
+    pending_bytes_ = 0;
+    snapshot_.measured_mb_per_s = 0.0;
+    snapshot_.reserve_reached = false;
+}
+
+void StorageMonitor::EndRecording(double mean_mb_per_s) {
+    if (!recording_) {
+        return;
+    }
+    recording_ = false;
+    if ((MonotonicNowNs() - record_start_ns_) / 1e9 >= MIN_SUSTAINED_SECONDS && mean_mb_per_s > 0) {
+        sustained_mb_per_s_ = mean_mb_per_s;
+    }
+    snapshot_.reserve_reached = false;
+}
+
+void StorageMonitor::Update(double required_mb_per_s, uint64_t bytes_written, uint64_t pending_bytes) {
+    int64_t now_ns = MonotonicNowNs();
+    snapshot_.required_mb_per_s = required_mb_per_s;
+    pending_bytes_ = pending_bytes;
+
+    if (recording_ && now_ns - window_start_ns_ >= BANDWIDTH_WINDOW_NS) {
+        double rate = (bytes_written - window_start_bytes_) / MB / ((now_ns - window_start_ns_) / 1e9);
+        snapshot_.measured_mb_per_s = snapshot_.measured_mb_per_s > 0 ? 0.5 * snapshot_.measured_mb_per_s + 0.5 * rate : rate;
+        window_start_ns_ = now_ns;
+        window_start_bytes_ = bytes_written;
+    }
+    if (now_ns - last_space_ns_ >= SPACE_INTERVAL_NS) {
+        sampleSpace(now_ns);
+    }
+}
+
+StorageSnapshot StorageMonitor::Snapshot() const {
+    StorageSnapshot snapshot = snapshot_;
+    {
+        std::lock_guard<std::mutex> lock(probe_mutex_);
+        snapshot.probe_mb_per_s = probe_mb_per_s_;
+    }
+    snapshot.probing = probing_.load();
+    return snapshot;
+}
+
+} // namespace cinepi
@@ -0,0 +1,97 @@
+// storage_monitor.h
+// 录制存储监视：剩余空间、实测写入带宽和录制准入
+//
+// 启动时在后台向录制目录写入一段测速文件（O_DIRECT + fdatasync，测的是盘而不是页缓存），
+// 开始录制前用测速结果和上一次录制的实测速度判断目标盘能否跟上分辨率×帧率×位深度的数据率；
+// 录制中按写入统计计算实际落盘速度，按statvfs估算剩余可录时长，
+// 剩余空间低于保留值加上队列中尚未落盘的数据时通知调用者停止录制，不在写到一半时遇到ENOSPC。
+// 除测速线程外所有调用都在UI线程进行。
+
+#ifndef STORAGE_MONITOR_H
+#define STORAGE_MONITOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace cinepi {
+
+// 存储监视配置
+struct StorageConfig {
+    uint64_t reserve_bytes;     // 保留空间，录制到这里为止
+    uint64_t probe_bytes;       // 启动时测速写入量，0表示不测速
+    bool require_bandwidth;     // 带宽或编码速度不足时拒绝开始录制，否则只警告
+
+    StorageConfig() : reserve_bytes(1024ull * 1024 * 1024), probe_bytes(128ull * 1024 * 1024),
+                      require_bandwidth(false) {}
+};
+
+// 存储状态快照
+struct StorageSnapshot {
+    uint64_t total_bytes;
+    uint64_t free_bytes;            // 非特权用户可用的空间
+    double probe_mb_per_s;          // 启动测速结果，0表示没有结果
+    double measured_mb_per_s;       // 录制中最近的落盘速度，0表示还没有样本
+    double required_mb_per_s;       // 当前录制需要的数据率
+    double remaining_seconds;       // 按需要的数据率写到保留线还能录制的时长
+    bool probing;                   // 测速进行中
+    bool reserve_reached;           // 剩余空间已到保留线，应停止录制
+};
+
+class StorageMonitor {
+public:
+    StorageMonitor();
+    ~StorageMonitor();
+
+    StorageMonitor(const StorageMonitor&) = delete;
+    StorageMonitor& operator=(const StorageMonitor&) = delete;
+
+    // 开始监视录制目录，配置了测速时在后台测速
+    void Open(const std::string& dir, const StorageConfig& config);
+
+    // 开始录制前检查：空间不足（或要求带宽时带宽不足）返回false；
+    // 有需要提示的情况时写入message。测速未完成时中止测速，使用已测得的部分
+    bool Admit(double required_mb_per_s, uint64_t buffer_bytes, std::string& message);
+
+    // 录制开始/结束；结束时保存本次的平均落盘速度，作为下一次准入的依据
+    void BeginRecording();
+    void EndRecording(double mean_mb_per_s);
+
+    // 定期调用（未录制时也调用，用于估算可录时长）：
+    // bytes_written为本次录制已落盘字节数，pending_bytes为队列中尚未落盘的字节数
+    void Update(double required_mb_per_s, uint64_t bytes_written, uint64_t pending_bytes);
+
+    StorageSnapshot Snapshot() const;
+
+    const StorageConfig& Config() const { return config_; }
+
+private:
+    std::string dir_;
+    StorageConfig config_;
+
+    std::thread probe_thread_;
+    std::atomic<bool> probe_cancel_;
+    std::atomic<bool> probing_;
+    mutable std::mutex probe_mutex_;
+    double probe_mb_per_s_;
+
+    StorageSnapshot snapshot_;
+    bool recording_;
+    double sustained_mb_per_s_;         // 上一次录制的平均落盘速度
+    uint64_t pending_bytes_;
+    int64_t last_space_ns_;
+    int64_t window_start_ns_;           // 带宽采样窗口
+    uint64_t window_start_bytes_;
+    int64_t record_start_ns_;
+
+    void probe();
+    void stopProbe();
+    void sampleSpace(int64_t now_ns);
+    double knownBandwidth() const;
+};
+
+} // namespace cinepi
+
+#endif // STORAGE_MONITOR_H
@@ -0,0 +1,107 @@
+// synthetic_frame_source.cpp
+// 合成帧来源实现
+
+#include "synthetic_frame_source.h"
+#include <cstring>
+#include <stdexcept>
+#include "bit_pack.h"
+#include "debayer.h"
+
+namespace cinepi {
+
+namespace {
+
+// 彩条：白、黄、青、绿、品红、红、蓝、黑（线性值，0~1）
+const float COLOR_BARS[8][3] = {
+    { 0.75f, 0.75f, 0.75f }, { 0.75f, 0.75f, 0.0f }, { 0.0f, 0.75f, 0.75f }, { 0.0f, 0.75f, 0.0f },
+    { 0.75f, 0.0f, 0.75f }, { 0.75f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.75f }, { 0.0f, 0.0f, 0.0f },
+};
+
+// 上2/3为彩条，下1/3为从黑到传感器饱和的水平灰阶
+float patternValue(unsigned int x, unsigned int y, unsigned int width, unsigned int height, int channel) {
+    if (y < height * 2 / 3) {
+        return COLOR_BARS[x * 8 / width][channel];
+    }
+    return static_cast<float>(x) / static_cast<float>(width - 1);
+}
+
+// 2x2块中各位置对应的颜色通道（0红 1绿 2蓝）
+int bayerChannel(BayerOrder order, unsigned int x, unsigned int y) {
+    static const int CHANNELS[4][4] = {
+        { 0, 1, 1, 2 },     // RGGB
+        { 1, 0, 2, 1 },     // GRBG
+        { 1, 2, 0, 1 },     // GBRG
+        { 2, 1, 1, 0 },     // BGGR
+    };
+    return CHANNELS[static_cast<int>(order)][(y & 1) * 2 + (x & 1)];
+}
+
+} // namespace
+
+SyntheticFrameSource::SyntheticFrameSource() {
+}
+
+SyntheticFrameSource::~SyntheticFrameSource() {
+    Close();
+}
+
+void SyntheticFrameSource::Open(const CameraParams& params) {
+    if (params.width < 16 || params.height < 16) {
+        throw std::runtime_error("合成图案分辨率无效");
+    }
+
+    // 宽高取偶数以保持完整的Bayer块
+    unsigned int width = static_cast<unsigned int>(params.width) & ~1u;
+    unsigned int height = static_cast<unsigned int>(params.height) & ~1u;
+    PixelEncoding encoding = PackedEncodingForBitDepth(params.bit_depth);
+    int bit_depth = EncodingBitDepth(encoding);
+    FrameFormat format(encoding, BayerOrder::RGGB, bit_depth);
+
+    // RAW预览时不生成取景帧
+    unsigned int preview_width = params.raw_preview ? 0 : static_cast<unsigned int>(params.PreviewWidth());
+    unsigned int preview_height = params.raw_preview ? 0 : static_cast<unsigned int>(params.PreviewHeight());
+
+    fps_ = params.fps;
+    allocatePool(format, width, height, AlignedRawStride(encoding, width), preview_width, preview_height);
+
+    // 生成RAW图案
+    pattern_raw_.assign(raw_template_.size, 0);
+    std::vector<uint16_t> row(width);
+    float max_value = static_cast<float>((1 << bit_depth) - 1);
+    for (unsigned int y = 0; y < height; ++y) {
+        for (unsigned int x = 0; x < width; ++x) {
+            float value = patternValue(x, y, width, height, bayerChannel(format.bayer_order, x, y));
+            row[x] = static_cast<uint16_t>(value * max_value + 0.5f);
+        }
+        PackRow(encoding, row.data(), pattern_raw_.data() + static_cast<size_t>(y) * raw_template_.stride, width);
+    }
+
+    // 预览图案由RAW图案去马赛克得到
+    FrameView raw_view = raw_template_;
+    raw_view.data = pattern_raw_.data();
+    pattern_viewfinder_.assign(viewfinder_template_.size, 0);
+    DebayerToRGB888(raw_view, pattern_viewfinder_.data(), preview_width, preview_height, viewfinder_template_.stride);
+}
+
+bool SyntheticFrameSource::fillFrame(PoolBuffer& buffer, uint64_t index) {
+    // 每帧向上滚动两行（保持Bayer行相位），预览按比例滚动
+    unsigned int height = raw_template_.height;
+    size_t stride = raw_template_.stride;
+    unsigned int offset = static_cast<unsigned int>((index * 2) % height);
+    size_t split = static_cast<size_t>(height - offset) * stride;
+    memcpy(buffer.raw.data(), pattern_raw_.data() + static_cast<size_t>(offset) * stride, split);
+    memcpy(buffer.raw.data() + split, pattern_raw_.data(), static_cast<size_t>(offset) * stride);
+
+    if (buffer.viewfinder.empty()) {
+        return true;
+    }
+    unsigned int preview_height = viewfinder_template_.height;
+    size_t preview_stride = viewfinder_template_.stride;
+    unsigned int preview_offset = static_cast<unsigned int>(static_cast<uint64_t>(offset) * preview_height / height);
+    size_t preview_split = static_cast<size_t>(preview_height - preview_offset) * preview_stride;
+    memcpy(buffer.viewfinder.data(), pattern_viewfinder_.data() + static_cast<size_t>(preview_offset) * preview_stride, preview_split);
+    memcpy(buffer.viewfinder.data() + preview_split, pattern_viewfinder_.data(), static_cast<size_t>(preview_offset) * preview_stride);
+    return true;
+}
+
+} // namespace cinepi
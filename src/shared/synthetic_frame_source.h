@@ -0,0 +1,31 @@
+// synthetic_frame_source.h
+// 合成帧来源：生成滚动的彩条Bayer图案，分辨率、帧率、位深度可配置
+
+#ifndef SYNTHETIC_FRAME_SOURCE_H
+#define SYNTHETIC_FRAME_SOURCE_H
+
+#include <vector>
+#include "software_frame_source.h"
+
+namespace cinepi {
+
+class SyntheticFrameSource : public SoftwareFrameSource {
+public:
+    SyntheticFrameSource();
+    ~SyntheticFrameSource() override;
+
+    const char* Name() const override { return "synthetic"; }
+    void Open(const CameraParams& params) override;
+
+protected:
+    bool fillFrame(PoolBuffer& buffer, uint64_t index) override;
+
+private:
+    // 预先生成的一帧图案，每帧按行滚动复制，内存带宽与真实数据一致
+    std::vector<uint8_t> pattern_raw_;
+    std::vector<uint8_t> pattern_viewfinder_;
+};
+
+} // namespace cinepi
+
+#endif // SYNTHETIC_FRAME_SOURCE_H
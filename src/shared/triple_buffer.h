@@ -0,0 +1,76 @@
+// triple_buffer.h
+// 无锁三缓冲，用于单生产者/单消费者之间传递最新一帧
+//
+// 生产者写入后台槽并发布，永不阻塞；消费者总是取到最新的完整帧。
+// 三个槽在后台、中间、前台之间通过一次原子交换轮转，槽内数据本身不需要同步。
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace cinepi {
+
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle_(1), back_(0), front_(2), produced_(0) {
+        for (uint64_t& generation : generations_) {
+            generation = 0;
+        }
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // 直接访问所有槽，仅用于启动前的初始化（例如预分配内存）
+    T& Slot(int index) { return slots_[index]; }
+
+    // 生产者：获取可写的后台槽
+    T& WriteSlot() { return slots_[back_]; }
+
+    // 生产者：发布后台槽，与中间槽交换，返回本帧的代数
+    uint64_t Publish() {
+        generations_[back_] = ++produced_;
+        uint32_t previous = middle_.exchange(back_ | FRESH_BIT, std::memory_order_acq_rel);
+        back_ = previous & INDEX_MASK;
+        return produced_;
+    }
+
+    // 消费者：如果有新发布的帧则换到前台，返回是否有更新
+    bool Update() {
+        if ((middle_.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+            return false;
+        }
+        uint32_t previous = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = previous & INDEX_MASK;
+        return true;
+    }
+
+    // 消费者：当前前台槽及其代数（0表示尚未收到任何帧）
+    const T& ReadSlot() const { return slots_[front_]; }
+    T& ReadSlot() { return slots_[front_]; }
+    uint64_t ReadGeneration() const { return generations_[front_]; }
+
+private:
+    static const uint32_t INDEX_MASK = 0x3;
+    static const uint32_t FRESH_BIT = 0x4;
+
+    T slots_[3];
+    uint64_t generations_[3];
+
+    // 中间槽索引 + 新帧标志，是生产者和消费者唯一共享的状态
+    std::atomic<uint32_t> middle_;
+
+    // 只由生产者访问
+    uint32_t back_;
+    // 只由消费者访问
+    uint32_t front_;
+    // 只由生产者访问
+    uint64_t produced_;
+};
+
+} // namespace cinepi
+
+#endif // TRIPLE_BUFFER_H
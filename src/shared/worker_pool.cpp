@@ -0,0 +1,78 @@
+// worker_pool.cpp
+// 工作线程池实现
+
+#include "worker_pool.h"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+namespace cinepi {
+
+WorkerPool::WorkerPool(size_t threads) : active_(0), stopping_(false) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    // 先执行完已提交的任务再退出
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::Submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    work_cv_.notify_one();
+}
+
+void WorkerPool::WaitIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cv_.wait(lock, [this] { return tasks_.empty() && active_ == 0; });
+}
+
+size_t WorkerPool::Pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tasks_.size() + active_;
+}
+
+void WorkerPool::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+            return;
+        }
+        std::function<void()> task = std::move(tasks_.front());
+        tasks_.pop_front();
+        ++active_;
+
+        lock.unlock();
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "工作线程任务异常: " << e.what() << std::endl;
+        }
+        // 任务捕获的资源（例如帧租约）在报告空闲之前释放
+        task = nullptr;
+        lock.lock();
+
+        --active_;
+        if (tasks_.empty() && active_ == 0) {
+            idle_cv_.notify_all();
+        }
+    }
+}
+
+} // namespace cinepi
@@ -0,0 +1,53 @@
+// worker_pool.h
+// 固定大小的工作线程池，用于逐帧编码等可以并行的任务
+//
+// 线程在构造时创建、析构时退出，运行期间不再创建线程；任务按提交顺序开始执行。
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cinepi {
+
+class WorkerPool {
+public:
+    // threads为0时使用全部CPU核心
+    explicit WorkerPool(size_t threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t Size() const { return threads_.size(); }
+
+    // 提交任务，立即返回
+    void Submit(std::function<void()> task);
+
+    // 等待已提交的任务全部完成
+    void WaitIdle();
+
+    // 排队和正在执行的任务数
+    size_t Pending() const;
+
+private:
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()>> tasks_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable idle_cv_;
+    size_t active_;
+    bool stopping_;
+
+    void run();
+};
+
+} // namespace cinepi
+
+#endif // WORKER_POOL_H